@@ -45,10 +45,14 @@
 ;; to do so with holding C-level mutex, since Scheme procedure may
 ;; take indefinitely long.  So we use Scheme-level slot to keep the
 ;; thread that is working on the queue.
+;;
+;; <mpmc-queue> is a bounded thread-safe queue that doesn't take locks
+;; to enqueue and dequeue.  It is not a subclass of <queue>; enqueue!,
+;; dequeue! and the */wait! variants dispatch on it in C.
 
 (define-module data.queue
-  (export <queue> <mtqueue>
-          make-queue make-mtqueue queue? mtqueue?
+  (export <queue> <mtqueue> <mpmc-queue>
+          make-queue make-mtqueue make-mpmc-queue queue? mtqueue? mpmc-queue?
           queue-length mtqueue-max-length mtqueue-room
           mtqueue-num-waiting-readers
           queue-empty? copy-queue
@@ -281,6 +285,250 @@
  (define-cproc %notify-readers (q::<mtqueue>) ::<void> (notify-readers q))
  )
 
+;;;
+;;;  <mpmc-queue>
+;;;
+
+;; A bounded queue that multiple producers and consumers can access
+;; without locking.  We use Dmitry Vyukov's algorithm: each cell of the
+;; ring buffer has a sequence number that tells whether the cell is ready
+;; to be written or read in the current lap, so a producer or a consumer
+;; only needs one CAS on the position counter to claim a cell.
+;;
+;; The mutex and condition variables are only used by the threads that
+;; have to wait for the queue to be non-empty or non-full.  The producers
+;; and the consumers check the number of waiters and skip the notification
+;; if no one is waiting.  A waiter increments the count and then checks
+;; the queue again; a notifier updates the queue and then checks the count.
+;; Each side puts a full fence between its store and its load, so either
+;; the waiter sees the new item or the notifier sees the waiter.  (Plain
+;; Scm_AtomicLoad/Store don't guarantee that by themselves; with
+;; libatomic_ops they're unordered with each other.)
+
+(inline-stub
+ (.include <gauche/priv/atomicP.h>)
+
+ (define-ctype MpmcCell::(.struct
+                          (seq::ScmAtomicVar
+                           data)))
+
+ (define-ctype MpmcQueue::(.struct
+                           (SCM_INSTANCE_HEADER :: ""
+                            mask::ScmAtomicWord ; capacity - 1
+                            cells::MpmcCell*
+                            enqPos::ScmAtomicVar
+                            deqPos::ScmAtomicVar
+                            closed::ScmAtomicVar
+                            numReaders::ScmAtomicVar ; modified under mutex
+                            numWriters::ScmAtomicVar ; modified under mutex
+                            mutex::ScmInternalMutex
+                            readerWait::ScmInternalCond
+                            writerWait::ScmInternalCond)))
+
+ "SCM_CLASS_DECL(MpmcQueueClass);"
+
+ (.define MPMCQP (obj) (SCM_ISA obj (& MpmcQueueClass)))
+ (.define MPMCQ (obj) (cast MpmcQueue* obj))
+ (.define MPMCQ_CAPACITY (q) (+ (-> (MPMCQ q) mask) 1))
+ (.define MPMCQ_CLOSED (q) (Scm_AtomicLoad (& (-> (MPMCQ q) closed))))
+
+ ;; CAPACITY is rounded up to a power of two.
+ (define-cfn makempmcq (klass::ScmClass* capacity::ScmSmallInt)
+   (let* ([z::MpmcQueue* (SCM_NEW_INSTANCE MpmcQueue klass)]
+          [size::ScmAtomicWord 1])
+     (when (<= capacity 0)
+       (Scm_Error "capacity must be a positive fixnum, but got: %ld" capacity))
+     (while (< size (cast ScmAtomicWord capacity))
+       (set! size (<< size 1)))
+     (set! (-> z mask) (- size 1)
+           (-> z cells) (SCM_NEW_ARRAY MpmcCell size))
+     (dotimes [i size]
+       (let* ([c::MpmcCell* (+ (-> z cells) i)])
+         (Scm_AtomicStore (& (-> c seq)) i)
+         (set! (-> c data) SCM_FALSE)))
+     (Scm_AtomicStore (& (-> z enqPos)) 0)
+     (Scm_AtomicStore (& (-> z deqPos)) 0)
+     (Scm_AtomicStore (& (-> z closed)) FALSE)
+     (Scm_AtomicStore (& (-> z numReaders)) 0)
+     (Scm_AtomicStore (& (-> z numWriters)) 0)
+     (SCM_INTERNAL_MUTEX_INIT (-> z mutex))
+     (SCM_INTERNAL_COND_INIT (-> z readerWait))
+     (SCM_INTERNAL_COND_INIT (-> z writerWait))
+     (return (SCM_OBJ z))))
+
+ ;; The number of items.  It is only a snapshot while other threads
+ ;; are working on the queue.
+ (define-cfn mpmcq-length (q::MpmcQueue*) ::ScmSmallInt
+   (let* ([d::ScmAtomicWord (Scm_AtomicLoad (& (-> q deqPos)))]
+          [e::ScmAtomicWord (Scm_AtomicLoad (& (-> q enqPos)))]
+          [n::intptr_t (cast intptr_t (- e d))])
+     (cond [(< n 0) (return 0)]
+           [(> n (cast intptr_t (+ (-> q mask) 1)))
+            (return (+ (-> q mask) 1))]
+           [else (return n)])))
+
+ (define-cclass <mpmc-queue>
+   "MpmcQueue*" "MpmcQueueClass" ()
+   ((max-length :getter "return SCM_MAKE_INT(MPMCQ_CAPACITY(obj));"
+                :setter #f)
+    (closed     :getter "return SCM_MAKE_BOOL(MPMCQ_CLOSED(obj));"
+                :setter #f))
+   (allocator
+    (let* ([ml (Scm_GetKeyword ':max-length initargs SCM_FALSE)])
+      (unless (SCM_INTP ml)
+        (Scm_Error "<mpmc-queue> requires :max-length, but got: %S" ml))
+      (return (makempmcq klass (SCM_INT_VALUE ml)))))
+   (printer
+    (Scm_Printf port "#<mpmc-queue %ld/%ld %s@%p>"
+                (mpmcq-length (MPMCQ obj))
+                (cast long (MPMCQ_CAPACITY obj))
+                (?: (MPMCQ_CLOSED obj) "(closed)" "")
+                obj))
+   (c-predicate "MPMCQP")
+   (unboxer "MPMCQ"))
+
+ ;; Returns TRUE if OBJ is enqueued, FALSE if the queue is full.
+ (define-cfn mpmcq-try-enqueue (q::MpmcQueue* obj) ::int
+   (let* ([pos::ScmAtomicWord (Scm_AtomicLoad (& (-> q enqPos)))])
+     (while TRUE
+       (let* ([cell::MpmcCell* (+ (-> q cells) (logand pos (-> q mask)))]
+              [seq::ScmAtomicWord (Scm_AtomicLoad (& (-> cell seq)))]
+              [diff::intptr_t (- (cast intptr_t seq) (cast intptr_t pos))])
+         (cond [(== diff 0)
+                ;; The cell is free in this lap.  Claim it.  If we fail,
+                ;; POS is updated with the current enqPos.
+                (when (Scm_AtomicCompareExchange (& (-> q enqPos))
+                                                 (& pos) (+ pos 1))
+                  (set! (-> cell data) obj)
+                  ;; Full store, so that DATA is written before SEQ
+                  ;; publishes it.  (With libatomic_ops, Scm_AtomicStore
+                  ;; has no release ordering.)
+                  (Scm_AtomicStoreFull (& (-> cell seq)) (+ pos 1))
+                  (return TRUE))]
+               [(< diff 0) (return FALSE)] ; the cell isn't consumed yet
+               [else (set! pos (Scm_AtomicLoad (& (-> q enqPos))))])))))
+
+ ;; Returns TRUE and sets *RESULT if an item is dequeued, FALSE if
+ ;; the queue is empty.
+ (define-cfn mpmcq-try-dequeue (q::MpmcQueue* result::ScmObj*) ::int
+   (let* ([pos::ScmAtomicWord (Scm_AtomicLoad (& (-> q deqPos)))])
+     (while TRUE
+       (let* ([cell::MpmcCell* (+ (-> q cells) (logand pos (-> q mask)))]
+              [seq::ScmAtomicWord (Scm_AtomicLoad (& (-> cell seq)))]
+              [diff::intptr_t (- (cast intptr_t seq) (cast intptr_t (+ pos 1)))])
+         (cond [(== diff 0)
+                (when (Scm_AtomicCompareExchange (& (-> q deqPos))
+                                                 (& pos) (+ pos 1))
+                  (set! (* result) (-> cell data)
+                        (-> cell data) SCM_FALSE) ; to be friendly to GC
+                  ;; Make the cell available for the next lap, after
+                  ;; we're done with DATA.
+                  (Scm_AtomicStoreFull (& (-> cell seq))
+                                       (+ pos (-> q mask) 1))
+                  (return TRUE))]
+               [(< diff 0) (return FALSE)] ; the cell isn't filled yet
+               [else (set! pos (Scm_AtomicLoad (& (-> q deqPos))))])))))
+
+ ;; Called after updating the queue.  See the comment above for the fence.
+ (define-cise-stmt mpmcq-notify
+   [(_ q counter cv)
+    `(begin
+       (Scm_AtomicThreadFence)
+       (when (> (Scm_AtomicLoad (& (-> ,q ,counter))) 0)
+         (SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN (-> ,q mutex))
+         (SCM_INTERNAL_COND_BROADCAST (-> ,q ,cv))
+         (SCM_INTERNAL_MUTEX_SAFE_LOCK_END)))])
+
+ (define-cfn mpmcq-close (q::MpmcQueue*) ::void
+   (SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN (-> q mutex))
+   (Scm_AtomicStore (& (-> q closed)) TRUE)
+   (SCM_INTERNAL_COND_BROADCAST (-> q readerWait))
+   (SCM_INTERNAL_COND_BROADCAST (-> q writerWait))
+   (SCM_INTERNAL_MUTEX_SAFE_LOCK_END))
+
+ ;; (mpmcq-wait Q COUNTER CV PTIMESPEC STATUS DONE RETRY)
+ ;;   Registers the current thread in COUNTER and waits on CV.  RETRY is
+ ;;   an expression that tries the operation again after registration;
+ ;;   if it succeeds, DONE is set to TRUE and we don't wait.  STATUS is
+ ;;   set to 0 (retry succeeded or woken up), CW_TIMEDOUT, CW_INTR or
+ ;;   CW_CLOSED.
+ (.define CW_CLOSED 3)
+ (define-cise-stmt mpmcq-wait
+   [(_ q counter cv ptimespec status done retry)
+    (let1 r (gensym)
+      `(begin
+         (SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN (-> ,q mutex))
+         (Scm_AtomicStore (& (-> ,q ,counter))
+                          (+ (Scm_AtomicLoad (& (-> ,q ,counter))) 1))
+         (Scm_AtomicThreadFence) ; see the comment above
+         (cond [,retry (set! ,done TRUE ,status 0)]
+               [(Scm_AtomicLoad (& (-> ,q closed))) (set! ,status CW_CLOSED)]
+               [,ptimespec
+                (let* ([,r :: int
+                        (SCM_INTERNAL_COND_TIMEDWAIT (-> ,q ,cv)
+                                                     (-> ,q mutex)
+                                                     ,ptimespec)])
+                  (cond [(== ,r SCM_INTERNAL_COND_TIMEDOUT)
+                         (set! ,status CW_TIMEDOUT)]
+                        [(== ,r SCM_INTERNAL_COND_INTR)
+                         (set! ,status CW_INTR)]
+                        [else (set! ,status 0)]))]
+               [else (SCM_INTERNAL_COND_WAIT (-> ,q ,cv) (-> ,q mutex))
+                     (set! ,status 0)])
+         (Scm_AtomicStore (& (-> ,q ,counter))
+                          (- (Scm_AtomicLoad (& (-> ,q ,counter))) 1))
+         (SCM_INTERNAL_MUTEX_SAFE_LOCK_END)))])
+
+ (define-cfn mpmcq-enqueue-wait (q::MpmcQueue* obj timeout timeout-val
+                                               close::int if-closed)
+   (let* ([ts::ScmTimeSpec]
+          [pts::ScmTimeSpec* (Scm_GetTimeSpec timeout (& ts))]
+          [status::int 0]
+          [done::int FALSE])
+     (while TRUE
+       (when (Scm_AtomicLoad (& (-> q closed)))
+         (when (SCM_EQ if-closed ':error)
+           (Scm_Error "queue is closed: %S" q))
+         (return timeout-val))
+       (set! done (mpmcq-try-enqueue q obj))
+       (unless done
+         (mpmcq-wait q numWriters writerWait pts status done
+                     (mpmcq-try-enqueue q obj)))
+       (cond [done
+              (when close (mpmcq-close q))
+              (mpmcq-notify q numReaders readerWait)
+              (return '#t)]
+             [(== status CW_TIMEDOUT) (return timeout-val)]
+             [(== status CW_INTR) (Scm_SigCheck (Scm_VM))]))))
+
+ (define-cfn mpmcq-dequeue-wait (q::MpmcQueue* timeout timeout-val close::int)
+   (let* ([ts::ScmTimeSpec]
+          [pts::ScmTimeSpec* (Scm_GetTimeSpec timeout (& ts))]
+          [status::int 0]
+          [done::int FALSE]
+          [r SCM_UNDEFINED])
+     (when close (mpmcq-close q))
+     (while TRUE
+       (set! done (mpmcq-try-dequeue q (& r)))
+       (unless done
+         (mpmcq-wait q numReaders readerWait pts status done
+                     (mpmcq-try-dequeue q (& r))))
+       (cond [done
+              (mpmcq-notify q numWriters writerWait)
+              (return r)]
+             [(or (== status CW_TIMEDOUT) (== status CW_CLOSED))
+              (return timeout-val)]
+             [(== status CW_INTR) (Scm_SigCheck (Scm_VM))]))))
+
+ (define-cproc make-mpmc-queue (max-length::<fixnum>)
+   (return (makempmcq (& MpmcQueueClass) max-length)))
+
+ (define-cproc %mpmc-queue-close! (q::<mpmc-queue>) ::<void>
+   (mpmcq-close q))
+ )
+
+(define-inline (mpmc-queue? q) (is-a? q <mpmc-queue>))
+
 ;; A common pattern
 (define-syntax queue-op
   (syntax-rules ()
@@ -329,12 +577,15 @@
 ;;; Predicates
 ;;;
 (inline-stub
- (define-cproc queue-empty? (q::<queue>) ::<boolean>
-   (if (MTQP q)
-     (let* ([r::int FALSE])
-       (with-mtq-light-lock q (set! r (Q_EMPTY_P q)))
-       (return r))
-     (return (Q_EMPTY_P q))))
+ (define-cproc queue-empty? (q) ::<boolean>
+   (cond [(MTQP q)
+          (let* ([r::int FALSE])
+            (with-mtq-light-lock q (set! r (Q_EMPTY_P q)))
+            (return r))]
+         [(QP q) (return (Q_EMPTY_P q))]
+         [(MPMCQP q) (return (== (mpmcq-length (MPMCQ q)) 0))]
+         [else (SCM_TYPE_ERROR q "<queue> or <mpmc-queue>")
+               (return FALSE)]))
  )
 
 (define-inline (queue? q)   (is-a? q <queue>))
@@ -350,16 +601,27 @@
           (> (+ ,cnt (%qlength (Q ,q))) (MTQ_MAXLEN ,q)))])
 
  ;; API
- (define-cproc queue-length (q::<queue>) ::<int> %qlength)
- (define-cproc mtqueue-max-length (q::<mtqueue>)
-   (return (?: (>= (MTQ_MAXLEN q) 0) (SCM_MAKE_INT (MTQ_MAXLEN q)) '#f)))
+ (define-cproc queue-length (q) ::<int>
+   (cond [(QP q) (return (%qlength (Q q)))]
+         [(MPMCQP q) (return (mpmcq-length (MPMCQ q)))]
+         [else (SCM_TYPE_ERROR q "<queue> or <mpmc-queue>")
+               (return 0)]))
+ (define-cproc mtqueue-max-length (q)
+   (cond [(MTQP q)
+          (return (?: (>= (MTQ_MAXLEN q) 0) (SCM_MAKE_INT (MTQ_MAXLEN q)) '#f))]
+         [(MPMCQP q) (return (SCM_MAKE_INT (MPMCQ_CAPACITY q)))]
+         [else (SCM_TYPE_ERROR q "<mtqueue> or <mpmc-queue>")
+               (return SCM_UNDEFINED)]))
 
  ;; caller must hold lock
  (define-cproc %mtqueue-overflow? (q::<mtqueue> cnt::<int>) ::<boolean>
    (return (mtq-overflows q cnt)))
 
  ;; API
- (define-cproc mtqueue-room (q::<mtqueue>) ::<number>
+ (define-cproc mtqueue-room (q) ::<number>
+   (when (MPMCQP q)
+     (return (SCM_MAKE_INT (- (MPMCQ_CAPACITY q) (mpmcq-length (MPMCQ q))))))
+   (unless (MTQP q) (SCM_TYPE_ERROR q "<mtqueue> or <mpmc-queue>"))
    (let* ([room::ScmSmallInt -1])
      (with-mtq-light-lock q
        (when (>= (MTQ_MAXLEN q) 0)
@@ -469,9 +731,21 @@
        (,op ,q ,cnt ,head ,tail))])
 
  ;; API
- (define-cproc enqueue! (q::<queue> obj :rest more-objs)
+ ;; NB: For <mpmc-queue>, enqueuing multiple objects isn't atomic.  If
+ ;; the queue becomes full in the middle, the preceding objects remain
+ ;; enqueued.
+ (define-cproc enqueue! (q obj :rest more-objs)
+   (when (MPMCQP q)
+     (dolist [x (Scm_Cons obj more-objs)]
+       (when (MPMCQ_CLOSED q)
+         (Scm_Error "queue is closed: %S" q))
+       (unless (mpmcq-try-enqueue (MPMCQ q) x)
+         (Scm_Error "queue is full: %S" q))
+       (mpmcq-notify (MPMCQ q) numReaders readerWait))
+     (return q))
+   (unless (QP q) (SCM_TYPE_ERROR q "<queue> or <mpmc-queue>"))
    (let* ([head (Scm_Cons obj more-objs)] [tail] [cnt::ScmSmallInt]
-          [qq::(Queue* volatile) q])
+          [qq::(Queue* volatile) (Q q)])
      (if (SCM_NULLP more-objs)
        (set! tail head cnt 1)
        (set! tail (Scm_LastPair more-objs) cnt (Scm_Length head)))
@@ -479,12 +753,17 @@
      (return (SCM_OBJ qq))))
 
  ;; API
- (define-cproc enqueue/wait! (q::<mtqueue> obj
-                                           :optional (timeout #f)
-                                                     (timeout-val #f)
-                                                     (close::<boolean> #f)
-                                                     (if-closed :error))
-   (let* ([cell (SCM_LIST1 obj)]
+ (define-cproc enqueue/wait! (qobj obj
+                                   :optional (timeout #f)
+                                             (timeout-val #f)
+                                             (close::<boolean> #f)
+                                             (if-closed :error))
+   (when (MPMCQP qobj)
+     (return (mpmcq-enqueue-wait (MPMCQ qobj) obj timeout timeout-val
+                                 close if-closed)))
+   (unless (MTQP qobj) (SCM_TYPE_ERROR qobj "<mtqueue> or <mpmc-queue>"))
+   (let* ([q::MtQueue* (MTQ qobj)]
+          [cell (SCM_LIST1 obj)]
           [close-code::int (?: (SCM_EQ if-closed ':error)
                                ERR_CLOSED
                                ERR_CLOSED_OK)]
@@ -521,11 +800,14 @@
 
 ;; API
 (define (mtqueue-close! q)
-  (assume-type q <mtqueue>)
-  (let1 r (enqueue/wait! q (%close-marker) #f (%close-marker) #t #f)
-    (if (eq? r (%close-marker))
-      :queue-closed
-      #f)))
+  (assume-type q (</> <mtqueue> <mpmc-queue>))
+  (cond [(not (mpmc-queue? q))
+         (let1 r (enqueue/wait! q (%close-marker) #f (%close-marker) #t #f)
+           (if (eq? r (%close-marker))
+             :queue-closed
+             #f))]
+        [(~ q'closed) :queue-closed]
+        [else (%mpmc-queue-close! q) #f]))
 
 (inline-stub
  ;; queue-push! - add item(s) to the head
@@ -603,11 +885,15 @@
        (set! (* result) r)
        (return FALSE))))
 
- (define-cproc dequeue! (q::<queue> :optional fallback)
+ (define-cproc dequeue! (q :optional fallback)
    (let* ([empty::int FALSE] [fb::(volatile ScmObj) fallback] [r SCM_UNDEFINED])
-     (if (not (MTQP q))
-       (set! empty (dequeue-int q (& r)))
-       (with-mtq-light-lock q (set! empty (dequeue-int q (& r)))))
+     (cond [(MTQP q)
+            (with-mtq-light-lock q (set! empty (dequeue-int (Q q) (& r))))]
+           [(QP q) (set! empty (dequeue-int (Q q) (& r)))]
+           [(MPMCQP q)
+            (set! empty (not (mpmcq-try-dequeue (MPMCQ q) (& r))))
+            (unless empty (mpmcq-notify (MPMCQ q) numWriters writerWait))]
+           [else (SCM_TYPE_ERROR q "<queue> or <mpmc-queue>")])
      (if empty
        (if (SCM_UNBOUNDP fb)
          (Scm_Error "queue is empty: %S" q)
@@ -615,10 +901,14 @@
        (when (MTQP q) (notify-writers q)))
      (return r)))
 
- (define-cproc dequeue/wait! (q::<mtqueue> :optional (timeout #f)
-                                                     (timeout-val #f)
-                                                     (close::<boolean> #f))
-   (let* ([retval SCM_UNDEFINED])
+ (define-cproc dequeue/wait! (qobj :optional (timeout #f)
+                                             (timeout-val #f)
+                                             (close::<boolean> #f))
+   (when (MPMCQP qobj)
+     (return (mpmcq-dequeue-wait (MPMCQ qobj) timeout timeout-val close)))
+   (unless (MTQP qobj) (SCM_TYPE_ERROR qobj "<mtqueue> or <mpmc-queue>"))
+   (let* ([q::MtQueue* (MTQ qobj)]
+          [retval SCM_UNDEFINED])
      (do-with-timeout q retval timeout timeout-val readerWait
                       ;; init
                       (begin (post++ (MTQ_READER_SEM q))
@@ -645,13 +935,21 @@
            (set! lis (Scm_DeleteX close_marker lis SCM_CMP_EQ)))))
      (return lis)))
 
- (define-cproc dequeue-all! (q::<queue>)
-   (if (not (MTQP q))
-     (return (dequeue-all-int q))
-     (let* ([r])
-       (with-mtq-light-lock q (set! r (dequeue-all-int q)))
-       (notify-writers q)
-       (return r))))
+ (define-cproc dequeue-all! (q)
+   (cond [(MTQP q)
+          (let* ([r])
+            (with-mtq-light-lock q (set! r (dequeue-all-int (Q q))))
+            (notify-writers q)
+            (return r))]
+         [(QP q) (return (dequeue-all-int (Q q)))]
+         [(MPMCQP q)
+          (let* ([h SCM_NIL] [t SCM_NIL] [x])
+            (while (mpmcq-try-dequeue (MPMCQ q) (& x))
+              (SCM_APPEND1 h t x))
+            (mpmcq-notify (MPMCQ q) numWriters writerWait)
+            (return h))]
+         [else (SCM_TYPE_ERROR q "<queue> or <mpmc-queue>")
+               (return SCM_UNDEFINED)]))
  )
 
 (define queue-pop! dequeue!)
@@ -661,7 +959,10 @@
 ;; change at any moment after returning this procedure, so for meaningful
 ;; operation the caller need another mutex to prevent new items
 ;; from being inserted into the mtq.
-(define-cproc mtqueue-num-waiting-readers (q::<mtqueue>) ::<int>
+(define-cproc mtqueue-num-waiting-readers (q) ::<int>
+  (when (MPMCQP q)
+    (return (Scm_AtomicLoad (& (-> (MPMCQ q) numReaders)))))
+  (unless (MTQP q) (SCM_TYPE_ERROR q "<mtqueue> or <mpmc-queue>"))
   (let* ([n::int 0])
     (with-mtq-light-lock q (set! n (MTQ_READER_SEM q)))
     (return n)))
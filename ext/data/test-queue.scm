@@ -200,6 +200,39 @@
 
 (test* "mtqueue room" +inf.0 (mtqueue-room (make-mtqueue)))
 
+(let1 q (make-mpmc-queue 3)
+  (test* "mpmc-queue" '(#t #f #f) (list (mpmc-queue? q) (queue? q) (mtqueue? q)))
+  (test* "mpmc-queue capacity" '(4 4 #t 0)
+         (list (mtqueue-max-length q) (mtqueue-room q)
+               (queue-empty? q) (queue-length q)))
+  (test* "mpmc-queue enqueue!" '(2 2 #f)
+         (begin (enqueue! q 'a 'b)
+                (list (queue-length q) (mtqueue-room q) (queue-empty? q))))
+  (test* "mpmc-queue dequeue!" '(a b none)
+         (let* ([x (dequeue! q)]
+                [y (dequeue! q)])
+           (list x y (dequeue! q 'none))))
+  (test* "mpmc-queue dequeue! (empty)" (test-error <error> #/queue is empty/)
+         (dequeue! q))
+  (test* "mpmc-queue wraparound" (iota 10)
+         (map (^i (enqueue! q i) (dequeue! q)) (iota 10)))
+  (test* "mpmc-queue overflow" (test-error <error> #/queue is full/)
+         (enqueue! q 1 2 3 4 5))
+  (test* "mpmc-queue dequeue-all!" '((1 2 3 4) 0)
+         (let1 r (dequeue-all! q)
+           (list r (queue-length q))))
+  (test* "mpmc-queue close" '(#f :queue-closed #t)
+         (let* ([r0 (mtqueue-close! q)]
+                [r1 (mtqueue-close! q)])
+           (list r0 r1 (~ q'closed))))
+  (test* "closed mpmc-queue rejects enqueue"
+         (test-error <error> #/queue is closed/)
+         (enqueue! q 'a))
+  )
+
+(test* "mpmc-queue with zero capacity" (test-error)
+       (make-mpmc-queue 0))
+
 ;; Note: */wait! APIs are tested in test/thread.scm instead of here,
 ;; since we need threads working.
 
@@ -117,6 +117,15 @@
        '((movq (imm64 #x0102030405060708) %r10))
        '(#x49 #xba #x08 #x07 #x06 #x05 #x04 #x03 #x02 #x01) '())
 
+;; movl (32-bit): C7 /0 id, B8+rd id, 89 /r, 8B /r -- no REX.W
+(t-asm "movl $5,%eax"      '((movl 5 %eax))       '(#xb8 #x05 #x00 #x00 #x00) '())
+(t-asm "movl $1,16(%rbx)"  '((movl 1 (16 %rbx)))
+       '(#xc7 #x43 #x10 #x01 #x00 #x00 #x00) '())
+(t-asm "movl $1,8(%r15)"   '((movl 1 (8 %r15)))
+       '(#x41 #xc7 #x47 #x08 #x01 #x00 #x00 #x00) '())
+(t-asm "movl %eax,(%rbx)"  '((movl %eax (%rbx)))  '(#x89 #x03) '())
+(t-asm "movl 8(%rbp),%ecx" '((movl (8 %rbp) %ecx)) '(#x8b #x4d #x08) '())
+
 ;; movzbq / movzwq (zero-extend): REX.W 0F B6/B7 /r
 (t-asm "movzbq (%rsi),%rdi" '((movzbq (%rsi) %rdi)) '(#x48 #x0f #xb6 #x3e) '())
 (t-asm "movzwq (%rax),%rcx" '((movzwq (%rax) %rcx)) '(#x48 #x0f #xb7 #x08) '())
@@ -168,6 +177,10 @@
 ;; cmpq reg→reg: REX.W 39 /r
 (t-asm "cmpq %rbx,%rcx"  '((cmpq %rbx %rcx))  '(#x48 #x39 #xd9) '())
 
+;; addq imm32→mem: REX.W 81 /0 id
+(t-asm "addq $1000,8(%rbx)" '((addq 1000 (8 %rbx)))
+       '(#x48 #x81 #x43 #x08 #xe8 #x03 #x00 #x00) '())
+
 ;; --- ALU instructions l/w/b variants ---
 
 ;; addl reg→reg: 01 /r  ModRM(11 src dst)
@@ -1077,4 +1090,54 @@
            '(#x48 #x81 #xc4 #x10 #x00 #x00 #x00 #xc3)
            (u8vector->list (u8vector-copy bytes 23 31)))))
 
+;;----------------------------------------------------------------------
+(test-section "gauche.vm.jit")
+
+(use gauche.vm.jit)
+(import gauche.vm.code)
+(test-module 'gauche.vm.jit)
+
+(define (jit-compiled? proc)
+  (boolean (any (^e (and (pair? e) (eq? (car e) 'XINSN)))
+                (vm-code->list (closure-code proc)))))
+
+;; Run PROC on each arg list before and after JIT, and compare the results.
+(define (jit-check name proc . arg-lists)
+  (let1 expected (map (cut apply proc <>) arg-lists)
+    (jit-compile-code! (closure-code proc))
+    (test* name expected (map (cut apply proc <>) arg-lists))))
+
+(when (jit-available?)
+  (let ()
+    (define (f a b) (list a b 1))
+    (test* "jit-compile-code!" #t (jit-compile-code! (closure-code f)))
+    (test* "jit-compile-code! (compiled)" #t (jit-compiled? f))
+    (test* "jit-compile-code! (again)" #f (jit-compile-code! (closure-code f)))
+    (test* "jit-compiled code" '(x y 1) (f 'x 'y)))
+
+  (jit-check "jit fixnum add" (^[a b] (+ (+ a b) 1))
+             '(1 2) '(-5 3) `(,(greatest-fixnum) 0) `(,(greatest-fixnum) 1)
+             '(1.5 2) '(1/3 1))
+  (jit-check "jit fixnum sub" (^[a b] (list (- a b) (+ a -1)))
+             '(1 2) `(,(least-fixnum) 1) `(0 ,(least-fixnum)) '(2.5 1))
+  (jit-check "jit car/cdr/cons" (^[x] (cons (cdr x) (car x)))
+             '((1 . 2)) '((a b c)))
+  (jit-check "jit eq/null" (^[x y] (list (eq? x y) (null? x)))
+             '(() ()) '(a b) '((1) ()))
+  (jit-check "jit locals" (^[a b c] ((^[d] (list c b a d)) (cons a c)))
+             '(1 2 3) '(x y z))
+
+  (let ()
+    (define (g x) (list (car x) 2))
+    (jit-compile-code! (closure-code g))
+    (test* "jit car type error" (test-error) (g 1)))
+
+  (let ()
+    (define (h a b) (list b a 3))
+    (jit-enable! :threshold 10)
+    (dotimes [i 100] (h i i))
+    (jit-disable!)
+    (test* "jit-enable!" #t (jit-compiled? h))
+    (test* "jit-enable! result" '(2 1 3) (h 1 2))))
+
 (test-end)
@@ -978,6 +978,7 @@
 
 (test-section "rfc.json")
 (use rfc.json)
+(use gauche.vport)
 (test-module 'rfc.json)
 
 (let ()
@@ -1096,6 +1097,82 @@
                                                   [(null) 'null]))])
          (parse-json-string "{\"x\":[1,2,3],\"y\":[false,true,null]}")))
 
+;; The string and the port parsers take different paths in C.
+(let ()
+  (define (t name str val)
+    (test* #"~name (string)" val (parse-json-string str))
+    (test* #"~name (port)" val
+           (call-with-input-string str parse-json)))
+  (t "long string" #"[\"~(make-string 1000 #\a)\"]"
+     (vector (make-string 1000 #\a)))
+  (t "long string with escapes"
+     #"[\"~(make-string 100 #\a)\\n~(make-string 100 #\b)\\\"\"]"
+     (vector #"~(make-string 100 #\a)\n~(make-string 100 #\b)\""))
+  (t "multibyte string" "[\"\\u00e9t\\u00e9 été\"]" '#("été été"))
+  (t "big integer" "[123456789012345678901234567890, -9223372036854775809]"
+     '#(123456789012345678901234567890 -9223372036854775809))
+  (t "flonums" "[1e2, -0.5, 1.7976931348623157e308, 5e-324]"
+     '#(100.0 -0.5 1.7976931348623157e308 5e-324))
+  (t "empty containers" "[[], {}, [[]], {\"a\":{}}]"
+     '#(#() () #(#()) (("a"))))
+  (t "whitespace" " \t\r\n[ 1 ,\n2 ]  " '#(1 2))
+  (t "empty input" "   " (eof-object))
+  )
+
+(test* "deep nesting" 100000
+       (let loop ([v (parse-json-string
+                      #"~(make-string 100000 #\[)~(make-string 100000 #\])")]
+                  [n 1])
+         (if (and (vector? v) (= (vector-length v) 1))
+           (loop (vector-ref v 0) (+ n 1))
+           n)))
+
+(test* "nesting depth limit" (test-error <json-parse-error>)
+       (parameterize ([json-nesting-depth-limit 2])
+         (parse-json-string "[[[1]]]")))
+(test* "nesting depth limit" '#(#(1))
+       (parameterize ([json-nesting-depth-limit 2])
+         (parse-json-string "[[1]]")))
+
+(test* "parse-json doesn't read ahead" '(#(1 2) " 3")
+       (call-with-input-string "[1,2] 3"
+         (^p (let1 v (parse-json p)
+               (list v (read-string 10 p))))))
+
+;; Port input is scanned in the port buffer.  Values straddling the
+;; buffer boundary of a file port, and procedural ports, which don't lend
+;; their buffer, must be read the same way.
+(let* ([elts (map (^i (if (odd? i) (make-string (* i 13) #\x) (* i 1234567)))
+                  (iota 300))]
+       [json (string-append
+              "["
+              (string-join (map (^e (if (string? e)
+                                      (string-append "\"" e "\"")
+                                      (number->string e)))
+                                elts)
+                           ", ")
+              "] 3")]
+       [expected (list (list->vector elts) " 3")]
+       [file "test-json.o"])
+  (define (read-it p)
+    (let1 v (parse-json p)
+      (list v (read-string 10 p))))
+  (with-output-to-file file (cut display json))
+  (unwind-protect
+      (test* "parse-json (file port)" expected
+             (call-with-input-file file read-it))
+    (sys-unlink file))
+  (test* "parse-json (procedural port)" expected
+         (let1 src (open-input-string json)
+           (read-it (make <virtual-input-port>
+                      :getb (^[] (read-byte src)))))))
+
+(test* "json-token-generator"
+       '(object-start "a" #\: array-start 1 #\, false array-end
+         #\, "b" #\: null object-end)
+       (call-with-input-string "{\"a\": [1, false], \"b\": null}"
+         (^p (generator->list (json-token-generator p)))))
+
 (let ()
   (define (test-writer name obj)
     (test* name obj
@@ -1161,6 +1238,45 @@
                                          "{\"b\":2,\"a\":1}")
        (construct-json-string (hash-table 'eq? '(a . 1) '(b . 2))))
 
+(let ()
+  (define (t name str obj)
+    (test* #"writer ~name" str (construct-json-string obj)))
+  (t "specials" "[false,true,null,false,true]" '#(#f #t null false true))
+  (t "numbers" "[0,-12,123456789012345678901234567890,0.5,-1.5,1.0e100]"
+     '#(0 -12 123456789012345678901234567890 1/2 -1.5 1e100))
+  (t "control chars" "\"\\u0000\\u001f\\b\\f\\n\\r\\t\\u007f\""
+     "\x00;\x1f;\x08;\x0c;\n\r\t\x7f;")
+  (t "quotes" "\"a\\\"b\\\\c/d\"" "a\"b\\c/d")
+  (t "non-ascii" "\"a\\u00e9b\\u3042c\\ud867\\ude3d\""
+     "a\u00e9b\u3042c\x29e3d;")
+  (t "symbol and number keys" "{\"a\":1,\"2\":[]}" '((a . 1) (2 . #())))
+  (t "nested" "{\"a\":[1,{\"b\":[]}],\"c\":{}}"
+     '(("a" . #(1 (("b" . #())))) ("c" . ())))
+  (t "generic sequence inside" "[[1,2],{\"a\":[3]}]"
+     `#(#u8(1 2) (("a" . #u8(3)))))
+  ;; strings longer than the internal buffer
+  (let1 s (string-append (make-string 10000 #\a) "\n"
+                         (make-string 10000 #\b))
+    (t "long string" #"\"~(make-string 10000 #\a)\\n~(make-string 10000 #\b)\""
+       s))
+  (let1 v (make-vector 5000 "abc")
+    (test* "writer long vector" v
+           (parse-json-string (construct-json-string v))))
+  )
+
+(let ()
+  (define (t obj)
+    (test* #"writer error ~obj" (test-error <json-construct-error>)
+           (construct-json-string obj)))
+  (t +inf.0)
+  (t '#(+nan.0))
+  (t 1+2i))
+
+(test* "writer to port" "[1,\"a\"]{}"
+       (call-with-output-string
+         (^p (construct-json '#(1 "a") p)
+             (construct-json '() p))))
+
 ;; https://sourceforge.net/p/gauche/mailman/message/36786284/
 (test* "read/write invariance"
        '#(48.529166)
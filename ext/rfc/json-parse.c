@@ -0,0 +1,651 @@
+/*
+ * json-parse.c - Native JSON parser
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This is the fast path of rfc.json.  It accepts the same language as
+ * the PEG parser in lib/rfc/json.scm (which is slightly more permissive
+ * than RFC 8259, e.g. it allows a leading '+' in numbers and raw control
+ * characters in strings), and builds the result with the same handlers.
+ *
+ * The input is either a port or a string.  Either way we scan a window
+ * of bytes in memory: the whole body of a string, or the buffer of a
+ * port borrowed with Scm_PortBorrowBufferUnsafe.  The port is locked
+ * once for the entire read, and we only commit the bytes we've consumed,
+ * so the caller can keep reading from the port after the parsed value.
+ * In the window we can skip runs of ordinary characters in string
+ * literals a word at a time.  Procedural ports, which don't allow
+ * borrowing their buffer, are read a byte at a time.
+ *
+ * Nesting is handled with an explicit stack instead of C recursion,
+ * so deeply nested input can't overflow the C stack.
+ */
+
+#include "json.h"
+#include <gauche/priv/portP.h>
+#include <math.h>
+
+static ScmModule *json_module;
+static ScmObj json_parse_error_proc = SCM_UNDEFINED;
+
+static ScmObj sym_false;
+static ScmObj sym_true;
+static ScmObj sym_null;
+static ScmObj sym_array_start;
+static ScmObj sym_array_end;
+static ScmObj sym_object_start;
+static ScmObj sym_object_end;
+
+void Scm_JsonInitHandlers(ScmJsonHandlers *h,
+                          ScmObj arrayHandler,
+                          ScmObj objectHandler,
+                          ScmObj specialHandler,
+                          ScmObj depthLimit)
+{
+    h->arrayHandler = arrayHandler;
+    h->objectHandler = objectHandler;
+    h->specialHandler = specialHandler;
+
+    if (!SCM_REALP(depthLimit)) {
+        Scm_Error("real number required for nesting depth limit, but got: %S",
+                  depthLimit);
+    }
+    double d = ceil(Scm_GetDouble(depthLimit));
+    if (d < 0) h->depthLimit = 0;
+    else if (!(d < (double)LONG_MAX)) h->depthLimit = LONG_MAX;
+    else h->depthLimit = (long)d;
+}
+
+/*================================================================
+ * Input
+ */
+
+typedef struct JsonInputRec {
+    ScmPort *port;              /* NULL if reading from memory.  If not,
+                                   the port is locked by us. */
+    const unsigned char *cur;   /* window of input */
+    const unsigned char *end;
+    const unsigned char *base;  /* beginning of the borrowed window */
+    int direct;                 /* FALSE if PORT doesn't allow borrowing */
+    int eof;                    /* TRUE if we've seen EOF of PORT */
+    ScmSize pos;                /* # of bytes consumed */
+} JsonInput;
+
+static void in_init(JsonInput *in, ScmPort *port,
+                    const unsigned char *start, const unsigned char *end)
+{
+    in->port = port;
+    in->cur = in->base = start;
+    in->end = end;
+    in->direct = (port != NULL);
+    in->eof = FALSE;
+    in->pos = 0;
+}
+
+/* Tells PORT that the bytes we've scanned are consumed, and drops the
+   window.  Must be called before anything else may touch PORT. */
+static void in_sync(JsonInput *in)
+{
+    if (in->port == NULL) return;
+    if (in->cur > in->base) {
+        Scm_PortCommitBufferUnsafe(in->port, in->cur - in->base);
+    }
+    in->cur = in->end = in->base = NULL;
+}
+
+/* Called when the window is empty.  Borrows the port buffer as a new
+   window, and returns TRUE if it has some bytes.  Returns FALSE at EOF,
+   or if the port doesn't allow borrowing. */
+static int in_fill(JsonInput *in)
+{
+    if (in->port == NULL || !in->direct || in->eof) return FALSE;
+    in_sync(in);
+    ScmSize size = 0;
+    const char *buf = Scm_PortBorrowBufferUnsafe(in->port, &size, TRUE);
+    if (buf == NULL) {
+        in->direct = FALSE;
+        return FALSE;
+    }
+    if (size == 0) {
+        in->eof = TRUE;
+        return FALSE;
+    }
+    in->cur = in->base = (const unsigned char*)buf;
+    in->end = in->cur + size;
+    return TRUE;
+}
+
+static inline int in_peek(JsonInput *in)
+{
+    if (in->cur < in->end || in_fill(in)) return *in->cur;
+    if (in->port && !in->direct) return Scm_PeekbUnsafe(in->port);
+    return EOF;
+}
+
+static inline int in_get(JsonInput *in)
+{
+    int b;
+    if (in->cur < in->end || in_fill(in)) b = *in->cur++;
+    else if (in->port && !in->direct) b = Scm_GetbUnsafe(in->port);
+    else b = EOF;
+    if (b != EOF) in->pos++;
+    return b;
+}
+
+#define JSON_WS_P(b)  ((b) == ' ' || (b) == '\t' || (b) == '\r' || (b) == '\n')
+
+static inline void skip_ws(JsonInput *in)
+{
+    while (in->cur < in->end || in_fill(in)) {
+        const unsigned char *p = in->cur;
+        while (p < in->end && JSON_WS_P(*p)) p++;
+        in->pos += p - in->cur;
+        in->cur = p;
+        if (p < in->end) return;
+    }
+    if (in->port && !in->direct) {
+        for (;;) {
+            int b = Scm_PeekbUnsafe(in->port);
+            if (!JSON_WS_P(b)) return;
+            (void)Scm_GetbUnsafe(in->port);
+            in->pos++;
+        }
+    }
+}
+
+/* Returns the first position in [p, end) that has either '"' or '\\'.
+   We check 8 bytes at once; the bytes that may terminate the run
+   are rare in typical strings. */
+
+static inline const unsigned char *skip_plain_chars(const unsigned char *p,
+                                                    const unsigned char *end)
+{
+    while (end - p >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        if (JSON_HAS_ZERO_BYTE(w ^ (JSON_ONES * '"'))
+            || JSON_HAS_ZERO_BYTE(w ^ (JSON_ONES * '\\'))) break;
+        p += 8;
+    }
+    while (p < end && *p != '"' && *p != '\\') p++;
+    return p;
+}
+
+/*================================================================
+ * Errors
+ */
+
+/* We let the Scheme side raise <json-parse-error>, which is defined
+   in rfc.json.native. */
+static void parse_error(JsonInput *in, ScmObj objs, const char *fmt, ...)
+    SCM_NORETURN;
+
+static void parse_error(JsonInput *in, ScmObj objs, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    ScmObj msg = Scm_Vsprintf(fmt, ap, TRUE);
+    va_end(ap);
+    in_sync(in);
+    SCM_BIND_PROC(json_parse_error_proc, "%json-parse-error", json_module);
+    Scm_ApplyRec3(json_parse_error_proc, Scm_MakeInteger(in->pos),
+                  msg, objs);
+    Scm_Error("%%json-parse-error returned unexpectedly"); /* NOTREACHED */
+}
+
+static void unexpected(JsonInput *in, int b, const char *expecting)
+    SCM_NORETURN;
+
+static void unexpected(JsonInput *in, int b, const char *expecting)
+{
+    if (b == EOF) {
+        parse_error(in, SCM_NIL, "expecting %s, but reached end of input",
+                    expecting);
+    } else if (b >= 0x20 && b < 0x7f) {
+        parse_error(in, SCM_LIST1(SCM_MAKE_CHAR(b)),
+                    "expecting %s, but got '%c'", expecting, b);
+    } else {
+        parse_error(in, SCM_LIST1(SCM_MAKE_INT(b)),
+                    "expecting %s, but got byte 0x%02x", expecting, b);
+    }
+}
+
+/*================================================================
+ * Tokens
+ */
+
+static int read_hex4(JsonInput *in)
+{
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        int b = in_get(in), d;
+        if (b >= '0' && b <= '9')      d = b - '0';
+        else if (b >= 'a' && b <= 'f') d = b - 'a' + 10;
+        else if (b >= 'A' && b <= 'F') d = b - 'A' + 10;
+        else unexpected(in, b, "hexadecimal digit");
+        v = v*16 + d;
+    }
+    return v;
+}
+
+/* We've read a backslash. */
+static void read_escape(JsonInput *in, ScmDString *ds)
+{
+    int b = in_get(in);
+    ScmChar c;
+    switch (b) {
+    case '"': case '\\': case '/': c = b; break;
+    case 'b': c = 0x08; break;
+    case 'f': c = 0x0c; break;
+    case 'n': c = 0x0a; break;
+    case 'r': c = 0x0d; break;
+    case 't': c = 0x09; break;
+    case 'u': {
+        int u = read_hex4(in);
+        if (u >= 0xd800 && u <= 0xdbff) {
+            if (in_peek(in) == '\\') {
+                (void)in_get(in);
+                if (in_peek(in) == 'u') {
+                    (void)in_get(in);
+                    int lo = read_hex4(in);
+                    if (lo >= 0xdc00 && lo <= 0xdfff) {
+                        c = Scm_UcsToChar(0x10000 + ((u - 0xd800) << 10)
+                                          + (lo - 0xdc00));
+                        break;
+                    }
+                }
+            }
+            parse_error(in, SCM_NIL, "unpaired high surrogate: \\u%04x", u);
+        }
+        if (u >= 0xdc00 && u <= 0xdfff) {
+            parse_error(in, SCM_NIL, "unpaired low surrogate: \\u%04x", u);
+        }
+        c = Scm_UcsToChar(u);
+        break;
+    }
+    default:
+        unexpected(in, b, "escaped character");
+    }
+    Scm_DStringPutc(ds, c);
+}
+
+/* We've read the opening double quote. */
+static ScmObj read_string(JsonInput *in)
+{
+    ScmDString ds;
+    int ds_used = FALSE;
+
+    for (;;) {
+        if (in->cur < in->end || in_fill(in)) {
+            const unsigned char *p = skip_plain_chars(in->cur, in->end);
+            ScmSize n = p - in->cur;
+            if (!ds_used && p < in->end && *p == '"') {
+                /* No escapes.  Build the string directly from the input. */
+                ScmObj s = Scm_MakeString((const char*)in->cur, n, -1,
+                                          SCM_STRING_COPYING);
+                in->cur = p + 1;
+                in->pos += n + 1;
+                return s;
+            }
+            if (!ds_used) { Scm_DStringInit(&ds); ds_used = TRUE; }
+            if (n > 0) {
+                Scm_DStringPutz(&ds, (const char*)in->cur, n);
+                in->cur = p;
+                in->pos += n;
+            }
+        } else if (!ds_used) {
+            Scm_DStringInit(&ds);
+            ds_used = TRUE;
+        }
+
+        int b = in_get(in);
+        switch (b) {
+        case '"':  return Scm_DStringGet(&ds, 0);
+        case '\\': read_escape(in, &ds); break;
+        case EOF:  unexpected(in, b, "closing '\"'");
+        default:   Scm_DStringPutb(&ds, (char)b);
+        }
+    }
+}
+
+/* Numbers are [+-]?\d+(\.\d+)?([eE][+-]?\d+)?.  Integers that fit in
+   18 digits are computed directly; others are handed to string->number. */
+#define NUMBUF_SIZE 64
+
+typedef struct NumBufRec {
+    char buf[NUMBUF_SIZE];
+    int n;
+    int spilled;
+    ScmDString ds;
+} NumBuf;
+
+static inline void numbuf_put(NumBuf *nb, int b)
+{
+    if (!nb->spilled) {
+        if (nb->n < NUMBUF_SIZE) { nb->buf[nb->n++] = (char)b; return; }
+        Scm_DStringInit(&nb->ds);
+        Scm_DStringPutz(&nb->ds, nb->buf, nb->n);
+        nb->spilled = TRUE;
+    }
+    Scm_DStringPutb(&nb->ds, (char)b);
+}
+
+#define DIGITP(b)  ((b) >= '0' && (b) <= '9')
+
+static int read_digits(JsonInput *in, NumBuf *nb, int64_t *acc)
+{
+    int b = in_peek(in), ndigits = 0;
+    if (!DIGITP(b)) {
+        (void)in_get(in);
+        unexpected(in, b, "digit");
+    }
+    do {
+        (void)in_get(in);
+        if (acc && ndigits < 18) *acc = *acc * 10 + (b - '0');
+        numbuf_put(nb, b);
+        ndigits++;
+        b = in_peek(in);
+    } while (DIGITP(b));
+    return ndigits;
+}
+
+static ScmObj read_number(JsonInput *in)
+{
+    NumBuf nb;
+    int64_t acc = 0;
+    int negative = FALSE, integral = TRUE;
+
+    nb.n = 0;
+    nb.spilled = FALSE;
+
+    int b = in_peek(in);
+    if (b == '+' || b == '-') {
+        negative = (b == '-');
+        numbuf_put(&nb, in_get(in));
+    }
+    int ndigits = read_digits(in, &nb, &acc);
+    if (in_peek(in) == '.') {
+        integral = FALSE;
+        numbuf_put(&nb, in_get(in));
+        read_digits(in, &nb, NULL);
+    }
+    b = in_peek(in);
+    if (b == 'e' || b == 'E') {
+        integral = FALSE;
+        numbuf_put(&nb, in_get(in));
+        b = in_peek(in);
+        if (b == '+' || b == '-') numbuf_put(&nb, in_get(in));
+        read_digits(in, &nb, NULL);
+    }
+
+    if (integral && ndigits <= 18) {
+        return Scm_MakeInteger64(negative? -acc : acc);
+    }
+    ScmObj s = (nb.spilled
+                ? Scm_DStringGet(&nb.ds, 0)
+                : Scm_MakeString(nb.buf, nb.n, nb.n, SCM_STRING_COPYING));
+    ScmObj r = Scm_StringToNumber(SCM_STRING(s), 10, 0);
+    if (SCM_FALSEP(r)) parse_error(in, SCM_LIST1(s), "invalid number: %A", s);
+    return r;
+}
+
+/* false, true or null */
+static ScmObj read_literal(JsonInput *in, const ScmJsonHandlers *h)
+{
+    const char *name;
+    ScmObj sym;
+
+    switch (in_peek(in)) {
+    case 'f': name = "false"; sym = sym_false; break;
+    case 't': name = "true";  sym = sym_true;  break;
+    default:  name = "null";  sym = sym_null;  break;
+    }
+    for (const char *p = name; *p; p++) {
+        int b = in_get(in);
+        if (b != *p) unexpected(in, b, name);
+    }
+    in_sync(in);
+    return Scm_ApplyRec1(h->specialHandler, sym);
+}
+
+/*================================================================
+ * Parser
+ */
+
+enum {
+    FRAME_ARRAY,
+    FRAME_OBJECT
+};
+
+typedef struct JsonFrameRec {
+    ScmObj head;                /* elements or (key . value)s so far */
+    ScmObj tail;
+    ScmObj key;                 /* object key whose value we're reading */
+    int kind;
+} JsonFrame;
+
+#define JSON_INITIAL_STACK 32
+
+static ScmObj parse_value(JsonInput *in, const ScmJsonHandlers *h)
+{
+    JsonFrame initial_stack[JSON_INITIAL_STACK];
+    JsonFrame *stack = initial_stack, *f;
+    long sp = 0, cap = JSON_INITIAL_STACK;
+    ScmObj v;
+    int b;
+
+#define PUSH_FRAME(k)                                                   \
+    do {                                                                \
+        if (sp >= h->depthLimit) {                                      \
+            parse_error(in, SCM_NIL, "Input JSON nesting is too deep."); \
+        }                                                               \
+        if (sp == cap) {                                                \
+            JsonFrame *ns = SCM_NEW_ARRAY(JsonFrame, cap*2);            \
+            memcpy(ns, stack, sizeof(JsonFrame)*cap);                   \
+            stack = ns;                                                 \
+            cap *= 2;                                                   \
+        }                                                               \
+        f = &stack[sp++];                                               \
+        f->kind = (k);                                                  \
+        f->head = f->tail = SCM_NIL;                                    \
+        f->key = SCM_FALSE;                                             \
+    } while (0)
+
+ value:
+    skip_ws(in);
+    b = in_peek(in);
+    switch (b) {
+    case '[':
+        (void)in_get(in);
+        PUSH_FRAME(FRAME_ARRAY);
+        skip_ws(in);
+        if (in_peek(in) == ']') { (void)in_get(in); goto close; }
+        goto value;
+    case '{':
+        (void)in_get(in);
+        PUSH_FRAME(FRAME_OBJECT);
+        skip_ws(in);
+        if (in_peek(in) == '}') { (void)in_get(in); goto close; }
+        goto key;
+    case '"':
+        (void)in_get(in);
+        v = read_string(in);
+        break;
+    case 'f': case 't': case 'n':
+        v = read_literal(in, h);
+        break;
+    case '+': case '-':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        v = read_number(in);
+        break;
+    default:
+        (void)in_get(in);
+        unexpected(in, b, "JSON value");
+    }
+
+ done:
+    if (sp == 0) return v;
+    f = &stack[sp-1];
+    if (f->kind == FRAME_ARRAY) {
+        SCM_APPEND1(f->head, f->tail, v);
+    } else {
+        SCM_APPEND1(f->head, f->tail, Scm_Cons(f->key, v));
+    }
+    skip_ws(in);
+    b = in_get(in);
+    if (b == ',') {
+        skip_ws(in);
+        if (f->kind == FRAME_ARRAY) goto value;
+        else goto key;
+    }
+    if (f->kind == FRAME_ARRAY) {
+        if (b != ']') unexpected(in, b, "',' or ']'");
+    } else {
+        if (b != '}') unexpected(in, b, "',' or '}'");
+    }
+    /* FALLTHROUGH */
+
+ close:
+    f = &stack[--sp];
+    in_sync(in);
+    v = Scm_ApplyRec1((f->kind == FRAME_ARRAY
+                       ? h->arrayHandler
+                       : h->objectHandler),
+                      f->head);
+    goto done;
+
+ key:
+    b = in_get(in);
+    if (b != '"') unexpected(in, b, "object key");
+    stack[sp-1].key = read_string(in);
+    skip_ws(in);
+    b = in_get(in);
+    if (b != ':') unexpected(in, b, "':'");
+    goto value;
+#undef PUSH_FRAME
+}
+
+/*================================================================
+ * Entry points
+ */
+
+static ScmObj parse_toplevel(JsonInput *in, const ScmJsonHandlers *h)
+{
+    skip_ws(in);
+    if (in_peek(in) == EOF) return SCM_EOF;
+    return parse_value(in, h);
+}
+
+/* Reads one token, in the same way as json-tokenizer in rfc.json.
+   Structural characters are returned as symbols array-start, array-end,
+   object-start, object-end, and characters #\: and #\,. */
+static ScmObj read_token(JsonInput *in, const ScmJsonHandlers *h)
+{
+    skip_ws(in);
+    int b = in_peek(in);
+    switch (b) {
+    case EOF: return SCM_EOF;
+    case '[': (void)in_get(in); return sym_array_start;
+    case ']': (void)in_get(in); return sym_array_end;
+    case '{': (void)in_get(in); return sym_object_start;
+    case '}': (void)in_get(in); return sym_object_end;
+    case ':': (void)in_get(in); return SCM_MAKE_CHAR(':');
+    case ',': (void)in_get(in); return SCM_MAKE_CHAR(',');
+    case '"': (void)in_get(in); return read_string(in);
+    case 'f': case 't': case 'n':
+        return read_literal(in, h);
+    case '+': case '-':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        return read_number(in);
+    default:
+        (void)in_get(in);
+        unexpected(in, b, "JSON token");
+    }
+}
+
+/* Runs READER on PORT, holding the lock of PORT. */
+static ScmObj read_port(ScmPort *port, const ScmJsonHandlers *h,
+                        ScmObj (*reader)(JsonInput*, const ScmJsonHandlers*))
+{
+    ScmVM *vm = Scm_VM();
+    JsonInput in;
+    volatile ScmObj r = SCM_UNDEFINED;
+
+    in_init(&in, port, NULL, NULL);
+    PORT_LOCK(port, vm);
+    PORT_SAFE_CALL(port, r = reader(&in, h), in_sync(&in));
+    PORT_UNLOCK(port);
+    return r;
+}
+
+/* Reads one JSON value from PORT.  Returns EOF if PORT has nothing but
+   whitespaces. */
+ScmObj Scm_JsonParsePort(ScmPort *port, const ScmJsonHandlers *h)
+{
+    return read_port(port, h, parse_toplevel);
+}
+
+/* Reads the first JSON value in a string S.  The rest of S is ignored,
+   as parse-json-string does. */
+ScmObj Scm_JsonParseString(ScmString *s, const ScmJsonHandlers *h)
+{
+    ScmSmallInt size;
+    u_long flags;
+    const char *z = Scm_GetStringContent(s, &size, NULL, &flags);
+    if (flags & SCM_STRING_INCOMPLETE) {
+        Scm_Error("incomplete string not allowed: %S", SCM_OBJ(s));
+    }
+    JsonInput in;
+    in_init(&in, NULL, (const unsigned char*)z,
+            (const unsigned char*)z + size);
+    return parse_toplevel(&in, h);
+}
+
+/* Reads one token from PORT.  See read_token. */
+ScmObj Scm_JsonReadToken(ScmPort *port, const ScmJsonHandlers *h)
+{
+    return read_port(port, h, read_token);
+}
+
+void Scm_Init_json_parser(ScmModule *mod)
+{
+    json_module = mod;
+    sym_false        = SCM_INTERN("false");
+    sym_true         = SCM_INTERN("true");
+    sym_null         = SCM_INTERN("null");
+    sym_array_start  = SCM_INTERN("array-start");
+    sym_array_end    = SCM_INTERN("array-end");
+    sym_object_start = SCM_INTERN("object-start");
+    sym_object_end   = SCM_INTERN("object-end");
+}
@@ -0,0 +1,345 @@
+/*
+ * json-write.c - Native JSON writer
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This is the fast path of construct-json.  It handles the common
+ * types (booleans, symbols false/true/null, alists, strings, real numbers,
+ * hash tables and vectors) in C, and writes the output into a local
+ * buffer, which is passed to the port in large chunks.  Other objects
+ * (generic dictionaries and sequences, <json-mixin> instances) are
+ * handed to the fallback procedure in rfc.json, after flushing the buffer.
+ */
+
+#include "json.h"
+#include <math.h>
+
+static ScmModule *json_module;
+static ScmObj json_construct_error_proc = SCM_UNDEFINED;
+static ScmObj x_to_string_proc = SCM_UNDEFINED;
+
+static ScmObj sym_false;
+static ScmObj sym_true;
+static ScmObj sym_null;
+
+/* For each ASCII character, 0 if it can be written as is, 'u' if
+   it needs \uXXXX, or the character to follow the backslash. */
+static char escape_table[128];
+
+#define JSON_OUTBUF_SIZE 8192
+
+typedef struct JsonOutputRec {
+    ScmPort *port;
+    ScmObj fallback;
+    int n;                      /* # of bytes in buf */
+    char buf[JSON_OUTBUF_SIZE];
+} JsonOutput;
+
+static void out_flush(JsonOutput *out)
+{
+    if (out->n > 0) {
+        Scm_Putz(out->buf, out->n, out->port);
+        out->n = 0;
+    }
+}
+
+static inline void out_putb(JsonOutput *out, char b)
+{
+    if (out->n == JSON_OUTBUF_SIZE) out_flush(out);
+    out->buf[out->n++] = b;
+}
+
+static void out_putz(JsonOutput *out, const char *s, ScmSize len)
+{
+    if (len > JSON_OUTBUF_SIZE - out->n) {
+        out_flush(out);
+        if (len >= JSON_OUTBUF_SIZE) {
+            Scm_Putz(s, len, out->port);
+            return;
+        }
+    }
+    memcpy(out->buf + out->n, s, len);
+    out->n += (int)len;
+}
+
+static void construct_error(JsonOutput *out, ScmObj obj, const char *fmt, ...)
+    SCM_NORETURN;
+
+static void construct_error(JsonOutput *out, ScmObj obj, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    ScmObj msg = Scm_Vsprintf(fmt, ap, TRUE);
+    va_end(ap);
+    out_flush(out);
+    SCM_BIND_PROC(json_construct_error_proc, "%json-construct-error",
+                  json_module);
+    Scm_ApplyRec2(json_construct_error_proc, obj, msg);
+    Scm_Error("%%json-construct-error returned unexpectedly"); /* NOTREACHED */
+}
+
+/*================================================================
+ * Strings
+ */
+
+/* Returns the first position in [p, end) that needs escaping.
+   Besides the characters listed in escape_table, every non-ASCII
+   character is written in \uXXXX. */
+static inline const unsigned char *skip_unescaped(const unsigned char *p,
+                                                  const unsigned char *end)
+{
+    while (end - p >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        if ((w & JSON_HIGHS)
+            || JSON_HAS_LESS_BYTE(w, 0x20)
+            || JSON_HAS_ZERO_BYTE(w ^ (JSON_ONES * '"'))
+            || JSON_HAS_ZERO_BYTE(w ^ (JSON_ONES * '\\'))
+            || JSON_HAS_ZERO_BYTE(w ^ (JSON_ONES * 0x7f))) break;
+        p += 8;
+    }
+    while (p < end && *p < 0x80 && escape_table[*p] == 0) p++;
+    return p;
+}
+
+static void write_ucs_escape(JsonOutput *out, int u)
+{
+    static const char hex[] = "0123456789abcdef";
+    char b[6];
+    b[0] = '\\';
+    b[1] = 'u';
+    b[2] = hex[(u >> 12) & 0xf];
+    b[3] = hex[(u >> 8) & 0xf];
+    b[4] = hex[(u >> 4) & 0xf];
+    b[5] = hex[u & 0xf];
+    out_putz(out, b, 6);
+}
+
+static void write_string(JsonOutput *out, ScmString *s)
+{
+    const ScmStringBody *body = SCM_STRING_BODY(s);
+    if (SCM_STRING_BODY_INCOMPLETE_P(body)) {
+        construct_error(out, SCM_OBJ(s),
+                        "json cannot represent an incomplete string: %S", s);
+    }
+    const unsigned char *p = (const unsigned char*)SCM_STRING_BODY_START(body);
+    const unsigned char *end = (const unsigned char*)SCM_STRING_BODY_END(body);
+
+    out_putb(out, '"');
+    while (p < end) {
+        const unsigned char *q = skip_unescaped(p, end);
+        if (q > p) {
+            out_putz(out, (const char*)p, q - p);
+            p = q;
+            if (p == end) break;
+        }
+        if (*p < 0x80) {
+            char e = escape_table[*p];
+            if (e == 'u') {
+                write_ucs_escape(out, *p);
+            } else {
+                out_putb(out, '\\');
+                out_putb(out, e);
+            }
+            p++;
+        } else {
+            ScmChar ch;
+            SCM_CHAR_GET(p, ch);
+            p += SCM_CHAR_NFOLLOWS(*p) + 1;
+            int u = Scm_CharToUcs(ch);
+            if (u >= 0x10000) {
+                u -= 0x10000;
+                write_ucs_escape(out, 0xd800 + (u >> 10));
+                write_ucs_escape(out, 0xdc00 + (u & 0x3ff));
+            } else {
+                write_ucs_escape(out, u);
+            }
+        }
+    }
+    out_putb(out, '"');
+}
+
+/* Object keys may be any object that can be converted by x->string. */
+static void write_key(JsonOutput *out, ScmObj key)
+{
+    if (SCM_STRINGP(key)) {
+        write_string(out, SCM_STRING(key));
+    } else if (SCM_SYMBOLP(key)) {
+        write_string(out, SCM_SYMBOL_NAME(key));
+    } else {
+        SCM_BIND_PROC(x_to_string_proc, "x->string", Scm_GaucheModule());
+        ScmObj s = Scm_ApplyRec1(x_to_string_proc, key);
+        SCM_ASSERT(SCM_STRINGP(s));
+        write_string(out, SCM_STRING(s));
+    }
+}
+
+/*================================================================
+ * Numbers
+ */
+
+static void write_number(JsonOutput *out, ScmObj num)
+{
+    if (SCM_INTP(num)) {
+        char b[32];
+        int n = snprintf(b, sizeof(b), "%ld", (long)SCM_INT_VALUE(num));
+        out_putz(out, b, n);
+        return;
+    }
+    ScmObj z = num;
+    if (SCM_RATNUMP(z)) z = Scm_ExactToInexact(z);
+    if (SCM_FLONUMP(z)) {
+        double d = SCM_FLONUM_VALUE(z);
+        if (isinf(d) || isnan(d)) {
+            construct_error(out, num, "json cannot represent a number %S", num);
+        }
+    } else if (!SCM_BIGNUMP(z)) {
+        construct_error(out, num, "json cannot represent a number %S", num);
+    }
+    ScmObj s = Scm_NumberToString(z, 10, 0);
+    ScmSmallInt size;
+    const char *b = Scm_GetStringContent(SCM_STRING(s), &size, NULL, NULL);
+    out_putz(out, b, size);
+}
+
+/*================================================================
+ * Values
+ */
+
+static void write_value(JsonOutput *out, ScmObj obj);
+
+static void write_alist(JsonOutput *out, ScmObj alist)
+{
+    ScmObj cp;
+    int first = TRUE;
+    out_putb(out, '{');
+    SCM_FOR_EACH(cp, alist) {
+        ScmObj attr = SCM_CAR(cp);
+        if (!SCM_PAIRP(attr)) {
+            construct_error(out, alist,
+                            "construct-json needs an assoc list or dictionary,"
+                            " but got: %S", alist);
+        }
+        if (!first) out_putb(out, ',');
+        first = FALSE;
+        write_key(out, SCM_CAR(attr));
+        out_putb(out, ':');
+        write_value(out, SCM_CDR(attr));
+    }
+    out_putb(out, '}');
+}
+
+static void write_hash_table(JsonOutput *out, ScmHashTable *ht)
+{
+    ScmHashIter iter;
+    ScmDictEntry *e;
+    int first = TRUE;
+    out_putb(out, '{');
+    Scm_HashTableIterInit(&iter, ht);
+    while ((e = Scm_HashIterNext(&iter)) != NULL) {
+        if (!first) out_putb(out, ',');
+        first = FALSE;
+        write_key(out, SCM_DICT_KEY(e));
+        out_putb(out, ':');
+        write_value(out, SCM_DICT_VALUE(e));
+    }
+    out_putb(out, '}');
+}
+
+static void write_vector(JsonOutput *out, ScmVector *v)
+{
+    ScmSmallInt len = SCM_VECTOR_SIZE(v);
+    out_putb(out, '[');
+    for (ScmSmallInt i = 0; i < len; i++) {
+        if (i > 0) out_putb(out, ',');
+        write_value(out, SCM_VECTOR_ELEMENT(v, i));
+    }
+    out_putb(out, ']');
+}
+
+static void write_value(JsonOutput *out, ScmObj obj)
+{
+    if (SCM_FALSEP(obj) || SCM_EQ(obj, sym_false)) {
+        out_putz(out, "false", 5);
+    } else if (SCM_TRUEP(obj) || SCM_EQ(obj, sym_true)) {
+        out_putz(out, "true", 4);
+    } else if (SCM_EQ(obj, sym_null)) {
+        out_putz(out, "null", 4);
+    } else if (SCM_STRINGP(obj)) {
+        write_string(out, SCM_STRING(obj));
+    } else if (SCM_NUMBERP(obj)) {
+        write_number(out, obj);
+    } else if (SCM_LISTP(obj) && Scm_Length(obj) >= 0) {
+        write_alist(out, obj);
+    } else if (SCM_HASH_TABLE_P(obj)) {
+        write_hash_table(out, SCM_HASH_TABLE(obj));
+    } else if (SCM_VECTORP(obj)) {
+        write_vector(out, SCM_VECTOR(obj));
+    } else {
+        out_flush(out);
+        Scm_ApplyRec1(out->fallback, obj);
+    }
+}
+
+/*================================================================
+ * Entry point
+ */
+
+/* Writes OBJ in JSON to PORT.  FALLBACK is called with an object we
+   don't handle here; it is supposed to write the object to PORT. */
+void Scm_JsonWrite(ScmObj obj, ScmPort *port, ScmObj fallback)
+{
+    JsonOutput out;
+    out.port = port;
+    out.fallback = fallback;
+    out.n = 0;
+    write_value(&out, obj);
+    out_flush(&out);
+}
+
+void Scm_Init_json_writer(ScmModule *mod)
+{
+    json_module = mod;
+    sym_false = SCM_INTERN("false");
+    sym_true  = SCM_INTERN("true");
+    sym_null  = SCM_INTERN("null");
+
+    for (int c = 0; c < 0x20; c++) escape_table[c] = 'u';
+    escape_table[0x7f] = 'u';
+    escape_table['"']  = '"';
+    escape_table['\\'] = '\\';
+    escape_table[0x08] = 'b';
+    escape_table[0x0c] = 'f';
+    escape_table['\n'] = 'n';
+    escape_table['\r'] = 'r';
+    escape_table['\t'] = 't';
+}
@@ -0,0 +1,75 @@
+/*
+ * json.h - Native JSON reader and writer
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_JSON_H
+#define GAUCHE_RFC_JSON_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+/*
+ * Handlers to construct Scheme objects from JSON arrays, objects,
+ * and literals (false, true and null).  They correspond to the
+ * parameters json-array-handler, json-object-handler and
+ * json-special-handler in rfc.json.
+ */
+typedef struct ScmJsonHandlersRec {
+    ScmObj arrayHandler;        /* receives a list of elements */
+    ScmObj objectHandler;       /* receives a list of (key . value) */
+    ScmObj specialHandler;      /* receives a symbol */
+    long   depthLimit;          /* max nesting level */
+} ScmJsonHandlers;
+
+/* Word-at-a-time byte scanning.  JSON_HAS_ZERO_BYTE(w) is nonzero iff
+   any byte in a 64bit word W is zero; JSON_HAS_LESS_BYTE(w, n) is nonzero
+   iff any byte in W is less than N (N <= 128). */
+#define JSON_ONES   UINT64_C(0x0101010101010101)
+#define JSON_HIGHS  UINT64_C(0x8080808080808080)
+#define JSON_HAS_ZERO_BYTE(w)  (((w) - JSON_ONES) & ~(w) & JSON_HIGHS)
+#define JSON_HAS_LESS_BYTE(w, n) (((w) - JSON_ONES*(n)) & ~(w) & JSON_HIGHS)
+
+extern void   Scm_JsonInitHandlers(ScmJsonHandlers *h,
+                                   ScmObj arrayHandler,
+                                   ScmObj objectHandler,
+                                   ScmObj specialHandler,
+                                   ScmObj depthLimit);
+extern ScmObj Scm_JsonParsePort(ScmPort *port, const ScmJsonHandlers *h);
+extern ScmObj Scm_JsonParseString(ScmString *s, const ScmJsonHandlers *h);
+extern ScmObj Scm_JsonReadToken(ScmPort *port, const ScmJsonHandlers *h);
+
+extern void   Scm_JsonWrite(ScmObj obj, ScmPort *port, ScmObj fallback);
+
+extern void Scm_Init_json_parser(ScmModule *mod);
+extern void Scm_Init_json_writer(ScmModule *mod);
+
+#endif /*GAUCHE_RFC_JSON_H*/
@@ -0,0 +1,88 @@
+;;;
+;;; rfc.json.native - native JSON reader and writer
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; This module provides the C-implemented fast path for rfc.json.
+;; It is not intended to be used directly; use rfc.json.
+;; The condition types are defined here so that the C code can raise them.
+
+(define-module rfc.json.native
+  (export <json-parse-error> <json-construct-error>
+          %json-parse-port %json-parse-string %json-read-token
+          %json-write))
+(select-module rfc.json.native)
+
+(define-condition-type <json-parse-error> <error> #f
+  (position)                            ;stream position
+  (objects))                            ;offending object(s) or messages
+
+(define-condition-type <json-construct-error> <error> #f
+  (object))                             ;offending object
+
+;; Called from C
+(define (%json-parse-error position msg objs)
+  (error <json-parse-error> :position position :objects objs msg))
+
+(define (%json-construct-error obj msg)
+  (error <json-construct-error> :object obj msg))
+
+(inline-stub
+ (declcode (.include "json.h"))
+
+ (initcode (Scm_Init_json_parser (Scm_CurrentModule))
+           (Scm_Init_json_writer (Scm_CurrentModule)))
+
+ (define-cproc %json-parse-port (port::<input-port>
+                                 array-handler object-handler special-handler
+                                 depth-limit)
+   (let* ([h::ScmJsonHandlers])
+     (Scm_JsonInitHandlers (& h) array-handler object-handler
+                           special-handler depth-limit)
+     (return (Scm_JsonParsePort port (& h)))))
+
+ (define-cproc %json-parse-string (str::<string>
+                                   array-handler object-handler special-handler
+                                   depth-limit)
+   (let* ([h::ScmJsonHandlers])
+     (Scm_JsonInitHandlers (& h) array-handler object-handler
+                           special-handler depth-limit)
+     (return (Scm_JsonParseString str (& h)))))
+
+ (define-cproc %json-read-token (port::<input-port> special-handler)
+   (let* ([h::ScmJsonHandlers])
+     (Scm_JsonInitHandlers (& h) SCM_FALSE SCM_FALSE special-handler
+                           (SCM_MAKE_INT 0))
+     (return (Scm_JsonReadToken port (& h)))))
+
+ (define-cproc %json-write (obj port::<output-port> fallback) ::<void>
+   (Scm_JsonWrite obj port fallback))
+ )
@@ -1466,6 +1466,43 @@
   (run-across test-reverse-endian)
   )
 
+(test* "write-blocks (string port)" "abCD\x00;ef"
+       (call-with-output-string
+         (cut write-blocks `("ab" #u8(67 68) "" #u8(0) ,(string-copy "ef")) <>)))
+
+(test* "write-blocks (bad element)" (test-error)
+       (call-with-output-string (cut write-blocks '("ab" 1) <>)))
+
+;; Large data bypasses the port buffer.  Make sure the already-buffered
+;; data comes first.
+(let ([body (make-u8vector 100000 65)]
+      [str (make-string 100000 #\B)])
+  (test* "write-blocks (file port)"
+         (string-append "header\nX: y\n\n" (u8vector->string body) "tail")
+         (begin
+           (call-with-output-file "test.o"
+             (^[out]
+               (display "header\n" out)
+               (write-blocks (list "X: y\n\n" body "tail") out)))
+           (call-with-input-file "test.o" port->string)))
+  (test* "write-blocks (file port, small)" "header\nabcd"
+         (begin
+           (call-with-output-file "test.o"
+             (^[out]
+               (display "header\n" out)
+               (write-blocks (list "ab" (string->u8vector "cd")) out)))
+           (call-with-input-file "test.o" port->string)))
+  (test* "large write-string (file port)"
+         (string-append "header\n" str "tail")
+         (begin
+           (call-with-output-file "test.o"
+             (^[out]
+               (display "header\n" out)
+               (write-string str out)
+               (display "tail" out)))
+           (call-with-input-file "test.o" port->string)))
+  )
+
 ;;-------------------------------------------------------------------
 (test-section "string <-> uvector")
 
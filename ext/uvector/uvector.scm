@@ -70,7 +70,7 @@
 
           uvector-class-valid-element?
 
-          write-block write-uvector write-bytevector
+          write-block write-blocks write-uvector write-bytevector
 
           ;; R7RS compatibility (scheme base) and (scheme bytevector)
           bytevector bytevector? make-bytevector bytevector-fill!
@@ -397,6 +397,34 @@
                                         (end::<fixnum> -1)
                                         (endian::<symbol>? #f))
    Scm_WriteBlock)
+
+ ;; Writes out uvectors and strings in BLOCKS as is, in native endian.
+ ;; For a file port, large data is passed to writev(2) without being
+ ;; copied into the port buffer.
+ (define-cproc write-blocks (blocks
+                             :optional (port::<output-port>
+                                        (current-output-port)))
+   ::<void>
+   (let* ([n::ScmSize (Scm_Length blocks)])
+     (when (< n 0) (Scm_TypeError "blocks" "list" blocks))
+     (let* ([iov::ScmIOVec* (SCM_NEW_ARRAY ScmIOVec n)]
+            [i::ScmSize 0])
+       (dolist [b blocks]
+         (cond [(SCM_UVECTORP b)
+                (set! (ref (aref iov i) data)
+                      (cast (const char*) (SCM_UVECTOR_ELEMENTS b))
+                      (ref (aref iov i) size)
+                      (Scm_UVectorSizeInBytes (SCM_UVECTOR b)))]
+               [(SCM_STRINGP b)
+                (let* ([size::ScmSmallInt 0])
+                  (set! (ref (aref iov i) data)
+                        (Scm_GetStringContent (SCM_STRING b) (& size)
+                                              NULL NULL)
+                        (ref (aref iov i) size) size))]
+               [else
+                (Scm_TypeError "element of blocks" "uvector or string" b)])
+         (post++ i))
+       (Scm_Putzv iov n port))))
  )
 
 ;; R7RS bytevectors
@@ -0,0 +1,313 @@
+;;;
+;;; control.fork-join - work-stealing fork/join scheduler
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(define-module control.fork-join
+  (use gauche.threads)
+  (use gauche.record)
+  (use data.queue)
+  (use data.ring-buffer)
+  (export <fork-join-pool>
+          make-fork-join-pool fork-join-pool? fork-join-pool-size
+          fork-join-pool-shutdown! default-fork-join-pool
+          <fork-join-task> fork-join-task? fork-join-task-done?
+          spawn sync sync/timeout))
+(select-module control.fork-join)
+
+;; - Each worker thread has its own deque of tasks.  The worker pushes
+;;   tasks it spawns to, and pops tasks from, the front of its deque
+;;   (LIFO), so it works on the freshest, hence most cache-friendly,
+;;   subtask.  An idle worker steals from the back of other workers'
+;;   deques, taking the oldest task, which tends to be the biggest chunk
+;;   of work in divide-and-conquer computations.
+;; - Tasks spawned from a thread that isn't a worker of the pool go to
+;;   the shared injection queue.
+;; - 'sync' on a task that no one has started yet runs it inline in the
+;;   calling thread.  The deque entry becomes stale, and is discarded
+;;   when someone pops it.  So nested spawn/sync never blocks a worker
+;;   waiting for a task sitting in its own deque.
+;; - 'sync' on a task running in another thread makes a worker run other
+;;   tasks while waiting, instead of sleeping.
+;;
+;; The deques are protected by per-worker mutexes.  Contention is low,
+;; since thieves only come when they run out of their own work.
+
+(define-class <fork-join-pool> ()
+  ;; all slots are private
+  ((workers   :init-value #f)              ; #(<worker> ...)
+   (injection :init-form (make-mtqueue))   ; tasks from outside
+   (lock      :init-form (make-mutex))     ; for idle workers
+   (cv        :init-form (make-condition-variable))
+   (num-idle  :init-value 0)
+   (epoch     :init-value 0)               ; incremented by each spawn
+   (shut-down :init-value #f)))
+
+(define-record-type worker %make-worker #t
+  pool                                  ; <fork-join-pool>
+  index                                 ; position in the pool's workers
+  deque                                 ; ring buffer of tasks
+  lock                                  ; protects deque
+  (thread))
+
+(define-record-type <fork-join-task> %make-task fork-join-task?
+  (thunk  task-thunk  task-thunk-set!)
+  (paramz task-paramz)                  ; parameterization of the spawner
+  (state  task-state  task-state-set!)  ; pending, running, done or error
+  (result task-result task-result-set!) ; list of values, or a condition
+  (lock   task-lock)
+  (cv     task-cv))
+
+;; The worker the current thread is, or #f.
+(define *current-worker* (make-thread-local #f))
+
+;; How long a worker waiting for a task running in another thread sleeps
+;; before looking for other tasks to run.
+(define-constant *sync-wait* 0.05)
+
+;;;
+;;; Pool
+;;;
+
+(define (make-fork-join-pool :optional (num-workers (sys-available-processors)))
+  (assume (and (exact-integer? num-workers) (> num-workers 0))
+          "Number of workers must be a positive exact integer:" num-workers)
+  (rlet1 pool (make <fork-join-pool>)
+    (let1 ws (vector-tabulate num-workers
+                              (^i (%make-worker pool i
+                                                (make-ring-buffer)
+                                                (make-mutex)
+                                                #f)))
+      (set! (~ pool'workers) ws)
+      (vector-for-each (^w ($ worker-thread-set! w
+                              $ thread-start!
+                              $ make-thread (cut %worker-loop w)
+                              (format "fork-join-~d" (worker-index w))))
+                       ws))))
+
+(define (fork-join-pool? obj) (is-a? obj <fork-join-pool>))
+
+(define (fork-join-pool-size pool)
+  (assume-type pool <fork-join-pool>)
+  (vector-length (~ pool'workers)))
+
+;; Workers finish the tasks already queued before exiting.
+(define (fork-join-pool-shutdown! pool)
+  (assume-type pool <fork-join-pool>)
+  (with-locking-mutex (~ pool'lock)
+    (^[]
+      (set! (~ pool'shut-down) #t)
+      (condition-variable-broadcast! (~ pool'cv))))
+  (unless (tlref *current-worker*)
+    (vector-for-each (^w (thread-join! (worker-thread w))) (~ pool'workers))))
+
+;; Created on demand, so that merely loading the module doesn't start
+;; threads.
+(define %default-pool (atom #f))
+
+(define (default-fork-join-pool)
+  (atomic-update! %default-pool (^p (or p (make-fork-join-pool)))))
+
+;;;
+;;; Deque operations
+;;;
+
+(define (%push! w task)
+  (with-locking-mutex (worker-lock w)
+    (^[] (ring-buffer-add-front! (worker-deque w) task))))
+
+(define (%pop! w)
+  (with-locking-mutex (worker-lock w)
+    (^[] (and (not (ring-buffer-empty? (worker-deque w)))
+              (ring-buffer-remove-front! (worker-deque w))))))
+
+(define (%steal! w)
+  (with-locking-mutex (worker-lock w)
+    (^[] (and (not (ring-buffer-empty? (worker-deque w)))
+              (ring-buffer-remove-back! (worker-deque w))))))
+
+;; Try to steal from other workers, starting from the next one of W
+;; so that thieves don't all rush to the same victim.
+(define (%steal-any! w)
+  (let* ([ws (~ (worker-pool w)'workers)]
+         [n (vector-length ws)]
+         [i (worker-index w)])
+    (let loop ([k 1])
+      (and (< k n)
+           (or (%steal! (vector-ref ws (modulo (+ i k) n)))
+               (loop (+ k 1)))))))
+
+;; Returns a task W can run, already claimed, or #f if there's none.
+;; Tasks that are already claimed by 'sync' are discarded.
+(define (%take-task! w)
+  (let loop ()
+    (and-let* ([task (or (%pop! w)
+                         (dequeue! (~ (worker-pool w)'injection) #f)
+                         (%steal-any! w))])
+      (if (%claim! task) task (loop)))))
+
+;;;
+;;; Workers
+;;;
+
+(define (%worker-loop w)
+  (define pool (worker-pool w))
+  (tlset! *current-worker* w)
+  (let loop ()
+    (if-let1 task (%take-task! w)
+      (begin (%run! task) (loop))
+      ;; Look again after noting the epoch, so that we don't miss
+      ;; a task spawned while we were looking.
+      (let1 epoch (with-locking-mutex (~ pool'lock) (^[] (~ pool'epoch)))
+        (if-let1 task (%take-task! w)
+          (begin (%run! task) (loop))
+          (unless (%idle-wait pool epoch)
+            (loop)))))))
+
+;; Sleep until a task is spawned after EPOCH.  Returns #t if the pool
+;; is shut down.
+(define (%idle-wait pool epoch)
+  (mutex-lock! (~ pool'lock))
+  (cond [(~ pool'shut-down) (mutex-unlock! (~ pool'lock)) #t]
+        [(not (= epoch (~ pool'epoch))) (mutex-unlock! (~ pool'lock)) #f]
+        [else
+         (inc! (~ pool'num-idle))
+         (mutex-unlock! (~ pool'lock) (~ pool'cv))
+         (with-locking-mutex (~ pool'lock) (^[] (dec! (~ pool'num-idle))))
+         #f]))
+
+;; Called after a task is queued.
+(define (%notify! pool)
+  (with-locking-mutex (~ pool'lock)
+    (^[]
+      (inc! (~ pool'epoch))
+      (when (> (~ pool'num-idle) 0)
+        (condition-variable-signal! (~ pool'cv))))))
+
+;;;
+;;; Tasks
+;;;
+
+;; Changes the state of TASK from pending to running.  Returns #f if
+;; someone else has already claimed it.
+(define (%claim! task)
+  (with-locking-mutex (task-lock task)
+    (^[] (and (eq? (task-state task) 'pending)
+              (begin (task-state-set! task 'running) #t)))))
+
+(define (%run! task)
+  (receive (state result)
+      (guard (e [else (values 'error e)])
+        (values 'done
+                (call-with-parameterization (task-paramz task)
+                  (^[] (values->list ((task-thunk task)))))))
+    (with-locking-mutex (task-lock task)
+      (^[]
+        (task-thunk-set! task #f)       ; allow gc
+        (task-result-set! task result)
+        (task-state-set! task state)
+        (condition-variable-broadcast! (task-cv task))))))
+
+(define (%finished? task)
+  (memq (task-state task) '(done error)))
+
+;; Wait for TASK that is running in another thread.
+(define (%wait! task)
+  (if-let1 w (tlref *current-worker*)
+    ;; Keep the worker busy while waiting.
+    (let loop ()
+      (unless (%finished? task)
+        (if-let1 t (%take-task! w)
+          (%run! t)
+          (begin
+            (mutex-lock! (task-lock task))
+            (if (%finished? task)
+              (mutex-unlock! (task-lock task))
+              (mutex-unlock! (task-lock task) (task-cv task) *sync-wait*))))
+        (loop)))
+    (let loop ()
+      (mutex-lock! (task-lock task))
+      (if (%finished? task)
+        (mutex-unlock! (task-lock task))
+        (begin
+          (mutex-unlock! (task-lock task) (task-cv task))
+          (loop))))))
+
+;; API
+(define (spawn thunk :optional (pool #f))
+  (let* ([w (tlref *current-worker*)]
+         [pool (or pool
+                   (and w (worker-pool w))
+                   (default-fork-join-pool))]
+         [task (%make-task thunk (current-parameterization) 'pending #f
+                           (make-mutex) (make-condition-variable))])
+    (when (~ pool'shut-down)
+      (error "Fork-join pool has been shut down:" pool))
+    (if (and w (eq? (worker-pool w) pool))
+      (%push! w task)
+      (enqueue! (~ pool'injection) task))
+    (%notify! pool)
+    task))
+
+;; API
+(define (sync task)
+  (assume-type task <fork-join-task>)
+  (if (%claim! task)
+    (%run! task)
+    (%wait! task))
+  (%task-values task))
+
+;; API
+;; Unlike sync, this doesn't run TASK inline, for we can't stop it when
+;; TIMEOUT expires.
+(define (sync/timeout task timeout timeout-thunk)
+  (assume-type task <fork-join-task>)
+  (if-let1 limit (absolute-time timeout)
+    (let loop ()
+      (mutex-lock! (task-lock task))
+      (cond [(%finished? task)
+             (mutex-unlock! (task-lock task))
+             (%task-values task)]
+            [(mutex-unlock! (task-lock task) (task-cv task) limit) (loop)]
+            [else (timeout-thunk)]))
+    (sync task)))
+
+;; TASK must have been finished.
+(define (%task-values task)
+  (with-locking-mutex (task-lock task)
+    (^[] (if (eq? (task-state task) 'done)
+           (apply values (task-result task))
+           (raise (task-result task))))))
+
+;; API
+(define (fork-join-task-done? task)
+  (assume-type task <fork-join-task>)
+  (boolean (%finished? task)))
@@ -31,8 +31,9 @@
 ;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ;;;
 
-;; This is a provisional implementation; we'll use implicit thread pool
-;; to avoid thread creation overhead eventually.
+;; Each future runs in its own thread.  Futures may block waiting for
+;; each other (e.g. via mtqueue), which could deadlock if they shared
+;; a fixed number of workers as fork-join tasks do.
 
 ;; Guile and Racket uses 'touch' to retrieve the result of a future, but
 ;; that name seems too generic.  We adopt 'future-get'.
@@ -43,12 +44,8 @@
 ;; result.
 ;;
 ;; If the concurrent computation raises an exception, it is caught, and
-;; re-raised when first 'future-get'.  It is undefined if future-get is
-;; called again on such a future---it depends on the behavior of thread-join!,
-;; but the behavior of calling thread-join! again on exceptionally terminated
-;; thread isn't defined either.  Currently, the second call of future-get
-;; won't raise an exception and returns #<undef>, but do not count on
-;; the behavior.
+;; re-raised by 'future-get'.  Subsequent 'future-get' raises the same
+;; exception again.
 
 (define-module control.future
   (use gauche.threads)
@@ -64,7 +61,13 @@
   (syntax-rules ()
     [(_ expr)
      (make <future>
-       :thread (thread-start! (make-thread (lambda () (values->list expr)))))]))
+       :thread (thread-start! (make-thread (%future-thunk (lambda () expr)))))]))
+
+;; The thread returns (#t . results) or (#f . exception), so that
+;; we can get the outcome again however many times it's joined.
+(define (%future-thunk thunk)
+  (^[] (guard (e [else (cons #f e)])
+         (cons #t (values->list (thunk))))))
 
 (define (make-future thunk)
   (future (thunk)))
@@ -86,7 +89,7 @@
 
 (define (future-get/timeout future timeout timeout-thunk)
   (assume-type future <future>)
-  (guard (e [(uncaught-exception? e) (raise (~ e'reason))]
-            [(join-timeout-exception? e) (timeout-thunk)]
-            [else (raise e)])
-    (apply values (thread-join! (~ future'%thread) timeout))))
+  (let1 r (thread-join! (~ future'%thread) timeout future)
+    (cond [(eq? r future) (timeout-thunk)] ; timed out
+          [(car r) (apply values (cdr r))]
+          [else (raise (cdr r))])))
@@ -41,11 +41,13 @@
   (use srfi.19)
   (use control.thread-pool)
   (use control.job)
-  (export pmap pfind pany
+  (use control.fork-join)
+  (export pmap pfor-each pfind pany
           sequential-mapper
           make-static-mapper
           make-pool-mapper
-          make-fully-concurrent-mapper))
+          make-fully-concurrent-mapper
+          make-fork-join-mapper))
 (select-module control.pmap)
 
 ;; MAPPER abstracts the parallelization strategy.  We provide several
@@ -68,6 +70,13 @@
 ;;      e.g. up to a few dozens, and (2) each task is expected to block
 ;;      on I/O.
 ;;
+;;   fork-join-mapper - Recursively halves the collection and runs the
+;;      halves on a work-stealing fork/join pool (control.fork-join).
+;;      Idle workers steal the remaining work, so it copes with uneven
+;;      load, and it can be nested---pmap called within pmap shares
+;;      the same workers.  If the system has more than one core, this is
+;;      the default mapper.
+;;
 ;; A mapper class implements the following methods.  This is a provisional
 ;; interface.  The protocol should be kept private, for we may change as
 ;; we support more operations.
@@ -81,6 +90,10 @@
 ;;      proc on each element of <collection>.  As soon as one of the proc
 ;;      returns true in stop?, it cancels other operations and returns
 ;;      the value.
+;;
+;;   run-for-each <mapper> proc <collection>
+;;      Apply proc on each element of <collection> in parallel, discarding
+;;      the results.  The default method uses run-map.
 
 ;;
 ;; The high-level API, pmap, can be used without knowing underlying
@@ -97,6 +110,10 @@
 ;; Abstract class.
 (define-class <mapper> () ())
 
+(define-method run-for-each ((mapper <mapper>) proc coll)
+  (run-map mapper proc coll)
+  (undefined))
+
 ;; Utilities
 
 ;; Start threads in the list.
@@ -141,6 +158,9 @@
 (define-method run-map ((mapper <sequential-mapper>) proc coll)
   (map proc coll))
 
+(define-method run-for-each ((mapper <sequential-mapper>) proc coll)
+  (for-each proc coll))
+
 (define-method run-select ((mapper <sequential-mapper>) proc coll)
   (with-iterator (coll end? next)
     (let loop ()
@@ -323,6 +343,74 @@
             [r #f (or (join! (car ts)) r)])
            [(null? ts) r])))))
 
+;;
+;; fork-join mapper
+;;
+
+;; POOL is a fork-join pool; #f to use the default pool.
+;; GRAIN is the max number of elements a leaf task handles sequentially.
+;; If #f, we split the collection into about 8 chunks per worker, so that
+;; there are enough chunks to steal when the load is uneven.
+(define-class <fork-join-mapper> (<mapper>)
+  ((pool  :init-keyword :pool :init-value #f)
+   (grain :init-keyword :grain :init-value #f)))
+
+(define (make-fork-join-mapper :key (pool #f) (grain #f))
+  (make <fork-join-mapper> :pool pool :grain grain))
+
+;; Calls (leaf start end) on disjoint subranges covering [0, size),
+;; in parallel.  (stop?) is checked before splitting.
+(define (%fork-join-ranges mapper size leaf :optional (stop? (^[] #f)))
+  (let* ([pool (or (~ mapper'pool) (default-fork-join-pool))]
+         [grain (or (~ mapper'grain)
+                    (max 1 (quotient size (* 8 (fork-join-pool-size pool)))))])
+    (let rec ([start 0] [end size])
+      (cond [(stop?)]
+            [(<= (- end start) grain) (leaf start end)]
+            [else
+             (let* ([mid (ash (+ start end) -1)]
+                    [t (spawn (cut rec mid end) pool)])
+               (rec start mid)
+               (sync t))]))))
+
+(define-method run-map ((mapper <fork-join-mapper>) proc coll)
+  (let* ([vec (coerce-to <vector> coll)]
+         [res (make-vector (vector-length vec))])
+    ($ %fork-join-ranges mapper (vector-length vec)
+       (^[start end]
+         (do ([i start (+ i 1)])
+             [(= i end)]
+           (vector-set! res i (proc (vector-ref vec i))))))
+    (vector->list res)))
+
+(define-method run-for-each ((mapper <fork-join-mapper>) proc coll)
+  (let1 vec (coerce-to <vector> coll)
+    ($ %fork-join-ranges mapper (vector-length vec)
+       (^[start end]
+         (do ([i start (+ i 1)])
+             [(= i end)]
+           (proc (vector-ref vec i)))))
+    (undefined)))
+
+(define-method run-select ((mapper <fork-join-mapper>) proc coll)
+  (define vec (coerce-to <vector> coll))
+  (define result (atom #f #f))
+  (define (found?) (atom-ref result 0))
+  (define (found! r)
+    (atomic-update! result (^[f v] (if f (values f v) (values #t r)))))
+  ($ %fork-join-ranges mapper (vector-length vec)
+     (^[start end]
+       ;; An error also stops other tasks.
+       (guard (e [else (found! #f) (raise e)])
+         (let loop ([i start])
+           (unless (or (= i end) (found?))
+             (receive (s? r) (proc (vector-ref vec i))
+               (if s?
+                 (found! r)
+                 (loop (+ i 1))))))))
+     found?)
+  (atom-ref result 1))
+
 ;;
 ;; default mapper
 ;;
@@ -331,7 +419,7 @@
   (make-parameter
    (if (= 1 (sys-available-processors))
      (sequential-mapper)
-     (make-static-mapper))))
+     (make-fork-join-mapper))))
 
 ;;;
 ;;; High-level API
@@ -340,6 +428,9 @@
 (define (pmap proc coll :key (mapper (default-mapper)))
   (run-map mapper proc coll))
 
+(define (pfor-each proc coll :key (mapper (default-mapper)))
+  (run-for-each mapper proc coll))
+
 (define (pfind pred coll :key (mapper (default-mapper)))
   (run-select mapper
               (^e (if (pred e)
@@ -81,6 +81,8 @@
   (use gauche.dictionary)
   (use data.queue)
   (use data.heap)
+  (use gauche.threads)
+  (use gauche.record)
   (use srfi.114)
   (export <cache>
           ;; Protocol
@@ -98,7 +100,8 @@
           make-ttl-cache
           make-ttlr-cache
           make-lru-cache
-          make-counting-cache cache-stats))
+          make-counting-cache cache-stats
+          make-concurrent-cache))
 (select-module data.cache)
 
 ;; storage and comparator
@@ -405,3 +408,193 @@
 
 (define-method cache-stats ((cache <counting-cache>))
   `(:hits ,(~ cache'hits) :misses ,(~ cache'misses)))
+
+;; Concurrent cache
+;; - A thread-safe cache, for memoizing across threads.  Entries are
+;;   distributed to shards by the hash value of the key.  Each shard
+;;   has its own lock, so threads working on different keys rarely
+;;   contend.
+;; - Each shard has a fixed number of slots, and evicts entries with
+;;   the CLOCK algorithm, which approximates LRU.  A hit merely sets the
+;;   reference bit of the slot, instead of touching a queue.  When the
+;;   shard is full, the clock hand sweeps slots, clearing reference bits,
+;;   until it finds an unreferenced or expired entry.
+;; - If ttl is given, an entry expires when ttl passes since it is
+;;   written.  Expired entries are removed when they're looked up, or
+;;   when the clock hand passes them.
+;; - The storage slot isn't used; the entries are kept in the shards.
+
+(define-class <concurrent-cache> (<cache>)
+  ([capacity :init-keyword :capacity]
+   [ttl :init-keyword :ttl :init-value #f]
+   [timestamper :init-keyword :timestamper :init-value sys-time]
+   [num-shards :init-keyword :num-shards :init-value #f]
+   ;; private
+   [shards]                             ; #(<cache-shard> ...)
+   [hash]))                             ; hash function of the comparator
+
+(define-record-type cache-shard %make-cache-shard #t
+  lock
+  table                                 ; key -> slot index
+  keys                                  ; slot -> key
+  vals                                  ; slot -> value
+  refs                                  ; slot -> reference bit
+  expires                               ; slot -> expiration time or #f
+  stats                                 ; #(hits misses evictions expirations)
+  (free)                                ; list of unused slots
+  (hand))                               ; next slot the clock hand looks at
+
+(define (make-concurrent-cache capacity :key (comparator #f) (ttl #f)
+                                             (timestamper sys-time)
+                                             (num-shards #f))
+  (make <concurrent-cache> :comparator comparator :capacity capacity
+        :ttl ttl :timestamper timestamper :num-shards num-shards))
+
+(define-method initialize ((c <concurrent-cache>) initargs)
+  (next-method)
+  (let ([cap (~ c'capacity)]
+        [nshards (~ c'num-shards)]
+        [cmpr (cache-comparator c)])
+    (assume (and (exact-integer? cap) (> cap 0))
+            "Capacity must be a positive exact integer:" cap)
+    (assume (or (not nshards) (and (exact-integer? nshards) (> nshards 0)))
+            "Number of shards must be a positive exact integer:" nshards)
+    ;; Distribute the capacity evenly, so that the total is exactly cap.
+    (let* ([n (min cap (or nshards (* 2 (sys-available-processors))))]
+           [q (quotient cap n)]
+           [r (remainder cap n)])
+      (set! (~ c'storage) #f)
+      (set! (~ c'num-shards) n)
+      (set! (~ c'hash) (comparator-hash-function cmpr))
+      (set! (~ c'shards)
+            (vector-tabulate n (^i (%new-shard cmpr (if (< i r) (+ q 1) q))))))))
+
+(define (%new-shard cmpr size)
+  (%make-cache-shard (make-mutex) (make-hash-table cmpr)
+                     (make-vector size #f) (make-vector size #f)
+                     (make-vector size #f) (make-vector size #f)
+                     (make-vector 4 0) (iota size) 0))
+
+(define (%shard-of c key)
+  (vector-ref (~ c'shards) (modulo ((~ c'hash) key) (~ c'num-shards))))
+
+;; We read the clock outside of the shard lock.  Returns #f if entries
+;; don't expire.
+(define (%concurrent-now c)
+  (and (~ c'ttl) ((~ c'timestamper))))
+
+(define (%count! shard k)
+  (let1 st (cache-shard-stats shard)
+    (vector-set! st k (+ (vector-ref st k) 1))))
+
+(define (%expired? shard i now)
+  (and-let1 t (vector-ref (cache-shard-expires shard) i)
+    (> now t)))
+
+;; Removes the entry in slot I, without returning the slot to the free list.
+(define (%shard-clear-slot! shard i)
+  (hash-table-delete! (cache-shard-table shard)
+                      (vector-ref (cache-shard-keys shard) i))
+  (vector-set! (cache-shard-keys shard) i #f)
+  (vector-set! (cache-shard-vals shard) i #f)
+  (vector-set! (cache-shard-refs shard) i #f)
+  (vector-set! (cache-shard-expires shard) i #f))
+
+(define (%shard-remove! shard i)
+  (%shard-clear-slot! shard i)
+  (cache-shard-free-set! shard (cons i (cache-shard-free shard))))
+
+;; Returns the slot index of the live entry of KEY, or #f.
+(define (%shard-find shard key now)
+  (and-let1 i (hash-table-get (cache-shard-table shard) key #f)
+    (if (%expired? shard i now)
+      (begin (%shard-remove! shard i) (%count! shard 3) #f)
+      i)))
+
+;; Returns an unused slot, evicting an entry if necessary.  When all
+;; the slots are in use, the hand finds a victim within two rounds.
+(define (%shard-take-slot! shard now)
+  (let1 free (cache-shard-free shard)
+    (if (pair? free)
+      (begin (cache-shard-free-set! shard (cdr free)) (car free))
+      (let* ([refs (cache-shard-refs shard)]
+             [n (vector-length refs)])
+        (let loop ([i (cache-shard-hand shard)])
+          (let ([next (if (= (+ i 1) n) 0 (+ i 1))]
+                [expired (%expired? shard i now)])
+            (if (and (vector-ref refs i) (not expired))
+              (begin (vector-set! refs i #f) (loop next))
+              (begin
+                (%count! shard (if expired 3 2))
+                (%shard-clear-slot! shard i)
+                (cache-shard-hand-set! shard next)
+                i))))))))
+
+(define (%shard-put! c shard key val now)
+  (let ([expiry (and now (+ now (~ c'ttl)))]
+        [i (or (hash-table-get (cache-shard-table shard) key #f)
+               (rlet1 i (%shard-take-slot! shard now)
+                 (vector-set! (cache-shard-keys shard) i key)
+                 (hash-table-put! (cache-shard-table shard) key i)))])
+    (vector-set! (cache-shard-vals shard) i val)
+    (vector-set! (cache-shard-expires shard) i expiry)))
+
+(define-method cache-check! ((c <concurrent-cache>) key)
+  (let ([shard (%shard-of c key)]
+        [now (%concurrent-now c)])
+    (with-locking-mutex (cache-shard-lock shard)
+      (^[] (if-let1 i (%shard-find shard key now)
+             (begin
+               (vector-set! (cache-shard-refs shard) i #t)
+               (%count! shard 0)
+               (cons key (vector-ref (cache-shard-vals shard) i)))
+             (begin (%count! shard 1) #f))))))
+
+;; NB: cache-through! calls value-fn outside of the lock, so that a slow
+;; value-fn doesn't block other threads.  Two threads missing the same key
+;; at the same time may both compute the value; the latter wins.
+(define-method cache-register! ((c <concurrent-cache>) key value)
+  (let ([shard (%shard-of c key)]
+        [now (%concurrent-now c)])
+    (with-locking-mutex (cache-shard-lock shard)
+      (^[] (%shard-put! c shard key value now)))
+    (cons key value)))
+
+(define-method cache-write! ((c <concurrent-cache>) key value)
+  (cache-register! c key value)
+  (undefined))
+
+(define-method cache-evict! ((c <concurrent-cache>) key)
+  (let1 shard (%shard-of c key)
+    (with-locking-mutex (cache-shard-lock shard)
+      (^[] (and-let1 i (hash-table-get (cache-shard-table shard) key #f)
+             (%shard-remove! shard i))))
+    (undefined)))
+
+(define-method cache-clear! ((c <concurrent-cache>))
+  (vector-for-each
+   (^[shard]
+     (with-locking-mutex (cache-shard-lock shard)
+       (^[]
+         (let1 n (vector-length (cache-shard-keys shard))
+           (hash-table-clear! (cache-shard-table shard))
+           (vector-fill! (cache-shard-keys shard) #f)
+           (vector-fill! (cache-shard-vals shard) #f)
+           (vector-fill! (cache-shard-refs shard) #f)
+           (vector-fill! (cache-shard-expires shard) #f)
+           (cache-shard-free-set! shard (iota n))
+           (cache-shard-hand-set! shard 0)))))
+   (~ c'shards))
+  (undefined))
+
+;; Returns (:hits n :misses n :evictions n :expirations n), summed up
+;; over the shards.  Evictions counts the entries pushed out by the
+;; capacity limit; expirations counts the ones removed by ttl.
+(define-method cache-stats ((c <concurrent-cache>))
+  (let1 sum (fold (^[shard sum]
+                    (with-locking-mutex (cache-shard-lock shard)
+                      (^[] (vector-map + sum (cache-shard-stats shard)))))
+                  (make-vector 4 0)
+                  (vector->list (~ c'shards)))
+    `(:hits ,(vector-ref sum 0) :misses ,(vector-ref sum 1)
+      :evictions ,(vector-ref sum 2) :expirations ,(vector-ref sum 3))))
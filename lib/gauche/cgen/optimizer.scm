@@ -116,6 +116,7 @@
                                            (~ orig-code'name)
                                            (~ orig-code'parent)
                                            (~ orig-code'intermediate-form))
+        (set! (~ cc'flags) (~ orig-code'flags))
         (do ([i 0 i])
             [(= i (vector-length cvec))
              (compiled-code-finish-builder cc (~ orig-code'max-stack))
@@ -672,8 +672,17 @@
                        (case flags
                          [(2) 'SCM_BINDING_CONST]
                          [(4) 'SCM_BINDING_INLINABLE]
+                         [(64) (if (exported-symbol? (unwrap-syntax id))
+                                 'SCM_BINDING_AUTO_INLINABLE
+                                 0)]
                          [else 0])))))
 
+;; Auto-inlinable bindings are only useful if other modules can see them.
+(define (exported-symbol? sym)
+  (let1 exports (compile-module-exports)
+    (or (eq? exports #t)
+        (and (list? exports) (memq sym exports) #t))))
+
 ;; given list of toplevel compiled codes, generate code in init
 ;; that calls them.  This is assumed to be the last procedure before
 ;; calling cgen-emit.
@@ -963,6 +972,9 @@
     (when (~ self'debug-info-cname)
       (print "  SCM_COMPILED_CODE("(~ self'c-name)")->debugInfo = "
              (~ self'debug-info-cname) ";"))
+    (unless (zero? (~ self'value'flags))
+      (print "  SCM_COMPILED_CODE("(~ self'c-name)")->flags = "
+             (~ self'value'flags) ";"))
     (fill-code self))
   (static (self) #t)
   )
@@ -360,6 +360,7 @@
    (%cclass <sys-stat> "ScmSysStat*")
    (%cclass <time> "ScmTime*")
    (%cclass <sys-fdset> "ScmSysFdset*")
+   (%cclass <sys-poller> "ScmSysPoller*")
    (%cclass <read-context> "ScmReadContext*")
    (%cclass <native-type> "ScmNativeType*")
    ;; NB: <sys-tm> is defined using define-cstruct in libsys.scm, and its
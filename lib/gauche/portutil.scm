@@ -85,10 +85,15 @@
                   (begin (write-block buf dst 0 nr)
                          (loop (+ count nr))))))))))))
 
-(define (copy-port src dst :key (unit 4096) (size -1))
+(define-constant *default-unit* 65536)
+
+(define (copy-port src dst :key (unit 0) (size -1))
   (assume (input-port? src))
   (assume (output-port? dst))
-  (cond [(eq? unit 'byte)
+  (cond [(and (integer? unit) (>= unit 0)
+              ((with-module gauche.internal %port-copy-fd)
+               src dst (if (and (integer? size) (>= size 0)) size -1)))]
+        [(eq? unit 'byte)
          (if (and (integer? size) (not (negative? size)))
            (%do-copy/limit1 (read-byte src) (write-byte data dst) size)
            (%do-copy (read-byte src) (write-byte data dst) (+ count 1)))]
@@ -97,7 +102,7 @@
            (%do-copy/limit1 (read-char src) (write-char data dst) size)
            (%do-copy (read-char src) (write-char data dst) (+ count 1)))]
         [(integer? unit)
-         (let ((buf (make-u8vector (if (zero? unit) 4096 unit))))
+         (let ((buf (make-u8vector (if (zero? unit) *default-unit* unit))))
            (if (and (integer? size) (not (negative? size)))
              (%do-copy/limitN src dst buf unit size)
              (%do-copy (read-block! buf src) (write-block buf dst 0 data)
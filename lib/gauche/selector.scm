@@ -1,5 +1,5 @@
 ;;;
-;;; selector - simple event loop by select()
+;;; selector - simple event loop
 ;;;
 ;;;   Copyright (c) 2000-2025  Shiro Kawai  <shiro@acm.org>
 ;;;
@@ -32,21 +32,79 @@
 ;;;
 
 
+;; The selector uses the most scalable readiness notification the
+;; platform provides: epoll on Linux, poll on other unixen (see
+;; sys-poller-open), and select as the last resort.  With epoll and poll,
+;; the cost of waiting doesn't depend on the number of idle descriptors,
+;; and there's no FD_SETSIZE limit.
+
 (define-module gauche.selector
   (use scheme.list)
-  (export <selector> selector-add! selector-delete! selector-select)
+  (use util.match)
+  (export <selector> selector-add! selector-delete! selector-select
+          selector-wait selector-add-timer! selector-delete-timer!)
   )
 (select-module gauche.selector)
 
 (define-class <selector> ()
-  ((rfds :init-form #f)
-   (wfds :init-form #f)
-   (xfds :init-form #f)
-   (rhandlers :init-form '())  ; list of (port-or-fd . proc)
-   (whandlers :init-form '())  ; ditto
-   (xhandlers :init-form '())  ; ditto
+  ((backend :init-keyword :backend :init-value #f) ; epoll, poll or select
+   (edge-triggered :init-keyword :edge-triggered :init-value #f)
+   (handlers :init-form (make-hash-table 'eqv?))
+                       ; key -> #(rhandler whandler xhandler), where
+                       ; key is fd, or a port if it doesn't have fd.
+                       ; each handler is (port-or-fd . proc) or #f.
+   (fdless :init-value '()) ; keys of ports without fd.  They're
+                            ; considered always ready.
+   (poller :init-value #f)  ; <sys-poller>, for epoll and poll backends
+   (rfds :init-value #f)    ; <sys-fdset>s, for select backend
+   (wfds :init-value #f)
+   (xfds :init-value #f)
+   ;; Timer wheel.  A timer due at tick T is kept in the bucket
+   ;; (modulo T *wheel-size*).
+   (wheel :init-form (make-vector *wheel-size* '()))
+   (tick :init-value 0)     ; next tick to be examined
+   (ntimers :init-value 0)  ; # of timers in the wheel, incl. cancelled ones
   ))
 
+(define-class <selector-timer> ()
+  ((tick :init-keyword :tick)
+   (proc :init-keyword :proc)))  ; #f if cancelled
+
+(define-constant *tick-usec* 10000)     ; timer resolution (10ms)
+(define-constant *wheel-size* 256)
+
+(cond-expand
+ [gauche.sys.poller]
+ [else
+  ;; Placeholders; they're never called since we don't have a poller.
+  (define (sys-poller-add! . _) #f)
+  (define (sys-poller-delete! . _) #f)
+  (define (sys-poller-wait . _) '())])
+
+(define-method initialize ((self <selector>) initargs)
+  (define (use-select!)
+    (slot-set! self 'backend 'select)
+    (slot-set! self 'rfds (make <sys-fdset>))
+    (slot-set! self 'wfds (make <sys-fdset>))
+    (slot-set! self 'xfds (make <sys-fdset>)))
+  (next-method)
+  (case (slot-ref self 'backend)
+    [(select) (use-select!)]
+    [(epoll poll #f)
+     (cond-expand
+      [gauche.sys.poller
+       (let1 poller (sys-poller-open (slot-ref self 'backend))
+         (slot-set! self 'poller poller)
+         (slot-set! self 'backend (sys-poller-kind poller)))]
+      [else
+       (when (slot-ref self 'backend)
+         (errorf "~a backend isn't supported on this platform"
+                 (slot-ref self 'backend)))
+       (use-select!)])]
+    [else (errorf "invalid selector backend ~s, must be one of \
+                   epoll, poll, select or #f" (slot-ref self 'backend))])
+  (slot-set! self 'tick (current-tick)))
+
 (define (canon-flag flag)
   (case flag
     [(r read) 'r]
@@ -54,73 +112,233 @@
     [(x exception) 'x]
     [else (errorf "invalid flag ~s, must be r, w, or x" flag)]))
 
-(define (flag->fd-slot flag)
+(define (flag->index flag)
   (case flag
-    [(r) 'rfds] [(w) 'wfds] [(x) 'xfds]))
+    [(r) 0] [(w) 1] [(x) 2]))
 
-(define (flag->handler-slot flag)
-  (case flag
-    [(r) 'rhandlers] [(w) 'whandlers] [(x) 'xhandlers]))
+(define (port-or-fd->key port-or-fd)
+  (cond [(integer? port-or-fd) port-or-fd]
+        [(port? port-or-fd) (or (port-file-number port-or-fd) port-or-fd)]
+        [else (error "port or integer file descriptor required, but got:"
+                     port-or-fd)]))
+
+;; Returns the keys of entries PORT-OR-FD is registered with.  Usually
+;; it is just the fd, but a port may have lost its fd by being closed
+;; after registration.
+(define (lookup-keys selector port-or-fd)
+  (let ([handlers (slot-ref selector 'handlers)]
+        [key (port-or-fd->key port-or-fd)])
+    (if (or (integer? key) (hash-table-exists? handlers key))
+      (list key)
+      (hash-table-fold handlers
+                       (^[k entry keys]
+                         (if (any (^h (and h (eq? (car h) port-or-fd)))
+                                  (vector->list entry))
+                           (cons k keys)
+                           keys))
+                       '()))))
+
+(define (entry-flags entry)
+  (filter-map (^[flag i] (and (vector-ref entry i) flag)) '(r w x) '(0 1 2)))
+
+;; Let the backend know the current conditions we're waiting for KEY.
+(define (update-interest! selector key entry)
+  (let1 flags (entry-flags entry)
+    (when (null? flags)
+      (hash-table-delete! (slot-ref selector 'handlers) key))
+    (cond
+     [(port? key)
+      (slot-set! selector 'fdless
+                 (if (null? flags)
+                   (delete key (slot-ref selector 'fdless) eq?)
+                   (lset-adjoin eq? (slot-ref selector 'fdless) key)))]
+     [(slot-ref selector 'poller)
+      => (^[poller]
+           (cond [(null? flags) (sys-poller-delete! poller key)]
+                 [(slot-ref selector 'edge-triggered)
+                  (sys-poller-add! poller key (cons 'edge flags))]
+                 [else (sys-poller-add! poller key flags)]))]
+     [else
+      (for-each (^[flag slot]
+                  (sys-fdset-set! (slot-ref selector slot) key
+                                  (boolean (memq flag flags))))
+                '(r w x) '(rfds wfds xfds))])))
 
 (define-method selector-add! ((selector <selector>) port-or-fd proc flags)
   (assume-type proc <procedure>)
   (assume-type flags <list>)
-  (dolist [flag (map canon-flag flags)]
-    (let* ([slot (flag->fd-slot flag)]
-           [fds (or (slot-ref selector slot)
-                    (rlet1 f (make <sys-fdset>)
-                      (slot-set! selector slot f)))])
-      (set! (sys-fdset-ref fds port-or-fd) #t))
-    (slot-push! selector (flag->handler-slot flag) (cons port-or-fd proc))))
+  (let* ([key (port-or-fd->key port-or-fd)]
+         [handlers (slot-ref selector 'handlers)]
+         [entry (or (hash-table-get handlers key #f)
+                    (rlet1 e (make-vector 3 #f)
+                      (hash-table-put! handlers key e)))])
+    (dolist [flag (map canon-flag flags)]
+      (vector-set! entry (flag->index flag) (cons port-or-fd proc)))
+    (update-interest! selector key entry)))
 
 (define-method selector-delete! ((selector <selector>) port-or-fd proc flags)
-  (let1 flags (if flags (map canon-flag flags) '(r w x))
-    (for-each (^[fds handlers]
-                (cond
-                 [port-or-fd
-                  (if-let1 p (assoc port-or-fd (slot-ref selector handlers))
-                    (when (or (not proc) (eq? proc (cdr p)))
-                      (slot-set! selector handlers
-                                 (delete p (slot-ref selector handlers)))
-                      (if-let1 fds (slot-ref selector fds)
-                        (sys-fdset-set! fds port-or-fd #f))))]
-                 [proc
-                  (let loop ([h (slot-ref selector handlers)]
-                             [newh '()])
-                    (cond [(null? h)
-                           (slot-set! selector handlers (reverse newh))]
-                          [(eq? proc (cdar h))
-                           (if-let1 fds (slot-ref selector fds)
-                             (sys-fdset-set! fds (caar h) #f))
-                           (loop (cdr h) newh)]
-                          [else
-                           (loop (cdr h) (cons (car h) newh))]))]
-                 [else
-                  (slot-set! selector fds #f)
-                  (slot-set! selector handlers '())]))
-              (map flag->fd-slot flags)
-              (map flag->handler-slot flags))))
+  (let ([indices (if flags (map (.$ flag->index canon-flag) flags) '(0 1 2))]
+        [handlers (slot-ref selector 'handlers)])
+    (define (purge! key)
+      (and-let1 entry (hash-table-get handlers key #f)
+        (dolist [i indices]
+          (and-let1 h (vector-ref entry i)
+            (when (or (not proc) (eq? proc (cdr h)))
+              (vector-set! entry i #f))))
+        (update-interest! selector key entry)))
+    (for-each purge! (if port-or-fd
+                       (lookup-keys selector port-or-fd)
+                       (hash-table-keys handlers)))))
+
+;;
+;; Waiting
+;;
+
+;; Timeout is given in microseconds or a list of seconds and microseconds.
+(define (timeout->usec timeout)
+  (match timeout
+    [#f #f]
+    [(sec usec) (+ (* sec 1000000) usec)]
+    [(? real?) (exact (ceiling timeout))]
+    [_ (error "timeout must be a real number or a list of two integers, \
+               but got:" timeout)]))
+
+(define (now-usec)
+  (receive (sec nsec) (sys-clock-gettime-monotonic)
+    (if sec
+      (+ (* sec 1000000) (quotient nsec 1000))
+      (receive (sec usec) (sys-gettimeofday)
+        (+ (* sec 1000000) usec)))))
+
+(define (current-tick) (quotient (now-usec) *tick-usec*))
+
+;; Waits for I/O at most TIMEOUT microseconds (#f to wait indefinitely).
+;; Returns a list of (key flag ...) for the ready entries.
+(define (wait-ready selector timeout)
+  (let* ([handlers (slot-ref selector 'handlers)]
+         [fdless (map (^k (cons k (entry-flags (hash-table-get handlers k))))
+                      (slot-ref selector 'fdless))]
+         [timeout (if (null? fdless) timeout 0)])
+    (append
+     fdless
+     (if-let1 poller (slot-ref selector 'poller)
+       (sys-poller-wait poller timeout)
+       (receive (nfds rfds wfds xfds)
+           (sys-select (slot-ref selector 'rfds)
+                       (slot-ref selector 'wfds)
+                       (slot-ref selector 'xfds)
+                       timeout)
+         (if (zero? nfds)
+           '()
+           (hash-table-fold
+            handlers
+            (^[key entry ready]
+              (if (integer? key)
+                (let1 flags (filter-map (^[flag fds]
+                                          (and (sys-fdset-ref fds key) flag))
+                                        '(r w x) (list rfds wfds xfds))
+                  (if (null? flags) ready (acons key flags ready)))
+                ready))
+            '())))))))
+
+;; Returns a list of (proc port-or-fd flag) for the ready entries.
+;; All read handlers come first, then write handlers, then exception
+;; handlers, as the previous select-based implementation did.
+(define (ready-handlers selector ready)
+  (let1 handlers (slot-ref selector 'handlers)
+    (append-map
+     (^[flag i]
+       (filter-map (^[r]
+                     (and (memq flag (cdr r))
+                          (and-let* ([entry (hash-table-get handlers (car r) #f)]
+                                     [h (vector-ref entry i)])
+                            (list (cdr h) (car h) flag))))
+                   ready))
+     '(r w x) '(0 1 2))))
+
+(define-method selector-wait ((selector <selector>) :optional (timeout #f))
+  (map cdr (ready-handlers selector
+                           (wait-ready selector (timeout->usec timeout)))))
 
 (define-method selector-select ((selector <selector>) :optional (timeout #f))
+  (let1 deadline (and timeout (+ (now-usec) (timeout->usec timeout)))
+    (let loop ()
+      (let* ([remaining (and deadline (max 0 (- deadline (now-usec))))]
+             [twait (timer-timeout selector)]
+             [ready (wait-ready selector
+                                (cond [(not twait) remaining]
+                                      [(not remaining) twait]
+                                      [else (min twait remaining)]))]
+             [calls (ready-handlers selector ready)])
+        (for-each (^h (apply (car h) (cdr h))) calls)
+        (let1 n (+ (length calls) (expire-timers! selector))
+          ;; We may be woken up by a wheel bucket that only has timers
+          ;; for later rounds; keep waiting in that case.
+          (if (or (positive? n)
+                  (and deadline (>= (now-usec) deadline)))
+            n
+            (loop)))))))
+
+;;
+;; Timers
+;;
+
+(define-method selector-add-timer! ((selector <selector>) seconds proc)
+  (assume-type proc <procedure>)
+  (assume (and (real? seconds) (>= seconds 0))
+          "seconds must be a nonnegative real number, but got:" seconds)
+  (let1 now (current-tick)
+    (when (zero? (slot-ref selector 'ntimers))
+      (slot-set! selector 'tick now))
+    (let* ([tick (max (slot-ref selector 'tick)
+                      (+ now (exact (ceiling (/ (* seconds 1000000)
+                                                *tick-usec*)))))]
+           [timer (make <selector-timer> :tick tick :proc proc)]
+           [wheel (slot-ref selector 'wheel)]
+           [i (modulo tick *wheel-size*)])
+      (vector-set! wheel i (cons timer (vector-ref wheel i)))
+      (slot-set! selector 'ntimers (+ (slot-ref selector 'ntimers) 1))
+      timer)))
+
+;; Cancelled timers stay in the wheel until their time comes.
+(define-method selector-delete-timer! ((selector <selector>) timer)
+  (assume-type timer <selector-timer>)
+  (slot-set! timer 'proc #f))
+
+;; Microseconds until the nearest nonempty bucket, or #f if no timers.
+(define (timer-timeout selector)
+  (and (positive? (slot-ref selector 'ntimers))
+       (let ([wheel (slot-ref selector 'wheel)]
+             [start (slot-ref selector 'tick)])
+         (let loop ([t start])
+           (if (and (< t (+ start *wheel-size*))
+                    (null? (vector-ref wheel (modulo t *wheel-size*))))
+             (loop (+ t 1))
+             (max 0 (- (* t *tick-usec*) (now-usec))))))))
 
-  (define (pick-handlers fds handlers flag)
-    (fold (^[entry tail]
-            (let1 fd (car entry)
-              (if (sys-fdset-ref fds fd)
-                (cons (list (cdr entry) fd flag) tail)
-                tail)))
-          '()
-          handlers))
-
-  (receive (nfds rfds wfds xfds)
-      (sys-select (slot-ref selector 'rfds)
-                  (slot-ref selector 'wfds)
-                  (slot-ref selector 'xfds)
-                  timeout)
-    (when (> nfds 0)
-      (for-each (^h (apply (car h) (cdr h)))
-                (append
-                 (pick-handlers rfds (slot-ref selector 'rhandlers) 'r)
-                 (pick-handlers wfds (slot-ref selector 'whandlers) 'w)
-                 (pick-handlers xfds (slot-ref selector 'xhandlers) 'x))))
-    nfds))
+;; Calls the procedures of expired timers.  Returns the number of them.
+(define (expire-timers! selector)
+  (if (zero? (slot-ref selector 'ntimers))
+    0
+    (let* ([now (current-tick)]
+           [start (slot-ref selector 'tick)]
+           [end (min (+ now 1) (+ start *wheel-size*))]
+           [wheel (slot-ref selector 'wheel)])
+      (slot-set! selector 'tick (+ now 1))
+      (let loop ([t start] [expired '()])
+        (if (< t end)
+          (let1 i (modulo t *wheel-size*)
+            (receive (due later)
+                (partition (^[timer] (<= (slot-ref timer 'tick) now))
+                           (vector-ref wheel i))
+              (vector-set! wheel i later)
+              (loop (+ t 1) (append-reverse due expired))))
+          (begin
+            (slot-set! selector 'ntimers
+                       (- (slot-ref selector 'ntimers) (length expired)))
+            (count (^[timer]
+                     (and-let1 proc (slot-ref timer 'proc)
+                       (slot-set! timer 'proc #f)
+                       (proc)
+                       #t))
+                   (reverse expired))))))))
@@ -0,0 +1,395 @@
+;;;
+;;; gauche.vm.jit - Baseline template JIT
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; This is EXPERIMENTAL.  Requires Gauche configured with
+;; --enable-unsafe-jit-api, running on x86_64 (non-Windows).
+;;
+;; A baseline JIT translates straight-line runs of simple VM instructions
+;; in a compiled code into x86_64 native code, instruction by instruction,
+;; and replaces each run with a single XINSN instruction that calls
+;; the native code.  Branches, calls, returns and other instructions are
+;; left to the VM, so the control flow of the code vector is unchanged;
+;; we only remove the dispatch overhead within each run.
+;;
+;; The native code is called from XINSN with %r15 holding the current VM,
+;; and accesses VM registers (SP, VAL0, ENV) through it.  Each instruction
+;; template computes the result into %rax, which is then either stored
+;; into VAL0 or pushed onto the VM stack.  Operations that need type
+;; dispatch have inlined fast paths for fixnums and pairs, and call
+;; the C runtime otherwise.
+
+(define-module gauche.vm.jit
+  (use util.match)
+  (use gauche.vm.insn)
+  (use lang.asm.linker)
+  (use lang.asm.x86_64)
+  (import gauche.vm.code)
+  (export jit-available? jit-enable! jit-disable! jit-compile-code!))
+(select-module gauche.vm.jit)
+
+(define %unsafe-jit-enabled?
+  (with-module gauche.internal %unsafe-jit-enabled?))
+(define %vm-set-jit-compiler!
+  (with-module gauche.internal %vm-set-jit-compiler!))
+(define %jit-allocate-code-page
+  (with-module gauche.internal %jit-allocate-code-page))
+(define vm-field-offset     (with-module gauche.internal vm-field-offset))
+(define vm-function-address (with-module gauche.internal vm-function-address))
+(define raw-value           (with-module gauche.internal raw-value))
+
+;; A run shorter than this isn't worth replacing, for XINSN itself
+;; costs one dispatch.
+(define-constant *min-run-length* 2)
+
+;;;
+;;; API
+;;;
+
+(define (jit-available?)
+  (and (%unsafe-jit-enabled?)
+       (#/^x86_64-/ (gauche-architecture))
+       (not (#/mingw|windows/ (gauche-architecture)))
+       #t))
+
+;; Let the VM call jit-compile-code! on a closure body when it is entered
+;; THRESHOLD times.
+(define (jit-enable! :key (threshold 1000))
+  (unless (jit-available?)
+    (error "JIT is not available on this platform"))
+  (unless (and (exact-integer? threshold) (> threshold 0))
+    (error "threshold must be a positive exact integer, but got:" threshold))
+  (%vm-set-jit-compiler! jit-compile-code! threshold))
+
+(define (jit-disable!)
+  (when (%unsafe-jit-enabled?)
+    (%vm-set-jit-compiler! #f 0)))
+
+;; Rewrite compiled code CC in place.  Returns #t if any part of CC
+;; is replaced by native code, #f otherwise.
+(define (jit-compile-code! cc)
+  (unless (jit-available?)
+    (error "JIT is not available on this platform"))
+  (let* ([cvec (list->vector (vm-code->list cc))]
+         [targets (jump-targets cvec)])
+    (and (not (jit-compiled? cvec))
+         (let1 runs (find-runs cvec targets)
+           (and (pair? runs)
+                (begin (rewrite-code! cc cvec targets runs) #t))))))
+
+;;;
+;;; Code vector scanning
+;;;
+
+(define (insn-at cvec i)
+  (vector-ref cvec i))
+
+(define (operand-at cvec i)
+  (and (< (+ i 1) (vector-length cvec))
+       (vector-ref cvec (+ i 1))))
+
+(define (jit-compiled? cvec)
+  (let loop ([i 0])
+    (and (< i (vector-length cvec))
+         (let1 opcode (car (insn-at cvec i))
+           (or (eq? opcode 'XINSN)
+               (loop (+ i (vm-insn-size opcode))))))))
+
+;; Returns a hash table of code offsets that are jumped into.
+(define (jump-targets cvec)
+  (rlet1 tab (make-hash-table 'eqv?)
+    (let loop ([i 0])
+      (when (< i (vector-length cvec))
+        (let* ([opcode (car (insn-at cvec i))]
+               [info (vm-find-insn-info opcode)])
+          (case (~ info'operand-type)
+            [(label)     (hash-table-put! tab (vector-ref cvec (+ i 1)) #t)]
+            [(obj+label) (hash-table-put! tab (vector-ref cvec (+ i 2)) #t)])
+          (loop (+ i (vm-insn-size opcode))))))))
+
+;; Returns a list of (start end asm) for each run of translatable
+;; instructions.  A run never contains a jump target except at its start.
+(define (find-runs cvec targets)
+  (define (close start end asms runs)
+    (if (and start (>= (length asms) *min-run-length*))
+      (cons (list start end (apply append (reverse asms))) runs)
+      runs))
+  (let loop ([i 0] [start #f] [asms '()] [runs '()])
+    (if (>= i (vector-length cvec))
+      (reverse (close start i asms runs))
+      (let* ([insn (insn-at cvec i)]
+             [next (+ i (vm-insn-size (car insn)))]
+             [asm  (insn-template insn (operand-at cvec i))])
+        (cond [(not asm) (loop next #f '() (close start i asms runs))]
+              [(or (not start) (hash-table-exists? targets i))
+               (loop next i (list asm) (close start i asms runs))]
+              [else (loop next start (cons asm asms) runs)])))))
+
+;;;
+;;; Rewriting
+;;;
+
+(define (rewrite-code! cc cvec targets runs)
+  (let* ([new (make-compiled-code-builder (~ cc'required-args)
+                                          (~ cc'optional-args)
+                                          (~ cc'name)
+                                          (~ cc'parent)
+                                          (~ cc'intermediate-form))]
+         [labels (rlet1 tab (make-hash-table 'eqv?)
+                   (hash-table-for-each
+                    targets
+                    (^[k _] (hash-table-put! tab k
+                                             (compiled-code-new-label new)))))]
+         [dinfo (~ cc'debug-info)]
+         [entries (map (^_ (gensym "run")) runs)])
+    (define (label-of addr) (hash-table-get labels addr))
+    (define (source-info-at i)
+      (and-let* ([e (assv i dinfo)])
+        (assq-ref (cdr e) 'source-info #f)))
+    (receive (bytes label-offsets)
+        (link-templates (list (x86_64-asm
+                               (append-map (^[entry run]
+                                             (native-entry entry (caddr run)))
+                                           entries runs)))
+                        '())
+      (let ([page (%jit-allocate-code-page bytes)]
+            [offsets (obj-template-labels->alist label-offsets)]
+            [xinsn (~ (vm-find-insn-info 'XINSN)'code)])
+        (let loop ([i 0] [runs runs] [entries entries])
+          (when (< i (vector-length cvec))
+            (and-let* ([lab (hash-table-get labels i #f)])
+              (compiled-code-set-label! new lab))
+            (if (and (pair? runs) (= i (car (car runs))))
+              (begin
+                (compiled-code-emit0oi! new xinsn
+                                        (list page
+                                              (assq-ref offsets (car entries)))
+                                        (source-info-at i))
+                (loop (cadr (car runs)) (cdr runs) (cdr entries)))
+              (let* ([insn (insn-at cvec i)]
+                     [info (vm-find-insn-info (car insn))])
+                (emit-insn! new insn (~ info'code)
+                            (ecase (~ info'operand-type)
+                              [(none) #f]
+                              [(obj code codes) (vector-ref cvec (+ i 1))]
+                              [(label) (label-of (vector-ref cvec (+ i 1)))]
+                              [(obj+label)
+                               (list (vector-ref cvec (+ i 1))
+                                     (label-of (vector-ref cvec (+ i 2))))])
+                            (source-info-at i))
+                (loop (+ i (vm-insn-size (car insn))) runs entries)))))
+        ;; Keep the information not associated with instructions.
+        (dolist [e dinfo]
+          (unless (integer? (car e))
+            (compiled-code-push-info! new e)))
+        (compiled-code-finish-builder new (~ cc'max-stack))
+        (slot-set! new 'signature-info (~ cc'signature-info))
+        (compiled-code-copy! cc new)))))
+
+(define (emit-insn! cc insn code operand info)
+  (match insn
+    [(_)     (compiled-code-emit0oi! cc code operand info)]
+    [(_ a)   (compiled-code-emit1oi! cc code a operand info)]
+    [(_ a b) (compiled-code-emit2oi! cc code a b operand info)]))
+
+;;;
+;;; Instruction templates
+;;;
+
+;; Native code for a run.  The stack is realigned, for the templates
+;; may call C functions.
+(define (native-entry entry body)
+  `(,entry
+    (push %rbp)
+    (movq %rsp %rbp)
+    (andq -16 %rsp)
+    ,@body
+    (movq %rbp %rsp)
+    (pop %rbp)
+    (ret)))
+
+(define (off field) (vm-field-offset field))
+
+(define (imm32? v) (<= (- (expt 2 31)) v (- (expt 2 31) 1)))
+
+(define (load-imm v reg)
+  (if (imm32? v)
+    `((movq ,v ,reg))
+    `((movq (imm64 ,v) ,reg))))
+
+(define (raw obj) (raw-value obj))
+
+;; Heap objects referenced only from native code would be invisible
+;; from GC, so we only embed immediate values.
+(define (immediate? obj)
+  (memv (logand (raw obj) 3) '(1 3)))
+
+(define (call-c name)
+  `(,@(load-imm (vm-function-address name) '%rax)
+    (call %rax)))
+
+(define (load-val0 reg)
+  `((movq (,(off 'val0) %r15) ,reg)))
+
+(define (pop-arg reg)
+  `((movq (,(off 'sp) %r15) %rcx)
+    (subq 8 %rcx)
+    (movq %rcx (,(off 'sp) %r15))
+    (movq (%rcx) ,reg)))
+
+(define (store-result push?)
+  (if push?
+    `((movq (,(off 'sp) %r15) %rcx)
+      (movq %rax (%rcx))
+      (addq 8 %rcx)
+      (movq %rcx (,(off 'sp) %r15)))
+    `((movq %rax (,(off 'val0) %r15))
+      (movl 1 (,(off 'numVals) %r15)))))
+
+(define (lref depth offset)
+  `((movq (,(off 'env) %r15) %rax)
+    ,@(make-list depth '(movq (%rax) %rax))
+    (movq (,(* -8 (+ offset 1)) %rax) %rax)))
+
+(define *lref-shortcuts*
+  '((LREF0 0 0) (LREF1 0 1) (LREF2 0 2) (LREF3 0 3)
+    (LREF10 1 0) (LREF11 1 1) (LREF12 1 2)
+    (LREF20 2 0) (LREF21 2 1)
+    (LREF30 3 0)))
+
+;; Returns a list of asm instructions for INSN, or #f if we can't
+;; translate it.
+(define (insn-template insn operand)
+  (if (eq? (car insn) 'PUSH)
+    `(,@(load-val0 '%rax) ,@(store-result #t))
+    (receive (base push?)
+        (if-let1 m (#/^(.*)-PUSH$/ (symbol->string (car insn)))
+          (values (string->symbol (m 1)) #t)
+          (values (car insn) #f))
+      (and-let* ([asm (value-template base (cdr insn) operand)])
+        `(,@asm ,@(store-result push?))))))
+
+;; Returns a list of asm instructions that leaves the value in %rax.
+(define (value-template opcode params operand)
+  (match (cons opcode params)
+    [('CONST)   (and (immediate? operand) (load-imm (raw operand) '%rax))]
+    [('CONSTI n) (load-imm (raw n) '%rax)]
+    [('CONSTN)  (load-imm (raw '()) '%rax)]
+    [('CONSTF)  (load-imm (raw #f) '%rax)]
+    [('CONSTU)  (load-imm (raw (undefined)) '%rax)]
+    [('LREF d o) (lref d o)]
+    [((? (cut assq <> *lref-shortcuts*) op))
+     (apply lref (cdr (assq op *lref-shortcuts*)))]
+    [('CAR)     (pair-ref 0 'JITCar)]
+    [('CDR)     (pair-ref 8 'JITCdr)]
+    [('CONS)    `(,@(pop-arg '%rdi) ,@(load-val0 '%rsi) ,@(call-c 'Cons))]
+    [('EQ)      (let1 done (gensym)
+                  `(,@(pop-arg '%rdx)
+                    ,@(load-imm (raw #f) '%rax)
+                    (cmpq (,(off 'val0) %r15) %rdx)
+                    (jne ,done)
+                    ,@(load-imm (raw #t) '%rax)
+                    ,done))]
+    [('NULLP)   (let1 done (gensym)
+                  `(,@(load-val0 '%rdx)
+                    ,@(load-imm (raw #f) '%rax)
+                    (cmpq ,(raw '()) %rdx)
+                    (jne ,done)
+                    ,@(load-imm (raw #t) '%rax)
+                    ,done))]
+    [('NUMADDI k) (numaddi k)]
+    [('NUMADD2) (numop2 'Add '((movq %rdi %rax)
+                                (subq 1 %rax)
+                                (addq %rsi %rax))
+                        '())]
+    [('NUMSUB2) (numop2 'Sub '((movq %rdi %rax)
+                                (subq %rsi %rax))
+                        '((addq 1 %rax)))]
+    [_ #f]))
+
+;; SCM_CAR/SCM_CDR with SCM_PAIRP check.  If the object doesn't look
+;; like a simple pair, let the C helper do the full check.
+(define (pair-ref offset helper)
+  (let ([slow (gensym)] [done (gensym)])
+    `(,@(load-val0 '%rax)
+      (movq %rax %rcx)
+      (andq 3 %rcx)
+      (jne ,slow)
+      (movq (%rax) %rcx)
+      (andq 7 %rcx)
+      (cmpq 7 %rcx)
+      (je ,slow)
+      (movq (,offset %rax) %rax)
+      (jmp ,done)
+      ,slow
+      (movq %rax %rdi)
+      ,@(call-c helper)
+      ,done)))
+
+;; Fixnums are tagged as 4n+1, so we can add/subtract tagged values
+;; directly with a tag adjustment.  The range of fixnums is such that
+;; the result doesn't fit in a fixnum iff the machine operation overflows.
+(define (fixnum-check reg slow)
+  `((movq ,reg %rax)
+    (andq 3 %rax)
+    (cmpq 1 %rax)
+    (jne ,slow)))
+
+(define (numaddi k)
+  (let ([slow (gensym)] [done (gensym)])
+    `(,@(load-val0 '%rsi)
+      ,@(fixnum-check '%rsi slow)
+      (movq %rsi %rax)
+      (addq ,(* k 4) %rax)
+      (jo ,slow)
+      (jmp ,done)
+      ,slow
+      ,@(load-imm (raw k) '%rdi)
+      ,@(call-c 'Add)
+      ,done)))
+
+;; Binary arithmetic, the first arg popped from the stack and the second
+;; in VAL0.  FAST computes the result from tagged %rdi and %rsi into %rax,
+;; leaving the overflow flag.  FIXUP adjusts the tag afterwards.
+(define (numop2 name fast fixup)
+  (let ([slow (gensym)] [done (gensym)])
+    `(,@(pop-arg '%rdi)
+      ,@(load-val0 '%rsi)
+      ,@(fixnum-check '%rdi slow)
+      ,@(fixnum-check '%rsi slow)
+      ,@fast
+      (jo ,slow)
+      ,@fixup
+      (jmp ,done)
+      ,slow
+      ,@(call-c name)
+      ,done)))
@@ -39,6 +39,7 @@
   (use gauche.unicode)
   (use scheme.charset)
   (use parser.peg)
+  (use rfc.json.native)
   (use srfi.13)
   (use srfi.113)
   (export <json-parse-error> <json-construct-error>
@@ -46,6 +47,7 @@
 
           parse-json parse-json-string
           parse-json*
+          json-token-generator
           construct-json construct-json-string
 
           json-array-handler json-object-handler json-special-handler
@@ -55,14 +57,10 @@
           ))
 (select-module rfc.json)
 
-;; NB: We have <json-parse-error> independent from <parse-error> for
-;; now, since parser.peg's interface may be changed later.
-(define-condition-type <json-parse-error> <error> #f
-  (position)                            ;stream position
-  (objects))                            ;offending object(s) or messages
-
-(define-condition-type <json-construct-error> <error> #f
-  (object))                             ;offending object
+;; NB: <json-parse-error> and <json-construct-error> are defined in
+;; rfc.json.native, as the C parser raises them.  We have
+;; <json-parse-error> independent from <parse-error> for now, since
+;; parser.peg's interface may be changed later.
 
 (define json-array-handler   (make-parameter list->vector))
 (define json-object-handler  (make-parameter identity))
@@ -88,6 +86,12 @@
 ;;;============================================================
 ;;; Parser
 ;;;
+
+;; The entry points (parse-json etc.) use the native parser in
+;; rfc.json.native.  The PEG parser below accepts the same language,
+;; and is kept for json-parser and json-tokenizer, which can be combined
+;; with other parser.peg parsers.
+
 (define %ws ($many_ ($. #[ \t\r\n])))
 
 (define %begin-array     ($seq ($. #\[) %ws))
@@ -194,36 +198,44 @@
 
 ;; entry point
 (define (parse-json :optional (port (current-input-port)))
-  (guard (e [(<parse-error> e)
-             ;; not to expose parser.peg's <parse-error>.
-             (error <json-parse-error>
-                    :position (~ e'position) :objects (~ e'objects)
-                    :message (condition-message e e))])
-    (peg-parse-port json-parser port)))
+  (%json-parse-port port (json-array-handler) (json-object-handler)
+                    (json-special-handler) (json-nesting-depth-limit)))
 
 (define (parse-json-string str)
-  (call-with-input-string str (cut parse-json <>)))
+  (%json-parse-string str (json-array-handler) (json-object-handler)
+                      (json-special-handler) (json-nesting-depth-limit)))
 
 (define (parse-json* :optional (port (current-input-port)))
-  (guard (e [(<parse-error> e)
-             ;; not to expose parser.peg's <parse-error>.
-             (error <json-parse-error>
-                    :position (~ e'position) :objects (~ e'objects)
-                    :message (~ e'message))])
-    (generator->list (peg-parser->generator json-parser port))))
+  (let ([ah (json-array-handler)]
+        [oh (json-object-handler)]
+        [sh (json-special-handler)]
+        [limit (json-nesting-depth-limit)])
+    (let loop ([r '()])
+      (let1 v (%json-parse-port port ah oh sh limit)
+        (if (eof-object? v)
+          (reverse! r)
+          (loop (cons v r)))))))
+
+;; Streaming.  Returns a generator that yields tokens as json-tokenizer
+;; does, without building the whole structure.  The caller is responsible
+;; for checking the nesting.
+(define (json-token-generator :optional (port (current-input-port)))
+  (let1 sh (json-special-handler)
+    (^[] (%json-read-token port sh))))
 
 ;;;============================================================
 ;;; Writer
 ;;;
 
+;; The native writer %json-write handles booleans, numbers, strings,
+;; alists, hash tables and vectors by itself, and calls back
+;; print-generic for other objects.
+
 (define (print-value obj)
-  (cond [(or (eq? obj 'false) (eq? obj #f)) (display "false")]
-        [(or (eq? obj 'true) (eq? obj #t))  (display "true")]
-        [(eq? obj 'null)  (display "null")]
-        [(list? obj)      (print-object obj)]
-        [(string? obj)    (print-string obj)]
-        [(number? obj)    (print-number obj)]
-        [(is-a? obj <dictionary>) (print-object obj)]
+  (%json-write obj (current-output-port) print-generic))
+
+(define (print-generic obj)
+  (cond [(is-a? obj <dictionary>) (print-object obj)]
         [(is-a? obj <sequence>)   (print-array obj)]
         [(is-a? obj <json-mixin>) (print-instance obj)]
         [else (error <json-construct-error> :object obj
@@ -238,7 +250,7 @@
                     but got:" obj))
           (when comma-needed?
             (write-char #\,))
-          (print-string (x->string (car attr)))
+          (print-value (x->string (car attr)))
           (write-char #\:)
           (print-value (cdr attr))
           #t)
@@ -261,9 +273,9 @@
               (begin
                 (when comma-needed?
                   (write-char #\,))
-                (print-string (if (eqv? json-name #t)
-                                (x->string (slot-definition-name slot))
-                                (x->string json-name)))
+                (print-value (if (eqv? json-name #t)
+                               (x->string (slot-definition-name slot))
+                               (x->string json-name)))
                 (write-char #\:)
                 (print-value (slot-ref obj (slot-definition-name slot)))
                 #t)
@@ -271,33 +283,6 @@
           #f (class-slots class))
     (write-char #\})))
 
-(define (print-number num)
-  (cond [(or (not (real? num)) (not (finite? num)))
-         (error <json-construct-error> :object num
-                "json cannot represent a number" num)]
-        [(and (rational? num) (not (integer? num)))
-         (write (exact->inexact num))]
-        [else (write num)]))
-
-(define (print-string str)
-  (define specials
-    '((#\" . #\") (#\\ . #\\) (#\x08 . #\b) (#\page . #\f)
-      (#\newline . #\n) (#\return . #\r) (#\tab . #\t)))
-  (define (hexescape code) (format #t "\\u~4,'0x" code))
-  (define (print-char c)
-    (cond [(assv c specials) => (^p (write-char #\\) (write-char (cdr p)))]
-          [(and (char-set-contains? char-set:ascii c)
-                (not (eq? (char-general-category c) 'Cc)))
-           (write-char c)]
-          [else
-           (let1 code (char->ucs c)
-             (if (>= code #x10000)
-               (for-each hexescape (ucs4->utf16 code))
-               (hexescape code)))]))
-  (write-char #\")
-  (string-for-each print-char str)
-  (write-char #\"))
-
 (define (construct-json x :optional (oport (current-output-port)))
   (with-output-to-port oport
     (^() (print-value x))))
@@ -109,11 +109,13 @@
         [else (make-comparator #t eq-fn #f default-hash)]))
 
 (define (make-hash-table cmpr . args)
-  (if (procedure? cmpr)                 ; SRFI-69
-    (if (and (pair? args) (procedure? (car args)))
-      (%make-hash-table (make-comparator #t cmpr #f (car args)))
-      (%make-hash-table (%eq-fn->comparator cmpr)))
-    (%make-hash-table cmpr)))
+  ;; SRFI-125 suggests 'thread-safe as an implementation-specific arg.
+  (let1 opts (if (memq 'thread-safe args) '(:concurrent #t) '())
+    (if (procedure? cmpr)                 ; SRFI-69
+      (if (and (pair? args) (procedure? (car args)))
+        (apply %make-hash-table (make-comparator #t cmpr #f (car args)) opts)
+        (apply %make-hash-table (%eq-fn->comparator cmpr) opts))
+      (apply %make-hash-table cmpr opts))))
 
 (define (hash-table cmpr . kvs)
   (cond [(comparator? cmpr) (apply hash-table-r7 cmpr kvs)]
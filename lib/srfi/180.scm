@@ -81,12 +81,21 @@
                [else (inc! nchars) c]))))
     (generator->lseq port)))            ;assume it's a char-generator
 
+;; internal
+;; The native parser in rfc.json reads directly from a port, and doesn't
+;; read ahead.  It can't count characters, though.
+(define (native-input? port)
+  (and (port? port)
+       (infinite? (json-number-of-character-limit))))
+
 ;; API: streaming parser
 ;; NB: srfi's json-generator doesn't take a char generator, but for
 ;; the upper layers, we accept it for the convenience.
 (define (json-generator :optional (port (current-input-port)))
   (define inner-gen
-    (peg-parser->generator json-tokenizer (port/gen->json-lseq port)))
+    (if (native-input? port)
+      (json-token-generator port)
+      (peg-parser->generator json-tokenizer (port/gen->json-lseq port))))
   (define (nexttok)
     (guard (e ([<parse-error> e]
                ;; not to expose parser.peg's <parse-error>.
@@ -221,9 +230,11 @@
 ;; API
 ;; We skip json-fold/json-generator stuff entirely.
 (define (json-read :optional (port-or-generator (current-input-port)))
-  (with-json-parser
-   (^s (values-ref (peg-run-parser json-parser s) 0))
-   (port/gen->json-lseq port-or-generator)))
+  (if (native-input? port-or-generator)
+    (with-json-parser (^_ (parse-json port-or-generator)) #f)
+    (with-json-parser
+     (^s (values-ref (peg-run-parser json-parser s) 0))
+     (port/gen->json-lseq port-or-generator))))
 
 ;; API
 (define (json-lines-read :optional (port-or-generator (current-input-port)))
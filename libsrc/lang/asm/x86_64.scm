@@ -371,6 +371,14 @@
     [`(movq (reg ,src) (mem . ,x)) (! w (opc #x89) (reg src) (mem x))]
     [`(movq (mem . ,x) (reg ,dst)) (! w (opc #x8b) (reg dst) (mem x))]
 
+    [`(movl (imm8  ,i) (reg32 ,dst)) (! (rex.b dst) (opc+rq #xb8 dst) (imm32 i))]
+    [`(movl (imm32 ,i) (reg32 ,dst)) (! (rex.b dst) (opc+rq #xb8 dst) (imm32 i))]
+    [`(movl (imm8  ,i) (mem . ,x))   (! (opc #xc7) (reg 0) (mem x) (imm32 i))]
+    [`(movl (imm32 ,i) (mem . ,x))   (! (opc #xc7) (reg 0) (mem x) (imm32 i))]
+    [`(movl (reg32 ,src) (reg32 ,dst)) (! (opc #x89) (reg src) (r/m-reg dst))]
+    [`(movl (reg32 ,src) (mem . ,x)) (! (opc #x89) (reg src) (mem x))]
+    [`(movl (mem . ,x) (reg32 ,dst)) (! (opc #x8b) (reg dst) (mem x))]
+
     [`(movzbq (mem . ,x) (reg ,dst)) (! w (opc'(#x0f #xb6)) (reg dst) (mem x))]
     [`(movzwq (mem . ,x) (reg ,dst)) (! w (opc'(#x0f #xb7)) (reg dst) (mem x))]
 
@@ -528,7 +536,7 @@
     [`(,_ (imm32 ,i) (reg ,dst)) (if (= dst 0) ; %rax
                                    (! w (opc raxc) (imm32 i))
                                    (! w (opc #x81) (reg regc) (r/m-reg dst) (imm32 i)))]
-    [`(,_ (imm32 ,i) (mem . ,x)) (! w (opc #x81) (reg regc) (imm32 i))]
+    [`(,_ (imm32 ,i) (mem . ,x)) (! w (opc #x81) (reg regc) (mem x) (imm32 i))]
     [`(,_ (reg ,src) (reg ,dst)) (! w (opc basc) (reg src) (r/m-reg dst))]
     [`(,_ (reg ,src) (mem . ,x)) (! w (opc basc) (reg src) (mem x))]
     [`(,_ (mem . ,x) (reg ,dst)) (! w (opc (+ basc 2)) (reg dst) (mem x))]
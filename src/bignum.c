@@ -796,13 +796,16 @@ static ScmBignum *bignum_mul_word(ScmBignum *br, const ScmBignum *bx,
     return br;
 }
 
+/*
+ * Large multiplication and division are in mparith.c.
+ */
+#include "mparith.c"
+
 /* returns bx * by.  not normalized */
 static ScmBignum *bignum_mul(const ScmBignum *bx, const ScmBignum *by)
 {
     ScmBignum *br = make_bignum(bx->size + by->size);
-    for (u_int i=0; i<by->size; i++) {
-        bignum_mul_word(br, bx, by->values[i], i);
-    }
+    mul_n(br->values, bx->values, bx->size, by->values, by->size);
     br->sign = bx->sign * by->sign;
     return br;
 }
@@ -848,18 +851,6 @@ ScmObj Scm_BignumMulSI(const ScmBignum *bx, long y)
  * Division
  */
 
-/* returns # of bits in the leftmost '1' in the word, counting from MSB. */
-static inline int div_normalization_factor(u_long w)
-{
-    u_long b = (1L<<(WORD_BITS-1)), c = 0;
-    for (; b > 0; b>>=1, c++) {
-        if (w & b) return c;
-    }
-    /* something got wrong here */
-    Scm_Panic("bignum.c: div_normalization_factor: can't be here");
-    return 0;                   /* dummy */
-}
-
 /* General case of division.  We use each half word as a digit.
    Assumes digitsof(dividend) >= digitsof(divisor) > 1.
    Assumes enough digits are allocated to quotient.
@@ -1060,7 +1051,14 @@ ScmObj Scm_BignumDivRem(const ScmBignum *dividend, const ScmBignum *divisor)
     }
 
     ScmBignum *q = make_bignum(dividend->size - divisor->size + 1);
-    ScmBignum *r = bignum_gdiv(dividend, divisor, q);
+    ScmBignum *r;
+    if (divisor->size >= DIV_DC_THRESHOLD) {
+        r = make_bignum(divisor->size);
+        div_qr(q->values, r->values, dividend->values, dividend->size,
+               divisor->values, divisor->size);
+    } else {
+        r = bignum_gdiv(dividend, divisor, q);
+    }
     q->sign = dividend->sign * divisor->sign;
     r->sign = dividend->sign;
 
@@ -1241,24 +1239,102 @@ int Scm_BignumLogCount(const ScmBignum *b)
  * Printing
  */
 
+/* Radix conversion.  Small numbers are converted by repeated division
+   by the largest power of the radix that fits in a half word.  For
+   large numbers we divide the number by radix^(k*2^i) whose size is
+   about half of the number, and convert the quotient and the remainder
+   recursively.  With the fast division it takes a time proportional
+   to that of multiplication (times log n). */
+
+#define TOSTR_DC_THRESHOLD   40
+
+typedef struct tostr_ctx_rec {
+    int radix;
+    const char *tab;
+    u_long chunk;               /* radix^chunk_digits < HALF_WORD */
+    int chunk_digits;
+    ScmObj pows[WORD_BITS];     /* pows[i] = chunk^(2^i) */
+    int npows;
+} tostr_ctx;
+
+/* Write the digits of nonnegative integer n backwards, ending right
+   before *end.  At least pad digits are written, padding with '0'.
+   Returns the pointer to the first digit. */
+static char *tostr_rec(tostr_ctx *ctx, ScmObj n, char *end, long pad)
+{
+    char *p = end;
+
+    if (SCM_BIGNUMP(n) && SCM_BIGNUM_SIZE(n) >= TOSTR_DC_THRESHOLD) {
+        int i;
+        for (i = ctx->npows-1; i > 0; i--) {
+            if (SCM_BIGNUM_SIZE(ctx->pows[i])*2 <= SCM_BIGNUM_SIZE(n)+1) break;
+        }
+        if (SCM_BIGNUMP(ctx->pows[i])) {
+            long d = (long)ctx->chunk_digits << i;
+            ScmObj qr = Scm_BignumDivRem(SCM_BIGNUM(n),
+                                         SCM_BIGNUM(ctx->pows[i]));
+            p = tostr_rec(ctx, SCM_CDR(qr), p, d);
+            return tostr_rec(ctx, SCM_CAR(qr), p, pad - d);
+        }
+    }
+
+    if (SCM_INTP(n)) {
+        for (u_long v = SCM_INT_VALUE(n); v > 0; v /= ctx->radix) {
+            *--p = ctx->tab[v % ctx->radix];
+        }
+    } else {
+        ScmBignum *q = SCM_BIGNUM(Scm_BignumCopy(SCM_BIGNUM(n)));
+        while (q->size > 0) {
+            u_long v = bignum_sdiv(q, ctx->chunk);
+            for (int i=0; i<ctx->chunk_digits; i++, v /= ctx->radix) {
+                *--p = ctx->tab[v % ctx->radix];
+            }
+            while (q->size > 0 && q->values[q->size-1] == 0) q->size--;
+        }
+    }
+    while (end - p < pad) *--p = '0';
+    return p;
+}
+
 ScmObj Scm_BignumToString(const ScmBignum *b, int radix, int use_upper)
 {
     static const char ltab[] = "0123456789abcdefghijklmnopqrstuvwxyz";
     static const char utab[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    const char *tab = use_upper? utab : ltab;
-    ScmObj h = SCM_NIL, t = SCM_NIL;
     if (radix < SCM_RADIX_MIN || radix > SCM_RADIX_MAX)
         Scm_Error("radix out of range: %d", radix);
-    ScmBignum *q = SCM_BIGNUM(Scm_BignumCopy(b));
-    for (;q->size > 0;) {
-        long rem = bignum_sdiv(q, radix);
-        SCM_ASSERT(rem >= 0 && rem < radix);
-        SCM_APPEND1(h, t, SCM_MAKE_CHAR(tab[rem]));
-        for (; q->values[q->size-1] == 0 && q->size > 0; q->size--)
-            ;
+
+    tostr_ctx ctx;
+    ctx.radix = radix;
+    ctx.tab = use_upper? utab : ltab;
+    ctx.chunk = radix;
+    ctx.chunk_digits = 1;
+    while (ctx.chunk * radix < HALF_WORD) {
+        ctx.chunk *= radix;
+        ctx.chunk_digits++;
+    }
+    ctx.pows[0] = Scm_MakeIntegerU(ctx.chunk);
+    ctx.npows = 1;
+    if (b->size >= TOSTR_DC_THRESHOLD) {
+        /* We only need the powers up to about a half of b. */
+        for (;;) {
+            ScmObj q = ctx.pows[ctx.npows-1];
+            if (SCM_BIGNUMP(q) && SCM_BIGNUM_SIZE(q)*4 > b->size+2) break;
+            ctx.pows[ctx.npows++] = Scm_Mul(q, q);
+        }
     }
-    if (q->sign < 0) SCM_APPEND1(h, t, SCM_MAKE_CHAR('-'));
-    return Scm_ListToString(Scm_ReverseX(h));
+
+    /* Upper bound of the number of digits, plus the sign.  The leftmost
+       chunk may add up to chunk_digits zeros. */
+    long len = (long)b->size * WORD_BITS / Scm__HighestBitNumber(radix)
+        + ctx.chunk_digits + 2;
+    char *buf = SCM_NEW_ATOMIC_ARRAY(char, len);
+    ScmBignum *a = SCM_BIGNUM(Scm_BignumCopy(b));
+    a->sign = 1;
+    char *s = tostr_rec(&ctx, SCM_OBJ(a), buf+len, 1);
+    while (*s == '0' && s < buf+len-1) s++;
+    if (b->sign < 0) *--s = '-';
+    return Scm_MakeString(s, (ScmSmallInt)(buf+len-s), (ScmSmallInt)(buf+len-s),
+                          SCM_STRING_COPYING);
 }
 
 void Scm_BignumDump(const ScmBignum *b, ScmPort *out)
@@ -1312,3 +1388,54 @@ ScmBignum *Scm_BignumAccMultAddUI(ScmBignum *acc, u_long coef, u_long c)
         return rr;
     }
 }
+
+/* Calculate acc * base^n + chunks[0] * base^(n-1) + ... + chunks[n-1],
+   i.e. append n "big digits" to acc, and returns the bignum that has
+   the result, without normalizing.  Acc may be destructively modified.
+   For long sequences we split the chunks in halves recursively, so that
+   the work is done by a few large multiplications. */
+
+#define CHUNKS_DC_THRESHOLD  40
+
+static ScmObj chunks_rec(u_long base, const u_long *chunks, int n,
+                         ScmObj *pows)
+{
+    if (n < CHUNKS_DC_THRESHOLD) {
+        ScmBignum *b = Scm_MakeBignumWithSize(n+1, 0);
+        for (int i=0; i<n; i++) {
+            b = Scm_BignumAccMultAddUI(b, base, chunks[i]);
+        }
+        return Scm_NormalizeBignum(b);
+    }
+    int k = 0;
+    while ((2 << k) < n) k++;  /* 2^k < n <= 2^(k+1) */
+    ScmObj hi = chunks_rec(base, chunks, n - (1<<k), pows);
+    ScmObj lo = chunks_rec(base, chunks + n - (1<<k), 1<<k, pows);
+    return Scm_Add(Scm_Mul(hi, pows[k]), lo);
+}
+
+ScmBignum *Scm_BignumAccMultAddChunks(ScmBignum *acc, u_long base,
+                                      const u_long *chunks, int n)
+{
+    if (n < CHUNKS_DC_THRESHOLD) {
+        for (int i=0; i<n; i++) {
+            acc = Scm_BignumAccMultAddUI(acc, base, chunks[i]);
+        }
+        return acc;
+    }
+
+    /* pows[k] = base^(2^k) */
+    ScmObj pows[WORD_BITS];
+    pows[0] = Scm_MakeIntegerU(base);
+    for (int k=1; (1<<k) < n; k++) pows[k] = Scm_Mul(pows[k-1], pows[k-1]);
+
+    ScmObj r = chunks_rec(base, chunks, n, pows);
+    ScmObj a = Scm_NormalizeBignum(acc);
+    if (a != SCM_MAKE_INT(0)) {
+        r = Scm_Add(Scm_Mul(a, Scm_ExactIntegerExpt(Scm_MakeIntegerU(base),
+                                                    Scm_MakeInteger(n))),
+                    r);
+    }
+    if (SCM_INTP(r)) return SCM_BIGNUM(Scm_MakeBignumFromSI(SCM_INT_VALUE(r)));
+    return SCM_BIGNUM(r);
+}
@@ -36,6 +36,7 @@
 #include "gauche/code.h"
 #include "gauche/vminsn.h"
 #include "gauche/priv/configP.h"
+#include "gauche/priv/atomicP.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/classP.h"
 #include "gauche/priv/identifierP.h"
@@ -196,6 +197,19 @@ static ScmObj key_body           = SCM_FALSE;
    dispatch accelerator.  Can be turned on with a environment variable. */
 static int disable_generic_dispatcher = FALSE;
 
+/* The dispatch accelerator is built automatically when a GF is called
+   a certain times (see dispatchP.h).  We count the calls in
+   gf->common.dispatchCount, and set it to GENERIC_DISPATCH_SETTLED once
+   we've tried, so that we won't try again until the methods are changed.
+   The accelerator built automatically is discarded when a method is
+   added or deleted, and will be rebuilt after another round of calls;
+   it is cheaper than keeping it up to date during a series of
+   define-methods. */
+#define GENERIC_DISPATCH_SETTLED  0xffff
+
+/* See "Call-site method cache" below. */
+static void invalidate_call_site_cache(void);
+
 /* A global lock to serialize class redefinition.  We need it since
    class redefinition is not a local effect---it propagates through
    its subclasses.  So it is pretty difficult to guarantee consistency
@@ -1105,6 +1119,7 @@ void Scm_CommitClassRedefinition(ScmClass *klass, ScmObj newklass)
         (void)SCM_INTERNAL_COND_BROADCAST(klass->cv);
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(klass->mutex);
+    invalidate_call_site_cache();
 
     /* Decrement the recursive global lock. */
     unlock_class_redefinition(vm);
@@ -2177,6 +2192,7 @@ static void generic_methods_set(ScmGeneric *gf, ScmObj val)
     gf->methods = val;
     gf->maxReqargs = reqs;
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    invalidate_call_site_cache();
 }
 
 /* Make base generic function from C */
@@ -2235,12 +2251,55 @@ int Scm_MethodApplicableForClasses(ScmMethod *m, ScmClass *types[], int nargs)
     return TRUE;
 }
 
+/* Returns the list of methods in METHODS that are applicable to
+   the argument classes TYPEV. */
+static ScmObj applicable_methods(ScmObj methods, ScmClass **typev, int argc)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL, mp;
+
+    SCM_ASSERT(SCM_PAIRP(methods));
+    if (SCM_NULLP(SCM_CDR(methods))) {
+        /* We have only one method, so just check its applicability
+           and return the list without allocation if possible. */
+        if (!SCM_METHOD(SCM_CAR(methods))->common.placeholder
+            && Scm_MethodApplicableForClasses(SCM_METHOD(SCM_CAR(methods)),
+                                              typev, argc)) {
+            return methods;
+        } else {
+            return SCM_NIL;
+        }
+    } else {
+        SCM_FOR_EACH(mp, methods) {
+            ScmObj m = SCM_CAR(mp);
+            SCM_ASSERT(SCM_METHODP(m));
+
+            if (!SCM_METHOD(m)->common.placeholder
+                && Scm_MethodApplicableForClasses(SCM_METHOD(m), typev, argc)) {
+                SCM_APPEND1(h, t, SCM_OBJ(m));
+            }
+        }
+        return h;
+    }
+}
+
+/* Called when GF has been called SCM_DISPATCHER_AUTO_CALLS times without
+   dispatcher.  We try to build one.  Whether it succeeds or not, we won't
+   try again until the set of methods is changed. */
+static void generic_auto_build_dispatcher(ScmGeneric *gf)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(gf->lock);
+    if (gf->dispatcher == NULL && !disable_generic_dispatcher) {
+        gf->dispatcher = Scm__AutoBuildMethodDispatcher(gf->methods);
+    }
+    gf->common.dispatchCount = GENERIC_DISPATCH_SETTLED;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+}
+
 /* compute-applicable-methods */
 ScmObj Scm_ComputeApplicableMethods(ScmGeneric *gf, ScmObj *argv, int argc,
                                     int applyargs)
 {
-    ScmObj methods = gf->methods, mp, ap;
-    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmObj methods = gf->methods, ap;
     ScmClass *typev_s[PREALLOC_SIZE], **typev = typev_s;
     int i, nsel;
 
@@ -2261,37 +2320,28 @@ ScmObj Scm_ComputeApplicableMethods(ScmGeneric *gf, ScmObj *argv, int argc,
         }
     }
 
-    if (gf->dispatcher
+    if (gf->dispatcher == NULL) {
+        /* NB: The counter isn't protected; we only need a rough count. */
+        if (gf->common.dispatchCount < SCM_DISPATCHER_AUTO_CALLS) {
+            gf->common.dispatchCount++;
+        } else if (gf->common.dispatchCount == SCM_DISPATCHER_AUTO_CALLS) {
+            generic_auto_build_dispatcher(gf);
+        }
+    }
+
+    ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
+    if (dis
         && argc <= SCM_DISPATCHER_MAX_NARGS
         && argc >= 1) {
-        ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
         ScmObj p = Scm__MethodDispatcherLookup(dis, typev, argc);
-        if (SCM_PAIRP(p)) methods = p;
-    }
-
-    SCM_ASSERT(SCM_PAIRP(methods));
-    if (SCM_NULLP(SCM_CDR(methods))) {
-        /* We have only one method, so just check its applicability
-           and return the list without allocation if possible. */
-        if (!SCM_METHOD(SCM_CAR(methods))->common.placeholder
-            && Scm_MethodApplicableForClasses(SCM_METHOD(SCM_CAR(methods)),
-                                              typev, argc)) {
-            return methods;
-        } else {
-            return SCM_NIL;
+        if (SCM_PAIRP(p)) {
+            /* If none of the methods the dispatcher gives is applicable,
+               a method less specific on the axis may still be. */
+            ScmObj r = applicable_methods(p, typev, argc);
+            if (!SCM_NULLP(r)) return r;
         }
-    } else {
-        SCM_FOR_EACH(mp, methods) {
-            ScmObj m = SCM_CAR(mp);
-            SCM_ASSERT(SCM_METHODP(m));
-
-            if (!SCM_METHOD(m)->common.placeholder
-                && Scm_MethodApplicableForClasses(SCM_METHOD(m), typev, argc)) {
-                SCM_APPEND1(h, t, SCM_OBJ(m));
-            }
-        }
-        return h;
     }
+    return applicable_methods(methods, typev, argc);
 }
 
 static ScmObj compute_applicable_methods(ScmNextMethod *nm SCM_UNUSED,
@@ -2428,6 +2478,155 @@ ScmObj Scm_SortMethods(ScmObj methods, ScmObj *argv, int argc)
     return Scm_ArrayToList(array, len);
 }
 
+/*
+ * Call-site method cache
+ *
+ *   When VM applies a pure generic function, it calls
+ *   Scm__GenericCallSiteMethods with the compiled code being executed
+ *   and the call site (the PC after the CALL instruction).  We remember,
+ *   per call site, the classes of the arguments and the sorted list of
+ *   applicable methods, so that the call site that keeps seeing the same
+ *   classes can skip computing and sorting the applicable methods.
+ *
+ *   The cache is kept in the callSiteCache field of the compiled code,
+ *   and allocated when the code first calls a generic function.  It is
+ *   indexed by the offset of the call site in the code vector.  Each
+ *   call site gets CALL_SITE_CACHE_WAYS slots, so that a site seeing a
+ *   few different combinations of classes can also hit.  A slot holds an
+ *   immutable entry, which is replaced as a whole, so the readers don't
+ *   need a lock.  Once a site fills all of its slots with valid entries,
+ *   we stop adding entries for it, so a megamorphic site doesn't allocate
+ *   a new entry on every call.
+ *
+ *   Any change that can affect the set or the order of applicable
+ *   methods---adding or deleting methods, and class redefinition---bumps
+ *   generic_generation, which invalidates all the entries at once.
+ *   Such changes are rare once the program gets going.
+ */
+
+#define CALL_SITE_CACHE_WAYS     4    /* must be a power of 2 */
+#define CALL_SITE_CACHE_MAXSETS  1024 /* must be a power of 2 */
+#define CALL_SITE_CACHE_NARGS    SCM_DISPATCHER_MAX_NARGS
+
+typedef struct call_site_entry_rec {
+    u_long site;                /* offset of the call site */
+    ScmGeneric *gf;
+    ScmAtomicWord generation;
+    int argc;
+    ScmClass *typev[CALL_SITE_CACHE_NARGS];
+    ScmObj methods;             /* sorted list of applicable methods */
+} call_site_entry;
+
+typedef struct call_site_cache_rec {
+    u_long mask;                /* # of sets - 1 */
+    ScmAtomicVar slots[1];      /* (mask+1)*CALL_SITE_CACHE_WAYS entries */
+} call_site_cache;
+
+static ScmAtomicVar generic_generation = 0;
+
+/* Called _after_ the change is made, so that the entry computed
+   before the change never carries the new generation. */
+static void invalidate_call_site_cache(void)
+{
+    ScmAtomicWord g = Scm_AtomicLoad(&generic_generation);
+    while (!Scm_AtomicCompareExchange(&generic_generation, &g, g+1))
+        ;
+}
+
+/* Returns the cache of CC, allocating it if necessary.  The number of
+   sets is roughly proportional to the code size, since we don't know
+   how many generic call sites the code has. */
+static call_site_cache *get_call_site_cache(ScmCompiledCode *cc)
+{
+    ScmAtomicVar *loc = (ScmAtomicVar*)&cc->callSiteCache;
+    ScmAtomicWord c = Scm_AtomicLoad(loc);
+    if (c) return (call_site_cache*)c;
+
+    u_long nsets = 1;
+    while (nsets < (u_long)cc->codeSize/8 && nsets < CALL_SITE_CACHE_MAXSETS) {
+        nsets <<= 1;
+    }
+    call_site_cache *z =
+        SCM_NEW2(call_site_cache*,
+                 sizeof(call_site_cache)
+                 + sizeof(ScmAtomicVar)*(nsets*CALL_SITE_CACHE_WAYS - 1));
+    z->mask = nsets - 1;
+    /* If another thread has installed one, use it. */
+    if (!Scm_AtomicCompareExchange(loc, &c, SCM_WORD(z))) {
+        return (call_site_cache*)c;
+    }
+    return z;
+}
+
+static ScmObj sorted_applicable_methods(ScmGeneric *gf,
+                                        ScmObj *argv, int argc)
+{
+    ScmObj mm = Scm_ComputeApplicableMethods(gf, argv, argc, FALSE);
+    if (SCM_PAIRP(mm) && SCM_PAIRP(SCM_CDR(mm))) {
+        mm = Scm_SortMethods(mm, argv, argc);
+    }
+    return mm;
+}
+
+/* Returns sorted applicable methods of GF for ARGV, called from SITE
+   in the code vector of CC.  CC may be NULL, or SITE may be outside of
+   its code vector, if the caller doesn't have a meaningful call site.
+   ARGV doesn't contain the spread arguments (i.e. not apply-call). */
+ScmObj Scm__GenericCallSiteMethods(ScmGeneric *gf, ScmCompiledCode *cc,
+                                   const ScmWord *site,
+                                   ScmObj *argv, int argc)
+{
+    int nsel = (argc < gf->maxReqargs) ? argc : gf->maxReqargs;
+
+    if (cc == NULL || cc->code == NULL
+        || site <= cc->code || site > cc->code + cc->codeSize
+        || nsel > CALL_SITE_CACHE_NARGS
+        || disable_generic_dispatcher) {
+        return sorted_applicable_methods(gf, argv, argc);
+    }
+
+    ScmClass *typev[CALL_SITE_CACHE_NARGS];
+    for (int i=0; i<nsel; i++) typev[i] = Scm_ClassOf(argv[i]);
+
+    call_site_cache *z = get_call_site_cache(cc);
+    u_long off = (u_long)(site - cc->code);
+    ScmAtomicVar *slots = z->slots + (off & z->mask) * CALL_SITE_CACHE_WAYS;
+    ScmAtomicWord gen = Scm_AtomicLoad(&generic_generation);
+    int victim = -1;
+    for (int w=0; w<CALL_SITE_CACHE_WAYS; w++) {
+        call_site_entry *e = (call_site_entry*)Scm_AtomicLoad(&slots[w]);
+        if (e == NULL || e->generation != gen) {
+            if (victim < 0) victim = w;
+            continue;
+        }
+        if (e->site != off) {
+            /* Another site sharing the set.  We may take over its slot. */
+            if (victim < 0) victim = w;
+            continue;
+        }
+        if (e->gf != gf || e->argc != argc) continue;
+        int i = 0;
+        for (; i<nsel; i++) {
+            if (e->typev[i] != typev[i]) break;
+        }
+        if (i == nsel) return e->methods;
+    }
+
+    ScmObj mm = sorted_applicable_methods(gf, argv, argc);
+    /* If all the slots are taken by this site, it's megamorphic. */
+    if (SCM_PAIRP(mm) && victim >= 0) {
+        call_site_entry *e = SCM_NEW(call_site_entry);
+        e->site = off;
+        e->gf = gf;
+        e->generation = gen;
+        e->argc = argc;
+        for (int i=0; i<nsel; i++) e->typev[i] = typev[i];
+        e->methods = mm;
+        Scm_AtomicStoreFull(&slots[victim], SCM_WORD(e));
+    }
+    return mm;
+}
+
 
 /* Developer API.  Accessible from Scheme via generic-build-dispatcher!
    If axis is out of range, we do nothing and returns #f.
@@ -2450,7 +2649,9 @@ void Scm__GenericInvalidateDispatcher(ScmGeneric *gf)
 {
     (void)SCM_INTERNAL_MUTEX_LOCK(gf->lock);
     gf->dispatcher = NULL;
+    gf->common.dispatchCount = 0;
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    invalidate_call_site_cache();
 }
 
 /* Developer API */
@@ -2815,12 +3016,18 @@ ScmObj Scm_AddMethod(ScmGeneric *gf, ScmMethod *method)
         gf->common.typeHint = SCM_FALSE;
 #endif /*GAUCHE_API_VERSION >= 98*/
     }
-    if (gf->dispatcher && (method_locked == NULL)) {
+    if (method_locked == NULL) {
         ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
-        if (replaced) Scm__MethodDispatcherDelete(dis, replaced);
-        Scm__MethodDispatcherAdd(dis, method);
+        if (dis == NULL || Scm__MethodDispatcherAutomaticP(dis)) {
+            gf->dispatcher = NULL;
+            gf->common.dispatchCount = 0;
+        } else {
+            if (replaced) Scm__MethodDispatcherDelete(dis, replaced);
+            Scm__MethodDispatcherAdd(dis, method);
+        }
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    invalidate_call_site_cache();
 
     if (method_locked != NULL) {
         Scm_Error("Attempt to replace a locked method %S",
@@ -2870,9 +3077,12 @@ ScmObj Scm_DeleteMethod(ScmGeneric *gf, ScmMethod *method)
             }
         }
     }
-    if (gf->dispatcher) {
-        Scm__MethodDispatcherDelete((ScmMethodDispatcher*)gf->dispatcher,
-                                    method);
+    ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
+    if (dis == NULL || Scm__MethodDispatcherAutomaticP(dis)) {
+        gf->dispatcher = NULL;
+        gf->common.dispatchCount = 0;
+    } else {
+        Scm__MethodDispatcherDelete(dis, method);
     }
     SCM_FOR_EACH(mp, gf->methods) {
         /* sync # of required selector */
@@ -2881,6 +3091,7 @@ ScmObj Scm_DeleteMethod(ScmGeneric *gf, ScmMethod *method)
         }
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    invalidate_call_site_cache();
     return SCM_UNDEFINED;
 }
 
@@ -3787,6 +3998,7 @@ void Scm__InitClass(void)
     /* regexp.c */
     CINIT(SCM_CLASS_REGEXP,           "<regexp>");
     CINIT(SCM_CLASS_REGMATCH,         "<regmatch>");
+    CINIT(SCM_CLASS_REGEXP_SET,       "<regexp-set>");
 
     /* string.c */
     CINIT(SCM_CLASS_STRING,           "<string>");
@@ -80,6 +80,9 @@ static ScmCompiledCode *make_compiled_code(void)
     cc->name = SCM_FALSE;
     cc->parent = SCM_FALSE;
     cc->builder = NULL;
+    cc->callCount = 0;
+    cc->flags = 0;
+    cc->callSiteCache = NULL;
     return cc;
 }
 
@@ -94,6 +97,8 @@ void Scm_CompiledCodeCopyX(ScmCompiledCode *dest,
     SCM_ASSERT(src->builder == NULL);
 
     memcpy(dest, src, sizeof(ScmCompiledCode));
+    /* The cache is indexed by offsets in the old code vector. */
+    dest->callSiteCache = NULL;
 }
 
 /*----------------------------------------------------------------------
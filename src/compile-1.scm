@@ -517,6 +517,7 @@
 (define %make-id-transformer.          (global-id% '%make-id-transformer))
 (define %with-inline-transformer.      (global-id% '%with-inline-transformer))
 
+(define <assertion-violation>. (global-id '<assertion-violation>))
 (define =>.               (global-id '=>))
 (define apply.            (global-id 'apply))
 (define begin.            (global-id 'begin))
@@ -627,10 +628,30 @@
          (unless (vm-compiler-flag-is-set? SCM_COMPILE_LEGACY_DEFINE)
            (%insert-binding module (unwrap-syntax name)
                             (%uninitialized) '(fresh)))
-         ($define oform flags id
-                  (%wrap-as-named-expression oform (pass1 expr cenv) id))))]
+         (let* ([iform (pass1 expr cenv)]
+                [flags (if (pass1/auto-inlinable-lambda? iform flags)
+                         (begin (pass1/attach-closure-inliner! iform)
+                                '(auto-inlinable))
+                         flags)])
+           ($define oform flags id
+                    (%wrap-as-named-expression oform iform id)))))]
     [_ (error "syntax-error:" oform)]))
 
+;; When SCM_COMPILE_AUTO_INLINE is set (gosh -fauto-inline), a toplevel
+;; procedure defined by plain 'define' is a candidate of cross-module
+;; inlining if it is small.  We attach the packed IForm to the closure and
+;; mark the binding 'auto-inlinable'.  Unlike define-inline, the binding
+;; isn't inlined within the same module, and the mark is dropped once the
+;; binding is altered (see Scm_GlocMark).  Call sites already compiled
+;; keep the old body, hence it's opt-in.
+(define (pass1/auto-inlinable-lambda? iform flags)
+  (and (null? flags)
+       (vm-compiler-flag-is-set? SCM_COMPILE_AUTO_INLINE)
+       (has-tag? iform $LAMBDA)
+       (not (vm-compiler-flag-is-set? SCM_COMPILE_NOINLINE_GLOBALS))
+       (< (iform-count-size-upto ($lambda-body iform) SMALL_LAMBDA_SIZE)
+          SMALL_LAMBDA_SIZE)))
+
 (define (%rename-toplevel-identifier! identifier)
   (slot-set! identifier 'name (gensym #"~(identifier->symbol identifier)."))
   identifier)
@@ -70,7 +70,7 @@
         (if (and (label-dic-info label-dic)
                  (< count *max-pass3-repetition*))
           (loop iform. (+ count 1))
-          iform.)))))
+          (pass3/flonum-loop-vars iform.))))))
 
 (define (pass3-dump iform count)
   (format #t "~78,,,'=a\n" #"pass3 #~count ")
@@ -500,3 +500,164 @@
 
 ;; Dispatch table.
 (define *pass3-dispatch-table* (generate-dispatch-table pass3))
+
+;;
+;; Flonum loop variables
+;;
+
+;; An embedded local procedure (typically a named let loop) is entered
+;; by its 'embed' call, and reentered by 'jump' calls.  If we can prove
+;; that a variable of such procedure is always bound to a flonum, the VM
+;; can keep it in a flonum register across iterations, instead of letting
+;; it be boxed eventually (see PACK-FLONUM-ARGS insn).  This pass finds
+;; such variables and records them in $lambda-flonum-lvars of the embedded
+;; $lambda node, which will be used in pass5.
+;;
+;; The type of an expression is one of the followings:
+;;   flonum - the value is always a flonum.
+;;   real   - the value is always a real number.
+;;   #f     - we don't know.
+;; Loop variables start from 'flonum, and are weakened until all the
+;; argument expressions of the embed and jump calls agree, so a variable
+;; that is just carried over by the loop stays 'flonum.
+
+;; We don't deal with procedures that take more arguments than this.
+;; Must match PACK_FLONUM_ARGS_MAX in vm.c.
+(define-constant *pass3-flonum-args-max* 28)
+
+;; Limits the depth of type inference through let-bound variables.
+(define-constant *pass3-flonum-infer-depth* 8)
+
+(define (pass3/flonum-loop-vars iform)
+  (let ([embeds (make-hash-table 'eq?)] ; embed $call -> list of jump $calls
+        [inits  (make-hash-table 'eq?)] ; let-bound lvar -> init iform
+        [types  (make-hash-table 'eq?)] ; loop lvar -> type
+        [sites  '()])                   ; ((loop lvar arg-iform ...) ...)
+    (pass3/scan-loops iform embeds inits (make-label-dic #f))
+    (hash-table-for-each
+     embeds
+     (^[ecall jcalls]
+       (let* ([lm ($call-proc ecall)]
+              [lvars ($lambda-lvars lm)]
+              [argss (map $call-args (cons ecall jcalls))])
+         (when (and (zero? ($lambda-optarg lm))
+                    (every (^[args] (= (length args) (length lvars))) argss))
+           (let loop ([lvs lvars] [argss argss] [i 0])
+             (when (and (pair? lvs) (< i *pass3-flonum-args-max*))
+               (when (lvar-immutable? (car lvs))
+                 (hash-table-put! types (car lvs) 'flonum)
+                 (push! sites (cons (car lvs) (map car argss))))
+               (loop (cdr lvs) (map cdr argss) (+ i 1))))))))
+    ;; Find the greatest fixpoint.
+    (let loop ()
+      (let1 changed #f
+        (dolist [site sites]
+          (let* ([lvar (car site)]
+                 [type (hash-table-get types lvar)]
+                 [type. (fold (^[arg t]
+                                (pass3/type-meet
+                                 t (pass3/numeric-type arg types inits 0)))
+                              type (cdr site))])
+            (unless (eq? type type.)
+              (hash-table-put! types lvar type.)
+              (set! changed #t))))
+        (when changed (loop))))
+    (hash-table-for-each
+     embeds
+     (^[ecall _]
+       (let1 lm ($call-proc ecall)
+         ($lambda-flonum-lvars-set! lm
+                                    (filter (^[lv] (eq? (hash-table-get types lv #f)
+                                                        'flonum))
+                                            ($lambda-lvars lm))))))
+    iform))
+
+(define (pass3/type-meet a b)
+  (cond [(eq? a b) a]
+        [(and a b) 'real]
+        [else #f]))
+
+(define (pass3/numeric-type iform types inits depth)
+  (define (rec x) (pass3/numeric-type x types inits (+ depth 1)))
+  (and (< depth *pass3-flonum-infer-depth*)
+       (case/unquote
+        (iform-tag iform)
+        [($CONST) (let1 v ($const-value iform)
+                    (cond [(flonum? v) 'flonum]
+                          [(real? v) 'real]
+                          [else #f]))]
+        [($LREF) (let1 lvar ($lref-lvar iform)
+                   (and (lvar-immutable? lvar)
+                        (let1 t (hash-table-get types lvar 'none)
+                          (if (eq? t 'none)
+                            (and-let1 init (hash-table-get inits lvar #f)
+                              (rec init))
+                            t))))]
+        [($IF) (pass3/type-meet (rec ($if-then iform)) (rec ($if-else iform)))]
+        [($SEQ) (let1 body ($seq-body iform)
+                  (and (pair? body) (rec (last body))))]
+        [($LET) (rec ($let-body iform))]
+        [($RECEIVE) (rec ($receive-body iform))]
+        [($LABEL) (rec ($label-body iform))]
+        [($ASM) (pass3/asm-numeric-type iform (map rec ($asm-args iform)))]
+        [else #f])))
+
+;; TYPES are the types of the arguments.
+(define (pass3/asm-numeric-type iform types)
+  (define (all-real?) (not (memq #f types)))
+  (define (all-flonum?) (every (cut eq? <> 'flonum) types))
+  (case/unquote
+   (car ($asm-insn iform))
+   ;; (+ x 1.0) is a flonum, but (* 0 1.0) can be an exact zero.
+   [(NUMADD2 NUMSUB2) (and (all-real?) (if (memq 'flonum types) 'flonum 'real))]
+   [(NUMMUL2 NUMDIV2) (and (all-real?) (if (all-flonum?) 'flonum 'real))]
+   [(NEGATE) (and (pair? types) (car types))]
+   [(NUMIADD2 NUMISUB2 NUMIMUL2 NUMIDIV2) (and (all-real?) 'flonum)]
+   [else #f]))
+
+;; Collects embed/jump calls and let-bound initializers.
+(define-macro (pass3/scan-loops* iforms embeds inits labels)
+  `(ifor-each (^[x] (pass3/scan-loops x ,embeds ,inits ,labels)) ,iforms))
+
+(define/case (pass3/scan-loops iform embeds inits labels)
+  (iform-tag iform)
+  [($DEFINE) (pass3/scan-loops ($define-expr iform) embeds inits labels)]
+  [($LSET)   (pass3/scan-loops ($lset-expr iform) embeds inits labels)]
+  [($GSET)   (pass3/scan-loops ($gset-expr iform) embeds inits labels)]
+  [($IF)     (pass3/scan-loops ($if-test iform) embeds inits labels)
+             (pass3/scan-loops ($if-then iform) embeds inits labels)
+             (pass3/scan-loops ($if-else iform) embeds inits labels)]
+  [($LET)    (for-each (^[lv init] (hash-table-put! inits lv init))
+                       ($let-lvars iform) ($let-inits iform))
+             (pass3/scan-loops* ($let-inits iform) embeds inits labels)
+             (pass3/scan-loops ($let-body iform) embeds inits labels)]
+  [($RECEIVE)(pass3/scan-loops ($receive-expr iform) embeds inits labels)
+             (pass3/scan-loops ($receive-body iform) embeds inits labels)]
+  [($LAMBDA) (pass3/scan-loops ($lambda-body iform) embeds inits labels)]
+  [($CLAMBDA) (pass3/scan-loops* ($clambda-closures iform) embeds inits labels)]
+  [($LABEL)  (unless (label-seen? labels iform)
+               (label-push! labels iform)
+               (pass3/scan-loops ($label-body iform) embeds inits labels))]
+  [($SEQ)    (pass3/scan-loops* ($seq-body iform) embeds inits labels)]
+  [($CALL)   (case ($call-flag iform)
+               [(embed)
+                (unless (hash-table-exists? embeds iform)
+                  (hash-table-put! embeds iform '()))
+                (pass3/scan-loops ($call-proc iform) embeds inits labels)]
+               [(jump)
+                (let1 ecall ($call-proc iform)
+                  (hash-table-put! embeds ecall
+                                   (cons iform (hash-table-get embeds ecall '()))))]
+               [else
+                (pass3/scan-loops ($call-proc iform) embeds inits labels)])
+             (pass3/scan-loops* ($call-args iform) embeds inits labels)]
+  [($ASM)    (pass3/scan-loops* ($asm-args iform) embeds inits labels)]
+  [($CONS $APPEND $MEMV $EQ? $EQV?)
+             (pass3/scan-loops ($*-arg0 iform) embeds inits labels)
+             (pass3/scan-loops ($*-arg1 iform) embeds inits labels)]
+  [($VECTOR $LIST $LIST*) (pass3/scan-loops* ($*-args iform) embeds inits labels)]
+  [($LIST->VECTOR) (pass3/scan-loops ($*-arg0 iform) embeds inits labels)]
+  [($DYNENV) (pass3/scan-loops ($dynenv-key iform) embeds inits labels)
+             (pass3/scan-loops ($dynenv-value iform) embeds inits labels)
+             (pass3/scan-loops ($dynenv-body iform) embeds inits labels)]
+  [else #f])
@@ -48,13 +48,15 @@
 ;;
 ;; Note for the reader of this code: The term "lambda lifting" usually
 ;; includes a transformation that substitutes closed variables for
-;; arguments.  We don't do such transformation so far.  It trades the
-;; cost of closure allocation for pushing extra arguments.  It may be
-;; a win if the closure is allocated lots of times.  OTOH, if the closure
-;; is created only a few times, but called lots of times, the overhead of
-;; extra arguments may exceed the gain by not allocating the closure.
+;; arguments.  It trades the cost of closure allocation for pushing extra
+;; arguments.  It may be a win if the closure is allocated lots of times.
+;; OTOH, if the closure is created only a few times, but called lots of
+;; times, the overhead of extra arguments may exceed the gain by not
+;; allocating the closure.  So we only do so for a closure that is
+;; created within a loop and called only in the same iteration, and
+;; that has a few free variables.  See pass4/convert-closures.
 ;;
-;; Pass4 is done in three steps.
+;; Pass4 is done in four steps.
 ;;
 ;; - The first step, pass4/scan, recursively descends the IForm and determine
 ;;   a set of free variables for each $LAMBDA nodes.  It also collects lambda
@@ -62,11 +64,15 @@
 ;;   In this pass, we mark the toplevel lambda node by setting
 ;;   $lambda-lifted-var to #t.  All other lambda nodes have #f at this moment.
 ;;
-;; - The second step, pass4/lift, takes a set of $LAMBDA nodes in the IForm
+;; - The second step, pass4/convert-closures, turns the free variables
+;;   of the closures that meet the criteria into extra arguments, so
+;;   that they no longer have free variables.
+;;
+;; - The third step, pass4/lift, takes a set of $LAMBDA nodes in the IForm
 ;;   and finds which $LAMBDA nodes can be lifted.  When lifted, we set
 ;;   its $lambda-lifted-var with the variable that bound to the lifted lambda.
 ;;
-;; - The third step, pass4/subst, walks the IForm again, and replaces the
+;; - The fourth step, pass4/subst, walks the IForm again, and replaces the
 ;;   occurence of $LAMBDA nodes to be lifted for $LREFs.  Then wraps the
 ;;   entire iform with $LET to save the lifted lambdas.
 ;;
@@ -117,14 +123,16 @@
                 (and (null? (cdr lambda-nodes)) ; iform has only a toplevel lambda
                      ($lambda-lifted-var (car lambda-nodes))))
           iform                           ;shortcut
-          (let1 lifted (pass4/lift lambda-nodes module)
-            (if (null? lifted)
-              iform                       ;shortcut
-              (let1 iform. (pass4/subst iform (make-label-dic '()))
-                ($let #f 'rec
-                      (imap (^[x] ($lambda-lifted-var x)) lifted)
-                      lifted
-                      iform.)))))))))
+          (begin
+            (pass4/convert-closures iform lambda-nodes)
+            (let1 lifted (pass4/lift lambda-nodes module)
+              (if (null? lifted)
+                iform                     ;shortcut
+                (let1 iform. (pass4/subst iform (make-label-dic '()))
+                  ($let #f 'rec
+                        (imap (^[x] ($lambda-lifted-var x)) lifted)
+                        lifted
+                        iform.))))))))))
 
 ;; Pass4 step1 - scan
 ;;   bs - List of lvars whose binding is introduced in the current scope.
@@ -210,6 +218,202 @@
   (let1 fs (pass4/scan ($*-arg0 iform) bs fs es labels)
     (pass4/scan ($*-arg1 iform) bs fs es labels)))
 
+;; Pass4 step2 - closure conversion
+;;   A closure that is created in a loop and called within the same
+;;   iteration is allocated as many times as it's called.  If it has
+;;   only a few free variables, we'd rather pass them as extra arguments,
+;;   so that it can be lifted by pass4/lift.  Specifically, we convert
+;;   a $LAMBDA node that satisfies all of the followings:
+;;
+;;   - It is bound to an immutable lvar by $LET, and all the references
+;;     to the lvar are 'local' calls.  So no closure leaks out.
+;;   - It doesn't have optional argument.
+;;   - It has 1 to *pass4-max-converted-free-lvars* free lvars, all of
+;;     which are immutable.  (A mutable one would need to be passed as a
+;;     box.)
+;;   - It doesn't contain another closure, whose free lvars would be
+;;     changed by conversion.
+;;   - It is created in a body of an embedded local procedure that loops,
+;;     and all the calls are in the same closure and in the same loop
+;;     nesting.
+;;
+;;   The free lvars are appended to the $lambda-lvars, and the call sites
+;;   pass the free lvars as additional arguments.
+
+(define-constant *pass4-max-converted-free-lvars* 3)
+
+(define (pass4/convert-closures iform lambda-nodes)
+  (define (candidate? lm)
+    (and (not ($lambda-lifted-var lm))   ; not toplevel
+         (zero? ($lambda-optarg lm))
+         (let1 fvs ($lambda-free-lvars lm)
+           (and (pair? fvs)
+                (<= (length fvs) *pass4-max-converted-free-lvars*)
+                (every lvar-immutable? fvs)))))
+  (let1 cands (filter candidate? lambda-nodes)
+    (unless (null? cands)
+      (let ([binds (make-hash-table 'eq?)] ; lvar -> (lambda home . embeds)
+            [refs  (make-hash-table 'eq?)] ; lvar -> ((call home . embeds) ...)
+            [loops (make-hash-table 'eq?)]) ; embed $call -> #t if it loops
+        (pass4/scan-closure-sites iform cands binds refs loops
+                                  #f '() (make-label-dic #f))
+        (hash-table-for-each
+         binds
+         (^[lvar bind]
+           (let ([lm (car bind)]
+                 [home (cadr bind)]
+                 [nloops (pass4/count-loops (cddr bind) loops)])
+             (when (and (> nloops 0)
+                        (lvar-immutable? lvar)
+                        (every (^[ref]
+                                 (and-let1 call (car ref)
+                                   (and (eq? ($call-flag call) 'local)
+                                        (eq? (cadr ref) home)
+                                        (= (pass4/count-loops (cddr ref) loops)
+                                           nloops))))
+                               (hash-table-get refs lvar '()))
+                        (not (pass4/has-closure? ($lambda-body lm)
+                                                 (make-label-dic #f))))
+               (pass4/convert-closure! lm
+                                       (map car (hash-table-get refs lvar '())))))))))))
+
+(define (pass4/count-loops embeds loops)
+  (count (cut hash-table-get loops <> #f) embeds))
+
+;; Collects the information pass4/convert-closures needs.
+;;   cands  - candidate $LAMBDA nodes.
+;;   binds  - records the lvar bound to each candidate.
+;;   refs   - records the references to those lvars.  The call is #f if
+;;            the reference isn't an operator of a $CALL node.
+;;   loops  - records the embedded calls that have jump calls.
+;;   home   - the innermost closure ($LAMBDA node), or #f at toplevel.
+;;   embeds - a list of embedded calls we're in, within the current home.
+(define (pass4/scan-closure-sites iform cands binds refs loops
+                                  home embeds labels)
+  (define (rec x) (pass4/scan-closure-sites x cands binds refs loops
+                                            home embeds labels))
+  (define (ref! lvar call)
+    (hash-table-push! refs lvar (list* call home embeds)))
+  (case/unquote
+   (iform-tag iform)
+   [($DEFINE) (rec ($define-expr iform))]
+   [($LREF)   (ref! ($lref-lvar iform) #f)]
+   [($LSET)   (rec ($lset-expr iform))]
+   [($GSET)   (rec ($gset-expr iform))]
+   [($IF)     (rec ($if-test iform)) (rec ($if-then iform)) (rec ($if-else iform))]
+   [($LET)    (for-each (^[lv init]
+                          (when (memq init cands)
+                            (hash-table-put! binds lv (list* init home embeds))))
+                        ($let-lvars iform) ($let-inits iform))
+              (for-each rec ($let-inits iform))
+              (rec ($let-body iform))]
+   [($RECEIVE)(rec ($receive-expr iform)) (rec ($receive-body iform))]
+   [($LAMBDA) (if ($lambda-dissolved? iform)
+                (rec ($lambda-body iform))
+                (pass4/scan-closure-sites ($lambda-body iform) cands binds refs
+                                          loops iform '() labels))]
+   [($CLAMBDA) (for-each rec ($clambda-closures iform))]
+   [($LABEL)  (unless (label-seen? labels iform)
+                (label-push! labels iform)
+                (rec ($label-body iform)))]
+   [($SEQ)    (for-each rec ($seq-body iform))]
+   [($CALL)   (let1 proc ($call-proc iform)
+                (case ($call-flag iform)
+                  [(jump) (hash-table-put! loops proc #t)]
+                  [(embed) (pass4/scan-closure-sites proc cands binds refs loops
+                                                     home (cons iform embeds)
+                                                     labels)]
+                  [else (if ($lref? proc)
+                          (ref! ($lref-lvar proc) iform)
+                          (rec proc))]))
+              (for-each rec ($call-args iform))]
+   [($ASM)    (for-each rec ($asm-args iform))]
+   [($CONS $APPEND $MEMV $EQ? $EQV?) (rec ($*-arg0 iform)) (rec ($*-arg1 iform))]
+   [($VECTOR $LIST $LIST*) (for-each rec ($*-args iform))]
+   [($LIST->VECTOR) (rec ($*-arg0 iform))]
+   [($DYNENV) (rec ($dynenv-key iform))
+              (rec ($dynenv-value iform))
+              (rec ($dynenv-body iform))]
+   [else #f]))
+
+;; Returns #t if IFORM contains a $LAMBDA node that creates a closure.
+(define (pass4/has-closure? iform labels)
+  (define (rec x) (pass4/has-closure? x labels))
+  (case/unquote
+   (iform-tag iform)
+   [($DEFINE) (rec ($define-expr iform))]
+   [($LSET)   (rec ($lset-expr iform))]
+   [($GSET)   (rec ($gset-expr iform))]
+   [($IF)     (or (rec ($if-test iform)) (rec ($if-then iform))
+                  (rec ($if-else iform)))]
+   [($LET)    (or (any rec ($let-inits iform)) (rec ($let-body iform)))]
+   [($RECEIVE)(or (rec ($receive-expr iform)) (rec ($receive-body iform)))]
+   [($LAMBDA) (or (not ($lambda-dissolved? iform)) (rec ($lambda-body iform)))]
+   [($CLAMBDA) #t]
+   [($LABEL)  (and (not (label-seen? labels iform))
+                   (begin (label-push! labels iform)
+                          (rec ($label-body iform))))]
+   [($SEQ)    (any rec ($seq-body iform))]
+   [($CALL)   (or (and (not (eq? ($call-flag iform) 'jump))
+                       (rec ($call-proc iform)))
+                  (any rec ($call-args iform)))]
+   [($ASM)    (any rec ($asm-args iform))]
+   [($CONS $APPEND $MEMV $EQ? $EQV?) (or (rec ($*-arg0 iform))
+                                         (rec ($*-arg1 iform)))]
+   [($VECTOR $LIST $LIST*) (any rec ($*-args iform))]
+   [($LIST->VECTOR) (rec ($*-arg0 iform))]
+   [($DYNENV) (or (rec ($dynenv-key iform))
+                  (rec ($dynenv-value iform))
+                  (rec ($dynenv-body iform)))]
+   [else #f]))
+
+;; Turns free lvars of LM into arguments.  CALLS are the $CALL nodes
+;; that call LM.
+(define (pass4/convert-closure! lm calls)
+  (let* ([fvs ($lambda-free-lvars lm)]
+         [new-lvs (imap (^v (make-lvar (lvar-name v))) fvs)])
+    (pass4/rename-lvars! ($lambda-body lm) (map cons fvs new-lvs)
+                         (make-label-dic #f))
+    ($lambda-lvars-set! lm (append ($lambda-lvars lm) new-lvs))
+    ($lambda-reqargs-set! lm (+ ($lambda-reqargs lm) (length new-lvs)))
+    ($lambda-free-lvars-set! lm '())
+    (dolist [call calls]
+      ($call-args-set! call (append ($call-args call) (imap $lref fvs))))))
+
+;; Destructively replaces the references of lvars according to ALIST.
+(define (pass4/rename-lvars! iform alist labels)
+  (define (rec x) (pass4/rename-lvars! x alist labels))
+  (case/unquote
+   (iform-tag iform)
+   [($DEFINE) (rec ($define-expr iform))]
+   [($LREF)   (and-let1 p (assq ($lref-lvar iform) alist)
+                (lvar-ref--! (car p))
+                (lvar-ref++! (cdr p))
+                ($lref-lvar-set! iform (cdr p)))]
+   [($LSET)   (rec ($lset-expr iform))]
+   [($GSET)   (rec ($gset-expr iform))]
+   [($IF)     (rec ($if-test iform)) (rec ($if-then iform)) (rec ($if-else iform))]
+   [($LET)    (for-each rec ($let-inits iform)) (rec ($let-body iform))]
+   [($RECEIVE)(rec ($receive-expr iform)) (rec ($receive-body iform))]
+   [($LAMBDA) (rec ($lambda-body iform))]
+   [($CLAMBDA) (for-each rec ($clambda-closures iform))]
+   [($LABEL)  (unless (label-seen? labels iform)
+                (label-push! labels iform)
+                (rec ($label-body iform)))]
+   [($SEQ)    (for-each rec ($seq-body iform))]
+   [($CALL)   (unless (eq? ($call-flag iform) 'jump)
+                (rec ($call-proc iform)))
+              (for-each rec ($call-args iform))]
+   [($ASM)    (for-each rec ($asm-args iform))]
+   [($CONS $APPEND $MEMV $EQ? $EQV?) (rec ($*-arg0 iform)) (rec ($*-arg1 iform))]
+   [($VECTOR $LIST $LIST*) (for-each rec ($*-args iform))]
+   [($LIST->VECTOR) (rec ($*-arg0 iform))]
+   [($DYNENV) (rec ($dynenv-key iform))
+              (rec ($dynenv-value iform))
+              (rec ($dynenv-body iform))]
+   [else #f]))
+
+;; Pass4 step3 - lift
 ;; Sort out the liftable lambda nodes.
 ;; Returns a list of lambda nodes, in each of which $lambda-lifted-var
 ;; contains an identifier.
@@ -275,6 +479,7 @@
                      (loop (cdr lms) #t remaining))
                    (loop (cdr lms) lifted? (cons lm remaining))))])))))
 
+;; Pass4 step4 - subst
 ;; Final touch of pass4 - replace lifted lambda nodes to the reference of
 ;; pre-bound lvars.
 ;; Returns (possibly modified) IForm.
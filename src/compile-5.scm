@@ -115,6 +115,8 @@
   (let ([d (pass5/rec ($define-expr iform) target renv 'normal/bottom)]
         [f (cond [(memq 'const ($define-flags iform)) SCM_BINDING_CONST]
                  [(memq 'inlinable ($define-flags iform)) SCM_BINDING_INLINABLE]
+                 [(memq 'auto-inlinable ($define-flags iform))
+                  SCM_BINDING_AUTO_INLINABLE]
                  [else 0])])
     (compiled-code-emit1oi! (ctarget-ccb target) DEFINE f
                             ($define-id iform) ($*-src iform))
@@ -622,6 +624,11 @@
         (unless (lvar-immutable? (car lvs))
           (compiled-code-emit1i! ccb BOX k (lvar-name (car lvs))))
         (loop (cdr lvs) (- k 1))))
+    ;; If the rest list never outlives the call, let the VM allocate
+    ;; it at once.
+    (when (and (> ($lambda-optarg iform) 0)
+               (not (pass5/rest-arg-escapes? iform)))
+      (slot-set! ccb 'flags SCM_COMPILED_CODE_REST_NOESCAPE))
     ;; Save list of unused arguments in the attributes of (car signature-info).
     (let1 uargs (filter-map (^[lv] (and (zero? (lvar-ref-count lv))
                                         (lvar-name lv)))
@@ -637,6 +644,117 @@
              (cons ($lambda-lvars iform) renv))
            'tail)))
 
+;; Escape analysis of the rest argument.
+;;   Returns #f if we can prove that neither the rest list of the lambda
+;;   node LM nor its tails outlive the call; that is, they are only taken
+;;   apart by car/cdr and friends, or passed to embedded local loops that
+;;   do the same.  It covers the typical expansion of let-optionals* and
+;;   let-keywords*.  Storing, returning, passing to other procedures or
+;;   capturing in a closure counts as escaping.
+;;   We run this after pass4, so the embedded calls and jumps are final.
+;;   The result only affects how the VM allocates the list (see
+;;   SCM_COMPILED_CODE_REST_NOESCAPE in code.h), not the semantics.
+(define (pass5/rest-arg-escapes? lm)
+  (define tracked (list (last ($lambda-lvars lm))))
+  (define grown #f)
+  (define labels '())
+  (define (tracked? lv) (memq lv tracked))
+  (define (track! lv)
+    (unless (tracked? lv) (push! tracked lv) (set! grown #t)))
+  (define (nil-const? iform)
+    (and ($const? iform) (null? ($const-value iform))))
+  ;; Returns #t if IFORM may yield a tracked list or its tail.
+  (define (list-valued? iform)
+    (case/unquote
+     (iform-tag iform)
+     [($LREF) (boolean (tracked? ($lref-lvar iform)))]
+     [($ASM)  (and (memv (car ($asm-insn iform)) `(,CDR ,CDDR))
+                   (list-valued? (car ($asm-args iform))))]
+     [($IF)   (let ([t ($if-then iform)] [e ($if-else iform)])
+                (and (or (list-valued? t) (nil-const? t))
+                     (or (list-valued? e) (nil-const? e))
+                     (or (list-valued? t) (list-valued? e))))]
+     [else #f]))
+  ;; Binding list-valued ARGS to immutable PARAMS doesn't escape; we just
+  ;; track the params as well.
+  (define (bind params args cap?)
+    (any (^[lv arg] (if (and (lvar-immutable? lv) (list-valued? arg))
+                      (begin (track! lv) (rec arg #f cap?))
+                      (rec arg #t cap?)))
+         params args))
+  ;; The error path may keep the list in a condition, but it's short-lived.
+  (define (error-call? iform)
+    (and-let* ([proc ($call-proc iform)]
+               [ (has-tag? proc $GREF) ]
+               [gloc (id->bound-gloc ($gref-id proc))])
+      (memq (gloc-ref gloc) (list error errorf))))
+  ;; ESC? - the value of IFORM may escape.
+  ;; CAP? - IFORM is in a closure, so any reference to tracked lvars escapes.
+  (define (rec iform esc? cap?)
+    (define (rec* iforms esc?) (any (cut rec <> esc? cap?) iforms))
+    (case/unquote
+     (iform-tag iform)
+     [($LREF)   (boolean (and (tracked? ($lref-lvar iform)) (or esc? cap?)))]
+     [($LSET)   (or (boolean (tracked? ($lset-lvar iform)))
+                    (rec ($lset-expr iform) #t cap?))]
+     [($GSET)   (rec ($gset-expr iform) #t cap?)]
+     [($DEFINE) (rec ($define-expr iform) #t cap?)]
+     [($CONST $GREF $IT) #f]
+     [($IF)     (or (rec ($if-test iform) #f cap?)
+                    (rec ($if-then iform) esc? cap?)
+                    (rec ($if-else iform) esc? cap?))]
+     [($LET)    (or (if (eq? ($let-type iform) 'let)
+                      (bind ($let-lvars iform) ($let-inits iform) cap?)
+                      (rec* ($let-inits iform) #t))
+                    (rec ($let-body iform) esc? cap?))]
+     [($RECEIVE) (or (rec ($receive-expr iform) #t cap?)
+                     (rec ($receive-body iform) esc? cap?))]
+     [($LAMBDA) (rec ($lambda-body iform) #t #t)]
+     [($CLAMBDA) (any (cut rec <> #t #t) ($clambda-closures iform))]
+     [($LABEL)  (and (not (memq iform labels))
+                     (begin (push! labels iform)
+                            (rec ($label-body iform) #t cap?)))]
+     [($SEQ)    (let loop ([xs ($seq-body iform)])
+                  (cond [(null? xs) #f]
+                        [(null? (cdr xs)) (rec (car xs) esc? cap?)]
+                        [else (or (rec (car xs) #f cap?) (loop (cdr xs)))]))]
+     [($CALL)   (case ($call-flag iform)
+                  [(embed)
+                   (let1 lm ($call-proc iform)
+                     (or (bind ($lambda-lvars lm) ($call-args iform) cap?)
+                         (rec ($lambda-body lm) esc? cap?)))]
+                  [(jump)
+                   (bind ($lambda-lvars ($call-proc ($call-proc iform)))
+                         ($call-args iform) cap?)]
+                  [else
+                   (or (rec ($call-proc iform) #t cap?)
+                       (rec* ($call-args iform) (not (error-call? iform))))])]
+     [($ASM)    (let1 insn (car ($asm-insn iform))
+                  (cond [(memv insn `(,CDR ,CDDR))
+                         (rec (car ($asm-args iform)) esc? cap?)]
+                        [(memv insn `(,CAR ,CADR ,CAAR ,CDAR ,NULLP ,PAIRP
+                                      ,LENGTH ,EQ ,EQV))
+                         (rec* ($asm-args iform) #f)]
+                        [else (rec* ($asm-args iform) #t)]))]
+     [($EQ? $EQV?) (or (rec ($*-arg0 iform) #f cap?)
+                       (rec ($*-arg1 iform) #f cap?))]
+     [($CONS $APPEND $MEMV) (or (rec ($*-arg0 iform) #t cap?)
+                                (rec ($*-arg1 iform) #t cap?))]
+     [($VECTOR $LIST $LIST*) (rec* ($*-args iform) #t)]
+     [($LIST->VECTOR) (rec ($*-arg0 iform) #t cap?)]
+     [($DYNENV) (or (rec ($dynenv-key iform) #t cap?)
+                    (rec ($dynenv-value iform) #t cap?)
+                    (rec ($dynenv-body iform) esc? cap?))]
+     [else #t]))
+  ;; Tracking a new lvar may reveal escapes in the part we've already
+  ;; scanned, so we repeat until the set of tracked lvars settles.
+  (let loop ()
+    (set! grown #f)
+    (set! labels '())
+    (cond [(rec ($lambda-body lm) #t #f) #t]
+          [grown (loop)]
+          [else #f])))
+
 (define (pass5/$CLAMBDA iform target renv ctx)
   (define (reqargs-min-max argcounts)
     (let loop ([counts argcounts] [mi #f] [mx 0])
@@ -800,6 +918,7 @@
       (compiled-code-emit1oi! ccb PRE-CALL nargs merge-label ($*-src iform)))
     (let1 dinit (if (> nargs 0)
                   (rlet1 d (pass5/prepare-args args target renv ctx)
+                    (pass5/emit-pack-flonum-args ccb proc 0)
                     (compiled-code-emit1i! ccb LOCAL-ENV nargs ($*-src iform))
                     (pass5/box-mutable-lvars lvars ccb))
                   0)
@@ -830,6 +949,8 @@
                 ($call-renv embed-node) renv))
       (if (tail-context? ctx)
         (let1 dinit (pass5/prepare-args args target renv ctx)
+          (pass5/emit-pack-flonum-args ccb ($call-proc embed-node)
+                                       (length renv-diff))
           (pass5/emit-local-env-jump ccb lvars (length renv-diff)
                                      (pass5/ensure-label ccb label)
                                      ($*-src iform))
@@ -837,6 +958,7 @@
         (let1 merge-label (compiled-code-new-label ccb)
           (compiled-code-emit1oi! ccb PRE-CALL nargs merge-label ($*-src iform))
           (let1 dinit (pass5/prepare-args args target renv ctx)
+            (pass5/emit-pack-flonum-args ccb ($call-proc embed-node) 0)
             (pass5/emit-local-env-jump ccb lvars (length renv-diff)
                                        (pass5/ensure-label ccb label)
                                        ($*-src iform))
@@ -846,6 +968,21 @@
               (imax dinit (+ nargs (env-header-size) (cont-frame-size))))))
         ))))
 
+;; If pass3 found flonum-only lvars of the embedded lambda LAMBDA-NODE,
+;; emit PACK-FLONUM-ARGS to keep them in flonum registers.  ENV-DEPTH is
+;; the number of env frames discarded by the following tail jump, or 0.
+;; The flonum arguments of a non-tail jump must not reuse the registers
+;; of the current iteration, for it will be resumed later.
+(define (pass5/emit-pack-flonum-args ccb lambda-node env-depth)
+  (let1 fls ($lambda-flonum-lvars lambda-node)
+    (unless (null? fls)
+      (let loop ([lvs ($lambda-lvars lambda-node)] [i 0] [mask 0])
+        (cond [(pair? lvs)
+               (loop (cdr lvs) (+ i 1)
+                     (if (memq (car lvs) fls) (logior mask (ash 1 i)) mask))]
+              [(> mask 0)
+               (compiled-code-emit1o! ccb PACK-FLONUM-ARGS env-depth mask)])))))
+
 (define (pass5/emit-local-env-jump ccb lvars env-depth label src)
   (let loop ([lvs lvars])
     (cond [(null? lvs)  ; no need of boxing.
@@ -333,3 +333,64 @@
                                          (list ($gref values.) ($lref r))))))
                     )))))]
       [_ (undefined)])))
+
+;;--------------------------------------------------------
+;; Inlining list iterators
+;;
+
+;; (for-each (lambda (x) ...) lis) and (map (lambda (x) ...) lis) are
+;; expanded into a local loop, so that the closure is never created
+;; and its body can be optimized in the context of the caller.  We only
+;; handle the common single-list case with a literal lambda; others are
+;; left to the procedure.  The expansion must behave exactly like the
+;; definitions in liblist.scm, including the error on improper lists.
+(define (gen-list-iteration-inliner name collect?)
+  (define (unary-lambda? iform)
+    (and (has-tag? iform $LAMBDA)
+         (= ($lambda-reqargs iform) 1)
+         (= ($lambda-optarg iform) 0)))
+  (^[src args]
+    (match args
+      [((? unary-lambda? proc) lis)
+       (let* ([l    (make-lvar 'lis)]
+              [loop (make-lvar 'loop)]
+              [xs   (make-lvar 'xs)]
+              [r    (make-lvar 'r)]
+              [elt  ($call #f proc (list ($asm #f `(,CAR) (list ($lref xs)))))]
+              [next ($asm #f `(,CDR) (list ($lref xs)))]
+              [err  ($call #f ($gref error.)
+                           `(,@(if collect? `(,($gref <assertion-violation>.)) '())
+                             ,($const "improper list not allowed:")
+                             ,($lref l)))]
+              [lmda (if collect?
+                      ($lambda src name 2 0 (list xs r)
+                               ($if #f ($asm #f `(,PAIRP) (list ($lref xs)))
+                                    ($call #f ($lref loop)
+                                           (list next
+                                                 ($asm #f `(,CONS)
+                                                       (list elt ($lref r)))))
+                                    ($if #f ($asm #f `(,NULLP) (list ($lref xs)))
+                                         ($asm #f `(,REVERSE) (list ($lref r)))
+                                         err))
+                               '())
+                      ($lambda src name 1 0 (list xs)
+                               ($if #f ($asm #f `(,PAIRP) (list ($lref xs)))
+                                    ($seq (list elt
+                                                ($call #f ($lref loop)
+                                                       (list next))))
+                                    ($if #f ($asm #f `(,NULLP) (list ($lref xs)))
+                                         ($const-undef)
+                                         err))
+                               '()))])
+         (lvar-initval-set! l lis)
+         (lvar-initval-set! loop lmda)
+         ($let src 'let (list l) (list lis)
+               ($let src 'rec (list loop) (list lmda)
+                     ($call #f ($lref loop)
+                            (if collect?
+                              (list ($lref l) ($const '()))
+                              (list ($lref l)))))))]
+      [_ (undefined)])))
+
+(define-builtin-inliner for-each (gen-list-iteration-inliner 'for-each #f))
+(define-builtin-inliner map (gen-list-iteration-inliner 'map #t))
@@ -139,6 +139,10 @@
 ;; the old value.)
 (define-constant SCM_BINDING_CONST 2)
 (define-constant SCM_BINDING_INLINABLE 4)
+(define-constant SCM_BINDING_AUTO_INLINABLE 64)
+
+;; used by pass5/lambda.  This should match the value in src/gauche/code.h.
+(define-constant SCM_COMPILED_CODE_REST_NOESCAPE 1)
 
 ;; IForm tags
 (define-enum .intermediate-tags.
@@ -570,6 +574,9 @@
    (lifted-var #f)  ; if this $LAMBDA is lifted to the toplevel, this slot
                     ; contains an lvar to which the toplevel closure
                     ; is to be bound.  See pass 4.
+   (flonum-lvars '()) ; if this $LAMBDA is embedded, a list of lvars
+                    ; that are proven to be bound only to flonums.
+                    ; See pass3/flonum-loop-vars.
    ))
 
 ;; (*1) Up to 0.9.14, this slot contains a symbol or a packed-iform, not a
@@ -2033,7 +2040,6 @@
    (let* ([mod::ScmModule* (-> (SCM_IDENTIFIER id) module)]
           [gloc::ScmGloc* (Scm_IdentifierGlobalBinding (SCM_IDENTIFIER id))])
      (set! SCM_RESULT0 '#f SCM_RESULT1 '#f)
-     (cast void cenv) ; suppress unused var warning
      (cast void mod)  ; suppress unused var warning
      (when gloc
        (let* ([gval (SCM_GLOC_GET gloc)])
@@ -2045,7 +2051,16 @@
                 (let* ([inl (SCM_PROCEDURE_INLINER gval)])
                   (if (and inl          ; inliner may be NULL
                            (not (SCM_FALSEP inl))
-                           (Scm_GlocInlinableP gloc)
+                           (or (Scm_GlocInlinableP gloc)
+                               ;; Small procedures defined by plain 'define'
+                               ;; are only inlined into other modules.
+                               ;; Within the defining module, the binding
+                               ;; is likely to be redefined during
+                               ;; development, so we keep calling it.
+                               (and (Scm_GlocAutoInlinableP gloc)
+                                    (SCM_VECTORP cenv)
+                                    (not (SCM_EQ (SCM_OBJ (-> gloc module))
+                                                 (SCM_VECTOR_ELEMENT cenv 0)))))
                            (not (SCM_VM_COMPILER_FLAG_IS_SET
                                  (Scm_VM) SCM_COMPILE_NOINLINE_GLOBALS))
                            ;; When SCM_COMPILE_NOINLINE_INLINER is set, we
@@ -2297,6 +2312,7 @@
  (define-enum SCM_COMPILE_LEGACY_DEFINE)
  (define-enum SCM_COMPILE_MUTABLE_LITERALS)
  (define-enum SCM_COMPILE_SRFI_FEATURE_ID)
+ (define-enum SCM_COMPILE_AUTO_INLINE)
 
  ;; Set/get VM's current module info. (temporary)
  (define-cproc vm-current-module () (return (SCM_OBJ (-> (Scm_VM) module))))
@@ -52,13 +52,11 @@
  *   - It is in performance critical path, and we can take advantage of
  *     domain knowledge to make it faster than generic implementation.
  *
- *  At this moment, the dispatch accelerator isn't built automatically.
- *  You need to call gauche.object#generic-build-dispatcher! explicitly
- *  on a generic function.  The effect varies depending on the methods
- *  the GF has, so we selectively turn on this feature for speed-sensitive
- *  GFs and see how it goes.  If it is proven to be effective enough,
- *  we might implement an automated mechanism when GF meets certain
- *  criteria.
+ *  The dispatch accelerator is built automatically once a GF is called
+ *  SCM_DISPATCHER_AUTO_CALLS times without it, if its methods meet
+ *  the criteria; see Scm__AutoBuildMethodDispatcher below.  You can also
+ *  call gauche.object#generic-build-dispatcher! explicitly on a generic
+ *  function to build it with a specific axis.
  *
  *  We take advantage of the following facts:
  *
@@ -118,6 +116,8 @@
 struct ScmMethodDispatcherRec {
     int axis;                    /* Which argument we look at?
                                     This is immutable. */
+    int automatic;               /* TRUE if built by
+                                    Scm__AutoBuildMethodDispatcher. */
     ScmAtomicVar methodHash;     /* mhash.  In case mhash is extended,
                                     we atomically swap reference. */
 };
@@ -271,7 +271,7 @@ static mhash *mhash_delete(mhash *h, ScmClass *k, int nargs, ScmMethod *m)
                 mn = Scm_Delete(SCM_OBJ(m), mn, SCM_CMP_EQ);
             }
 
-            if (SCM_NULLP(ml) && SCM_NULLP(ml)) {
+            if (SCM_NULLP(ml) && SCM_NULLP(mn)) {
                 h->num_entries--;
                 Scm_AtomicStore(&h->bins[j], 1); /* mark as deleted */
             } else {
@@ -312,10 +312,10 @@ static void mhash_print(mhash *h, ScmPort *out)
 static mhash *add_method_to_dispatcher(mhash *h, int axis, ScmMethod *m)
 {
     int req = SCM_PROCEDURE_REQUIRED(m);
-    if (req >= axis) {
+    if (req > axis) {
         ScmClass *klass = m->specializers[axis];
         if (SCM_PROCEDURE_OPTIONAL(m)) {
-            for (int k = req; k < SCM_DISPATCHER_MAX_NARGS; k++)
+            for (int k = req; k <= SCM_DISPATCHER_MAX_NARGS; k++)
                 h = mhash_insert(h, klass, k, m);
         } else {
             h = mhash_insert(h, klass, req, m);
@@ -327,10 +327,10 @@ static mhash *add_method_to_dispatcher(mhash *h, int axis, ScmMethod *m)
 static mhash *delete_method_from_dispatcher(mhash *h, int axis, ScmMethod *m)
 {
     int req = SCM_PROCEDURE_REQUIRED(m);
-    if (req >= axis) {
+    if (req > axis) {
         ScmClass *klass = m->specializers[axis];
         if (SCM_PROCEDURE_OPTIONAL(m)) {
-            for (int k = req; k < SCM_DISPATCHER_MAX_NARGS; k++)
+            for (int k = req; k <= SCM_DISPATCHER_MAX_NARGS; k++)
                 h = mhash_delete(h, klass, k, m);
         } else {
             h = mhash_delete(h, klass, req, m);
@@ -359,10 +359,64 @@ ScmMethodDispatcher *Scm__BuildMethodDispatcher(ScmObj methods, int axis)
     }
     ScmMethodDispatcher *dis = SCM_NEW(ScmMethodDispatcher);
     dis->axis = axis;
+    dis->automatic = FALSE;
     dis->methodHash = (ScmAtomicWord)mh;
     return dis;
 }
 
+/*
+    Automatic construction.  Called from class.c when a GF without
+    the accelerator has been called certain times.  Returns NULL if
+    the accelerator isn't likely to pay off.
+
+    The accelerator only returns the methods whose axis specializer
+    is exactly the class of the argument.  They are more specific than
+    any other applicable methods only if the methods aren't specialized
+    by the arguments before the axis, for the arguments are compared
+    from left to right.  So we only consider such axes, and choose the
+    one that most methods are specialized on.  We also require that
+    the GF has enough methods, that most of them are specialized on the
+    axis, and that most of them are leaf methods.
+ */
+ScmMethodDispatcher *Scm__AutoBuildMethodDispatcher(ScmObj methods)
+{
+    int nmethods = 0, nleaves = 0;
+    int specialized[SCM_DISPATCHER_MAX_NARGS];
+    int eligible = SCM_DISPATCHER_MAX_NARGS; /* axes < this are eligible */
+    ScmObj mm;
+
+    for (int i = 0; i < SCM_DISPATCHER_MAX_NARGS; i++) specialized[i] = 0;
+    SCM_FOR_EACH(mm, methods) {
+        ScmMethod *m = SCM_METHOD(SCM_CAR(mm));
+        int req = SCM_PROCEDURE_REQUIRED(m);
+        nmethods++;
+        if (SCM_METHOD_LEAF_P(m)) nleaves++;
+        for (int i = 0; i < req && i < SCM_DISPATCHER_MAX_NARGS; i++) {
+            if (m->specializers[i] != SCM_CLASS_TOP) {
+                specialized[i]++;
+                if (eligible > i+1) eligible = i+1;
+            }
+        }
+    }
+    if (nmethods < SCM_DISPATCHER_AUTO_METHODS) return NULL;
+    if (nleaves*2 < nmethods) return NULL;
+
+    int axis = 0;
+    for (int i = 1; i < eligible; i++) {
+        if (specialized[i] > specialized[axis]) axis = i;
+    }
+    if (specialized[axis]*4 < nmethods*3) return NULL;
+
+    ScmMethodDispatcher *dis = Scm__BuildMethodDispatcher(methods, axis);
+    dis->automatic = TRUE;
+    return dis;
+}
+
+int Scm__MethodDispatcherAutomaticP(const ScmMethodDispatcher *dis)
+{
+    return dis->automatic;
+}
+
 void Scm__MethodDispatcherAdd(ScmMethodDispatcher *dis, ScmMethod *m)
 {
     mhash *h = (mhash*)Scm_AtomicLoad(&dis->methodHash);
@@ -380,7 +434,7 @@ void Scm__MethodDispatcherDelete(ScmMethodDispatcher *dis, ScmMethod *m)
 ScmObj Scm__MethodDispatcherLookup(ScmMethodDispatcher *dis,
                                    ScmClass **typev, int argc)
 {
-    if (dis->axis <= argc) {
+    if (dis->axis < argc) {
         ScmClass *selector = typev[dis->axis];
         mhash *h = (mhash*)Scm_AtomicLoad(&dis->methodHash);
         return mhash_probe(h, selector, argc);
@@ -400,11 +454,14 @@ ScmObj Scm__MethodDispatcherInfo(const ScmMethodDispatcher *dis)
     SCM_APPEND1(h, t, SCM_MAKE_INT(dis->axis));
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("num-entries"));
     SCM_APPEND1(h, t, SCM_MAKE_INT(mh->num_entries));
+    SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("automatic"));
+    SCM_APPEND1(h, t, SCM_MAKE_BOOL(dis->automatic));
     return h;
 }
 
 void Scm__MethodDispatcherDump(ScmMethodDispatcher *dis, ScmPort *port)
 {
-    Scm_Printf(port, "MethodDispatcher axis=%d\n", dis->axis);
+    Scm_Printf(port, "MethodDispatcher axis=%d%s\n", dis->axis,
+               dis->automatic? " (automatic)" : "");
     mhash_print((mhash*)dis->methodHash, port);
 }
@@ -569,6 +569,7 @@ typedef struct ScmMemoryRegionRec   ScmMemoryRegion;   /* see mmapP.h */
 typedef struct ScmPromiseRec        ScmPromise;
 typedef struct ScmRegexpRec         ScmRegexp;
 typedef struct ScmRegMatchRec       ScmRegMatch;
+typedef struct ScmRegexpSetRec      ScmRegexpSet;
 typedef struct ScmWriteControlsRec  ScmWriteControls;  /* see writerP.h */
 typedef struct ScmWriteContextRec   ScmWriteContext;   /* see writerP.h */
 typedef struct ScmWriteStateRec     ScmWriteState;     /* see wrtierP.h */
@@ -1193,6 +1194,16 @@ SCM_EXTERN ScmObj Scm_RegMatchAfter(ScmRegMatch *rm, ScmObj obj);
 SCM_EXTERN ScmObj Scm_RegMatchBefore(ScmRegMatch *rm, ScmObj obj);
 SCM_EXTERN void Scm_RegMatchDump(ScmRegMatch *match);
 
+/* Regexp set - matches multiple regexps at once */
+SCM_CLASS_DECL(Scm_RegexpSetClass);
+#define SCM_CLASS_REGEXP_SET      (&Scm_RegexpSetClass)
+#define SCM_REGEXP_SET(obj)       ((ScmRegexpSet*)obj)
+#define SCM_REGEXP_SETP(obj)      SCM_XTYPEP(obj, SCM_CLASS_REGEXP_SET)
+
+SCM_EXTERN ScmObj Scm_MakeRegexpSet(ScmObj regexps);
+SCM_EXTERN ScmObj Scm_RegexpSetMatch(ScmRegexpSet *rs, ScmString *input,
+                                     ScmObj start, ScmObj end);
+
 /*-------------------------------------------------------
  * STUB MACROS
  */
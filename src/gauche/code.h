@@ -75,6 +75,19 @@ struct ScmCompiledCodeRec {
                                    #f otherwise. (*5) */
     void *builder;              /* An opaque data used during constructing
                                    the code vector.  Usually NULL. */
+    u_long callCount;           /* # of times this code is entered as a
+                                   closure body.  Only counted when JIT
+                                   is enabled.  (*6) */
+    u_long flags;               /* SCM_COMPILED_CODE_* flags below.  Set
+                                   by the compiler. (*7) */
+    void *callSiteCache;        /* Methods cached per generic call site.
+                                   Allocated on demand.  (*8) */
+};
+
+/* Bits of ScmCompiledCode.flags */
+enum {
+    SCM_COMPILED_CODE_REST_NOESCAPE = (1L<<0) /* The rest argument list never
+                                                 outlives the call.  */
 };
 
 /* Footnotes on ScmCompiledCodeRec
@@ -105,6 +118,18 @@ struct ScmCompiledCodeRec {
  *       '(<list> <integer> * -> *).  We may add more <key>s later.
  *   *5) This IForm is a direct result of Pass1, i.e. non-optimized form.
  *       Pass2 scans it when IForm is inlined into the caller site.
+ *   *6) When the count reaches the JIT threshold, the code is queued
+ *       for the JIT compiler (see Scm__VMSetJITCompiler in vm.c).
+ *       Once processed, the count is set beyond the threshold so that
+ *       it won't be queued again.
+ *   *7) SCM_COMPILED_CODE_REST_NOESCAPE is set when the compiler proves
+ *       that the rest list is only taken apart within the body and never
+ *       stored, returned or captured.  The VM then allocates the whole rest
+ *       list as a single block instead of one pair at a time; since nothing
+ *       keeps a tail of it after the call, the block doesn't retain extra
+ *       memory.  See pass5/rest-arg-escapes? in compile-5.scm.
+ *   *8) Opaque to anything but class.c; see "Call-site method cache"
+ *       there.  It is read and written atomically.
  */
 
 SCM_CLASS_DECL(Scm_CompiledCodeClass);
@@ -118,11 +143,21 @@ SCM_CLASS_DECL(Scm_CompiledCodeClass);
 #define SCM_COMPILED_CODE_OPTIONAL_ARGS(obj) \
     (SCM_COMPILED_CODE(obj)->optionalArgs)
 
+/* Static instances of ScmCompiledCode, such as the ones generated by
+   precomp, must be initialized with this macro.  Fields added to
+   ScmCompiledCode go to the end and are initialized to zero here,
+   leaving the macro's arguments unchanged; precomp sets them in the
+   initialization code if needed (see flags).  Adding a field still
+   changes the struct size, so it must go with a bump of
+   GAUCHE_ABI_VERSION in configure.ac.  callCount, flags and
+   callSiteCache were added in ABI 0.99; the VM reads flags on every
+   closure call, so extensions precompiled for 0.98 can't be loaded. */
 #define SCM_COMPILED_CODE_CONST_INITIALIZER(code, codesize, maxstack, reqargs, optargs, name, debuginfo, signatureinfo, parent, iform) \
     { { SCM_CLASS_STATIC_TAG(Scm_CompiledCodeClass) },   \
       (code), NULL, (codesize), 0, (maxstack),           \
       (reqargs), (optargs), (name), (debuginfo), (signatureinfo),   \
-      (parent), (iform), NULL /*builder*/ }
+      (parent), (iform), NULL /*builder*/, 0 /*callCount*/, 0 /*flags*/, \
+      NULL /*callSiteCache*/ }
 
 SCM_EXTERN void   Scm_CompiledCodeCopyX(ScmCompiledCode *dest,
                                         const ScmCompiledCode *src);
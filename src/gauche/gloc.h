@@ -97,6 +97,7 @@ SCM_EXTERN void   Scm_GlocSetValue(ScmGloc *g, ScmObj val);
 SCM_EXTERN int    Scm_GlocPhantomBindingP(ScmGloc *g);
 SCM_EXTERN int    Scm_GlocConstP(ScmGloc *g);
 SCM_EXTERN int    Scm_GlocInlinableP(ScmGloc *g);
+SCM_EXTERN int    Scm_GlocAutoInlinableP(ScmGloc *g);
 SCM_EXTERN int    Scm_GlocSyntaxP(ScmGloc *g);
 SCM_EXTERN int    Scm_GlocSupersedableP(ScmGloc *g, u_long flags, ScmObj val);
 
@@ -141,6 +141,8 @@ struct ScmHashTableRec {
     SCM_HEADER;
     ScmHashType type;
     ScmHashCore core;
+    void *concurrent;           /* actual type hidden.  non-NULL if the
+                                   table is safe for concurrent access. */
 };
 
 SCM_CLASS_DECL(Scm_HashTableClass);
@@ -149,6 +151,7 @@ SCM_CLASS_DECL(Scm_HashTableClass);
 #define SCM_HASH_TABLE_P(obj)  SCM_ISA(obj, SCM_CLASS_HASH_TABLE)
 
 #define SCM_HASH_TABLE_CORE(obj) (&SCM_HASH_TABLE(obj)->core)
+#define SCM_HASH_TABLE_CONCURRENT_P(obj) (SCM_HASH_TABLE(obj)->concurrent != NULL)
 
 SCM_EXTERN ScmObj Scm_MakeHashTableSimple(ScmHashType type,
                                           unsigned int initSize);
@@ -166,6 +169,18 @@ SCM_EXTERN ScmObj Scm_HashTableRef(ScmHashTable *ht,
 SCM_EXTERN ScmObj Scm_HashTableSet(ScmHashTable *ht,
                                    ScmObj key, ScmObj value, int flags);
 SCM_EXTERN ScmObj Scm_HashTableDelete(ScmHashTable *ht, ScmObj key);
+SCM_EXTERN void   Scm_HashTableClear(ScmHashTable *ht);
+
+/* Concurrent hash table.  See hash.c for the details. */
+SCM_EXTERN void   Scm_HashTableMakeConcurrent(ScmHashTable *ht);
+SCM_EXTERN ScmDictEntry *Scm_HashTableConcurrentEntry(ScmHashTable *ht,
+                                                      ScmObj key,
+                                                      ScmObj fallback,
+                                                      ScmObj *valp);
+SCM_EXTERN int    Scm_HashTableConcurrentSwap(ScmDictEntry *e,
+                                              ScmObj oldval,
+                                              ScmObj newval);
+SCM_EXTERN void   Scm_HashTableIterInit(ScmHashIter *iter, ScmHashTable *ht);
 
 
 SCM_EXTERN ScmObj Scm_HashTableKeys(ScmHashTable *table);
@@ -101,8 +101,14 @@ enum {
                                             the proper one when the compiled
                                             module is loaded, so we won't warn
                                             the overwriting. */
-    SCM_BINDING_SYNTAX = (1L<<5)          /*(F,M) indicates the identifier is
+    SCM_BINDING_SYNTAX = (1L<<5),         /*(F,M) indicates the identifier is
                                             bound to a syntax or a macro. */
+    SCM_BINDING_AUTO_INLINABLE = (1L<<6)  /*(M) a small procedure defined by
+                                            ordinary 'define'.  The compiler
+                                            may inline it into other modules
+                                            as long as the binding is never
+                                            altered; set! or redefinition
+                                            drops the mark. */
 };
 
 SCM_EXTERN ScmGloc *Scm_FindBinding(ScmModule *module, ScmSymbol *symbol,
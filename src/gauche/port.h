@@ -99,6 +99,12 @@ typedef struct ScmPortBufferRec {
     u_long flags;               /* reserved */
 } ScmPortBuffer;
 
+/* A piece of data for gather-write (Scm_Putzv). */
+typedef struct ScmIOVecRec {
+    const char *data;
+    ScmSize size;
+} ScmIOVec;
+
 /* The function table of procedural port. */
 typedef struct ScmPortVTableRec {
     int     (*Getb)(ScmPort *p);
@@ -380,6 +386,7 @@ SCM_EXTERN ScmObj Scm_PortSeek(ScmPort *port, ScmObj off, int whence);
 SCM_EXTERN ScmObj Scm_PortSeekUnsafe(ScmPort *port, ScmObj off, int whence);
 SCM_EXTERN int    Scm_PortFileNo(ScmPort *port);
 SCM_EXTERN void   Scm_PortFdDup(ScmPort *dst, ScmPort *src);
+SCM_EXTERN ScmSize Scm_PortCopyFd(ScmPort *src, ScmPort *dst, ScmSize limit);
 SCM_EXTERN int    Scm_FdReady(int fd, int dir);
 SCM_EXTERN int    Scm_ByteReady(ScmPort *port);
 SCM_EXTERN int    Scm_ByteReadyUnsafe(ScmPort *port);
@@ -412,12 +419,15 @@ SCM_EXTERN void   Scm_Putb(ScmByte b, ScmPort *port);
 SCM_EXTERN void   Scm_Putc(ScmChar c, ScmPort *port);
 SCM_EXTERN void   Scm_Puts(ScmString *s, ScmPort *port);
 SCM_EXTERN void   Scm_Putz(const char *s, ScmSize len, ScmPort *port);
+SCM_EXTERN void   Scm_Putzv(const ScmIOVec *iov, ScmSize count, ScmPort *port);
 SCM_EXTERN void   Scm_Flush(ScmPort *port);
 
 SCM_EXTERN void   Scm_PutbUnsafe(ScmByte b, ScmPort *port);
 SCM_EXTERN void   Scm_PutcUnsafe(ScmChar c, ScmPort *port);
 SCM_EXTERN void   Scm_PutsUnsafe(ScmString *s, ScmPort *port);
 SCM_EXTERN void   Scm_PutzUnsafe(const char *s, ScmSize len, ScmPort *port);
+SCM_EXTERN void   Scm_PutzvUnsafe(const ScmIOVec *iov, ScmSize count,
+                                  ScmPort *port);
 SCM_EXTERN void   Scm_FlushUnsafe(ScmPort *port);
 
 SCM_EXTERN void   Scm_Ungetc(ScmChar ch, ScmPort *port);
@@ -442,6 +452,12 @@ SCM_EXTERN ScmObj Scm_UngottenBytesUnsafe(ScmPort *port);
 
 SCM_EXTERN ScmObj Scm_ReadLine(ScmPort *port);
 SCM_EXTERN ScmObj Scm_ReadLineUnsafe(ScmPort *port);
+SCM_EXTERN ScmObj Scm_ReadSpan(ScmPort *port, ScmCharSet *cs, int until,
+                               ScmSize limit);
+
+SCM_EXTERN const char *Scm_PortBorrowBufferUnsafe(ScmPort *port,
+                                                  ScmSize *size, int fillp);
+SCM_EXTERN void   Scm_PortCommitBufferUnsafe(ScmPort *port, ScmSize n);
 
 /*================================================================
  * File ports
@@ -66,8 +66,12 @@
    argument register mismatch in the asm code in arith_x86_64.h.
    Ideally we should fix the macro caller to use variables with proper
    width of integer.  But for the time being, we use i386 asm code
-   on MinGW64/x86_64 for quick workaround. */
-#if defined(SCM_TARGET_I386) || (defined(SCM_TARGET_X86_64) && SIZEOF_LONG == 4)
+   on MinGW64/x86_64 for quick workaround.
+   Defining SCM_ARITH_PORTABLE forces the portable versions; test-mparith.c
+   uses it to test them on every platform. */
+#if defined(SCM_ARITH_PORTABLE)
+/* use the portable versions below */
+#elif defined(SCM_TARGET_I386) || (defined(SCM_TARGET_X86_64) && SIZEOF_LONG == 4)
 #include "arith_i386.h"
 #elif defined(SCM_TARGET_X86_64)
 #include "arith_x86_64.h"
@@ -83,6 +83,10 @@ SCM_EXTERN ScmObj Scm_BignumAsh(const ScmBignum *bx, int cnt);
 SCM_EXTERN ScmBignum *Scm_MakeBignumWithSize(int size, u_long init);
 SCM_EXTERN ScmBignum *Scm_BignumAccMultAddUI(ScmBignum *acc,
                                              u_long coef, u_long c);
+SCM_EXTERN ScmBignum *Scm_BignumAccMultAddChunks(ScmBignum *acc,
+                                                 u_long base,
+                                                 const u_long *chunks,
+                                                 int n);
 
 SCM_EXTERN void   Scm_BignumDump(const ScmBignum *b, ScmPort *out);
 
@@ -46,6 +46,12 @@ SCM_EXTERN void   Scm__GenericInvalidateDispatcher(ScmGeneric *gf);
 SCM_EXTERN ScmObj Scm__GenericDispatcherInfo(ScmGeneric *gf);
 SCM_EXTERN void   Scm__GenericDispatcherDump(ScmGeneric *gf, ScmPort *port);
 
+/* Called from VM; returns sorted applicable methods, cached per call site */
+SCM_EXTERN ScmObj Scm__GenericCallSiteMethods(ScmGeneric *gf,
+                                              ScmCompiledCode *cc,
+                                              const ScmWord *site,
+                                              ScmObj *argv, int argc);
+
 
 /* A proxy type is a class to hold a reference to another class.
    It is used to keep reference to a type in another compound type
@@ -41,15 +41,24 @@
    smaller than this */
 #define SCM_DISPATCHER_MAX_NARGS   4
 
+/* A GF without dispatcher tries to build one automatically after it is
+   called this many times.  See Scm__AutoBuildMethodDispatcher for the
+   criteria; the GF needs to have at least SCM_DISPATCHER_AUTO_METHODS
+   methods among others. */
+#define SCM_DISPATCHER_AUTO_CALLS   64
+#define SCM_DISPATCHER_AUTO_METHODS 4
+
 typedef struct ScmMethodDispatcherRec ScmMethodDispatcher;
 
 ScmMethodDispatcher *Scm__BuildMethodDispatcher(ScmObj methods, int axis);
+ScmMethodDispatcher *Scm__AutoBuildMethodDispatcher(ScmObj methods);
 
 void   Scm__MethodDispatcherAdd(ScmMethodDispatcher *dis, ScmMethod *m);
 void   Scm__MethodDispatcherDelete(ScmMethodDispatcher *dis, ScmMethod *m);
 ScmObj Scm__MethodDispatcherLookup(ScmMethodDispatcher *dis,
                                    ScmClass **typev, int argc);
 ScmObj Scm__MethodDispatcherInfo(const ScmMethodDispatcher *dis);
+int    Scm__MethodDispatcherAutomaticP(const ScmMethodDispatcher *dis);
 void   Scm__MethodDispatcherDump(ScmMethodDispatcher *dis, ScmPort *port);
 
 #endif  /*GAUCHE_PRIV_DISPATCHP_H*/
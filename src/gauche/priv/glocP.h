@@ -66,7 +66,8 @@ SCM_EXTERN ScmObj Scm_MakeGlocWithHooks(ScmSymbol *sym, ScmModule *module,
                                         ScmObj (*get)(ScmGloc*),
                                         ScmObj (*set)(ScmGloc*, ScmObj),
                                         void *data);
-/* flags may be 0, SCM_BINDING_CONST, or SCM_BINDING_INLINABLE. */
+/* flags may be 0, SCM_BINDING_CONST, SCM_BINDING_INLINABLE,
+   SCM_BINDING_SYNTAX or SCM_BINDING_AUTO_INLINABLE. */
 SCM_EXTERN void   Scm_GlocMark(ScmGloc *g, int flags);
 SCM_EXTERN ScmObj Scm_GlocConstSetter(ScmGloc *g, ScmObj val);
 SCM_EXTERN ScmObj Scm_GlocInlinableSetter(ScmGloc *g, ScmObj val);
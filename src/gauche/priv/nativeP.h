@@ -52,6 +52,8 @@ SCM_EXTERN ScmObj Scm__VMCallNative(ScmVM *vm,
                                     ScmSmallInt win_frame_size);
 
 SCM_EXTERN ScmObj Scm__AllocateCodePage(ScmU8Vector *code);
+SCM_EXTERN ScmObj Scm__JITCar(ScmObj obj);
+SCM_EXTERN ScmObj Scm__JITCdr(ScmObj obj);
 
 /*
  * FFI callback codepad
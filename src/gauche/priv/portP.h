@@ -223,6 +223,15 @@ enum {
  *  wait on it.  If we use CV, unlocking becomes two-step operation
  *  (set lockOwner to NULL, and call cond_signal), so it is no longer
  *  atomic.  We would need to get system-level lock in PORT_UNLOCK as well.
+ *
+ *  We don't bias the lock toward the thread that has been using the port
+ *  (skipping the system-level lock until another thread shows up).
+ *  Revoking the bias requires the owner thread to acknowledge it at a
+ *  safepoint, and the owner may be blocked in a system call indefinitely,
+ *  leaving the other thread waiting on a port nobody is using.  Disabling
+ *  the lock process-wide while there's only one VM doesn't work either,
+ *  for an embedding application can attach a new VM from a foreign thread
+ *  while the root VM is in the middle of PORT_LOCK.
  */
 
 /* Lock a port P.  Can perform recursive lock. */
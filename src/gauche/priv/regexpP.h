@@ -54,6 +54,9 @@ struct ScmRegexpRec {
                             match at the beginning of the regexp.  It can be
                             used to skip input start position when regexp
                             isn't BOL_ANCHORED. */
+    struct ScmRegexpDFARec *dfa; /* Lazy DFA, if the regexp can be matched
+                                    without backtracking.  NULL otherwise.
+                                    Opaque; see regexp.c. */
 };
 
 struct ScmRegMatchRec {
@@ -72,6 +75,15 @@ struct ScmRegMatchRec {
     } **matches;
 };
 
+struct ScmRegexpSetRec {
+    SCM_HEADER;
+    ScmObj regexps;             /* list of regexps */
+    int numRegexps;
+    ScmRegexp **rxs;            /* array of regexps */
+    struct ScmRegexpSetDFARec *dfa; /* Combined lazy DFA.  Opaque;
+                                       see regexp.c. */
+};
+
 #define SCM_REG_MATCH_SINGLE_BYTE_P(rm) \
     ((rm)->inputSize == (rm)->inputLen)
 
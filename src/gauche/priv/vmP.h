@@ -206,6 +206,9 @@ SCM_EXTERN int Scm_VMUndefinedBool(ScmVM*); /* in boolean.c */
 /* For machine-level introspection */
 SCM_EXTERN ScmObj Scm__VMInsnAddress(int, _Bool);
 
+/* JIT hook (only effective with GAUCHE_ENABLE_UNSAFE_JIT_API) */
+SCM_EXTERN void Scm__VMSetJITCompiler(ScmObj proc, u_long threshold);
+
 /*
  * Thread Locals
  *   We keep the definition private, so that we can extend it later.
@@ -93,7 +93,9 @@ struct ScmProcedureRec {
     unsigned int leaf     : 1;     /* leaf procedure/method */
     unsigned int placeholder : 1;  /* placeholder method. */
 #if GAUCHE_API_VERSION >= 98
-    unsigned int reserved32 : 32;  /* unused yet. */
+    unsigned int dispatchCount : 16; /* <generic> only.  # of calls without
+                                        dispatch accelerator.  See class.c */
+    unsigned int reserved16 : 16;  /* unused yet. */
 #endif /*GAUCHE_API_VERSION >= 98*/
     ScmObj info;                   /* source code info (see below) */
     ScmObj setter;                 /* setter, if exists. */
@@ -304,7 +306,7 @@ SCM_CLASS_DECL(Scm_ProcedureClass);
 /* This is internal - should never be used directly */
 #if GAUCHE_API_VERSION >= 98
 #define SCM__PROCEDURE_INITIALIZER(klass, req, opt, typ, cst, lef, inf, inl) \
-    { { klass, NULL }, (req), (opt), (typ), FALSE, FALSE, cst, lef, 0, 0,    \
+    { { klass, NULL }, (req), (opt), (typ), FALSE, FALSE, cst, lef, 0, 0, 0, \
       (inf), SCM_FALSE, (inl), SCM_FALSE, SCM_NIL }
 #else  /* GAUCHE_API_VERSION < 98 */
 #define SCM__PROCEDURE_INITIALIZER(klass, req, opt, typ, cst, lef, inf, inl) \
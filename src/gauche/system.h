@@ -280,6 +280,42 @@ typedef struct ScmHeaderRec ScmSysFdset;
 #define SCM_SYS_FDSET_P(obj)    (FALSE)
 #endif /*!HAVE_SELECT*/
 
+/* poller - readiness notification that scales with the number of
+   active descriptors.  Backed by epoll if available, poll otherwise.
+   The structure is opaque; see system.c. */
+#if defined(HAVE_SELECT) && (defined(HAVE_SYS_EPOLL_H) || defined(HAVE_POLL_H))
+#define SCM_HAVE_SYS_POLLER 1
+
+typedef struct ScmSysPollerRec ScmSysPoller;
+
+SCM_CLASS_DECL(Scm_SysPollerClass);
+#define SCM_CLASS_SYS_POLLER    (&Scm_SysPollerClass)
+#define SCM_SYS_POLLER(obj)     ((ScmSysPoller*)(obj))
+#define SCM_SYS_POLLER_P(obj)   (SCM_XTYPEP(obj, SCM_CLASS_SYS_POLLER))
+
+/* Backend kinds */
+enum {
+    SCM_SYS_POLLER_DEFAULT,     /* epoll if available, poll otherwise */
+    SCM_SYS_POLLER_EPOLL,
+    SCM_SYS_POLLER_POLL
+};
+
+/* Event mask bits */
+enum {
+    SCM_SYS_POLL_READ   = (1L<<0),
+    SCM_SYS_POLL_WRITE  = (1L<<1),
+    SCM_SYS_POLL_EXCEPT = (1L<<2),
+    SCM_SYS_POLL_EDGE   = (1L<<3)  /* edge-triggered; ignored by poll */
+};
+
+SCM_EXTERN ScmObj Scm_MakeSysPoller(int kind);
+SCM_EXTERN int    Scm_SysPollerKind(ScmSysPoller *p);
+SCM_EXTERN void   Scm_SysPollerAdd(ScmSysPoller *p, int fd, u_long events);
+SCM_EXTERN void   Scm_SysPollerDelete(ScmSysPoller *p, int fd);
+SCM_EXTERN ScmObj Scm_SysPollerWait(ScmSysPoller *p, ScmObj timeout);
+SCM_EXTERN void   Scm_SysPollerClose(ScmSysPoller *p);
+#endif /*SCM_HAVE_SYS_POLLER*/
+
 /*==============================================================
  * Miscellaneous
  */
@@ -474,7 +474,6 @@ struct ScmVMRec {
                                    Scm_ThreadTerminate in
                                    ext/threads/threads.c, and turned off by
                                    process_queued_requests() in vm.c */
-
     ScmVMThreadLocalTable *threadLocals; /* thread local table */
 
     /* Registers */
@@ -585,6 +584,12 @@ struct ScmVMRec {
                                    appears in 'reset' and the end marker of
                                    partial continuation is set. */
 
+    /* Fields added after ABI 0.98 */
+    ScmObj jitPending;          /* List of compiled code that has become
+                                   hot and waiting for JIT compilation.
+                                   Pushed by the closure call path, and
+                                   consumed by process_queued_requests()
+                                   in vm.c.  Only used when JIT is enabled. */
 };
 
 SCM_EXTERN ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name);
@@ -768,10 +773,13 @@ enum {
     SCM_COMPILE_MUTABLE_LITERALS = (1L<<12),/* Literal pairs are mutable */
     SCM_COMPILE_SRFI_FEATURE_ID = (1L<<13), /* Allow srfi-N feature id in
                                                cond-expand */
-    SCM_COMPILE_NOINLINE_INLINER = (1L<<14)/* (internal) Do not invoke custom
+    SCM_COMPILE_NOINLINE_INLINER = (1L<<14),/* (internal) Do not invoke custom
                                               inliner and ASM inliners.
                                               hybrid macro is still expanded.
                                               used for macroexpand-all */
+    SCM_COMPILE_AUTO_INLINE = (1L<<15)     /* Mark small toplevel procedures
+                                              defined by 'define' inlinable
+                                              into other modules */
 };
 
 #define SCM_VM_COMPILER_FLAG_IS_SET(vm, flag) ((vm)->compilerFlags & (flag))
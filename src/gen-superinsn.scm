@@ -0,0 +1,271 @@
+;;;
+;;;  Generate vminsn-super.scm from the instruction frequency profile
+;;;
+;;;  This script should be executed by BUILD_GOSH
+;;;
+;;;    gosh gen-superinsn.scm [--vminsn vminsn.scm] [--count N]
+;;;                           [-o vminsn-super.scm] profile ...
+;;;
+;;;  PROFILEs are the statistics dumped by gosh built with
+;;;  COUNT_INSN_FREQUENCY (see vmstat.c).  We sum them up, and pick
+;;;  the N most frequently executed sequences of adjacent instructions
+;;;  that geninsn knows how to fuse, then write define-insn forms for
+;;;  them.  The instruction combiner in code.c is generated from those
+;;;  definitions, so pass5 emits the new instructions without any change.
+;;;
+;;;  The profile should be taken with the empty vminsn-super.scm, for
+;;;  the counts of the instructions not defined in vminsn.scm itself
+;;;  are ignored.  'make insn-profile' and 'make generate-superinsns'
+;;;  in src/Makefile run the whole process.
+;;;
+
+(use gauche.parseopt)
+(use srfi.13)
+(use util.match)
+
+;; Max # of primitive instructions in one superinstruction.
+(define-constant *max-length* 4)
+
+;; LREF shortcuts; must match geninsn.
+(define-constant .lrefx.
+  '(LREF0 LREF1 LREF2 LREF3 LREF10 LREF11 LREF12 LREF20 LREF21 LREF30))
+
+;;=============================================================
+;; Instruction definitions
+;;
+
+(define-class <insn> ()
+  ((name        :init-keyword :name)
+   (num-params  :init-keyword :num-params)
+   (operand     :init-keyword :operand)
+   (combined    :init-keyword :combined)
+   (body        :init-keyword :body)
+   (flags       :init-keyword :flags)))
+
+(define *insns* (make-hash-table 'eq?))  ; name -> <insn>
+(define *cise-macros* (make-hash-table 'eq?)) ; name -> definition
+
+(define (insn-ref name) (hash-table-get *insns* name #f))
+(define (insn-flag? insn flag) (boolean (memq flag (~ insn'flags))))
+
+(define (add-insn! name nparams operand combined body flags)
+  (hash-table-put! *insns* name
+                   (make <insn> :name name
+                         :num-params (if (pair? nparams) (car nparams) nparams)
+                         :operand operand :combined combined
+                         :body body :flags flags)))
+
+;; Reads vminsn.scm, except the included files.  Handles the LREF
+;; shortcut expansion in the same way as geninsn.
+(define (read-vminsn file)
+  (define (lref-replace form lrefx)
+    (match form
+      [(syms ...) (map (cut lref-replace <> lrefx) syms)]
+      [symbol ($ string->symbol
+                 $ regexp-replace #/\bLREF\b/ (x->string symbol)
+                 $ x->string lrefx)]))
+  (define (add-lrefx! insn nparams operand comb)
+    (dolist [lrefx .lrefx.]
+      (add-insn! (lref-replace insn lrefx) nparams operand
+                 (lref-replace comb lrefx)
+                 #f (if (eq? (last comb) 'RET) '(:terminal) '()))))
+  (dolist [form (file->sexp-list file)]
+    (match form
+      [('define-insn name nparams operand . opts)
+       (let-optionals* opts ([combined #f] [body #f] . flags)
+         (add-insn! name nparams operand combined body flags))]
+      [('define-insn-lref* insn nparams operand comb)
+       (add-insn! insn 2 operand comb #f '())
+       (add-lrefx! insn 0 operand comb)]
+      [('define-insn-lref+ insn nparams operand comb)
+       (add-lrefx! insn nparams operand comb)]
+      [('define-cise-stmt name . defn)
+       (hash-table-put! *cise-macros* name defn)]
+      [_ #f])))
+
+;; Checks if FORM mentions any of the symbols or strings satisfying PRED,
+;; either directly or through cise macros.  $result and its variations
+;; are not expanded; see below.
+(define (mentions? pred form)
+  (define seen '())
+  (let loop ([form form])
+    (cond [(pair? form) (or (loop (car form)) (loop (cdr form)))]
+          [(string? form) (pred form)]
+          [(symbol? form)
+           (or (pred form)
+               (and-let* ([ (not (result-macro? form)) ]
+                          [ (not (memq form seen)) ]
+                          [defn (hash-table-get *cise-macros* form #f)])
+                 (push! seen form)
+                 (loop defn)))]
+          [else #f])))
+
+;; $result and its variations are interpreted by geninsn according to
+;; how the instruction is combined.  Other ways to leave the insn body
+;; can't be fused.
+(define (result-macro? x)
+  (and (symbol? x) (string-prefix? "$result" (symbol->string x))))
+
+(define (exit? x)
+  (if (string? x)
+    (boolean (string-scan x "goto "))
+    (memq x '(NEXT NEXT_PUSHCHECK RETURN-OP CHECK-INTR $goto-insn
+              $branch $branch* $retc $retc* $insn-body $arg-source
+              return))))
+
+;; A body that yields its result with $result, and otherwise falls
+;; through.
+(define (simple-body? insn)
+  (and-let* ([body (~ insn'body)])
+    (and (mentions? result-macro? body)
+         (not (mentions? exit? body)))))
+
+;; A body that takes its argument by $w/argr, so that it can take it
+;; from a local variable instead.
+(define (argr-body? insn)
+  (and-let* ([body (~ insn'body)])
+    (and (mentions? (cut eq? <> '$w/argr) body)
+         (not (mentions? (cut eq? <> '$w/argp) body)))))
+
+;;=============================================================
+;; Profile
+;;
+
+;; Returns a hashtable (insn-name ...) -> count.
+(define (read-profiles files)
+  (rlet1 tab (make-hash-table 'equal?)
+    (define (add! seq count)
+      (when (> count 0) (hash-table-update! tab seq (cut + <> count) 0)))
+    (dolist [file files]
+      (dolist [plist (file->sexp-list file)]
+        (let1 rows (get-keyword :instruction-frequencies plist '())
+          (dolist [row rows]
+            (for-each (^[next count] (add! (list (car row) (car next)) count))
+                      rows (cddr row))))
+        (dolist [triple (get-keyword :instruction-triples plist '())]
+          (match triple
+            [(a b c count) (add! (list a b c) count)]))))))
+
+;;=============================================================
+;; Selecting superinstructions
+;;
+
+(define (join-names names)
+  (string->symbol (string-join (map symbol->string names) "-")))
+
+;; Expands a sequence of executed insns to the primitive ones that the
+;; combiner sees.  Returns #f if we can't handle it.
+(define (flatten seq)
+  (let loop ([seq seq] [r '()])
+    (match seq
+      [() (reverse r)]
+      [(name . rest)
+       (and-let* ([insn (insn-ref name)]
+                  [ (not (insn-flag? insn :fold-lref)) ]
+                  [ (not (insn-flag? insn :obsoleted)) ])
+         (if-let1 comb (~ insn'combined)
+           (loop (append comb rest) r)
+           (loop rest (cons name r))))])))
+
+;; Can geninsn generate the body of the combined insn SEQ?  This must
+;; follow the order of the patterns in do-combined of geninsn.
+;; DEFINED? tells if the given name is a defined insn.
+(define (renderable? seq defined?)
+  (define (simple? name) (simple-body? (insn-ref name)))
+  (match seq
+    [() #f]
+    [(base 'PUSH) (simple? base)]
+    [(base 'RET) (simple? base)]
+    [(base (or 'CALL 'TAIL-CALL)) (simple? base)]
+    [('PUSH . next) (defined? (join-names next))]
+    [('LREF0 'PUSH . next) (defined? (join-names next))]
+    [((? (cut memq <> `(LREF ,@.lrefx.))) next)
+     (let1 insn (insn-ref next)
+       (and (argr-body? insn) (zero? (~ insn'num-params))))]
+    [((? (cut memq <> `(LREF ,@.lrefx.))) . _) #f]
+    [(base . next)
+     (and (simple? base)
+          (or (defined? (join-names next))
+              (renderable? next defined?)))]))
+
+;; Returns a define-insn form for SEQ, or #f if it can't be fused.
+(define (superinsn-form seq defined?)
+  (and-let* ([insns (map insn-ref seq)]
+             [ (every (^i (memq (~ i'operand) '(none obj))) insns) ]
+             [ (<= (count (^i (eq? (~ i'operand) 'obj)) insns) 1) ]
+             [ (<= (count (^i (> (~ i'num-params) 0)) insns) 1) ]
+             [ (not (any (^i (or (insn-flag? i :terminal)
+                                 (insn-flag? i :multi-value)))
+                         (drop-right insns 1))) ]
+             ;; The combiner needs every prefix as an insn.
+             [ (every (^k (defined? (join-names (take seq k))))
+                      (iota (- (length seq) 2) 2)) ]
+             [ (renderable? seq defined?) ])
+    (let ([lasti (last insns)]
+          [opi (find (^i (eq? (~ i'operand) 'obj)) insns)]
+          [pi (find (^i (> (~ i'num-params) 0)) insns)])
+      `(define-insn ,(join-names seq)
+         ,(if pi (~ pi'num-params) 0)
+         ,(if opi 'obj 'none)
+         ,seq #f
+         ,@(cond-list [(insn-flag? lasti :terminal) :terminal]
+                      [(insn-flag? lasti :multi-value) :multi-value])))))
+
+;; Returns a list of (form . saved-dispatches), at most COUNT.
+(define (select-superinsns profile count)
+  (define cands (make-hash-table 'equal?)) ; flattened seq -> saved
+  (define selected '())
+  (define (defined? name)
+    (or (boolean (insn-ref name))
+        (boolean (find (^s (eq? (cadar s) name)) selected))))
+  (hash-table-for-each
+   profile
+   (^[seq cnt]
+     (and-let* ([flat (flatten seq)]
+                [ (<= 2 (length flat) *max-length*) ]
+                [ (not (insn-ref (join-names flat))) ])
+       (hash-table-update! cands flat (cut + <> (* cnt (- (length seq) 1)))
+                           0))))
+  (let loop ([cs (sort (hash-table->alist cands) > cdr)])
+    (unless (or (null? cs) (>= (length selected) count))
+      (and-let* ([form (superinsn-form (caar cs) defined?)])
+        (push! selected (cons form (cdar cs))))
+      (loop (cdr cs))))
+  ;; Shorter ones first, for the combiner wants prefixes defined earlier.
+  (stable-sort (reverse selected) < (^s (length (list-ref (car s) 4)))))
+
+;;=============================================================
+;; Main
+;;
+
+(define (write-superinsns selected files)
+  (print ";; Generated by gen-superinsn.scm.  DO NOT EDIT.")
+  (print ";; Included from vminsn.scm.  To regenerate, see 'insn-profile'")
+  (print ";; in src/Makefile.")
+  (print ";;")
+  (print ";; Profiles: " (string-join (map sys-basename files) " "))
+  (dolist [s selected]
+    (print)
+    (format #t ";; ~a dispatches saved\n" (cdr s))
+    (write (car s))
+    (newline)))
+
+(define (main args)
+  (let-args (cdr args) ([vminsn "vminsn=s" "vminsn.scm"]
+                        [count  "count=i" 16]
+                        [output "o=s" "vminsn-super.scm"]
+                        . files)
+    (when (null? files)
+      (exit 1 "Usage: gosh gen-superinsn.scm [--vminsn vminsn.scm] \
+               [--count N] [-o output] profile ..."))
+    (read-vminsn vminsn)
+    (let1 selected (select-superinsns (read-profiles files) count)
+      (with-output-to-file output
+        (cut write-superinsns selected files))
+      (format #t "~a superinstructions written to ~a\n"
+              (length selected) output)))
+  0)
+
+;; Local variables:
+;; mode: scheme
+;; end:
@@ -50,11 +50,13 @@ static void gloc_print(ScmObj obj, ScmPort *port,
                 ? " const"
                 : (Scm_GlocInlinableP(g)
                    ? " inlinable"
-                   : (SCM_GLOC_PHANTOM_BINDING_P(g)
-                      ? " phantom"
-                      : (Scm_GlocSyntaxP(g)
-                         ? " syntax"
-                         : "")))));
+                   : (Scm_GlocAutoInlinableP(g)
+                      ? " auto-inlinable"
+                      : (SCM_GLOC_PHANTOM_BINDING_P(g)
+                         ? " phantom"
+                         : (Scm_GlocSyntaxP(g)
+                            ? " syntax"
+                            : ""))))));
 }
 
 SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_GlocClass, gloc_print);
@@ -166,6 +168,22 @@ static int gloc_dummy_inlinable_p(ScmGloc *gloc)
     return ((gloc)->setter == gloc_dummy_inlinable_setter);
 }
 
+/* Auto-inlinable binding is a weaker form of inlinable binding.  The
+   procedure is small enough that the compiler may inline it into other
+   modules, but the user never promised not to change it.  So instead of
+   warning, altering the binding just drops the mark; the code compiled
+   after that refers to the binding as usual. */
+static ScmObj gloc_auto_inlinable_setter(ScmGloc *gloc, ScmObj val)
+{
+    gloc->setter = NULL;
+    return val;
+}
+
+int Scm_GlocAutoInlinableP(ScmGloc *gloc)
+{
+    return ((gloc)->setter == gloc_auto_inlinable_setter);
+}
+
 int Scm_GlocSyntaxP(ScmGloc *gloc)
 {
     return ((gloc)->setter == Scm_GlocSyntaxSetter);
@@ -213,6 +231,8 @@ void Scm_GlocMark(ScmGloc *gloc, int flags)
         }
     } else if (flags & SCM_BINDING_SYNTAX) {
         gloc->setter = Scm_GlocSyntaxSetter;
+    } else if (flags & SCM_BINDING_AUTO_INLINABLE) {
+        gloc->setter = gloc_auto_inlinable_setter;
     } else {
         gloc->setter = NULL;
     }
@@ -929,6 +929,338 @@ ScmDictEntry *Scm_HashIterNext(ScmHashIter *iter)
     return (ScmDictEntry*)e;
 }
 
+/*============================================================
+ * Concurrent hash tables
+ *
+ *  A concurrent hash table can be shared among threads without an
+ *  external lock.  As with the method dispatcher (see dispatch.c),
+ *  readers never lock, and structural changes are serialized by a
+ *  per-table mutex.
+ *
+ *  - Lookup walks the chain without locking.  A new entry is fully
+ *    initialized before it is linked, and a deleted entry keeps its
+ *    next pointer, so a reader always sees a well-formed chain.
+ *  - Resizing relinks the entries into the new bucket array in place,
+ *    during which a reader may miss an entry.  The version counter
+ *    is odd while rehashing.  A reader that misses retries if the
+ *    version has changed since it started.  Since the bucket array
+ *    only grows, a reader loads numBuckets before buckets, and the
+ *    writer stores them in the opposite order, so the index never
+ *    goes out of range.
+ *  - Changing the value of an existing entry is done by CAS on the
+ *    value word, without locking.  A deleted entry gets 0 as its
+ *    value before being unlinked, so that an updater racing with
+ *    the deletion fails the CAS and retries.  Readers treat such an
+ *    entry as absent.
+ *  - Inserting, deleting, resizing and clearing take the mutex.
+ *    The comparison and hash functions may be Scheme procedures, which
+ *    may even access the same table, so we never call them with the
+ *    mutex held.  A writer looks up the key without locking first,
+ *    remembering the count of structural changes, then takes the mutex
+ *    and only proceeds if the count is unchanged; otherwise it retries.
+ *
+ *  The entries are still in ScmHashCore, but Scm_HashCore* and
+ *  Scm_HashIter* API don't know about the concurrency.  Use the
+ *  Scm_HashTable* API for concurrent tables.
+ */
+
+typedef struct ConcurrentRec {
+    ScmInternalMutex mutex;     /* serializes structural changes */
+    ScmAtomicVar version;       /* incremented before and after rehashing */
+    ScmAtomicVar mods;          /* incremented by each structural change */
+} Concurrent;
+
+#define CONCURRENT(ht)   ((Concurrent*)(ht)->concurrent)
+#define ENTRY_VALUE_LOC(e)  ((ScmAtomicVar*)&((Entry*)(e))->value)
+
+void Scm_HashTableMakeConcurrent(ScmHashTable *ht)
+{
+    if (ht->concurrent) return;
+    Concurrent *c = SCM_NEW(Concurrent);
+    SCM_INTERNAL_MUTEX_INIT(c->mutex);
+    Scm_AtomicStore(&c->version, 0);
+    Scm_AtomicStore(&c->mods, 0);
+    ht->concurrent = c;
+}
+
+/* The hash value must agree with what the accessor function computes,
+   so that the core stays valid for Scm_HashCore* API.  The accessor of
+   the string table also checks the key type; we do the same here. */
+static u_long concurrent_hash(ScmHashTable *ht, intptr_t key)
+{
+    ScmHashCore *core = SCM_HASH_TABLE_CORE(ht);
+    if (ht->type == SCM_HASH_STRING && !SCM_STRINGP(SCM_OBJ(key))) {
+        Scm_Error("Got non-string key %S to the string hashtable.",
+                  SCM_OBJ(key));
+    }
+    return core->hashfn(core, key);
+}
+
+/* Lock-free lookup.  May return an entry whose value is 0.
+   The count of structural changes before the lookup is set to *MODS;
+   if it's unchanged when the mutex is acquired, the result of the
+   lookup is still valid. */
+static Entry *concurrent_search(ScmHashTable *ht, intptr_t key,
+                                u_long hashval, ScmAtomicWord *mods)
+{
+    ScmHashCore *core = SCM_HASH_TABLE_CORE(ht);
+    Concurrent *c = CONCURRENT(ht);
+    for (;;) {
+        ScmAtomicWord ver = Scm_AtomicLoad(&c->version);
+        if (mods) *mods = Scm_AtomicLoad(&c->mods);
+        int size = core->numBuckets;
+        int bits = core->numBucketsLog2;
+        Scm_AtomicThreadFence();
+        Entry **buckets = BUCKETS(core);
+        for (Entry *e = buckets[HASH2INDEX(size, bits, hashval)];
+             e; e = e->next) {
+            if (e->hashval == hashval && core->cmpfn(core, key, e->key)) {
+                return e;
+            }
+        }
+        Scm_AtomicThreadFence();
+        if (!(ver & 1) && Scm_AtomicLoad(&c->version) == ver) return NULL;
+    }
+}
+
+/* The following routines must be called with the mutex held.  They
+   don't call the comparison or hash function, which may be a Scheme
+   procedure that touches the table itself; the caller finds the
+   position by concurrent_search beforehand, and checks the mods
+   counter after acquiring the mutex. */
+
+static int concurrent_unchanged(ScmHashTable *ht, ScmAtomicWord mods)
+{
+    return Scm_AtomicLoad(&CONCURRENT(ht)->mods) == mods;
+}
+
+static void concurrent_touch(ScmHashTable *ht)
+{
+    Concurrent *c = CONCURRENT(ht);
+    Scm_AtomicThreadFence();    /* the change must be visible first */
+    Scm_AtomicStore(&c->mods, Scm_AtomicLoad(&c->mods) + 1);
+}
+
+static void concurrent_extend(ScmHashTable *ht)
+{
+    ScmHashCore *core = SCM_HASH_TABLE_CORE(ht);
+    Concurrent *c = CONCURRENT(ht);
+    int newsize = (core->numBuckets << EXTEND_BITS);
+    int newbits = core->numBucketsLog2 + EXTEND_BITS;
+    Entry **newb = SCM_NEW_ARRAY(Entry*, newsize);
+    for (int i=0; i<newsize; i++) newb[i] = NULL;
+
+    Scm_AtomicStore(&c->version, Scm_AtomicLoad(&c->version) + 1);
+    for (int i=0; i<core->numBuckets; i++) {
+        Entry *e = BUCKETS(core)[i];
+        while (e) {
+            Entry *next = e->next;
+            int index = HASH2INDEX(newsize, newbits, e->hashval);
+            e->next = newb[index];
+            newb[index] = e;
+            e = next;
+        }
+    }
+    /* We don't clear the old buckets, for readers may be walking them. */
+    core->buckets = (void**)newb;
+    Scm_AtomicThreadFence();
+    core->numBucketsLog2 = newbits;
+    core->numBuckets = newsize;
+    Scm_AtomicStore(&c->version, Scm_AtomicLoad(&c->version) + 1);
+}
+
+/* Adds a new entry.  The caller has made sure KEY isn't in the table. */
+static Entry *concurrent_insert(ScmHashTable *ht, intptr_t key,
+                                u_long hashval, intptr_t value)
+{
+    ScmHashCore *core = SCM_HASH_TABLE_CORE(ht);
+    if (core->numEntries == INT_MAX) {
+        Scm_Error("Too many entries in a hashtable; can't insert any more entries.");
+    }
+
+    int index = HASH2INDEX(core->numBuckets, core->numBucketsLog2, hashval);
+    Entry *e = SCM_NEW(Entry);
+    e->key = key;
+    e->value = value;
+    e->hashval = hashval;
+    e->next = BUCKETS(core)[index];
+    Scm_AtomicThreadFence();    /* E must be complete before it's visible */
+    BUCKETS(core)[index] = e;
+    core->numEntries++;
+
+    if (core->numBuckets <= MAX_NUM_BUCKETS
+        && core->numEntries > core->numBuckets*MAX_AVG_CHAIN_LIMITS) {
+        concurrent_extend(ht);
+    }
+    concurrent_touch(ht);
+    return e;
+}
+
+/* Unlinks E, which the caller has found.  Returns its value. */
+static ScmAtomicWord concurrent_delete(ScmHashTable *ht, Entry *e)
+{
+    ScmHashCore *core = SCM_HASH_TABLE_CORE(ht);
+    ScmAtomicVar *loc = ENTRY_VALUE_LOC(e);
+    ScmAtomicWord oldval = Scm_AtomicLoad(loc);
+    while (!Scm_AtomicCompareExchange(loc, &oldval, 0))
+        ;
+    Entry **p = &BUCKETS(core)[HASH2INDEX(core->numBuckets,
+                                          core->numBucketsLog2,
+                                          e->hashval)];
+    while (*p != e) {
+        SCM_ASSERT(*p != NULL);
+        p = &(*p)->next;
+    }
+    *p = e->next;
+    core->numEntries--;
+    concurrent_touch(ht);
+    return oldval;
+}
+
+static void concurrent_clear(ScmHashTable *ht)
+{
+    ScmHashCore *core = SCM_HASH_TABLE_CORE(ht);
+    for (int i=0; i<core->numBuckets; i++) {
+        for (Entry *e = BUCKETS(core)[i]; e; e = e->next) {
+            Scm_AtomicStore(ENTRY_VALUE_LOC(e), 0);
+        }
+        core->buckets[i] = NULL;
+    }
+    core->numEntries = 0;
+    concurrent_touch(ht);
+}
+
+/* Inserting can throw an error when the table is full.  We make sure
+   the mutex is released then. */
+#define WITH_CONCURRENT_LOCK(ht, stmt)                          \
+    do {                                                        \
+        Concurrent *c__ = CONCURRENT(ht);                       \
+        SCM_INTERNAL_MUTEX_LOCK(c__->mutex);                    \
+        SCM_UNWIND_PROTECT { stmt; }                            \
+        SCM_WHEN_ERROR {                                        \
+            SCM_INTERNAL_MUTEX_UNLOCK(c__->mutex);              \
+            SCM_NEXT_HANDLER;                                   \
+        } SCM_END_PROTECT;                                      \
+        SCM_INTERNAL_MUTEX_UNLOCK(c__->mutex);                  \
+    } while (0)
+
+/* Adds KEY with VALUE, if KEY is still absent and the table hasn't been
+   changed structurally since MODS.  Returns the new entry, or NULL if
+   the caller should search again. */
+static Entry *concurrent_add(ScmHashTable *ht, intptr_t key, u_long hashval,
+                             intptr_t value, ScmAtomicWord mods)
+{
+    Entry *volatile ne = NULL;
+    WITH_CONCURRENT_LOCK(ht, if (concurrent_unchanged(ht, mods)) {
+            ne = concurrent_insert(ht, key, hashval, value);
+        });
+    return ne;
+}
+
+static ScmObj concurrent_ref(ScmHashTable *ht, ScmObj key, ScmObj fallback)
+{
+    u_long hashval = concurrent_hash(ht, (intptr_t)key);
+    Entry *e = concurrent_search(ht, (intptr_t)key, hashval, NULL);
+    if (e == NULL) return fallback;
+    ScmAtomicWord v = Scm_AtomicLoad(ENTRY_VALUE_LOC(e));
+    return v ? SCM_OBJ(v) : fallback;
+}
+
+static ScmObj concurrent_set(ScmHashTable *ht, ScmObj key, ScmObj value,
+                             int flags)
+{
+    u_long hashval = concurrent_hash(ht, (intptr_t)key);
+    for (;;) {
+        ScmAtomicWord mods;
+        Entry *e = concurrent_search(ht, (intptr_t)key, hashval, &mods);
+        if (e) {
+            ScmAtomicWord oldval = Scm_AtomicLoad(ENTRY_VALUE_LOC(e));
+            if (oldval == 0) continue; /* being deleted */
+            if (flags&SCM_DICT_NO_OVERWRITE) return SCM_OBJ(oldval);
+            if (Scm_AtomicCompareExchange(ENTRY_VALUE_LOC(e), &oldval,
+                                          (ScmAtomicWord)value)) {
+                return SCM_OBJ(oldval);
+            }
+            continue;           /* someone else has changed it */
+        }
+        if (flags&SCM_DICT_NO_CREATE) return SCM_UNBOUND;
+        if (concurrent_add(ht, (intptr_t)key, hashval, (intptr_t)value,
+                           mods)) {
+            return SCM_UNBOUND;
+        }
+    }
+}
+
+static ScmObj concurrent_delete_key(ScmHashTable *ht, ScmObj key)
+{
+    u_long hashval = concurrent_hash(ht, (intptr_t)key);
+    for (;;) {
+        ScmAtomicWord mods;
+        Entry *e = concurrent_search(ht, (intptr_t)key, hashval, &mods);
+        if (e == NULL) return SCM_UNBOUND;
+        Concurrent *c = CONCURRENT(ht);
+        ScmAtomicWord oldval = 0;
+        int done = FALSE;
+        /* concurrent_delete doesn't throw */
+        SCM_INTERNAL_MUTEX_LOCK(c->mutex);
+        if (concurrent_unchanged(ht, mods)) {
+            oldval = concurrent_delete(ht, e);
+            done = TRUE;
+        }
+        SCM_INTERNAL_MUTEX_UNLOCK(c->mutex);
+        if (done) return oldval ? SCM_OBJ(oldval) : SCM_UNBOUND;
+    }
+}
+
+/* For read-modify-write operations.  Returns the entry of KEY, and its
+   current value in *VALP.  If there's no entry for KEY, a new entry with
+   FALLBACK is inserted, unless FALLBACK is SCM_UNBOUND, in which case
+   NULL is returned.  The caller computes a new value from *VALP, and
+   tries Scm_HashTableConcurrentSwap; if it fails, start over. */
+ScmDictEntry *Scm_HashTableConcurrentEntry(ScmHashTable *ht, ScmObj key,
+                                           ScmObj fallback, ScmObj *valp)
+{
+    SCM_ASSERT(ht->concurrent);
+    u_long hashval = concurrent_hash(ht, (intptr_t)key);
+    for (;;) {
+        ScmAtomicWord mods;
+        Entry *e = concurrent_search(ht, (intptr_t)key, hashval, &mods);
+        if (e) {
+            ScmAtomicWord v = Scm_AtomicLoad(ENTRY_VALUE_LOC(e));
+            if (v) {
+                *valp = SCM_OBJ(v);
+                return (ScmDictEntry*)e;
+            }
+            continue;           /* being deleted */
+        }
+        if (SCM_UNBOUNDP(fallback)) return NULL;
+        Entry *ne = concurrent_add(ht, (intptr_t)key, hashval,
+                                   (intptr_t)fallback, mods);
+        if (ne) {
+            *valp = fallback;
+            return (ScmDictEntry*)ne;
+        }
+    }
+}
+
+/* Sets the value of E to NEWVAL if it still has OLDVAL.  Returns FALSE
+   if it's been changed or deleted by another thread. */
+int Scm_HashTableConcurrentSwap(ScmDictEntry *e, ScmObj oldval, ScmObj newval)
+{
+    ScmAtomicWord expected = (ScmAtomicWord)oldval;
+    return Scm_AtomicCompareExchange(ENTRY_VALUE_LOC(e), &expected,
+                                     (ScmAtomicWord)newval);
+}
+
+/* Initializes ITER to walk the entries of HT.  A concurrent table is
+   copied first, so it takes time and memory proportional to the size
+   of the table. */
+void Scm_HashTableIterInit(ScmHashIter *iter, ScmHashTable *ht)
+{
+    if (ht->concurrent) ht = SCM_HASH_TABLE(Scm_HashTableCopy(ht));
+    Scm_HashIterInit(iter, SCM_HASH_TABLE_CORE(ht));
+}
+
 /*============================================================
  * Scheme <hash-table> object
  */
@@ -949,6 +1281,7 @@ ScmObj Scm_MakeHashTableSimple(ScmHashType type, unsigned int initSize)
     SCM_SET_CLASS(z, SCM_CLASS_HASH_TABLE);
     Scm_HashCoreInitSimple(&z->core, type, initSize, NULL);
     z->type = type;
+    z->concurrent = NULL;
     return SCM_OBJ(z);
 }
 
@@ -959,6 +1292,7 @@ ScmObj Scm_MakeHashTableFull(ScmHashProc hashfn,
     ScmHashTable *z = SCM_NEW(ScmHashTable);
     SCM_SET_CLASS(z, SCM_CLASS_HASH_TABLE);
     z->type = SCM_HASH_GENERAL;
+    z->concurrent = NULL;
     Scm_HashCoreInitGeneral(&z->core, hashfn, cmpfn, initSize, data);
     return SCM_OBJ(z);
 }
@@ -967,7 +1301,17 @@ ScmObj Scm_HashTableCopy(ScmHashTable *src)
 {
     ScmHashTable *dst = SCM_NEW(ScmHashTable);
     SCM_SET_CLASS(dst, SCM_CLASS_HASH_TABLE);
-    Scm_HashCoreCopy(SCM_HASH_TABLE_CORE(dst), SCM_HASH_TABLE_CORE(src));
+    dst->concurrent = NULL;
+    if (src->concurrent) {
+        /* Scm_HashCoreCopy doesn't call Scheme, so it won't throw. */
+        Concurrent *c = CONCURRENT(src);
+        SCM_INTERNAL_MUTEX_LOCK(c->mutex);
+        Scm_HashCoreCopy(SCM_HASH_TABLE_CORE(dst), SCM_HASH_TABLE_CORE(src));
+        SCM_INTERNAL_MUTEX_UNLOCK(c->mutex);
+        Scm_HashTableMakeConcurrent(dst);
+    } else {
+        Scm_HashCoreCopy(SCM_HASH_TABLE_CORE(dst), SCM_HASH_TABLE_CORE(src));
+    }
     dst->type = src->type;
     return SCM_OBJ(dst);
 }
@@ -979,6 +1323,7 @@ ScmHashType Scm_HashTableType(ScmHashTable *ht)
 
 ScmObj Scm_HashTableRef(ScmHashTable *ht, ScmObj key, ScmObj fallback)
 {
+    if (ht->concurrent) return concurrent_ref(ht, key, fallback);
     ScmDictEntry *e = Scm_HashCoreSearch(SCM_HASH_TABLE_CORE(ht),
                                          (intptr_t)key, SCM_DICT_GET);
     if (!e) return fallback;
@@ -989,6 +1334,7 @@ ScmObj Scm_HashTableRef(ScmHashTable *ht, ScmObj key, ScmObj fallback)
    been there.  Be careful not to let SCM_UNBOUND leak out to Scheme! */
 ScmObj Scm_HashTableSet(ScmHashTable *ht, ScmObj key, ScmObj value, int flags)
 {
+    if (ht->concurrent) return concurrent_set(ht, key, value, flags);
     ScmDictEntry *e;
 
     e = Scm_HashCoreSearch(SCM_HASH_TABLE_CORE(ht),
@@ -1004,21 +1350,43 @@ ScmObj Scm_HashTableSet(ScmHashTable *ht, ScmObj key, ScmObj value, int flags)
 
 ScmObj Scm_HashTableDelete(ScmHashTable *ht, ScmObj key)
 {
+    if (ht->concurrent) return concurrent_delete_key(ht, key);
     ScmDictEntry *e = Scm_HashCoreSearch(SCM_HASH_TABLE_CORE(ht),
                                          (intptr_t)key, SCM_DICT_DELETE);
     if (e && e->value) return SCM_DICT_VALUE(e);
     else               return SCM_UNBOUND;
 }
 
+void Scm_HashTableClear(ScmHashTable *ht)
+{
+    if (ht->concurrent) {
+        Concurrent *c = CONCURRENT(ht);
+        SCM_INTERNAL_MUTEX_LOCK(c->mutex);
+        concurrent_clear(ht);
+        SCM_INTERNAL_MUTEX_UNLOCK(c->mutex);
+    } else {
+        Scm_HashCoreClear(SCM_HASH_TABLE_CORE(ht));
+    }
+}
+
+/* For the concurrent table, we walk the entries with the mutex held.
+   It's safe since we don't call Scheme code. */
+#define CONCURRENT_LOCK(ht) \
+    do { if ((ht)->concurrent) SCM_INTERNAL_MUTEX_LOCK(CONCURRENT(ht)->mutex); } while (0)
+#define CONCURRENT_UNLOCK(ht) \
+    do { if ((ht)->concurrent) SCM_INTERNAL_MUTEX_UNLOCK(CONCURRENT(ht)->mutex); } while (0)
+
 ScmObj Scm_HashTableKeys(ScmHashTable *table)
 {
     ScmHashIter iter;
     ScmDictEntry *e;
     ScmObj h = SCM_NIL, t = SCM_NIL;
+    CONCURRENT_LOCK(table);
     Scm_HashIterInit(&iter, SCM_HASH_TABLE_CORE(table));
     while ((e = Scm_HashIterNext(&iter)) != NULL) {
         SCM_APPEND1(h, t, SCM_DICT_KEY(e));
     }
+    CONCURRENT_UNLOCK(table);
     return h;
 }
 
@@ -1027,16 +1395,19 @@ ScmObj Scm_HashTableValues(ScmHashTable *table)
     ScmHashIter iter;
     ScmDictEntry *e;
     ScmObj h = SCM_NIL, t = SCM_NIL;
+    CONCURRENT_LOCK(table);
     Scm_HashIterInit(&iter, SCM_HASH_TABLE_CORE(table));
     while ((e = Scm_HashIterNext(&iter)) != NULL) {
         SCM_APPEND1(h, t, SCM_DICT_VALUE(e));
     }
+    CONCURRENT_UNLOCK(table);
     return h;
 }
 
 ScmObj Scm_HashTableStat(ScmHashTable *table)
 {
     ScmObj h = SCM_NIL, t = SCM_NIL;
+    CONCURRENT_LOCK(table);
     ScmHashCore *c = SCM_HASH_TABLE_CORE(table);
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("num-entries"));
     SCM_APPEND1(h, t, Scm_MakeInteger(c->numEntries));
@@ -1054,6 +1425,7 @@ ScmObj Scm_HashTableStat(ScmHashTable *table)
             *vp = Scm_Acons(SCM_DICT_KEY(e), SCM_DICT_VALUE(e), *vp);
         }
     }
+    CONCURRENT_UNLOCK(table);
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("contents"));
     SCM_APPEND1(h, t, SCM_OBJ(v));
     return h;
@@ -227,7 +227,8 @@
     (full-name :c-spec "Scm_CompiledCodeFullName(obj)" :setter #f)
     (size :type <fixnum> :c-name "codeSize" :setter #f)
     (max-stack :type <fixnum> :c-name "maxstack" :setter #f)
-    (intermediate-form :c-name "intermediateForm" :setter #f))
+    (intermediate-form :c-name "intermediateForm" :setter #f)
+    (flags :type <ulong>))
    (printer (Scm_Printf port "#<compiled-code %S@%p>"
                         (Scm_CompiledCodeFullName (SCM_COMPILED_CODE obj))
                         obj)))
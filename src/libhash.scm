@@ -212,7 +212,19 @@
 
 ;; Comparator argument can be <comparator> or one of the symbols
 ;; eq?, eqv?, equal? or string=?.
-(define (make-hash-table :optional (comparator 'eq?) (init-size 0))
+;; Init-size can be omitted before the keyword arguments.
+(define (make-hash-table :optional (comparator 'eq?) (init-size 0) :rest opts)
+  (receive (init-size opts) (if (keyword? init-size)
+                              (values 0 (cons init-size opts))
+                              (values init-size opts))
+    (let-keywords opts ([concurrent #f])
+      (rlet1 ht ((with-module gauche.internal %make-hash-table)
+                 comparator init-size)
+        (when concurrent
+          ((with-module gauche.internal %hash-table-make-concurrent!) ht))))))
+
+(select-module gauche.internal)
+(define (%make-hash-table comparator init-size)
   (case comparator
     [(eq? eqv? equal? string=?)
      (%make-hash-table-simple comparator init-size)]
@@ -230,14 +242,14 @@
      (cond
       [(or (eq? comparator eq-comparator)
            (eq? (comparator-equality-predicate comparator) eq?))
-       (make-hash-table 'eq? init-size)]
+       (%make-hash-table 'eq? init-size)]
       [(or (eq? comparator eqv-comparator)
            (eq? (comparator-equality-predicate comparator) eqv?))
-       (make-hash-table 'eqv? init-size)]
+       (%make-hash-table 'eqv? init-size)]
       [(eq? comparator equal-comparator)
-       (make-hash-table 'equal? init-size)]
+       (%make-hash-table 'equal? init-size)]
       [(eq? comparator string-comparator)
-       (make-hash-table 'string=? init-size)]
+       (%make-hash-table 'string=? init-size)]
       [else
        (unless (comparator-hashable? comparator)
          (error "make-hash-table requires a comparator with hash function, \
@@ -247,6 +259,13 @@
           (not (eq? (comparator-type-test-predicate comparator)
                     (with-module gauche.internal default-type-test))))])]))
 
+(define-cproc %hash-table-make-concurrent! (hash::<hash-table>) ::<void>
+  Scm_HashTableMakeConcurrent)
+
+(select-module gauche)
+(define-cproc hash-table-concurrent? (hash::<hash-table>) ::<boolean>
+  (return (SCM_HASH_TABLE_CONCURRENT_P hash)))
+
 (define-cproc hash-table-type (hash::<hash-table>)
   (get-hash-type (-> hash type)))
 
@@ -273,7 +292,7 @@
   (return (Scm_HashCoreNumEntries (SCM_HASH_TABLE_CORE hash))))
 
 (define-cproc hash-table-clear! (hash::<hash-table>) ::<void>
-  (Scm_HashCoreClear (SCM_HASH_TABLE_CORE hash)))
+  Scm_HashTableClear)
 
 (define-cproc hash-table-get (hash::<hash-table> key :optional fallback)
   (dict-get hash Scm_HashTableRef))
@@ -300,18 +319,94 @@
    (let* ([e::ScmDictEntry* (cast ScmDictEntry* (aref data 0))])
      (cast void (SCM_DICT_SET_VALUE e result))
      (return result)))
+
+ ;; On concurrent tables, we don't lock the entry while PROC runs.
+ ;; Instead, we swap the value only if no one has changed it, and start
+ ;; over otherwise.  So PROC may be called more than once.  If the key
+ ;; is absent, the entry is added with PROC's result, so that other
+ ;; threads never see FALLBACK itself.
+
+ (define-cfn hash-table-concurrent-update (hash::ScmHashTable* key proc
+                                           fallback)
+   :static
+   (let* ([v SCM_UNBOUND]
+          [e::ScmDictEntry*
+             (Scm_HashTableConcurrentEntry hash key SCM_UNBOUND (& v))]
+          [data::(.array void* (6))])
+     (when (== e NULL)
+       (dict-check-entry hash key (SCM_UNBOUNDP fallback))
+       (set! v fallback))
+     (set! (aref data 0) hash)
+     (set! (aref data 1) key)
+     (set! (aref data 2) proc)
+     (set! (aref data 3) fallback)
+     (set! (aref data 4) e)
+     (set! (aref data 5) v)
+     (Scm_VMPushCC hash-table-concurrent-update-cc data 6)
+     (return (Scm_VMApply1 proc v))))
+
+ (define-cfn hash-table-concurrent-update-cc (result (data :: void**))
+   :static
+   (let* ([hash::ScmHashTable* (cast ScmHashTable* (aref data 0))]
+          [key (SCM_OBJ (aref data 1))]
+          [e::ScmDictEntry* (cast ScmDictEntry* (aref data 4))])
+     (if (?: (== e NULL)
+             (SCM_UNBOUNDP (Scm_HashTableSet hash key result
+                                             SCM_DICT_NO_OVERWRITE))
+             (Scm_HashTableConcurrentSwap e (SCM_OBJ (aref data 5)) result))
+       (return result)
+       (return (hash-table-concurrent-update hash key
+                                             (SCM_OBJ (aref data 2))
+                                             (SCM_OBJ (aref data 3)))))))
+
+ (define-cfn hash-table-concurrent-push! (hash::ScmHashTable* key value)
+   ::void :static
+   (loop
+    (let* ([v SCM_UNBOUND]
+           [e::ScmDictEntry*
+              (Scm_HashTableConcurrentEntry hash key SCM_UNBOUND (& v))])
+      (cond
+       [(== e NULL)
+        (when (SCM_UNBOUNDP (Scm_HashTableSet hash key (SCM_LIST1 value)
+                                              SCM_DICT_NO_OVERWRITE))
+          (break))]
+       [(Scm_HashTableConcurrentSwap e v (Scm_Cons value v))
+        (break)]))))
+
+ (define-cfn hash-table-concurrent-pop! (hash::ScmHashTable* key fallback)
+   :static
+   (loop
+    (let* ([v SCM_UNBOUND]
+           [e::ScmDictEntry*
+              (Scm_HashTableConcurrentEntry hash key SCM_UNBOUND (& v))])
+      (cond
+       [(== e NULL)
+        (dict-check-entry hash key (SCM_UNBOUNDP fallback))
+        (return fallback)]
+       [(not (SCM_PAIRP v))
+        (when (SCM_UNBOUNDP fallback)
+          (Scm_Error "%S's value for key %S is not a pair: %S" hash key v))
+        (return fallback)]
+       [(Scm_HashTableConcurrentSwap e v (SCM_CDR v))
+        (return (SCM_CAR v))]))))
  )
 
 (define-cproc hash-table-update! (hash::<hash-table> key proc
                                                      :optional fallback)
-  (dict-update! hash Scm_HashCoreSearch SCM_HASH_TABLE_CORE
-                hash-table-update-cc))
+  (if (SCM_HASH_TABLE_CONCURRENT_P hash)
+    (return (hash-table-concurrent-update hash key proc fallback))
+    (dict-update! hash Scm_HashCoreSearch SCM_HASH_TABLE_CORE
+                  hash-table-update-cc)))
 
 (define-cproc hash-table-push! (hash::<hash-table> key value) ::<void>
-  (dict-push! hash Scm_HashCoreSearch SCM_HASH_TABLE_CORE))
+  (if (SCM_HASH_TABLE_CONCURRENT_P hash)
+    (hash-table-concurrent-push! hash key value)
+    (dict-push! hash Scm_HashCoreSearch SCM_HASH_TABLE_CORE)))
 
 (define-cproc hash-table-pop! (hash::<hash-table> key :optional fallback)
-  (dict-pop! hash Scm_HashCoreSearch SCM_HASH_TABLE_CORE))
+  (if (SCM_HASH_TABLE_CONCURRENT_P hash)
+    (return (hash-table-concurrent-pop! hash key fallback))
+    (dict-pop! hash Scm_HashCoreSearch SCM_HASH_TABLE_CORE)))
 
 (inline-stub
  (define-cfn hash-table-iter (args::ScmObj* _::int data::void*) :static
@@ -326,7 +421,8 @@
 (select-module gauche.internal)
 (define-cproc %hash-table-iter (hash::<hash-table>)
   (let* ([iter::ScmHashIter* (SCM_NEW ScmHashIter)])
-    (Scm_HashIterInit iter (SCM_HASH_TABLE_CORE hash))
+    ;; A concurrent table is iterated over its snapshot.
+    (Scm_HashTableIterInit iter hash)
     (return (Scm_MakeSubr hash_table_iter iter 1 0 '"hash-table-iterator"))))
 
 (select-module gauche)
@@ -150,6 +150,16 @@
             (logand= (SCM_PORT_FLAGS port) (lognot SCM_PORT_CASE_FOLD))))
   (return (logand (SCM_PORT_FLAGS port) SCM_PORT_CASE_FOLD)))
 
+;; Used by copy-port.  Copies up to LIMIT bytes (or until EOF if LIMIT
+;; is negative) directly between file descriptors.  Returns #f if either
+;; port isn't directly connected to a file descriptor.
+(define-cproc %port-copy-fd (src::<input-port> dst::<output-port>
+                             limit::<ssize_t>)
+  (let* ([n::ScmSize (Scm_PortCopyFd src dst limit)])
+    (if (< n 0)
+      (return SCM_FALSE)
+      (return (Scm_MakeIntegerU n)))))
+
 
 ;;
 ;; Open and close
@@ -618,17 +628,23 @@
       (Scm_ReadError port "read-line: encountered illegal byte sequence: %S" r))
     (return r)))
 
-(define (read-string n :optional (port (current-input-port)))
-  (define o (open-output-string :private? #t))
-  (let loop ([i 0])
-    (if (>= i n)
-      (get-output-string o)
-      (let1 c (read-char port)
-        (if (eof-object? c)
-          (if (= i 0)
-            (eof-object)
-            (get-output-string o))
-          (begin (write-char c o) (loop (+ i 1))))))))
+(define-cproc read-string (n::<fixnum>
+                          :optional (port::<input-port> (current-input-port)))
+  (if (<= n 0)
+    (return (SCM_MAKE_STR ""))
+    (return (Scm_ReadSpan port NULL FALSE n))))
+
+;; Read characters while they're in / not in CS.  These scan the port
+;; buffer directly, so they're much faster than looping with peek-char
+;; and read-char.
+(define-cproc read-span (cs::<char-set>
+                         :optional (port::<input-port> (current-input-port)))
+  (return (Scm_ReadSpan port cs FALSE -1)))
+
+(define-cproc read-until-char-set (cs::<char-set>
+                                   :optional (port::<input-port>
+                                              (current-input-port)))
+  (return (Scm_ReadSpan port cs TRUE -1)))
 
 ;; Special reader for code. This reads input with modified <read-context>,
 ;; so that the literal objects are read as immutable.
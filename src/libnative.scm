@@ -48,6 +48,7 @@
            "gauche/priv/nativeP.h"
            "gauche/priv/codeP.h"
            "gauche/priv/typeP.h"
+           "gauche/priv/vmP.h"
            "gauche/vminsn.h")
 
  ;; This procedure is accessible via gauche.libtype#native-ptr-fill!,
@@ -288,6 +289,20 @@
       (^[proc compiler] (jcp proc compiler)))
     (^ _ (error "Operation not allowed"))))
 
+;; Returns an executable <memory-region> containing CODE.  The region
+;; is used as the operand of XINSN.
+(define-cproc %jit-allocate-code-page (code::<u8vector>)
+  (.unless GAUCHE_ENABLE_UNSAFE_JIT_API
+    (Scm_Error "Operation not allowed"))
+  (return (Scm__AllocateCodePage code)))
+
+;; Registers a procedure to be called with a <compiled-code> when
+;; it is entered THRESHOLD times.  #f disables JIT.  See gauche.vm.jit.
+(define-cproc %vm-set-jit-compiler! (proc threshold::<ulong>) ::<void>
+  (.if GAUCHE_ENABLE_UNSAFE_JIT_API
+       (Scm__VMSetJITCompiler proc threshold)
+       (Scm_Error "Operation not allowed")))
+
 (inline-stub
  (define-cise-stmt with-static-table
    [(_ (var ((key intval) ...)) body ...)
@@ -334,7 +349,9 @@
          (Add    Scm_Add)
          (Sub    Scm_Sub)
          (Mul    Scm_Mul)
-         (Div    Scm_Div)))
+         (Div    Scm_Div)
+         (JITCar Scm__JITCar)
+         (JITCdr Scm__JITCdr)))
    (let* ([addr (Scm_HashTableRef tab (SCM_OBJ name) SCM_FALSE)])
      (unless (SCM_INTEGERP addr)
        (Scm_Error "Unknown function address: %S" name))
@@ -36,7 +36,8 @@
 
 (inline-stub
  (.include "gauche/priv/configP.h"
-           "gauche/priv/regexpP.h"))
+           "gauche/priv/regexpP.h")
+ (declare-stub-type <regexp-set> "ScmRegexpSet*"))
 
 (define-cproc regexp? (obj)   ::<boolean> :constant SCM_REGEXPP)
 (define-cproc regmatch? (obj) ::<boolean> SCM_REGMATCHP)
@@ -107,6 +108,17 @@
     (return SCM_NIL)
     (rxmatchop (-> (SCM_REGMATCH match) grpNames))))
 
+;; Regexp set
+(define-cproc regexp-set? (obj) ::<boolean> SCM_REGEXP_SETP)
+(define-cproc make-regexp-set (regexps::<list>) Scm_MakeRegexpSet)
+(define-cproc regexp-set-regexps (rs::<regexp-set>)
+  (return (-> rs regexps)))
+(define-cproc regexp-set-size (rs::<regexp-set>) ::<int>
+  (return (-> rs numRegexps)))
+(define-cproc regexp-set-match (rs::<regexp-set> str::<string>
+                                :optional start end)
+  Scm_RegexpSetMatch)
+
 (select-module gauche.internal)
 (define-cproc %regexp-dump (rx::<regexp>) ::<void> Scm_RegDump)
 (define-cproc %regmatch-dump (rm::<regmatch>) ::<void> Scm_RegMatchDump)
@@ -1446,6 +1446,65 @@
    ) ;; when defined(HAVE_SELECT)
  )
 
+;;---------------------------------------------------------------------
+;; poller
+
+(inline-stub
+ (.when (defined "SCM_HAVE_SYS_POLLER")
+   ;; Conditions are given and reported as a list of symbols r, w and x,
+   ;; the same as gauche.selector.  In sys-poller-add!, a symbol edge
+   ;; can also be included to request edge-triggered notification.
+   (define-cfn poller-flags->mask (flags) ::u_long :static
+     (let* ([mask::u_long 0])
+       (dolist [f flags]
+         (cond [(SCM_EQ f 'r) (logior= mask SCM_SYS_POLL_READ)]
+               [(SCM_EQ f 'w) (logior= mask SCM_SYS_POLL_WRITE)]
+               [(SCM_EQ f 'x) (logior= mask SCM_SYS_POLL_EXCEPT)]
+               [(SCM_EQ f 'edge) (logior= mask SCM_SYS_POLL_EDGE)]
+               [else (Scm_Error "invalid poller flag %S, must be one of \
+                                 r, w, x or edge" f)]))
+       (return mask)))
+
+   (define-cproc sys-poller-open (:optional (kind #f))
+     (let* ([k::int SCM_SYS_POLLER_DEFAULT])
+       (cond [(SCM_FALSEP kind)]
+             [(SCM_EQ kind 'epoll) (set! k SCM_SYS_POLLER_EPOLL)]
+             [(SCM_EQ kind 'poll)  (set! k SCM_SYS_POLLER_POLL)]
+             [else (Scm_Error "poller kind must be epoll, poll or #f, \
+                               but got %S" kind)])
+       (return (Scm_MakeSysPoller k))))
+
+   (define-cproc sys-poller-kind (poller::<sys-poller>)
+     (if (== (Scm_SysPollerKind poller) SCM_SYS_POLLER_EPOLL)
+       (return 'epoll)
+       (return 'poll)))
+
+   (define-cproc sys-poller-add! (poller::<sys-poller> pf flags::<list>)
+     ::<void>
+     (let* ([fd::int (Scm_GetPortFd pf TRUE)])
+       (Scm_SysPollerAdd poller fd (poller-flags->mask flags))))
+
+   (define-cproc sys-poller-delete! (poller::<sys-poller> pf) ::<void>
+     (let* ([fd::int (Scm_GetPortFd pf FALSE)])
+       (Scm_SysPollerDelete poller fd)))
+
+   ;; Returns a list of (fd flag ...)
+   (define-cproc sys-poller-wait (poller::<sys-poller> :optional (timeout #f))
+     (let* ([h SCM_NIL] [t SCM_NIL])
+       (dolist [e (Scm_SysPollerWait poller timeout)]
+         (let* ([mask::u_long (Scm_GetIntegerU (SCM_CDR e))]
+                [fl SCM_NIL])
+           (when (logand mask SCM_SYS_POLL_EXCEPT) (set! fl (Scm_Cons 'x fl)))
+           (when (logand mask SCM_SYS_POLL_WRITE)  (set! fl (Scm_Cons 'w fl)))
+           (when (logand mask SCM_SYS_POLL_READ)   (set! fl (Scm_Cons 'r fl)))
+           (SCM_APPEND1 h t (Scm_Cons (SCM_CAR e) fl))))
+       (return h)))
+
+   (define-cproc sys-poller-close (poller::<sys-poller>) ::<void>
+     Scm_SysPollerClose)
+   ) ;; when defined(SCM_HAVE_SYS_POLLER)
+ )
+
 ;;---------------------------------------------------------------------
 ;; miscellaneous
 
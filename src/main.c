@@ -133,6 +133,8 @@ void usage(int errorp)
             "           values are supported as <standard>.\n"
             "      7               R7RS (R7RS-small)\n"
             "  -f<flag> Sets various flags\n"
+            "      auto-inline     inlines small procedures defined by 'define'\n"
+            "                      into other modules.\n"
             "      case-fold       uses case-insensitive reader (as in R5RS)\n"
             "      include-verbose reports while including files\n"
             "      load-verbose    reports while loading files\n"
@@ -328,6 +330,9 @@ void further_options(const char *optarg)
         SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_NOINLINE_CONSTS);
         SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_NOINLINE_SETTERS);
     }
+    else if (strcmp(optarg, "auto-inline") == 0) {
+        SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_AUTO_INLINE);
+    }
     else if (strcmp(optarg, "no-post-inline-pass") == 0) {
         SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_NO_POST_INLINE_OPT);
     }
@@ -469,6 +469,10 @@ ScmGloc *Scm_MakeBinding(ScmModule *module, ScmSymbol *symbol,
     }
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
 
+    /* NB: We don't modify FLAGS itself, for it is live across the
+       setjmp that SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN may use. */
+    int mark = flags;
+
     if (existing) {
         if (!Scm_GlocSupersedableP(g, flags, value)) {
             Scm_Warn("redefining %s %S#%S",
@@ -487,6 +491,13 @@ ScmGloc *Scm_MakeBinding(ScmModule *module, ScmSymbol *symbol,
                      g->module->name, g->name);
         }
 #endif
+        /* A procedure can be inlined across modules only if it is
+           defined once.  If we already have a real value, this is
+           a redefinition and other modules must see the new value. */
+        if ((flags & SCM_BINDING_AUTO_INLINABLE)
+            && !SCM_UNBOUNDP(g->value) && !SCM_UNINITIALIZEDP(g->value)) {
+            mark &= ~SCM_BINDING_AUTO_INLINABLE;
+        }
     }
 
 #if 0
@@ -499,7 +510,7 @@ ScmGloc *Scm_MakeBinding(ScmModule *module, ScmSymbol *symbol,
 #endif
 
     g->value = value;
-    Scm_GlocMark(g, flags);
+    Scm_GlocMark(g, mark);
     return g;
 }
 
@@ -0,0 +1,762 @@
+/*
+ * mparith.c - arithmetic on raw word arrays
+ *
+ *
+ *   Copyright (c) 2000-2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* This file is included by bignum.c.  The routines here work on arrays
+ * of u_long, least significant word first, and don't know about
+ * ScmBignum.  bignum.c uses mul_n and div_qr.
+ *
+ * The includer must include gauche/priv/arith.h and define min().
+ * test-mparith.c includes this file with the portable versions of
+ * the arithmetic macros, which the bignum tests don't exercise on
+ * the platforms that have the asm versions.
+ */
+
+/*
+ * Multiplying large bignums
+ *
+ *   mul_n chooses the algorithm by the length of the shorter operand,
+ *   n words:
+ *
+ *     n < KARATSUBA_THRESHOLD   schoolbook, O(n^2)
+ *     n < TOOM3_THRESHOLD       Karatsuba, O(n^1.585)
+ *     n < NTT_THRESHOLD         Toom-3, O(n^1.465)
+ *     otherwise                 number theoretic transform, O(n log n)
+ *
+ *   They work on raw word arrays.  The thresholds are measured on x86_64.
+ *   Around the thresholds the neighboring algorithms perform about the
+ *   same, so they don't need to be precise.
+ */
+
+#define KARATSUBA_THRESHOLD  32
+#define TOOM3_THRESHOLD      2000
+#define NTT_THRESHOLD        10000
+
+static void mul_n(u_long *r, const u_long *x, int xn,
+                  const u_long *y, int yn);
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn).  r must not overlap x or y. */
+static void mul_basecase(u_long *r, const u_long *x, int xn,
+                         const u_long *y, int yn)
+{
+    for (int i=0; i<xn+yn; i++) r[i] = 0;
+    for (int j=0; j<yn; j++) {
+        u_long yj = y[j], c = 0;
+        if (yj == 0) continue;
+        for (int i=0; i<xn; i++) {
+            u_long hi, lo, t;
+            UMUL(hi, lo, x[i], yj);
+            /* hi <= 2^WORD_BITS-2, so adding two carries never overflows */
+            t = lo + c;       hi += (t < c);
+            lo = t + r[i+j];  hi += (lo < t);
+            r[i+j] = lo;
+            c = hi;
+        }
+        r[j+xn] = c;
+    }
+}
+
+/* r[0..n) += x[0..xn), where n >= xn.  Returns the carry. */
+static u_long mul_acc(u_long *r, int n, const u_long *x, int xn)
+{
+    u_long c = 0;
+    int i;
+    for (i=0; i<xn; i++) { u_long t = r[i]; UADD(r[i], c, t, x[i]); }
+    for (; c && i<n; i++) { u_long t = r[i]; UADD(r[i], c, t, 0); }
+    return c;
+}
+
+/* r[0..n) -= x[0..xn), where n >= xn.  Returns the borrow. */
+static u_long mul_dec(u_long *r, int n, const u_long *x, int xn)
+{
+    u_long c = 0;
+    int i;
+    for (i=0; i<xn; i++) { u_long t = r[i]; USUB(r[i], c, t, x[i]); }
+    for (; c && i<n; i++) { u_long t = r[i]; USUB(r[i], c, t, 0); }
+    return c;
+}
+
+/* r[0..xn+1) = x[0..xn) + y[0..yn), where xn >= yn. */
+static void mul_sum(u_long *r, const u_long *x, int xn,
+                    const u_long *y, int yn)
+{
+    u_long c = 0;
+    int i;
+    for (i=0; i<yn; i++) UADD(r[i], c, x[i], y[i]);
+    for (; i<xn; i++) UADD(r[i], c, x[i], 0);
+    r[xn] = c;
+}
+
+/* r[0..n) = |x[0..n) - y[0..n)|.  Returns TRUE if x < y. */
+static int mul_absdiff(u_long *r, const u_long *x, const u_long *y, int n)
+{
+    int i = n-1;
+    while (i >= 0 && x[i] == y[i]) r[i--] = 0;
+    if (i < 0) return FALSE;
+    int neg = (x[i] < y[i]);
+    if (neg) { const u_long *t = x; x = y; y = t; }
+    u_long c = 0;
+    for (int j=0; j<=i; j++) USUB(r[j], c, x[j], y[j]);
+    return neg;
+}
+
+/*
+ * Karatsuba
+ */
+
+/* # of words of the scratch area mul_karatsuba needs for
+   an operand of n words. */
+static int karatsuba_scratch_size(int n)
+{
+    int s = 0;
+    while (n >= KARATSUBA_THRESHOLD) {
+        int h = (n+1)/2;
+        s += 4*h + 4;
+        n = h + 1;
+    }
+    return s;
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn), where xn >= yn.
+   ws is the scratch area of karatsuba_scratch_size(xn) words. */
+static void mul_karatsuba(u_long *r, const u_long *x, int xn,
+                          const u_long *y, int yn, u_long *ws)
+{
+    if (yn < KARATSUBA_THRESHOLD) {
+        mul_basecase(r, x, xn, y, yn);
+        return;
+    }
+
+    int h = (xn+1)/2;
+    if (yn <= h) {
+        /* y is too short to split.  r = x0*y + (x1*y << h) */
+        int n1 = xn - h;
+        mul_karatsuba(r, x, h, y, yn, ws);
+        u_long *t = ws;
+        if (n1 >= yn) mul_karatsuba(t, x+h, n1, y, yn, ws+n1+yn);
+        else          mul_karatsuba(t, y, yn, x+h, n1, ws+n1+yn);
+        for (int i=h+yn; i<xn+yn; i++) r[i] = 0;
+        mul_acc(r+h, xn+yn-h, t, n1+yn);
+        return;
+    }
+
+    /* x = x1*B^h + x0, y = y1*B^h + y0, where B = 2^WORD_BITS.
+       x*y = z2*B^2h + z1*B^h + z0, where
+       z0 = x0*y0, z2 = x1*y1, z1 = (x0+x1)*(y0+y1) - z0 - z2 */
+    u_long *sx = ws, *sy = ws + h + 1, *z1 = ws + 2*h + 2;
+    u_long *wsnext = ws + 4*h + 4;
+    mul_karatsuba(r, x, h, y, h, wsnext);                 /* z0 */
+    mul_karatsuba(r+2*h, x+h, xn-h, y+h, yn-h, wsnext);   /* z2 */
+    mul_sum(sx, x, h, x+h, xn-h);
+    mul_sum(sy, y, h, y+h, yn-h);
+    mul_karatsuba(z1, sx, h+1, sy, h+1, wsnext);
+    mul_dec(z1, 2*h+2, r, 2*h);
+    mul_dec(z1, 2*h+2, r+2*h, xn+yn-2*h);
+    /* The upper words of z1 beyond the result are zero. */
+    mul_acc(r+h, xn+yn-h, z1, min(2*h+2, xn+yn-h));
+}
+
+/*
+ * Toom-3
+ *
+ *   We use the evaluation points 0, 1, -1, -2 and infinity, and the
+ *   interpolation sequence by Bodrato.  The intermediate values of the
+ *   interpolation can be negative; we keep them in two's complement
+ *   of fixed width, in which exact division by 2 and 3 is easy.
+ */
+
+/* x = x2*B^2k + x1*B^k + x0.  Computes the magnitudes of x(1), x(-1)
+   and x(-2) into e1, em1 and em2, each k+1 words, and returns
+   the signs of x(-1) and x(-2) as bit 0 and bit 1 of the result.
+   t and u are work areas of k+1 words. */
+static int toom3_eval(u_long *e1, u_long *em1, u_long *em2,
+                      u_long *t, u_long *u,
+                      const u_long *x, int xn, int k)
+{
+    const u_long *x0 = x, *x1 = x+k, *x2 = x+2*k;
+    int n2 = xn - 2*k, signs = 0;
+
+    mul_sum(t, x0, k, x2, n2);                  /* t = x0 + x2 */
+    for (int i=0; i<k; i++) u[i] = x1[i];
+    u[k] = 0;
+    for (int i=0; i<=k; i++) e1[i] = t[i];      /* x(1) = t + x1 */
+    mul_acc(e1, k+1, x1, k);
+    if (mul_absdiff(em1, t, u, k+1)) signs |= 1; /* x(-1) = t - x1 */
+
+    /* x(-2) = x0 - 2*x1 + 4*x2 = (x0 + 4*x2) - 2*x1 */
+    u_long c = 0, hi = 0;
+    for (int i=0; i<=k; i++) {
+        u_long w = (i < n2)? x2[i] : 0;
+        u_long w4 = (w << 2) | hi;
+        u_long w0 = (i < k)? x0[i] : 0;
+        hi = w >> (WORD_BITS-2);
+        UADD(t[i], c, w0, w4);
+    }
+    hi = 0;
+    for (int i=0; i<=k; i++) {
+        u_long w = u[i];
+        u[i] = (w << 1) | hi;
+        hi = w >> (WORD_BITS-1);
+    }
+    if (mul_absdiff(em2, t, u, k+1)) signs |= 2;
+    return signs;
+}
+
+/* r[0..n) = -r[0..n) in two's complement */
+static void toom3_negate(u_long *r, int n)
+{
+    u_long c = 0;
+    for (int i=0; i<n; i++) { u_long t = r[i]; USUB(r[i], c, 0, t); }
+}
+
+/* r[0..n) >>= 1, arithmetic shift of two's complement. */
+static void toom3_half(u_long *r, int n)
+{
+    for (int i=0; i<n-1; i++) r[i] = (r[i] >> 1) | (r[i+1] << (WORD_BITS-1));
+    r[n-1] = (u_long)((long)r[n-1] >> 1);
+}
+
+/* r[0..n) /= 3, exact division of two's complement.  We multiply
+   each word by the modular inverse of 3. */
+static void toom3_third(u_long *r, int n)
+{
+    const u_long third = SCM_ULONG_MAX/3;
+    const u_long inv3 = third*2 + 1;
+    u_long c = 0;
+    for (int i=0; i<n; i++) {
+        u_long s = r[i], l = s - c;
+        c = (l > s);
+        u_long q = l * inv3;
+        r[i] = q;
+        /* q*3 == l + hi*2^WORD_BITS; we subtract hi from the next word */
+        c += (q > third) + (q > third*2);
+    }
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn), where xn >= yn > 2*ceil(xn/3). */
+static void mul_toom3(u_long *r, const u_long *x, int xn,
+                      const u_long *y, int yn)
+{
+    int k = (xn+2)/3, w = 2*k+2;    /* w: width of intermediate values */
+    u_long *ws = SCM_NEW_ATOMIC_ARRAY(u_long, 8*(k+1) + 3*w);
+    u_long *xe1 = ws, *xem1 = xe1+k+1, *xem2 = xem1+k+1;
+    u_long *ye1 = xem2+k+1, *yem1 = ye1+k+1, *yem2 = yem1+k+1;
+    u_long *t = yem2+k+1, *u = t+k+1;
+    u_long *r1 = u+k+1, *rm1 = r1+w, *rm2 = rm1+w;
+
+    int xs = toom3_eval(xe1, xem1, xem2, t, u, x, xn, k);
+    int ys = toom3_eval(ye1, yem1, yem2, t, u, y, yn, k);
+
+    /* pointwise products.  r0 and rinf directly go to r. */
+    u_long *r0 = r, *rinf = r + 4*k;
+    int ninf = xn + yn - 4*k;
+    mul_n(r0, x, k, y, k);
+    mul_n(rinf, x+2*k, xn-2*k, y+2*k, yn-2*k);
+    for (int i=2*k; i<4*k; i++) r[i] = 0;
+    mul_n(r1, xe1, k+1, ye1, k+1);
+    mul_n(rm1, xem1, k+1, yem1, k+1);
+    if ((xs ^ ys) & 1) toom3_negate(rm1, w);
+    mul_n(rm2, xem2, k+1, yem2, k+1);
+    if ((xs ^ ys) & 2) toom3_negate(rm2, w);
+
+    /* interpolation.  t3 = rm2, t1 = r1, t2 = rm1 in place. */
+    u_long *t1 = r1, *t2 = rm1, *t3 = rm2;
+    mul_dec(t3, w, r1, w);                  /* t3 = (r(-2) - r(1))/3 */
+    toom3_third(t3, w);
+    mul_dec(t1, w, rm1, w);                 /* t1 = (r(1) - r(-1))/2 */
+    toom3_half(t1, w);
+    mul_dec(t2, w, r0, 2*k);                /* t2 = r(-1) - r(0) */
+    mul_dec(t3, w, t2, w);                  /* t3 = (t2 - t3)/2 + 2*rinf */
+    toom3_negate(t3, w);
+    toom3_half(t3, w);
+    mul_acc(t3, w, rinf, ninf);
+    mul_acc(t3, w, rinf, ninf);
+    mul_acc(t2, w, t1, w);                  /* t2 = t2 + t1 - rinf */
+    mul_dec(t2, w, rinf, ninf);
+    mul_dec(t1, w, t3, w);                  /* t1 = t1 - t3 */
+
+    /* recomposition.  t1, t2 and t3 are nonnegative now, and
+       their upper words beyond the result are zero. */
+    mul_acc(r+k,   xn+yn-k,   t1, min(w, xn+yn-k));
+    mul_acc(r+2*k, xn+yn-2*k, t2, min(w, xn+yn-2*k));
+    mul_acc(r+3*k, xn+yn-3*k, t3, min(w, xn+yn-3*k));
+}
+
+/*
+ * Number theoretic transform
+ *
+ *   We split operands into 16-bit digits and compute the convolution
+ *   modulo two primes, p1 = 7*2^26+1 and p2 = 5*2^25+1, then combine
+ *   them by CRT.  Each coefficient of the convolution is less than
+ *   2^24 * (2^16-1)^2 < p1*p2 as far as the transform length is within
+ *   2^25, so it is exact.  Longer operands are split by Toom-3 first.
+ *
+ *   Modular multiplication is done in Montgomery form with R = 2^32.
+ */
+
+#define NTT_P1       469762049U /* 7*2^26+1 */
+#define NTT_P2       167772161U /* 5*2^25+1 */
+#define NTT_G        3          /* primitive root of both */
+#define NTT_MAX_LEN  (1UL<<25)
+#define NTT_DIGITS   (WORD_BITS/16) /* # of 16-bit digits per word */
+#define NTT_FITS(nwords)  ((u_long)(nwords)*NTT_DIGITS <= NTT_MAX_LEN)
+
+typedef struct ntt_prime_rec {
+    uint32_t p;
+    uint32_t pinv;              /* -p^-1 mod 2^32 */
+    uint32_t r2;                /* 2^64 mod p */
+} ntt_prime;
+
+static uint32_t ntt_powmod(uint32_t a, uint64_t e, uint32_t p)
+{
+    uint64_t r = 1, b = a % p;
+    for (; e; e >>= 1) {
+        if (e & 1) r = r * b % p;
+        b = b * b % p;
+    }
+    return (uint32_t)r;
+}
+
+static void ntt_prime_init(ntt_prime *m, uint32_t p)
+{
+    uint32_t inv = p;               /* Newton's iteration for p^-1 */
+    for (int i=0; i<4; i++) inv *= 2 - p*inv;
+    m->p = p;
+    m->pinv = -inv;
+    m->r2 = (uint32_t)(((((uint64_t)1<<32) % p) << 32) % p);
+}
+
+/* a * b * 2^-32 mod p.  a*b must be less than p*2^32. */
+static inline uint32_t ntt_mul(const ntt_prime *m, uint32_t a, uint32_t b)
+{
+    uint64_t t = (uint64_t)a * b;
+    uint32_t q = (uint32_t)t * m->pinv;
+    uint32_t u = (uint32_t)((t + (uint64_t)q * m->p) >> 32);
+    return (u >= m->p)? u - m->p : u;
+}
+
+/* Twiddle factors in Montgomery form.  For each stage of transform
+   length len, w[len/2 + j] = root_len^j * 2^32 mod p, for 0 <= j < len/2,
+   where root_len is the primitive len-th root of unity.  w has n words. */
+static void ntt_roots(const ntt_prime *m, uint32_t *w, u_long n, int inverse)
+{
+    uint32_t root = ntt_powmod(NTT_G, (m->p - 1)/n, m->p);
+    if (inverse) root = ntt_powmod(root, m->p - 2, m->p);
+    uint32_t rootm = ntt_mul(m, root, m->r2);
+    u_long half = n/2;
+    w[half] = ntt_mul(m, 1, m->r2);
+    for (u_long j = 1; j < half; j++) w[half+j] = ntt_mul(m, w[half+j-1], rootm);
+    /* root_len^j == root_2len^2j */
+    for (half >>= 1; half >= 1; half >>= 1) {
+        for (u_long j = 0; j < half; j++) w[half+j] = w[2*half+2*j];
+    }
+}
+
+/* Forward transform, decimation in frequency.  The result is in
+   bit-reversed order, which the inverse transform expects. */
+static void ntt_forward(const ntt_prime *m, uint32_t *a, u_long n,
+                        const uint32_t *w)
+{
+    uint32_t p = m->p;
+    for (u_long half = n/2; half >= 1; half >>= 1) {
+        const uint32_t *wh = w + half;
+        for (u_long i = 0; i < n; i += 2*half) {
+            uint32_t *a0 = a + i, *a1 = a + i + half;
+            for (u_long j = 0; j < half; j++) {
+                uint32_t u = a0[j], v = a1[j];
+                a0[j] = (u + v >= p)? u + v - p : u + v;
+                a1[j] = ntt_mul(m, u + p - v, wh[j]);
+            }
+        }
+    }
+}
+
+/* Inverse transform, decimation in time, without the scaling by 1/n. */
+static void ntt_inverse(const ntt_prime *m, uint32_t *a, u_long n,
+                        const uint32_t *w)
+{
+    uint32_t p = m->p;
+    for (u_long half = 1; half < n; half <<= 1) {
+        const uint32_t *wh = w + half;
+        for (u_long i = 0; i < n; i += 2*half) {
+            uint32_t *a0 = a + i, *a1 = a + i + half;
+            for (u_long j = 0; j < half; j++) {
+                uint32_t u = a0[j], v = ntt_mul(m, a1[j], wh[j]);
+                a0[j] = (u + v >= p)? u + v - p : u + v;
+                a1[j] = (u >= v)? u - v : u + p - v;
+            }
+        }
+    }
+}
+
+static void ntt_load(uint32_t *a, u_long n, const u_long *x, int xn)
+{
+    u_long k = 0;
+    for (int i = 0; i < xn; i++) {
+        for (int d = 0; d < NTT_DIGITS; d++) {
+            a[k++] = (uint32_t)((x[i] >> (d*16)) & 0xffff);
+        }
+    }
+    for (; k < n; k++) a[k] = 0;
+}
+
+/* Convolution of x and y modulo p, into a.  b and w are work areas. */
+static void ntt_convolve(uint32_t *a, uint32_t *b, uint32_t *w, u_long n,
+                         const u_long *x, int xn, const u_long *y, int yn,
+                         uint32_t p)
+{
+    ntt_prime m;
+    ntt_prime_init(&m, p);
+    ntt_load(a, n, x, xn);
+    ntt_load(b, n, y, yn);
+    ntt_roots(&m, w, n, FALSE);
+    ntt_forward(&m, a, n, w);
+    ntt_forward(&m, b, n, w);
+    /* The pointwise product leaves a factor 2^-32, which we cancel
+       together with 1/n at the end. */
+    for (u_long i = 0; i < n; i++) a[i] = ntt_mul(&m, a[i], b[i]);
+    ntt_roots(&m, w, n, TRUE);
+    ntt_inverse(&m, a, n, w);
+    uint32_t scale = ntt_mul(&m, ntt_powmod((uint32_t)(n % p), p-2, p),
+                             m.r2);
+    scale = ntt_mul(&m, scale, m.r2);               /* n^-1 * 2^64 */
+    for (u_long i = 0; i < n; i++) a[i] = ntt_mul(&m, a[i], scale);
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn).  NTT_FITS(xn+yn) must hold. */
+static void mul_ntt(u_long *r, const u_long *x, int xn,
+                    const u_long *y, int yn)
+{
+    u_long ndigits = (u_long)(xn + yn) * NTT_DIGITS;
+    u_long n = 1;
+    while (n < ndigits) n <<= 1;
+    SCM_ASSERT(n <= NTT_MAX_LEN);
+
+    uint32_t *a1 = SCM_NEW_ATOMIC_ARRAY(uint32_t, n);
+    uint32_t *a2 = SCM_NEW_ATOMIC_ARRAY(uint32_t, n);
+    uint32_t *b  = SCM_NEW_ATOMIC_ARRAY(uint32_t, n);
+    uint32_t *w  = SCM_NEW_ATOMIC_ARRAY(uint32_t, n);
+    ntt_convolve(a1, b, w, n, x, xn, y, yn, NTT_P1);
+    ntt_convolve(a2, b, w, n, x, xn, y, yn, NTT_P2);
+
+    /* c = a1 + p1 * ((a2 - a1) * p1^-1 mod p2), and carry it over */
+    uint64_t p1inv = ntt_powmod(NTT_P1 % NTT_P2, NTT_P2-2, NTT_P2);
+    uint64_t carry = 0;
+    u_long k = 0;
+    for (int i = 0; i < xn+yn; i++) {
+        u_long word = 0;
+        for (int d = 0; d < NTT_DIGITS; d++, k++) {
+            uint64_t c1 = a1[k], c2 = a2[k];
+            uint64_t t = (c2 + NTT_P2 - c1 % NTT_P2) * p1inv % NTT_P2;
+            carry += c1 + t * NTT_P1;
+            word |= (u_long)(carry & 0xffff) << (d*16);
+            carry >>= 16;
+        }
+        r[i] = word;
+    }
+    SCM_ASSERT(carry == 0);
+}
+
+/*
+ * Dispatcher
+ */
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn).  r must not overlap x or y. */
+static void mul_n(u_long *r, const u_long *x, int xn,
+                  const u_long *y, int yn)
+{
+    if (xn < yn) {
+        const u_long *t = x; x = y; y = t;
+        int tn = xn; xn = yn; yn = tn;
+    }
+
+    if (yn < KARATSUBA_THRESHOLD) {
+        mul_basecase(r, x, xn, y, yn);
+    } else if (yn < TOOM3_THRESHOLD) {
+        u_long *ws = SCM_NEW_ATOMIC_ARRAY(u_long, karatsuba_scratch_size(xn));
+        mul_karatsuba(r, x, xn, y, yn, ws);
+    } else if (yn >= NTT_THRESHOLD && NTT_FITS(xn + yn)) {
+        mul_ntt(r, x, xn, y, yn);
+    } else if (yn <= 2*((xn+2)/3)) {
+        /* Unbalanced.  Multiply by yn-word pieces of x. */
+        u_long *t = SCM_NEW_ATOMIC_ARRAY(u_long, 2*yn);
+        mul_n(r, x, yn, y, yn);
+        for (int i=2*yn; i<xn+yn; i++) r[i] = 0;
+        for (int off = yn; off < xn; off += yn) {
+            int n = min(yn, xn - off);
+            mul_n(t, x+off, n, y, yn);
+            mul_acc(r+off, xn+yn-off, t, n+yn);
+        }
+    } else {
+        mul_toom3(r, x, xn, y, yn);
+    }
+}
+
+/*
+ * Dividing large bignums
+ *
+ *   When both the divisor and the quotient are long, we use the
+ *   recursive division of Burnikel and Ziegler.  It divides a 2n-word
+ *   number by an n-word number with two recursive divisions of half
+ *   the size plus two n/2 x n/2 multiplications, so its cost is a
+ *   small constant times that of mul_n.
+ *
+ *   Like mul_n, these routines work on raw word arrays.  Divisors
+ *   are normalized, i.e. the MSB of the top word is set.
+ */
+
+#define DIV_DC_THRESHOLD     60
+
+/* returns # of bits in the leftmost '1' in the word, counting from MSB. */
+static inline int div_normalization_factor(u_long w)
+{
+    u_long b = (1L<<(WORD_BITS-1)), c = 0;
+    for (; b > 0; b>>=1, c++) {
+        if (w & b) return c;
+    }
+    /* something got wrong here */
+    Scm_Panic("bignum.c: div_normalization_factor: can't be here");
+    return 0;                   /* dummy */
+}
+
+/* r[0..n) += 1.  Returns the carry. */
+static u_long div_incr(u_long *r, int n)
+{
+    for (int i=0; i<n; i++) {
+        if (++r[i] != 0) return 0;
+    }
+    return 1;
+}
+
+/* r[0..n) -= 1.  Returns the borrow. */
+static u_long div_decr(u_long *r, int n)
+{
+    for (int i=0; i<n; i++) {
+        if (r[i]-- != 0) return 0;
+    }
+    return 1;
+}
+
+/* r[0..n) -= x[0..n) * m.  Returns the high word of the product,
+   plus the borrow, which is yet to be subtracted from r[n]. */
+static u_long div_submul(u_long *r, const u_long *x, int n, u_long m)
+{
+    u_long c = 0;
+    for (int i=0; i<n; i++) {
+        u_long hi, lo, t;
+        UMUL(hi, lo, x[i], m);
+        /* x[i]*m + c fits in two words, and if its high word is
+           2^WORD_BITS-1 its low word is 0, so hi never overflows */
+        t = lo + c;    hi += (t < c);
+        lo = r[i] - t; hi += (lo > r[i]);
+        r[i] = lo;
+        c = hi;
+    }
+    return c;
+}
+
+/* Divides the double word (n1, n0) by d, where d is normalized and
+   n1 < d.  Returns the quotient and sets the remainder to *r.
+   We use half words as digits as bignum_gdiv does, so that we don't
+   need a double-word division. */
+static u_long div_2by1(u_long n1, u_long n0, u_long d, u_long *r)
+{
+    u_long d1 = HI(d), d0 = LO(d);
+    u_long q1 = n1 / d1, r1 = n1 - q1*d1, m = q1*d0;
+    r1 = (r1 << HALF_BITS) | HI(n0);
+    if (r1 < m) {
+        q1--; r1 += d;
+        if (r1 >= d && r1 < m) { q1--; r1 += d; } /* no overflow in r1 */
+    }
+    r1 -= m;
+
+    u_long q0 = r1 / d1, r0 = r1 - q0*d1;
+    m = q0*d0;
+    r0 = (r0 << HALF_BITS) | LO(n0);
+    if (r0 < m) {
+        q0--; r0 += d;
+        if (r0 >= d && r0 < m) { q0--; r0 += d; }
+    }
+    *r = r0 - m;
+    return (q1 << HALF_BITS) | q0;
+}
+
+/* Schoolbook division, Knuth's Algorithm D with full words.
+   Divides u[0..un) by the normalized v[0..vn), where un >= vn.
+   The quotient goes to q[0..un-vn), and the remainder is left in
+   u[0..vn); u[vn..un) becomes zero.  Returns the extra top word of
+   the quotient, which is 1 if the top vn words of u are not less
+   than v, and 0 otherwise. */
+static u_long div_basecase(u_long *q, u_long *u, int un,
+                           const u_long *v, int vn)
+{
+    u_long qh = 0, v1 = v[vn-1], v0 = (vn > 1)? v[vn-2] : 0;
+    int i;
+
+    for (i=vn-1; i>=0 && u[un-vn+i] == v[i]; i--)
+        ;
+    if (i < 0 || u[un-vn+i] > v[i]) {
+        mul_dec(u+un-vn, vn, v, vn);
+        qh = 1;
+    }
+
+    for (int j=un-vn-1; j>=0; j--) {
+        u_long u2 = u[j+vn], qq, rr;
+        if (u2 >= v1) {
+            /* u2 == v1.  qq is at most two too large. */
+            qq = ~0UL;
+        } else {
+            qq = div_2by1(u2, u[j+vn-1], v1, &rr);
+            while (vn > 1) {
+                u_long hi, lo;
+                UMUL(hi, lo, qq, v0);
+                if (hi < rr || (hi == rr && lo <= u[j+vn-2])) break;
+                qq--;
+                rr += v1;
+                if (rr < v1) break; /* rr >= 2^WORD_BITS */
+            }
+        }
+        u_long top = u2 - div_submul(u+j, v, vn, qq);
+        while ((long)top < 0) {
+            qq--;
+            top += mul_acc(u+j, vn, v, vn);
+        }
+        u[j+vn] = 0;
+        q[j] = qq;
+    }
+    return qh;
+}
+
+/* Divides a[0..2n) by the normalized d[0..n).  The quotient goes to
+   q[0..n) and the remainder is left in a[0..n); a[n..2n) becomes
+   zero.  Returns the top word of the quotient as div_basecase.
+   ws is the scratch area of n words. */
+static u_long div_dc(u_long *q, u_long *a, const u_long *d, int n,
+                     u_long *ws)
+{
+    if (n < DIV_DC_THRESHOLD) return div_basecase(q, a, 2*n, d, n);
+
+    int lo = n/2, hi = n - lo;
+    long top;
+
+    /* Estimate the upper half of the quotient, q[lo..n), with the upper
+       half of d.  The estimate can only be too large; the subtraction
+       of the rest of the product tells us how much. */
+    u_long qh = div_dc(q+lo, a+2*lo, d+lo, hi, ws);
+    mul_n(ws, q+lo, hi, d, lo);
+    top = -(long)mul_dec(a+lo, n, ws, n);
+    if (qh) top -= (long)mul_dec(a+n, lo, d, lo);
+    while (top < 0) {
+        top += (long)mul_acc(a+lo, n, d, n);
+        qh -= div_decr(q+lo, hi);
+    }
+
+    /* The lower half, q[0..lo), likewise. */
+    u_long ql = div_dc(q, a+hi, d+hi, lo, ws);
+    if (ql) qh += div_incr(q+lo, hi);
+    mul_n(ws, q, lo, d, hi);
+    top = -(long)mul_dec(a, n, ws, n);
+    if (ql) top -= (long)mul_dec(a+lo, hi, d, hi);
+    while (top < 0) {
+        top += (long)mul_acc(a, n, d, n);
+        qh -= div_decr(q, n);
+    }
+    return qh;
+}
+
+/* q[0..un-vn+1) = u[0..un) / v[0..vn), and r[0..vn) = u[0..un) % v[0..vn),
+   where un >= vn and v[vn-1] != 0.  v needn't be normalized. */
+static void div_qr(u_long *q, u_long *r, const u_long *u, int un,
+                   const u_long *v, int vn)
+{
+    int qn = un - vn + 1;
+
+    if (qn >= DIV_DC_THRESHOLD && qn + 1 < vn) {
+        /* The quotient is much shorter than the divisor.  Compute it
+           from the top words only, then fix it up by the full remainder.
+           The truncated divisor has qn+1 words, so the estimate is at
+           most two too large. */
+        int drop = vn - qn - 1;
+        u_long *w = SCM_NEW_ATOMIC_ARRAY(u_long, un + 1);
+        u_long *p = SCM_NEW_ATOMIC_ARRAY(u_long, qn + vn);
+        div_qr(q, w, u+drop, un-drop, v+drop, vn-drop);
+        mul_n(p, q, qn, v, vn);
+        for (int i=0; i<un; i++) w[i] = u[i];
+        w[un] = 0;
+        mul_dec(w, un+1, p, un+1);
+        while ((long)w[un] < 0) {
+            mul_acc(w, un+1, v, vn);
+            div_decr(q, qn);
+        }
+        for (int i=0; i<vn; i++) r[i] = w[i];
+        return;
+    }
+
+    /* Normalize */
+    int s = div_normalization_factor(v[vn-1]);
+    u_long *vv = SCM_NEW_ATOMIC_ARRAY(u_long, vn);
+    for (int i=vn-1; i>0; i--) {
+        vv[i] = s? ((v[i] << s) | (v[i-1] >> (WORD_BITS - s))) : v[i];
+    }
+    vv[0] = v[0] << s;
+
+    u_long *a = SCM_NEW_ATOMIC_ARRAY(u_long, un+1);
+    u_long *qq = SCM_NEW_ATOMIC_ARRAY(u_long, qn+1);
+    a[un] = s? (u[un-1] >> (WORD_BITS - s)) : 0;
+    for (int i=un-1; i>0; i--) {
+        a[i] = s? ((u[i] << s) | (u[i-1] >> (WORD_BITS - s))) : u[i];
+    }
+    a[0] = u[0] << s;
+
+    if (vn < DIV_DC_THRESHOLD || qn < DIV_DC_THRESHOLD) {
+        /* The top vn words of a is less than vv, so no extra word. */
+        (void)div_basecase(qq, a, un+1, vv, vn);
+    } else {
+        /* Divide the top n+t words first, so that the rest of a consists
+           of n-word blocks.  Then divide each block from the top,
+           carrying the remainder. */
+        int n = vn, k = (un+1-n) / n, t = (un+1-n) % n;
+        u_long *ws = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+        div_qr(qq + k*n, ws, a + k*n, n+t, vv, n);
+        for (int i=0; i<n; i++) a[k*n+i] = ws[i];
+        for (int i=k*n+n; i<=un; i++) a[i] = 0;
+        for (int i=k-1; i>=0; i--) {
+            (void)div_dc(qq + i*n, a + i*n, vv, n, ws);
+        }
+    }
+    for (int i=0; i<qn; i++) q[i] = qq[i];
+    for (int i=0; i<vn-1; i++) {
+        r[i] = s? ((a[i] >> s) | (a[i+1] << (WORD_BITS - s))) : a[i];
+    }
+    r[vn-1] = a[vn-1] >> s;
+}
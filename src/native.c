@@ -616,6 +616,21 @@ ScmObj Scm__AllocateCodePage(ScmU8Vector *code)
     return SCM_OBJ(xpad);
 }
 
+/* Slow paths called from JIT-generated code, when the inlined fast path
+   can't handle the argument.  They raise the same error as the VM
+   instructions do. */
+ScmObj Scm__JITCar(ScmObj obj)
+{
+    if (!SCM_PAIRP(obj)) SCM_TYPE_ERROR(obj, "pair");
+    return SCM_CAR(obj);
+}
+
+ScmObj Scm__JITCdr(ScmObj obj)
+{
+    if (!SCM_PAIRP(obj)) SCM_TYPE_ERROR(obj, "pair");
+    return SCM_CDR(obj);
+}
+
 
 /*======================================================================
  * Initialization
@@ -3891,6 +3891,8 @@ static double raise_pow10(double x, int n)
  * This version implements Burger&Dybvig algorithm (Robert G. Burger
  * and and R. Kent Dybvig, "Priting Floating-Point Numbers Quickly and
  * Accurately", PLDI '96, pp.108--116, 1996).
+ * When no precision is specified, we take a shortcut with Ryu; see
+ * print_double_shortest.
  */
 
 /* print a hexadecimal floating-point number. We don't need conversion
@@ -4040,6 +4042,335 @@ static void spill_fixup(ScmDString *ds, int numstart)
     Scm_DStringPutz(ds, nbuf, -1);
 }
 
+/*
+ * Shortest representation
+ *
+ * For the common case---we want the shortest digits that read back to
+ * the same flonum---we use Ryu (Ulf Adams, "Ryu: Fast Float-to-String
+ * Conversion", PLDI '18, pp.270--282, 2018), which needs only a few
+ * 64x64->128 bit multiplications and no allocation.  It yields the same
+ * digits as Burger&Dybvig's free-format algorithm: the shortest digits
+ * within the rounding interval, and the closest to VAL among them.
+ * The interval includes its boundaries iff the mantissa is even.
+ * When VAL is exactly halfway between two candidates we choose the
+ * same one as print_double below does.
+ *
+ * The tables of 5^i and 2^k/5^i, scaled to 125 bits, are computed
+ * at initialization.
+ */
+
+#define RYU_POW5_BITS       125
+#define RYU_POW5_TABLE_SIZE 326   /* 5^i for i up to 325 */
+#define RYU_POW5_INV_TABLE_SIZE 292 /* 2^k/5^i for i up to 291 */
+
+static uint64_t ryu_pow5_split[RYU_POW5_TABLE_SIZE][2];
+static uint64_t ryu_pow5_inv_split[RYU_POW5_INV_TABLE_SIZE][2];
+
+/* Extracts 128 bits from a bignum W (little-endian array of NW 32-bit
+   words) starting from bit position SHIFT, and stores them into R
+   (R[0] is lower 64 bits).  SHIFT may be negative. */
+static void ryu_extract128(const uint32_t *w, int nw, int shift, uint64_t r[2])
+{
+    uint32_t z[4];
+    for (int i=0; i<4; i++) {
+        int b = shift + i*32;   /* bit position of the lowest bit */
+        int k = (b >= 0)? b/32 : -((-b+31)/32);
+        int o = b - k*32;       /* 0 <= o < 32 */
+        uint32_t lo = (k >= 0 && k < nw)? w[k] : 0;
+        uint32_t hi = (k+1 >= 0 && k+1 < nw)? w[k+1] : 0;
+        z[i] = o? ((lo >> o) | (hi << (32-o))) : lo;
+    }
+    r[0] = ((uint64_t)z[1] << 32) | z[0];
+    r[1] = ((uint64_t)z[3] << 32) | z[2];
+}
+
+static int ryu_bitlength(const uint32_t *w, int nw)
+{
+    while (nw > 0 && w[nw-1] == 0) nw--;
+    if (nw == 0) return 0;
+    int n = (nw-1)*32;
+    for (uint32_t top = w[nw-1]; top; top >>= 1) n++;
+    return n;
+}
+
+static void ryu_init_tables(void)
+{
+    /* P = 5^i, X = floor(2^XBITS / 5^i).  We need XBITS at least
+       log2(5^291) + RYU_POW5_BITS. */
+#define RYU_PWORDS 24
+#define RYU_XWORDS 27
+#define RYU_XBITS  (RYU_XWORDS*32-1)
+    uint32_t p[RYU_PWORDS], x[RYU_XWORDS];
+    memset(p, 0, sizeof(p));
+    memset(x, 0, sizeof(x));
+    p[0] = 1;
+    x[RYU_XWORDS-1] = 1U << 31;
+
+    for (int i=0; i<RYU_POW5_TABLE_SIZE; i++) {
+        int len = ryu_bitlength(p, RYU_PWORDS);
+        ryu_extract128(p, RYU_PWORDS, len - RYU_POW5_BITS,
+                       ryu_pow5_split[i]);
+        if (i < RYU_POW5_INV_TABLE_SIZE) {
+            uint64_t *v = ryu_pow5_inv_split[i];
+            ryu_extract128(x, RYU_XWORDS,
+                           RYU_XBITS - (len - 1 + RYU_POW5_BITS), v);
+            if (++v[0] == 0) v[1]++;
+        }
+        /* P *= 5, X /= 5 */
+        uint64_t c = 0;
+        for (int k=0; k<RYU_PWORDS; k++) {
+            c += (uint64_t)p[k] * 5;
+            p[k] = (uint32_t)c;
+            c >>= 32;
+        }
+        uint64_t r = 0;
+        for (int k=RYU_XWORDS-1; k>=0; k--) {
+            r = (r << 32) | x[k];
+            x[k] = (uint32_t)(r / 5);
+            r %= 5;
+        }
+    }
+#undef RYU_PWORDS
+#undef RYU_XWORDS
+#undef RYU_XBITS
+}
+
+/* floor(log2(5^e))+1 for e > 0, 1 for e == 0; valid for 0 <= e <= 3528 */
+static inline int ryu_pow5bits(int e)
+{
+    return (int)((((uint32_t)e) * 1217359) >> 19) + 1;
+}
+
+/* floor(log10(2^e)); valid for 0 <= e <= 1650 */
+static inline int ryu_log10pow2(int e)
+{
+    return (int)((((uint32_t)e) * 78913) >> 18);
+}
+
+/* floor(log10(5^e)); valid for 0 <= e <= 2620 */
+static inline int ryu_log10pow5(int e)
+{
+    return (int)((((uint32_t)e) * 732923) >> 20);
+}
+
+static inline int ryu_multiple_of_pow5(uint64_t v, int p)
+{
+    int count = 0;
+    while (v % 5 == 0) {
+        v /= 5;
+        count++;
+    }
+    return count >= p;
+}
+
+static inline int ryu_multiple_of_pow2(uint64_t v, int p)
+{
+    return (v & ((UINT64_C(1) << p) - 1)) == 0;
+}
+
+/* Returns lower 64 bits of A*B, and stores higher 64 bits in *HI. */
+static inline uint64_t umul64(uint64_t a, uint64_t b, uint64_t *hi)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 p = (unsigned __int128)a * b;
+    *hi = (uint64_t)(p >> 64);
+    return (uint64_t)p;
+#else  /*!defined(__SIZEOF_INT128__)*/
+    uint64_t a0 = a & 0xffffffffU, a1 = a >> 32;
+    uint64_t b0 = b & 0xffffffffU, b1 = b >> 32;
+    uint64_t t00 = a0*b0, t01 = a0*b1, t10 = a1*b0, t11 = a1*b1;
+    uint64_t mid = (t00 >> 32) + (t01 & 0xffffffffU) + (t10 & 0xffffffffU);
+    *hi = t11 + (t01 >> 32) + (t10 >> 32) + (mid >> 32);
+    return (mid << 32) | (t00 & 0xffffffffU);
+#endif /*!defined(__SIZEOF_INT128__)*/
+}
+
+/* (M * MUL) >> J, where MUL is 128bit and 64 < J < 128. */
+static inline uint64_t ryu_mulshift(uint64_t m, const uint64_t mul[2], int j)
+{
+    uint64_t hi0, hi1;
+    (void)umul64(m, mul[0], &hi0);
+    uint64_t lo1 = umul64(m, mul[1], &hi1);
+    uint64_t sum = hi0 + lo1;
+    if (sum < hi0) hi1++;
+    return (hi1 << (128 - j)) | (sum >> (j - 64));
+}
+
+/* Finds the shortest decimal digits of a positive finite double,
+   given its IEEE754 exponent and mantissa fields.  Returns the digits
+   as an integer, and sets the decimal exponent to *E10, i.e. the
+   value is RETURN_VALUE * 10^(*E10). */
+static uint64_t ryu_shortest(uint64_t ieee_mant, int ieee_exp, int *e10)
+{
+    int e2;
+    uint64_t m2;
+    if (ieee_exp == 0) {
+        e2 = 1 - 1023 - 52 - 2;
+        m2 = ieee_mant;
+    } else {
+        e2 = ieee_exp - 1023 - 52 - 2;
+        m2 = (UINT64_C(1) << 52) | ieee_mant;
+    }
+    int accept_bounds = (m2 & 1) == 0;
+
+    /* The interval of valid representations is [mv-mmshift-1, mv+2]*2^e2,
+       scaled by 4 so that all bounds are integers.  The lower bound
+       is closer if VAL is a power of 2 (except the smallest
+       normalized number). */
+    uint64_t mv = 4 * m2;
+    int mmshift = (ieee_mant != 0 || ieee_exp <= 1);
+
+    uint64_t vr, vp, vm;
+    int vm_trailing_zeros = FALSE, vr_trailing_zeros = FALSE;
+    if (e2 >= 0) {
+        int q = ryu_log10pow2(e2) - (e2 > 3);
+        int k = RYU_POW5_BITS + ryu_pow5bits(q) - 1;
+        int i = -e2 + q + k;
+        *e10 = q;
+        vr = ryu_mulshift(mv, ryu_pow5_inv_split[q], i);
+        vp = ryu_mulshift(mv + 2, ryu_pow5_inv_split[q], i);
+        vm = ryu_mulshift(mv - 1 - mmshift, ryu_pow5_inv_split[q], i);
+        if (q <= 21) {
+            /* Only one of mp, mv, and mm can be a multiple of 5, if any. */
+            if (mv % 5 == 0) {
+                vr_trailing_zeros = ryu_multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_trailing_zeros = ryu_multiple_of_pow5(mv - 1 - mmshift, q);
+            } else {
+                vp -= ryu_multiple_of_pow5(mv + 2, q);
+            }
+        }
+    } else {
+        int q = ryu_log10pow5(-e2) - (-e2 > 1);
+        int i = -e2 - q;
+        int k = ryu_pow5bits(i) - RYU_POW5_BITS;
+        int j = q - k;
+        *e10 = q + e2;
+        vr = ryu_mulshift(mv, ryu_pow5_split[i], j);
+        vp = ryu_mulshift(mv + 2, ryu_pow5_split[i], j);
+        vm = ryu_mulshift(mv - 1 - mmshift, ryu_pow5_split[i], j);
+        if (q <= 1) {
+            /* mv has at least q trailing zero bits, and so do mp and mm. */
+            vr_trailing_zeros = TRUE;
+            if (accept_bounds) {
+                vm_trailing_zeros = (mmshift == 1);
+            } else {
+                vp--;
+            }
+        } else if (q < 63) {
+            vr_trailing_zeros = ryu_multiple_of_pow2(mv, q);
+        }
+    }
+
+    /* Remove digits while the interval still contains a candidate. */
+    int removed = 0;
+    int last_digit = 0;
+    uint64_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        /* Rare case; we need to track whether the removed digits
+           are all zeros to handle the boundaries and ties. */
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= (vm % 10 == 0);
+            vr_trailing_zeros &= (last_digit == 0);
+            last_digit = (int)(vr % 10);
+            vr /= 10; vp /= 10; vm /= 10;
+            removed++;
+        }
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= (last_digit == 0);
+                last_digit = (int)(vr % 10);
+                vr /= 10; vp /= 10; vm /= 10;
+                removed++;
+            }
+        }
+        if (vr_trailing_zeros && last_digit == 5 && accept_bounds) {
+            /* Exactly halfway; print_double rounds down when the
+               mantissa is even. */
+            last_digit = 4;
+        }
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros))
+                       || last_digit >= 5);
+    } else {
+        int round_up = FALSE;
+        if (vp / 100 > vm / 100) {
+            round_up = (vr % 100 >= 50);
+            vr /= 100; vp /= 100; vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = (vr % 10 >= 5);
+            vr /= 10; vp /= 10; vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+    *e10 += removed;
+    return output;
+}
+
+/* Prints positive finite VAL in shortest representation, the same way
+   as print_double does when precision isn't specified. */
+static void print_double_shortest(ScmDString *ds, double val,
+                                  const ScmNumberFormat *fmt)
+{
+    u_long mant1 = 0, mant0 = 0;
+    int ieee_exp, ieee_sign;
+    decode_double(val, &mant1, &mant0, &ieee_exp, &ieee_sign);
+#if SIZEOF_LONG >= 8
+    uint64_t ieee_mant = mant0;
+#else  /*SIZEOF_LONG < 8*/
+    uint64_t ieee_mant = ((uint64_t)mant0 << 32) | mant1;
+#endif /*SIZEOF_LONG < 8*/
+
+    int e10;
+    uint64_t digits = ryu_shortest(ieee_mant, ieee_exp, &e10);
+
+    char dbuf[20];              /* at most 17 digits */
+    int ndigs = 0;
+    for (char *p = dbuf + sizeof(dbuf); digits > 0; digits /= 10, ndigs++) {
+        *--p = (char)('0' + digits % 10);
+    }
+    const char *d = dbuf + sizeof(dbuf) - ndigs;
+
+    /* EST and POINT have the same meanings as in print_double. */
+    int est = ndigs + e10;
+    int point = 1;
+    int need_exp = TRUE;
+    if (est < fmt->exp_hi && est > fmt->exp_lo) {
+        point = est; est = 1; need_exp = FALSE;
+    }
+
+    if (point <= 0) {
+        Scm_DStringPutz(ds, "0.", 2);
+        for (int i=point; i<0; i++) SCM_DSTRING_PUTC(ds, '0');
+        Scm_DStringPutz(ds, d, ndigs);
+    } else if (ndigs <= point) {
+        Scm_DStringPutz(ds, d, ndigs);
+        for (int i=ndigs; i<point; i++) SCM_DSTRING_PUTC(ds, '0');
+        Scm_DStringPutz(ds, ".0", 2);
+    } else {
+        Scm_DStringPutz(ds, d, point);
+        SCM_DSTRING_PUTC(ds, '.');
+        Scm_DStringPutz(ds, d+point, ndigs-point);
+    }
+
+    est--;
+    if (est != 0 || need_exp) {
+        SCM_DSTRING_PUTC(ds, fmt->exp_char? fmt->exp_char : 'e');
+        if (est < 0) {
+            SCM_DSTRING_PUTC(ds, '-');
+            est = -est;
+        }
+        char zbuf[5];
+        int echars = snprintf(zbuf, sizeof(zbuf), "%d", est);
+        for (int fill = fmt->exp_width - echars; fill > 0; fill--) {
+            SCM_DSTRING_PUTC(ds, '0');
+        }
+        Scm_DStringPutz(ds, zbuf, echars);
+    }
+}
+
 /* The main routine to get string representation of double.
    Convert VAL to a string and store to BUF, which must have at least FLT_BUF
    bytes long.
@@ -4090,6 +4421,12 @@ static void print_double(ScmDString *ds, double val, int plus_sign,
     if (val < 0.0) SCM_DSTRING_PUTC(ds, '-');
     else if (plus_sign) SCM_DSTRING_PUTC(ds, '+');
 
+    /* The common case.  No need of bignums. */
+    if (precision < 0) {
+        print_double_shortest(ds, (val < 0.0)? -val : val, fmt);
+        return;
+    }
+
     int numstart = Scm_DStringSize(ds); /* remember this for notational rounding */
 
     /* variable names follows Burger&Dybvig paper. mp, mm for m+, m-.
@@ -4622,6 +4959,11 @@ static ScmObj read_uint(const char **strp, int *lenp,
     u_long limit = longlimit[radix-SCM_RADIX_MIN], bdig = bigdig[radix-SCM_RADIX_MIN];
     u_long value_int = 0;
     ScmBignum *value_big = NULL;
+    /* Big digits following value_big.  We accumulate them and add them
+       up at once, which is much faster than doing so one by one when
+       there are many of them. */
+    u_long chunkbuf[16], *chunks = chunkbuf;
+    int nchunks = 0, chunks_size = 16;
     static const char tab[] = "0123456789abcdefghijklmnopqrstuvwxyz";
 
     if (!SCM_FALSEP(initval)) {
@@ -4684,7 +5026,13 @@ static ScmObj read_uint(const char **strp, int *lenp,
                 value_int = digits = 0;
             }
         } else if (digits > diglimit) {
-            value_big = Scm_BignumAccMultAddUI(value_big, bdig, value_int);
+            if (nchunks == chunks_size) {
+                u_long *p = SCM_NEW_ATOMIC_ARRAY(u_long, chunks_size*2);
+                memcpy(p, chunks, sizeof(u_long)*nchunks);
+                chunks = p;
+                chunks_size *= 2;
+            }
+            chunks[nchunks++] = value_int;
             value_int = digits = 0;
         }
     }
@@ -4701,6 +5049,10 @@ static ScmObj read_uint(const char **strp, int *lenp,
         return SCM_FALSE;       /* caller will handle this */
     }
     if (value_big == NULL) return Scm_MakeInteger(value_int);
+    if (nchunks > 0) {
+        value_big = Scm_BignumAccMultAddChunks(value_big, bdig,
+                                               chunks, nchunks);
+    }
     if (digits > 0) {
         value_big = Scm_BignumAccMultAddUI(value_big,
                                            ipow(radix, digits),
@@ -4709,6 +5061,136 @@ static ScmObj read_uint(const char **strp, int *lenp,
     return Scm_NormalizeBignum(SCM_BIGNUM(value_big));
 }
 
+/*
+ * Fast path of decimal->double conversion
+ *
+ * Most decimal numbers we read have no more than 19 significant digits
+ * and a moderate exponent.  For them we use Eisel-Lemire algorithm
+ * (Daniel Lemire, "Number Parsing at a Gigabyte per Second",
+ * Software: Practice and Experience 51(8), 2021), which multiplies the
+ * digits by a 128-bit approximation of 10^e and can tell whether
+ * the result is correctly rounded.  It gives up on the rare ambiguous
+ * cases, as well as subnormals and overflow, and we fall back to
+ * algorithmR for them.
+ *
+ * The table holds the 128-bit mantissa of 5^e (which is the same as
+ * 10^e's), truncated, for LEMIRE_MIN_EXP10 <= e <= LEMIRE_MAX_EXP10.
+ * It is computed at initialization.
+ */
+
+#define LEMIRE_MIN_EXP10  (-348)
+#define LEMIRE_MAX_EXP10  347
+
+static uint64_t lemire_pow5[LEMIRE_MAX_EXP10 - LEMIRE_MIN_EXP10 + 1][2];
+
+static void lemire_init_tables(void)
+{
+    /* P = 5^i, X = floor(2^XBITS / 5^i).  We need XBITS at least
+       log2(5^348) + 128. */
+#define LEMIRE_PWORDS 26
+#define LEMIRE_XWORDS 30
+#define LEMIRE_XBITS  (LEMIRE_XWORDS*32-1)
+    uint32_t p[LEMIRE_PWORDS], x[LEMIRE_XWORDS];
+    memset(p, 0, sizeof(p));
+    memset(x, 0, sizeof(x));
+    p[0] = 1;
+    x[LEMIRE_XWORDS-1] = 1U << 31;
+
+    for (int i=0; i<=-LEMIRE_MIN_EXP10; i++) {
+        int len = ryu_bitlength(p, LEMIRE_PWORDS);
+        if (i <= LEMIRE_MAX_EXP10) {
+            ryu_extract128(p, LEMIRE_PWORDS, len - 128,
+                           lemire_pow5[i - LEMIRE_MIN_EXP10]);
+        }
+        if (i > 0) {
+            /* 2^(127+len)/5^i is in [2^127, 2^128). */
+            ryu_extract128(x, LEMIRE_XWORDS, LEMIRE_XBITS - 127 - len,
+                           lemire_pow5[-i - LEMIRE_MIN_EXP10]);
+        }
+        /* P *= 5, X /= 5 */
+        uint64_t c = 0;
+        for (int k=0; k<LEMIRE_PWORDS; k++) {
+            c += (uint64_t)p[k] * 5;
+            p[k] = (uint32_t)c;
+            c >>= 32;
+        }
+        uint64_t r = 0;
+        for (int k=LEMIRE_XWORDS-1; k>=0; k--) {
+            r = (r << 32) | x[k];
+            x[k] = (uint32_t)(r / 5);
+            r %= 5;
+        }
+    }
+#undef LEMIRE_PWORDS
+#undef LEMIRE_XWORDS
+#undef LEMIRE_XBITS
+}
+
+static inline int clz64(uint64_t w)
+{
+#if defined(__GNUC__)
+    return __builtin_clzll(w);
+#else
+    int n = 0;
+    for (; !(w & (UINT64_C(1) << 63)); w <<= 1) n++;
+    return n;
+#endif
+}
+
+/* Try to compute the double closest to W * 10^E10.  Returns TRUE and
+   sets *R on success.  Returns FALSE if we can't determine the result
+   cheaply. */
+static int eisel_lemire(uint64_t w, int e10, double *r)
+{
+    if (w == 0) {
+        *r = 0.0;
+        return TRUE;
+    }
+    if (e10 < LEMIRE_MIN_EXP10 || e10 > LEMIRE_MAX_EXP10) return FALSE;
+
+    const uint64_t *pow5 = lemire_pow5[e10 - LEMIRE_MIN_EXP10];
+    int lz = clz64(w);
+    w <<= lz;
+    /* 217706/2^16 approximates log2(10) */
+    int64_t e2 = ((217706 * (int64_t)e10) >> 16) + 64 + 1023 - lz;
+
+    uint64_t xhi;
+    uint64_t xlo = umul64(w, pow5[1], &xhi);
+    if ((xhi & 0x1ff) == 0x1ff && xlo + w < xlo) {
+        /* The truncated lower bits may carry into the bits we need.
+           Take the lower half of the table into account. */
+        uint64_t yhi;
+        uint64_t ylo = umul64(w, pow5[0], &yhi);
+        uint64_t mhi = xhi, mlo = xlo + yhi;
+        if (mlo < xlo) mhi++;
+        if ((mhi & 0x1ff) == 0x1ff && mlo + 1 == 0 && ylo + w < ylo) {
+            return FALSE;
+        }
+        xhi = mhi;
+        xlo = mlo;
+    }
+
+    /* Get 54 bits, then round to 53 bits. */
+    int msb = (int)(xhi >> 63);
+    uint64_t m = xhi >> (msb + 9);
+    e2 -= 1 ^ msb;
+    if (xlo == 0 && (xhi & 0x1ff) == 0 && (m & 3) == 1) {
+        return FALSE;           /* exactly halfway; can't tell */
+    }
+    m += m & 1;
+    m >>= 1;
+    if (m >> 53) {
+        m >>= 1;
+        e2++;
+    }
+    if (e2 <= 0 || e2 >= 0x7ff) return FALSE; /* subnormal or overflow */
+
+    *r = Scm__EncodeDouble((u_long)(m & ((UINT64_C(1) << 52) - 1)),
+                           (u_long)((m >> 32) & 0xfffff),
+                           (int)e2, 0);
+    return TRUE;
+}
+
 /*
  * Find a double number closest to f * 10^e, using z as the starting
  * approximation.  The algorithm (and its name) is taken from Will Clinger's
@@ -5225,6 +5707,17 @@ static ScmObj read_real(const char **strp, int *lenp,
        AlgorithmR.  We have to be careful, however, not to overflow
        the following GetDouble call. */
     int raise_factor = exponent - fracdigs;
+
+    /* Try the fast path first. */
+    if (SCM_INTEGERP(fraction)) {
+        int oor = FALSE;
+        uint64_t w = Scm_GetIntegerU64Clamp(fraction, SCM_CLAMP_NONE, &oor);
+        double d;
+        if (!oor && eisel_lemire(w, raise_factor, &d)) {
+            return Scm_MakeFlonum(minusp? -d : d);
+        }
+    }
+
     double realnum = Scm_GetDouble(fraction);
 
     if (SCM_IS_INF(realnum)) {
@@ -5486,6 +5979,9 @@ void Scm__InitNumber(void)
         }
     }
 
+    ryu_init_tables();
+    lemire_init_tables();
+
     SCM_2_63 = Scm_Ash(SCM_MAKE_INT(1), 63);
     SCM_2_64 = Scm_Ash(SCM_MAKE_INT(1), 64);
     SCM_2_64_MINUS_1 = Scm_Sub(SCM_2_64, SCM_MAKE_INT(1));
@@ -31,6 +31,10 @@
  *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* This is needed before including features.h first time, in order
+   to get splice() and copy_file_range() */
+#define _GNU_SOURCE
+
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/priv/configP.h"
@@ -41,6 +45,16 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <ctype.h>
+#if defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#endif
+#if !defined(GAUCHE_WINDOWS)
+#include <sys/uio.h>
+#include <limits.h>
+#if !defined(IOV_MAX)
+#define IOV_MAX 16              /* the minimum POSIX requires */
+#endif
+#endif /*!GAUCHE_WINDOWS*/
 
 #undef MAX
 #undef MIN
@@ -81,6 +95,9 @@ static void bufport_flush(ScmPort*, ScmSize, int);
 static void file_closer(ScmPort *p);
 static int  file_buffered_port_p(ScmPort *p);       /* for Scm_PortFdDup */
 static void file_buffered_port_set_fd(ScmPort *p, int fd); /* ditto */
+#if !defined(GAUCHE_WINDOWS)
+static void file_writev(ScmPort *p, const ScmIOVec *iov, ScmSize count);
+#endif
 
 /* Returns an appropripate basic port class according to the direciton */
 static ScmClass *port_class_from_direction(int direction)
@@ -1156,6 +1173,17 @@ static void bufport_flush(ScmPort *p, ScmSize cnt, int forcep)
    the port's buffer.  Won't return until entire siz bytes are written. */
 static void bufport_write(ScmPort *p, const char *src, ScmSize siz)
 {
+#if !defined(GAUCHE_WINDOWS)
+    /* If we have a chunk larger than the buffer, we write it out together
+       with the buffered data, without copying it into the buffer. */
+    if (siz >= PORT_BUF(p)->size && file_buffered_port_p(p)) {
+        ScmIOVec iov;
+        iov.data = src;
+        iov.size = siz;
+        file_writev(p, &iov, 1);
+        return;
+    }
+#endif /*!GAUCHE_WINDOWS*/
     do {
         ScmSize room = PORT_BUF(p)->end - PORT_BUF(p)->current;
         if (room >= siz) {
@@ -1172,6 +1200,24 @@ static void bufport_write(ScmPort *p, const char *src, ScmSize siz)
     } while (siz != 0);
 }
 
+/* Writes COUNT pieces of data in IOV to the buffered port.  If the port
+   is directly connected to a file descriptor and the data is large,
+   we pass the buffered data and the pieces to writev() at once. */
+static void bufport_writev(ScmPort *p, const ScmIOVec *iov, ScmSize count)
+{
+#if !defined(GAUCHE_WINDOWS)
+    ScmSize total = 0;
+    for (ScmSize i = 0; i < count; i++) total += iov[i].size;
+    if (total >= PORT_BUF(p)->size && file_buffered_port_p(p)) {
+        file_writev(p, iov, count);
+        return;
+    }
+#endif /*!GAUCHE_WINDOWS*/
+    for (ScmSize i = 0; i < count; i++) {
+        if (iov[i].size > 0) bufport_write(p, iov[i].data, iov[i].size);
+    }
+}
+
 /* Fills the buffer.  Reads at least MIN bytes (unless it reaches EOF).
  * If ALLOW_LESS is true, however, we allow to return before the full
  * data is read.
@@ -1460,6 +1506,190 @@ ScmObj Scm_GetBufferingMode(ScmPort *port)
 #undef SAFE_PORT_OP
 #include "portapi.c"
 
+/*===============================================================
+ * Direct access to the input buffer
+ */
+
+/* Returns a pointer to the bytes that can be read from an input port P
+   without further I/O, and sets their count to *SIZE.  The caller can
+   scan them directly, then tell how many bytes are consumed by
+   Scm_PortCommitBufferUnsafe.  The bytes must not be modified.
+   If no bytes are available and FILLP is TRUE, more data is read from
+   the source; if *SIZE is still 0, the port is at EOF.  An EOF seen
+   by a previous peek is reported in the same way, regardless of FILLP.
+   Returns NULL if the port doesn't allow direct access (procedural
+   ports); the caller should fall back to Scm_Getc etc.
+
+   The caller must hold the lock of P, and the returned view is only
+   valid until the next operation on P. */
+const char *Scm_PortBorrowBufferUnsafe(ScmPort *p, ScmSize *size, int fillp)
+{
+    if (!SCM_IPORTP(p)) {
+        Scm_Error("input port required, but got %S", p);
+    }
+    if (SCM_PORT_CLOSED_P(p)) {
+        Scm_PortError(p, SCM_PORT_ERROR_CLOSED,
+                      "I/O attempted on closed port: %S", p);
+    }
+    if (SCM_PORT_TYPE(p) != SCM_PORT_FILE
+        && SCM_PORT_TYPE(p) != SCM_PORT_ISTR) {
+        return NULL;
+    }
+    flush_linked_port(p);
+
+    /* The ungotten character or the peeked bytes come first. */
+    if (p->scrcnt == 0 && PORT_UNGOTTEN(p) != SCM_CHAR_INVALID) {
+        if (PORT_UNGOTTEN(p) == EOF) {
+            /* Peek has seen EOF.  Report it once, as Scm_Getb does. */
+            PORT_UNGOTTEN(p) = SCM_CHAR_INVALID;
+            *size = 0;
+            return PORT_SCRATCH(p);
+        }
+        p->scrcnt = SCM_CHAR_NBYTES(PORT_UNGOTTEN(p));
+        SCM_CHAR_PUT(PORT_SCRATCH(p), PORT_UNGOTTEN(p));
+        PORT_UNGOTTEN(p) = SCM_CHAR_INVALID;
+    }
+    if (p->scrcnt > 0) {
+        *size = p->scrcnt;
+        return PORT_SCRATCH(p);
+    }
+
+    if (SCM_PORT_TYPE(p) == SCM_PORT_FILE) {
+        if (PORT_BUF(p)->current >= PORT_BUF(p)->end && fillp) {
+            bufport_fill(p, 1, TRUE);
+        }
+        *size = PORT_BUF(p)->end - PORT_BUF(p)->current;
+        return PORT_BUF(p)->current;
+    } else {
+        *size = PORT_ISTR(p)->end - PORT_ISTR(p)->current;
+        return PORT_ISTR(p)->current;
+    }
+}
+
+/* Consumes the first N bytes of the view returned by the last
+   Scm_PortBorrowBufferUnsafe. */
+void Scm_PortCommitBufferUnsafe(ScmPort *p, ScmSize n)
+{
+    const char *start;
+
+    if (n <= 0) return;
+    if (p->scrcnt > 0) {
+        /* These bytes are already counted when they're read. */
+        SCM_ASSERT(n <= (ScmSize)p->scrcnt);
+        p->scrcnt -= n;
+        shift_scratch(p, n);
+        return;
+    }
+    switch (SCM_PORT_TYPE(p)) {
+    case SCM_PORT_FILE:
+        SCM_ASSERT(n <= PORT_BUF(p)->end - PORT_BUF(p)->current);
+        start = PORT_BUF(p)->current;
+        PORT_BUF(p)->current += n;
+        break;
+    case SCM_PORT_ISTR:
+        SCM_ASSERT(n <= PORT_ISTR(p)->end - PORT_ISTR(p)->current);
+        start = PORT_ISTR(p)->current;
+        PORT_ISTR(p)->current += n;
+        break;
+    default:
+        Scm_Error("port doesn't allow direct buffer access: %S", p);
+        return;                 /* dummy */
+    }
+    PORT_BYTES(p) += n;
+    const char *nl = memchr(start, '\n', n);
+    if (nl) {
+        do {
+            PORT_LINE(p)++;
+            nl = memchr(nl+1, '\n', start + n - nl - 1);
+        } while (nl);
+        reset_linked_column(p);
+    }
+}
+
+/* Should we stop reading at CH? */
+static inline int span_stop_p(ScmCharSet *cs, int until, ScmChar ch)
+{
+    if (cs == NULL) return FALSE;
+    return until ? Scm_CharSetContains(cs, ch) : !Scm_CharSetContains(cs, ch);
+}
+
+/* Body of Scm_ReadSpan.  Returns TRUE iff it reached EOF. */
+static int read_span(ScmPort *p, ScmCharSet *cs, int until, ScmSize limit,
+                     ScmDString *ds)
+{
+    ScmSize nchars = 0;
+
+    while (limit < 0 || nchars < limit) {
+        ScmSize size = 0;
+        const char *buf = Scm_PortBorrowBufferUnsafe(p, &size, TRUE);
+        if (buf == NULL) {
+            /* Procedural port.  We go one char at a time. */
+            for (; limit < 0 || nchars < limit; nchars++) {
+                ScmChar ch = (cs == NULL)? Scm_GetcUnsafe(p) : Scm_PeekcUnsafe(p);
+                if (ch == EOF) return TRUE;
+                if (span_stop_p(cs, until, ch)) return FALSE;
+                if (cs != NULL) Scm_GetcUnsafe(p);
+                Scm_DStringPutc(ds, ch);
+            }
+            return FALSE;
+        }
+        if (size == 0) return TRUE;
+
+        ScmSize i = 0;
+        int stop = FALSE;
+        while (i < size && (limit < 0 || nchars < limit)) {
+            int nb = SCM_CHAR_NFOLLOWS(buf[i]) + 1;
+            if (i + nb > size) break; /* incomplete char */
+            ScmChar ch;
+            SCM_CHAR_GET(buf+i, ch);
+            if (ch == SCM_CHAR_INVALID) {
+                /* Stray byte.  See getc_scratch. */
+                ch = (ScmChar)(buf[i] & 0xff);
+                nb = 1;
+            }
+            if (span_stop_p(cs, until, ch)) {
+                stop = TRUE;
+                break;
+            }
+            i += nb;
+            nchars++;
+        }
+        Scm_DStringPutz(ds, buf, i);
+        Scm_PortCommitBufferUnsafe(p, i);
+        if (stop) return FALSE;
+        if (i < size && (limit < 0 || nchars < limit)) {
+            /* A multibyte char straddles the end of the buffer.  Peeking
+               makes it available as a whole on the next borrowing. */
+            if (Scm_PeekcUnsafe(p) == EOF) return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Reads characters from P as long as they're not in CS if UNTIL is TRUE,
+   or as long as they're in CS if UNTIL is FALSE, up to LIMIT characters
+   if LIMIT isn't negative.  CS can be NULL, in which case characters are
+   read up to LIMIT.  The character that stops reading is left in P.
+   Returns the characters read as a string.  If P is at EOF and no
+   character is read, returns EOF.
+
+   This scans the port's buffer directly, avoiding per-character
+   overhead of Scm_Getc. */
+ScmObj Scm_ReadSpan(ScmPort *p, ScmCharSet *cs, int until, ScmSize limit)
+{
+    ScmVM *vm = Scm_VM();
+    ScmDString ds;
+    volatile int eof = FALSE;
+
+    if (limit == 0) return SCM_MAKE_STR("");
+    Scm_DStringInit(&ds);
+    PORT_LOCK(p, vm);
+    PORT_SAFE_CALL(p, eof = read_span(p, cs, until, limit, &ds), /*no cleanup*/);
+    PORT_UNLOCK(p);
+    if (eof && Scm_DStringSize(&ds) == 0) return SCM_EOF;
+    return Scm_DStringGet(&ds, 0);
+}
+
 /*===============================================================
  * File Port
  */
@@ -1492,6 +1722,21 @@ static ScmSize file_filler(ScmPort *p, ScmSize cnt)
     return nread;
 }
 
+static void file_write_error(ScmPort *p)
+{
+    if (errno == EPIPE && PORT_BUFFER_SIGPIPE_SENSITIVE_P(p)) {
+        /* (sort of) emulate termination by SIGPIPE.
+           NB: The difference is visible from the outside world
+           as the process exit status differ (WIFEXITED
+           instead of WIFSIGNALED).  If it becomes a problem,
+           we can reset the signal handler to SIG_DFL and
+           send SIGPIPE to self. */
+        Scm_Exit(1);    /* exit code is somewhat arbitrary */
+    }
+    p->error = TRUE;
+    Scm_SysError("write failed on %S", p);
+}
+
 static ScmSize file_flusher(ScmPort *p, ScmSize cnt, int forcep)
 {
     ScmSize nwrote = 0;
@@ -1506,17 +1751,7 @@ static ScmSize file_flusher(ScmPort *p, ScmSize cnt, int forcep)
         errno = 0;
         SCM_SYSCALL(r, write(fd, datptr, datsiz-nwrote));
         if (r < 0) {
-            if (errno == EPIPE && PORT_BUFFER_SIGPIPE_SENSITIVE_P(p)) {
-                /* (sort of) emulate termination by SIGPIPE.
-                   NB: The difference is visible from the outside world
-                   as the process exit status differ (WIFEXITED
-                   instead of WIFSIGNALED).  If it becomes a problem,
-                   we can reset the signal handler to SIG_DFL and
-                   send SIGPIPE to self. */
-                Scm_Exit(1);    /* exit code is somewhat arbitrary */
-            }
-            p->error = TRUE;
-            Scm_SysError("write failed on %S", p);
+            file_write_error(p);
         } else {
             datptr += r;
             nwrote += r;
@@ -1525,6 +1760,55 @@ static ScmSize file_flusher(ScmPort *p, ScmSize cnt, int forcep)
     return nwrote;
 }
 
+#if !defined(GAUCHE_WINDOWS)
+/* Writes out all the data in V, retrying on partial writes. */
+static void file_writev_all(ScmPort *p, struct iovec *v, int n)
+{
+    int fd = FILE_PORT_FD(p);
+    SCM_ASSERT(fd >= 0);
+    while (n > 0) {
+        ScmSize r;
+        SCM_SYSCALL(r, writev(fd, v, n));
+        if (r < 0) file_write_error(p);
+        while (n > 0 && (size_t)r >= v->iov_len) {
+            r -= v->iov_len;
+            v++;
+            n--;
+        }
+        if (n > 0) {
+            v->iov_base = (char*)v->iov_base + r;
+            v->iov_len -= r;
+        }
+    }
+}
+
+/* Writes the buffered data, followed by COUNT pieces in IOV, bypassing
+   the buffer.  The buffer becomes empty. */
+static void file_writev(ScmPort *p, const ScmIOVec *iov, ScmSize count)
+{
+    struct iovec v[IOV_MAX];
+    ScmSize i = 0;
+    int n = 0;
+
+    if (PORT_BUFFER_AVAIL(p) > 0) {
+        v[n].iov_base = PORT_BUF(p)->buffer;
+        v[n].iov_len = PORT_BUFFER_AVAIL(p);
+        n++;
+    }
+    do {
+        for (; i < count && n < IOV_MAX; i++) {
+            if (iov[i].size == 0) continue;
+            v[n].iov_base = (void*)iov[i].data;
+            v[n].iov_len = iov[i].size;
+            n++;
+        }
+        file_writev_all(p, v, n);
+        PORT_BUF(p)->current = PORT_BUF(p)->buffer;
+        n = 0;
+    } while (i < count);
+}
+#endif /*!GAUCHE_WINDOWS*/
+
 static void file_closer(ScmPort *p)
 {
     int fd = FILE_PORT_FD(p);
@@ -1648,6 +1932,192 @@ ScmObj Scm_MakePortWithFd(ScmObj name, int direction,
     return p;
 }
 
+/*===============================================================
+ * Copying between file ports
+ */
+
+/* Methods to move data between fds, in the order of preference.
+   We fall back to the next one when the system says the current
+   one can't handle the given pair of fds.  */
+enum {
+    FDCOPY_COPY_FILE_RANGE,     /* file to file */
+    FDCOPY_SENDFILE,            /* file to anything */
+    FDCOPY_SPLICE,              /* either end is a pipe */
+    FDCOPY_READ_WRITE           /* anything */
+};
+
+#define FDCOPY_CHUNK  (1L<<30)  /* max # of bytes to pass to a syscall */
+#define FDCOPY_BUFSIZ 65536     /* buffer size for FDCOPY_READ_WRITE */
+
+static int fdcopy_unsupported_p(int e)
+{
+    switch (e) {
+    case EINVAL: case EBADF:
+#if defined(ENOSYS)
+    case ENOSYS:
+#endif
+#if defined(EXDEV)
+    case EXDEV:
+#endif
+#if defined(EOPNOTSUPP)
+    case EOPNOTSUPP:
+#endif
+#if defined(ENOTSUP) && defined(EOPNOTSUPP) && ENOTSUP != EOPNOTSUPP
+    case ENOTSUP:
+#endif
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static void fdcopy_write_error(ScmPort *src, ScmPort *dst)
+{
+    /* See file_flusher */
+    if (errno == EPIPE && PORT_BUFFER_SIGPIPE_SENSITIVE_P(dst)) {
+        Scm_Exit(1);
+    }
+    dst->error = TRUE;
+    Scm_SysError("copying data from %S to %S failed", src, dst);
+}
+
+/* Moves at most LEN bytes from SRC to DST.  Returns the number of bytes
+   moved, or 0 on EOF. */
+static ScmSize fdcopy_chunk(int *method, ScmPort *src, ScmPort *dst,
+                            ScmSize len, char **buf)
+{
+    int sfd = FILE_PORT_FD(src);
+    int dfd = FILE_PORT_FD(dst);
+    ScmSize r = -1;
+
+    for (;;) {
+        switch (*method) {
+#if defined(HAVE_COPY_FILE_RANGE)
+        case FDCOPY_COPY_FILE_RANGE:
+            SCM_SYSCALL(r, copy_file_range(sfd, NULL, dfd, NULL, len, 0));
+            break;
+#endif
+#if defined(HAVE_SYS_SENDFILE_H)
+        case FDCOPY_SENDFILE:
+            SCM_SYSCALL(r, sendfile(dfd, sfd, NULL, len));
+            break;
+#endif
+#if defined(HAVE_SPLICE)
+        case FDCOPY_SPLICE:
+            SCM_SYSCALL(r, splice(sfd, NULL, dfd, NULL, len, SPLICE_F_MOVE));
+            break;
+#endif
+        case FDCOPY_READ_WRITE: {
+            if (*buf == NULL) *buf = SCM_NEW_ATOMIC2(char*, FDCOPY_BUFSIZ);
+            if (len > FDCOPY_BUFSIZ) len = FDCOPY_BUFSIZ;
+            SCM_SYSCALL(r, read(sfd, *buf, len));
+            if (r < 0) {
+                src->error = TRUE;
+                Scm_SysError("read failed on %S", src);
+            }
+            for (ScmSize nwrote = 0; nwrote < r;) {
+                ScmSize w;
+                SCM_SYSCALL(w, write(dfd, *buf + nwrote, r - nwrote));
+                if (w < 0) fdcopy_write_error(src, dst);
+                nwrote += w;
+            }
+            return r;
+        }
+        default:
+            (*method)++;        /* not available on this system */
+            continue;
+        }
+
+        if (r > 0) return r;
+        /* Some files, e.g. the ones in procfs, look empty to the
+           in-kernel copy.  So we only trust EOF reported by read(). */
+        if (r == 0 || fdcopy_unsupported_p(errno)) {
+            (*method)++;
+            continue;
+        }
+        fdcopy_write_error(src, dst);
+    }
+}
+
+/* Copies data from an input file port SRC to an output file port DST,
+   up to LIMIT bytes, or until EOF if LIMIT is negative.  Returns the
+   number of bytes copied.
+
+   The data already read into SRC's buffer goes through DST's buffer,
+   which is then flushed.  The rest is moved directly between the file
+   descriptors, using copy_file_range(), sendfile() or splice() if
+   possible, so that it doesn't need to be copied into the user space.
+
+   If either port isn't directly connected to a file descriptor,
+   returns -1 without doing anything; the caller should fall back to
+   the generic copy.  Note that SRC's line count doesn't take account
+   of the bytes moved directly. */
+ScmSize Scm_PortCopyFd(ScmPort *src, ScmPort *dst, ScmSize limit)
+{
+    if (SCM_PORT_TYPE(src) != SCM_PORT_FILE || !file_buffered_port_p(src)
+        || SCM_PORT_TYPE(dst) != SCM_PORT_FILE || !file_buffered_port_p(dst)
+        || !(SCM_PORT_DIR(src) & SCM_PORT_INPUT)
+        || !(SCM_PORT_DIR(dst) & SCM_PORT_OUTPUT)) {
+        return -1;
+    }
+    if (SCM_PORT_CLOSED_P(src)) {
+        Scm_PortError(src, SCM_PORT_ERROR_CLOSED,
+                      "I/O attempted on closed port: %S", src);
+    }
+    if (SCM_PORT_CLOSED_P(dst)) {
+        Scm_PortError(dst, SCM_PORT_ERROR_CLOSED,
+                      "I/O attempted on closed port: %S", dst);
+    }
+
+    ScmVM *vm = Scm_VM();
+    ScmSize copied = 0;
+    PORT_LOCK(src, vm);
+    PORT_LOCK(dst, vm);
+    SCM_UNWIND_PROTECT {
+        flush_linked_port(src);
+
+        /* Peeked or ungotten data */
+        while ((src->scrcnt > 0 || PORT_UNGOTTEN(src) != SCM_CHAR_INVALID)
+               && (limit < 0 || copied < limit)) {
+            int b = Scm_GetbUnsafe(src);
+            if (b == EOF) break;
+            Scm_PutbUnsafe((ScmByte)b, dst);
+            copied++;
+        }
+
+        /* Buffered data */
+        ScmPortBuffer *sb = PORT_BUF(src);
+        ScmSize avail = sb->end - sb->current;
+        if (limit >= 0 && avail > limit - copied) avail = limit - copied;
+        if (avail > 0) {
+            Scm_PutzUnsafe(sb->current, avail, dst);
+            sb->current += avail;
+            PORT_BYTES(src) += avail;
+            copied += avail;
+        }
+        Scm_FlushUnsafe(dst);
+
+        /* The rest */
+        int method = FDCOPY_COPY_FILE_RANGE;
+        char *buf = NULL;
+        while (limit < 0 || copied < limit) {
+            ScmSize len = FDCOPY_CHUNK;
+            if (limit >= 0 && limit - copied < len) len = limit - copied;
+            ScmSize n = fdcopy_chunk(&method, src, dst, len, &buf);
+            if (n == 0) break;
+            copied += n;
+            PORT_BYTES(src) += n;
+        }
+    } SCM_WHEN_ERROR {
+        PORT_UNLOCK(dst);
+        PORT_UNLOCK(src);
+        SCM_NEXT_HANDLER;
+    } SCM_END_PROTECT;
+    PORT_UNLOCK(dst);
+    PORT_UNLOCK(src);
+    return copied;
+}
+
 /*===============================================================
  * String port
  */
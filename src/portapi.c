@@ -352,6 +352,68 @@ void Scm_PutzUnsafe(const char *s, volatile ScmSize siz, ScmPort *p)
     }
 }
 
+/*=================================================================
+ * Putzv - gather write
+ */
+
+#ifdef SAFE_PORT_OP
+void Scm_Putzv(const ScmIOVec * volatile iov, volatile ScmSize count,
+               ScmPort *p)
+#else
+void Scm_PutzvUnsafe(const ScmIOVec *iov, volatile ScmSize count, ScmPort *p)
+#endif
+{
+    VMDECL;
+    SHORTCUT(p, Scm_PutzvUnsafe(iov, count, p); return);
+    WALKER_CHECK(p);
+    LOCK(p);
+    CLOSE_CHECK(p);
+    PORT_FLUSHED_CLEAR(p);
+    switch (SCM_PORT_TYPE(p)) {
+    case SCM_PORT_FILE:
+        SAFE_CALL(p, bufport_writev(p, iov, count));
+        if (PORT_BUFFER_MODE(p) == SCM_PORT_BUFFER_LINE) {
+            const char *cp = PORT_BUF(p)->current;
+            while (cp-- > PORT_BUF(p)->buffer) {
+                if (*cp == '\n') {
+                    SAFE_CALL(p, bufport_flush(p, (cp - PORT_BUF(p)->current), FALSE));
+                    break;
+                }
+            }
+        } else if (PORT_BUFFER_MODE(p) == SCM_PORT_BUFFER_NONE) {
+            SAFE_CALL(p, bufport_flush(p, 0, TRUE));
+        }
+        UNLOCK(p);
+        break;
+    case SCM_PORT_OSTR:
+        for (ScmSize i = 0; i < count; i++) {
+            Scm_DStringPutz(PORT_OSTR(p), iov[i].data, iov[i].size);
+        }
+        UNLOCK(p);
+        break;
+    case SCM_PORT_PROC:
+        /* I is live across the setjmp in SAFE_CALL. */
+        for (volatile ScmSize i = 0; i < count; i++) {
+            SAFE_CALL(p, PORT_VT(p)->Putz(iov[i].data, iov[i].size, p));
+        }
+        UNSAVE_POS(p);
+        UNLOCK(p);
+        break;
+    default:
+        UNLOCK(p);
+        Scm_PortError(p, SCM_PORT_ERROR_OUTPUT,
+                      "bad port type for output: %S", p);
+    }
+
+    for (ScmSize i = 0; i < count; i++) {
+        const u_char *start = (const u_char*)iov[i].data;
+        const u_char *end = (const u_char*)(iov[i].data + iov[i].size);
+        int col = column_count(start, end);
+        if (col < 0) PORT_COLUMN(p) += length_count(start, end);
+        else PORT_COLUMN(p) = col;
+    }
+}
+
 /*=================================================================
  * Flush
  */
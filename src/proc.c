@@ -104,7 +104,8 @@ void Scm__ProcedureInit(ScmProcedure *proc,
     proc->setter = SCM_FALSE;
     proc->inliner = SCM_FALSE;
 #if GAUCHE_API_VERSION >= 98
-    proc->reserved32 = 0;
+    proc->dispatchCount = 0;
+    proc->reserved16 = 0;
     proc->typeHint = SCM_FALSE;
     proc->tagsAlist = SCM_NIL;
 #endif /*GAUCHE_API_VERSION >= 98*/
@@ -236,7 +237,8 @@ ScmObj Scm__CopyProcedure(ScmProcedure *proc , ScmObj tagsAlist)
     SCM_PROCEDURE_SETTER_LOCKED(n) = SCM_PROCEDURE_SETTER_LOCKED(proc);
     SCM_PROCEDURE_CURRYING(n) = SCM_PROCEDURE_CURRYING(proc);
 #if GAUCHE_API_VERSION >= 98
-    SCM_PROCEDURE(n)->reserved32 = proc->reserved32;
+    SCM_PROCEDURE(n)->dispatchCount = proc->dispatchCount;
+    SCM_PROCEDURE(n)->reserved16 = proc->reserved16;
     SCM_PROCEDURE(n)->typeHint = proc->typeHint;
     if (SCM_FALSEP(tagsAlist)) {
         SCM_PROCEDURE(n)->tagsAlist = proc->tagsAlist;
@@ -38,6 +38,7 @@
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/priv/configP.h"
+#include "gauche/priv/atomicP.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/charP.h"
 #include "gauche/priv/regexpP.h"
@@ -81,6 +82,11 @@
  * A possible fix is to check if recursion level exceeds some limit,
  * then save the C stack into heap (as in the C-stack-copying continuation
  * does) and reuse the stack area.
+ *
+ * If the regexp doesn't use features that need backtracking, such as
+ * backreferences and lookaround assertions, we run a lazy DFA and
+ * a breadth-first NFA simulation instead, which never goes exponential.
+ * See "Lazy DFA" section below.
  */
 
 /* Instructions.  `RL' suffix indicates that the instruction moves the
@@ -93,6 +99,24 @@ enum {
     RE_NUM_INSN
 };
 
+/* Operand types of instructions.  See regexp_insn.h. */
+enum {
+    OP_none,
+    OP_octet,
+    OP_string,
+    OP_cset,
+    OP_group,
+    OP_offset2,
+    OP_offset1_2,
+    OP_offset2_2
+};
+
+static const unsigned char re_optypes[] = {
+#define DEF_RE_INSN(_, optype) optype,
+#include "gauche/regexp_insn.h"
+#undef DEF_RE_INSN
+};
+
 /* maximum # of {n,m}-type limited repeat count */
 #define MAX_LIMITED_REPEAT 255
 
@@ -175,6 +199,8 @@ static ScmRegexp *make_regexp(void)
     rx->flags = 0;
     rx->pattern = SCM_FALSE;
     rx->ast = SCM_FALSE;
+    rx->laset = SCM_FALSE;
+    rx->dfa = NULL;
     return rx;
 }
 
@@ -272,6 +298,7 @@ static ScmObj rc1_group_name(regcomp_ctx *ctx);
 static ScmObj rc1_lex_minmax(regcomp_ctx *ctx);
 static ScmObj rc1_lex_open_paren(regcomp_ctx *ctx);
 static ScmObj rc1_lex_xdigits(ScmPort *port, int key);
+static struct ScmRegexpDFARec *rx_dfa_prepare(ScmRegexp *rx);
 
 /*----------------------------------------------------------------
  * pass1 - parser
@@ -1895,6 +1922,9 @@ static ScmObj rc3(regcomp_ctx *ctx, ScmObj ast)
     ctx->rx->code = ctx->code;
     ctx->rx->numCodes = ctx->codep;
 
+    /* see if we can run the code with the lazy DFA */
+    ctx->rx->dfa = rx_dfa_prepare(ctx->rx);
+
     ctx->rx->ast = ast;
     return SCM_OBJ(ctx->rx);
 }
@@ -1908,26 +1938,13 @@ void Scm_RegDump(ScmRegexp *rx)
 #undef DEF_RE_INSN
     };
 
-    static enum {
-        OP_none,
-        OP_octet,
-        OP_string,
-        OP_cset,
-        OP_group,
-        OP_offset2,
-        OP_offset1_2,
-        OP_offset2_2
-    } optypes[] = {
-#define DEF_RE_INSN(_, optype) optype,
-#include "gauche/regexp_insn.h"
-#undef DEF_RE_INSN
-    };
-
     Scm_Printf(SCM_CUROUT, "Regexp %p: (flags=%08x", rx, rx->flags);
     if (rx->flags&SCM_REGEXP_BOL_ANCHORED)
         Scm_Printf(SCM_CUROUT, ",BOL_ANCHORED");
     if (rx->flags&SCM_REGEXP_SIMPLE_PREFIX)
         Scm_Printf(SCM_CUROUT, ",SIMPLE_PREFIX");
+    if (rx->dfa)
+        Scm_Printf(SCM_CUROUT, ",DFA");
     Scm_Printf(SCM_CUROUT, ")\n");
     Scm_Printf(SCM_CUROUT, " laset = %S\n", rx->laset);
     Scm_Printf(SCM_CUROUT, "  must = ");
@@ -1940,7 +1957,7 @@ void Scm_RegDump(ScmRegexp *rx)
     int end = rx->numCodes;
     for (int codep = 0; codep < end; codep++) {
         int code = rx->code[codep];
-        int optype = optypes[code];
+        int optype = re_optypes[code];
         Scm_Printf(SCM_CUROUT, "%4d  ", codep);
         switch (optype) {
         case OP_none:
@@ -2241,6 +2258,7 @@ static int is_word_boundary(struct match_ctx *ctx, const char *input, unsigned i
 
     if ((code == RE_BOW || code == RE_WB) && input == ctx->input) return TRUE;
     if ((code == RE_EOW || code == RE_WB) && input == ctx->stop) return TRUE;
+    if (input == ctx->input) return FALSE; /* no previous char */
     unsigned char nextb = (unsigned char)*input;
     SCM_CHAR_BACKWARD(input, ctx->input, prevp);
     if (prevp == NULL) return FALSE;
@@ -2805,6 +2823,840 @@ static inline const char *skip_input(const char *start, const char *limit,
     return limit;
 }
 
+/*=======================================================================
+ * Lazy DFA
+ */
+
+/* If the compiled code doesn't contain instructions that need
+ * backtracking information---backreferences, lookahead/lookbehind
+ * assertions, conditional patterns, standalone patterns and grapheme
+ * boundaries---we can run it as an automaton without backtracking.
+ * Rx_dfa_prepare() checks the code at compile time and attaches
+ * ScmRegexpDFA to the regexp if it's the case.
+ *
+ * The matching is done in two steps.
+ *
+ *  1. We run the DFA over the input to see if there's a match at all.
+ *     The DFA states are built lazily from the bytecode; each state is
+ *     a set of "positions" in the code, and the transition on a character
+ *     is computed on demand and cached in the state.  It takes time
+ *     proportional to the length of the input, regardless of the pattern.
+ *     Most of the inputs of typical use (e.g. scanning log lines) don't
+ *     match, and that's all we need for them.
+ *
+ *  2. If there is a match, we run the code with the "Pike VM", a
+ *     breadth-first NFA simulation that keeps the threads in priority
+ *     order, to find out the leftmost match and submatches that the
+ *     backtracking matcher would find.  It takes time proportional to
+ *     (length of input) * (size of the code), but never goes exponential.
+ *
+ * A position is an index into the bytecode.  Usually it points to an
+ * instruction, but while we're matching a multibyte string of RE_MATCH
+ * or RE_MATCH_CI, it points to the byte in the string to be matched next.
+ * dfa->insn[pos] gives the instruction the position belongs to.
+ *
+ * The repeat instructions RE_*R don't backtrack; if the next character
+ * matches they must consume it.  So the epsilon closure of such a
+ * position depends on the next character.  Similarly, the assertions
+ * such as RE_BOL or RE_WB depend on the previous and next characters.
+ * Hence the closure is always computed when we know the next character,
+ * and a DFA state keeps the set of positions *before* taking the closure,
+ * along with the context of the previous character.
+ *
+ * The DFA states are shared among threads.  Reading the cached transition
+ * is lock-free; computing a new transition is done while holding
+ * dfa->mutex.  Transitions by ASCII chars are kept in an array indexed
+ * by the char, and the ones by other chars in a small hash table of the
+ * state (see rx_wide_lookup).  If the number of states exceeds RX_DFA_MAX_STATES, we
+ * discard the cache and start over.  The old states are still valid
+ * while some thread is looking at them (thanks to GC).  If we keep
+ * discarding the cache during a single match, we give up using the DFA
+ * and fall back to the Pike VM.
+ */
+
+#define RX_DFA_MAX_STATES   1024 /* cap of # of states we keep */
+#define RX_DFA_TABLE_SIZE   512  /* # of buckets of state table.  power of 2 */
+#define RX_DFA_MAX_FLUSH    2    /* we give up DFA if we flush the cache
+                                    more than this during a match */
+#define RX_PIKE_MAX_CAPS    0x10000 /* we don't run Pike VM if it requires
+                                       more than this # of capture slots */
+
+/* Context of the previous character */
+#define RX_CTX_BOS    (1L<<0)    /* at the beginning of the input */
+#define RX_CTX_WORD   (1L<<1)    /* previous char is word constituent */
+#define RX_CTX_NL     (1L<<2)    /* previous char is newline */
+
+/* Pseudo character to represent the end of input */
+#define RX_EOS        (-1)
+
+/* Cached transitions by non-ASCII chars.  An open-addressing hash table
+   keyed by the char.  Readers look into it without locking, so an entry
+   is never modified once stored; instead, we replace the whole entry, or
+   the whole table when it grows.  It is kept less than half full, so
+   the lookup always hits an empty slot if the char isn't there. */
+typedef struct rx_wide_entry_rec {
+    ScmChar ch;
+    void *next;                 /* rx_dfa_state* or rx_set_state* */
+} rx_wide_entry;
+
+typedef struct rx_wide_table_rec {
+    int size;                   /* # of slots.  power of 2 */
+    int count;                  /* # of entries */
+    ScmAtomicVar entries[1];    /* rx_wide_entry*, or 0 (variable length) */
+} rx_wide_table;
+
+#define RX_WIDE_INITIAL_SIZE  8
+
+typedef struct rx_dfa_state_rec rx_dfa_state;
+
+struct rx_dfa_state_rec {
+    ScmAtomicVar next[128];     /* cached transitions by ASCII chars.
+                                   0 if not computed yet. */
+    ScmAtomicVar wide;          /* rx_wide_table* for non-ASCII chars,
+                                   0 if none is computed yet. */
+    rx_dfa_state *chain;        /* hash chain */
+    u_long hashval;
+    int context;                /* RX_CTX_* of the previous char */
+    int accept;                 /* Can we match at the end of input?
+                                   -1: not computed yet, 0: no, 1: yes */
+    int npos;                   /* # of positions */
+    int pos[1];                 /* positions, sorted (variable length) */
+};
+
+/* Special states.  These are never looked into. */
+static rx_dfa_state rx_dfa_matched; /* a match is found */
+static rx_dfa_state rx_dfa_dead;    /* no match is possible */
+#define RX_DFA_MATCHED  (&rx_dfa_matched)
+#define RX_DFA_DEAD     (&rx_dfa_dead)
+
+typedef struct ScmRegexpDFARec {
+    ScmRegexp *rx;
+    int npos;                   /* == rx->numCodes */
+    int *insn;                  /* insn[pos] - the instruction pos belongs */
+    int ctxmask;                /* RX_CTX_* bits that matter */
+    int anchored;               /* TRUE if we only match at the beginning */
+    int nslots;                 /* max # of threads of the Pike VM */
+    ScmAtomicVar start;         /* start state, or 0 if not computed yet */
+
+    /* The following slots are protected by mutex. */
+    ScmInternalMutex mutex;
+    rx_dfa_state **table;       /* state table */
+    int nstates;                /* # of states in the table */
+    u_long flushes;             /* # of times the cache is flushed */
+    /* work area to compute transitions */
+    u_long gen;                 /* generation counter for mark */
+    u_long *mark;               /* mark[pos] == gen if visited */
+    u_long *omark;              /* omark[pos] == gen if in result */
+    int *stack;
+    int *result;
+} ScmRegexpDFA;
+
+/* Returns TRUE if we can run CODE with the DFA and Pike VM. */
+static int rx_dfa_runnable_p(const unsigned char *code, int numCodes)
+{
+    for (int pc = 0; pc < numCodes; ) {
+        switch (code[pc]) {
+        case RE_MATCH1: case RE_MATCH1_CI: case RE_ANY:
+        case RE_MATCH: case RE_MATCH_CI:
+        case RE_SET: case RE_NSET: case RE_SET1: case RE_NSET1:
+        case RE_TRY: case RE_JUMP: case RE_FAIL: case RE_SUCCESS:
+        case RE_BEGIN: case RE_END:
+        case RE_BOS: case RE_EOS: case RE_BOL: case RE_EOL:
+        case RE_BOW: case RE_EOW: case RE_WB: case RE_NWB:
+        case RE_SET1R: case RE_NSET1R: case RE_SETR: case RE_NSETR:
+        case RE_MATCH1R: case RE_MATCHR: case RE_ANYR:
+            break;
+        default:
+            return FALSE;
+        }
+        switch (re_optypes[code[pc]]) {
+        case OP_none:   pc += 1; break;
+        case OP_octet: case OP_cset: case OP_group: pc += 2; break;
+        case OP_string: pc += 2 + code[pc+1]; break;
+        case OP_offset2: pc += 3; break;
+        default: return FALSE;  /* can't be here */
+        }
+    }
+    return TRUE;
+}
+
+static ScmRegexpDFA *rx_dfa_prepare(ScmRegexp *rx)
+{
+    const unsigned char *code = rx->code;
+    int npos = rx->numCodes;
+
+    if (!rx_dfa_runnable_p(code, npos)) return NULL;
+
+    ScmRegexpDFA *dfa = SCM_NEW(ScmRegexpDFA);
+    dfa->rx = rx;
+    dfa->npos = npos;
+    dfa->insn = SCM_NEW_ATOMIC_ARRAY(int, npos);
+    dfa->ctxmask = 0;
+    dfa->anchored = (rx->flags & SCM_REGEXP_BOL_ANCHORED) != 0;
+    dfa->nslots = 0;
+    for (int pc = 0; pc < npos; ) {
+        int len = 1;
+        dfa->insn[pc] = pc;
+        switch (code[pc]) {
+        case RE_BOS:
+            dfa->ctxmask |= RX_CTX_BOS;
+            break;
+        case RE_BOL:
+            dfa->ctxmask |= RX_CTX_BOS;
+            if (rx->flags & SCM_REGEXP_MULTI_LINE) dfa->ctxmask |= RX_CTX_NL;
+            break;
+        case RE_BOW: case RE_EOW: case RE_WB: case RE_NWB:
+            dfa->ctxmask |= RX_CTX_BOS|RX_CTX_WORD;
+            break;
+        case RE_TRY: case RE_JUMP: case RE_EOS: case RE_EOL: case RE_FAIL:
+        case RE_BEGIN: case RE_END:
+            break;
+        default:
+            /* consumers and RE_SUCCESS may become a thread */
+            dfa->nslots++;
+            break;
+        }
+        switch (re_optypes[code[pc]]) {
+        case OP_octet: case OP_cset: case OP_group: len = 2; break;
+        case OP_offset2: len = 3; break;
+        case OP_string:
+            len = 2 + code[pc+1];
+            /* positions in the middle of the string can be threads */
+            if (code[pc] != RE_MATCHR) dfa->nslots += code[pc+1];
+            break;
+        }
+        for (int i = 1; i < len; i++) dfa->insn[pc+i] = pc;
+        pc += len;
+    }
+
+    dfa->start = 0;
+    SCM_INTERNAL_MUTEX_INIT(dfa->mutex);
+    dfa->table = SCM_NEW_ARRAY(rx_dfa_state*, RX_DFA_TABLE_SIZE);
+    dfa->nstates = 0;
+    dfa->flushes = 0;
+    dfa->gen = 0;
+    dfa->mark = SCM_NEW_ATOMIC_ARRAY(u_long, npos);
+    dfa->omark = SCM_NEW_ATOMIC_ARRAY(u_long, npos);
+    for (int i = 0; i < npos; i++) dfa->mark[i] = dfa->omark[i] = 0;
+    dfa->stack = SCM_NEW_ATOMIC_ARRAY(int, 3*npos+1);
+    dfa->result = SCM_NEW_ATOMIC_ARRAY(int, npos+1);
+    return dfa;
+}
+
+static inline int rx_word_char_p(ScmChar c)
+{
+    return (c >= 0 && (c >= 128 || is_word_constituent((unsigned char)c)));
+}
+
+/* Returns the context a character C leaves for the next position. */
+static inline int rx_char_context(ScmChar c)
+{
+    int r = 0;
+    if (rx_word_char_p(c)) r |= RX_CTX_WORD;
+    if (c == '\n' || c == '\r') r |= RX_CTX_NL;
+    return r;
+}
+
+/* Check zero-width assertion OP, given the context of the previous
+   character PREV and the next character C (RX_EOS at the end).
+   This must agree with is_beginning_of_line etc. used by rex_rec. */
+static int rx_assertion_ok(ScmRegexp *rx, int op, int prev, ScmChar c)
+{
+    int bos = prev & RX_CTX_BOS;
+    int multiline = rx->flags & SCM_REGEXP_MULTI_LINE;
+    switch (op) {
+    case RE_BOS: return bos;
+    case RE_EOS: return c == RX_EOS;
+    case RE_BOL: return bos || (multiline && (prev & RX_CTX_NL));
+    case RE_EOL:
+        return c == RX_EOS || (multiline && (c == '\n' || c == '\r'));
+    case RE_BOW:
+        return bos || (rx_word_char_p(c) && !(prev & RX_CTX_WORD));
+    case RE_EOW:
+        return c == RX_EOS || (!rx_word_char_p(c) && (prev & RX_CTX_WORD));
+    case RE_WB:
+        return rx_assertion_ok(rx, RE_BOW, prev, c)
+            || rx_assertion_ok(rx, RE_EOW, prev, c);
+    case RE_NWB:
+        return !rx_assertion_ok(rx, RE_WB, prev, c);
+    default:
+        Scm_Panic("rx_assertion_ok: can't be here");
+        return FALSE;           /* dummy */
+    }
+}
+
+/* For repeat instructions RE_*R at PC, returns TRUE if the character C
+   should be consumed. */
+static int rx_repeat_ok(ScmRegexp *rx, int pc, ScmChar c)
+{
+    const unsigned char *code = rx->code;
+    if (c == RX_EOS) return FALSE;
+    switch (code[pc]) {
+    case RE_SET1R:
+        return c < 128 && Scm_CharSetContains(rx->sets[code[pc+1]], c);
+    case RE_NSET1R:
+        return c >= 128 || !Scm_CharSetContains(rx->sets[code[pc+1]], c);
+    case RE_SETR:
+        return Scm_CharSetContains(rx->sets[code[pc+1]], c);
+    case RE_NSETR:
+        return !Scm_CharSetContains(rx->sets[code[pc+1]], c);
+    case RE_MATCH1R:
+        return c == code[pc+1];
+    case RE_MATCHR: {
+        ScmChar ch;
+        SCM_CHAR_GET(code+pc+2, ch);
+        return c == ch;
+    }
+    case RE_ANYR:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/* Next pc of the repeat instruction at PC */
+static inline int rx_repeat_next(const unsigned char *code, int pc)
+{
+    switch (code[pc]) {
+    case RE_ANYR:   return pc+1;
+    case RE_MATCHR: return pc+2+code[pc+1];
+    default:        return pc+2;
+    }
+}
+
+/* Consumes a character C at position POS.  Returns the next position,
+   or -1 if C doesn't match.  C must not be RX_EOS. */
+static int rx_consume(ScmRegexpDFA *dfa, int pos, ScmChar c)
+{
+    ScmRegexp *rx = dfa->rx;
+    const unsigned char *code = rx->code;
+    int pc = dfa->insn[pos];
+
+    switch (code[pc]) {
+    case RE_MATCH1:
+        return (c == code[pc+1])? pc+2 : -1;
+    case RE_MATCH1_CI:
+        return (c < 128 && code[pc+1] == SCM_CHAR_DOWNCASE(c))? pc+2 : -1;
+    case RE_MATCH: {
+        int end = pc + 2 + code[pc+1];
+        int p = (pos == pc)? pc+2 : pos;
+        int n = SCM_CHAR_NBYTES(c);
+        if (p + n > end) return -1;
+        if (n == 1) {
+            if (code[p] != c) return -1;
+        } else {
+            unsigned char buf[SCM_CHAR_MAX_BYTES];
+            SCM_CHAR_PUT(buf, c);
+            if (memcmp(code+p, buf, n) != 0) return -1;
+        }
+        return p + n;           /* this is end if we've matched all */
+    }
+    case RE_MATCH_CI: {
+        int end = pc + 2 + code[pc+1];
+        int p = (pos == pc)? pc+2 : pos;
+        ScmChar ch;
+        SCM_CHAR_GET(code+p, ch);
+        if (Scm_CharDowncase(c) != ch) return -1;
+        p += SCM_CHAR_NBYTES(ch);
+        return (p <= end)? p : -1;
+    }
+    case RE_ANY:
+        return pc+1;
+    case RE_SET1:
+        return (c < 128 && Scm_CharSetContains(rx->sets[code[pc+1]], c))
+            ? pc+2 : -1;
+    case RE_NSET1:
+        return (c >= 128 || !Scm_CharSetContains(rx->sets[code[pc+1]], c))
+            ? pc+2 : -1;
+    case RE_SET:
+        return Scm_CharSetContains(rx->sets[code[pc+1]], c)? pc+2 : -1;
+    case RE_NSET:
+        return !Scm_CharSetContains(rx->sets[code[pc+1]], c)? pc+2 : -1;
+    case RE_SET1R: case RE_NSET1R: case RE_SETR: case RE_NSETR:
+    case RE_MATCH1R: case RE_MATCHR: case RE_ANYR:
+        return rx_repeat_ok(rx, pc, c)? pc : -1;
+    default:
+        return -1;
+    }
+}
+
+/*
+ * DFA transition
+ */
+
+/* Returns the cached transition by a non-ASCII char C, or NULL. */
+static void *rx_wide_lookup(ScmAtomicVar *wide, ScmChar c)
+{
+    rx_wide_table *t = (rx_wide_table*)Scm_AtomicLoad(wide);
+    if (t == NULL) return NULL;
+    for (u_long i = (u_long)c;; i++) {
+        rx_wide_entry *e =
+            (rx_wide_entry*)Scm_AtomicLoad(&t->entries[i & (t->size-1)]);
+        if (e == NULL) return NULL;
+        if (e->ch == c) return e->next;
+    }
+}
+
+/* Stores E into T, replacing the entry of the same char if any. */
+static void rx_wide_put(rx_wide_table *t, rx_wide_entry *e)
+{
+    for (u_long i = (u_long)e->ch;; i++) {
+        ScmAtomicVar *slot = &t->entries[i & (t->size-1)];
+        rx_wide_entry *o = (rx_wide_entry*)Scm_AtomicLoad(slot);
+        if (o == NULL || o->ch == e->ch) {
+            if (o == NULL) t->count++;
+            Scm_AtomicStoreFull(slot, (ScmAtomicWord)e);
+            return;
+        }
+    }
+}
+
+/* Caches the transition by a non-ASCII char C to N.  Called with the
+   mutex of the DFA held.  Returns the number of bytes allocated. */
+static size_t rx_wide_insert(ScmAtomicVar *wide, ScmChar c, void *n)
+{
+    rx_wide_table *t = (rx_wide_table*)Scm_AtomicLoad(wide);
+    rx_wide_entry *e = SCM_NEW(rx_wide_entry);
+    size_t size = sizeof(rx_wide_entry);
+    e->ch = c;
+    e->next = n;
+    if (t != NULL && (t->count+1)*2 <= t->size) {
+        rx_wide_put(t, e);
+        return size;
+    }
+    int nsize = t ? t->size*2 : RX_WIDE_INITIAL_SIZE;
+    size_t tsize = sizeof(rx_wide_table)+sizeof(ScmAtomicVar)*(nsize-1);
+    rx_wide_table *nt = SCM_NEW2(rx_wide_table*, tsize);
+    nt->size = nsize;
+    nt->count = 0;
+    for (int i = 0; i < nsize; i++) nt->entries[i] = 0;
+    if (t != NULL) {
+        for (int i = 0; i < t->size; i++) {
+            rx_wide_entry *o = (rx_wide_entry*)Scm_AtomicLoad(&t->entries[i]);
+            if (o != NULL) rx_wide_put(nt, o);
+        }
+    }
+    rx_wide_put(nt, e);
+    Scm_AtomicStoreFull(wide, (ScmAtomicWord)nt);
+    return size + tsize;
+}
+
+static u_long rx_dfa_hash(int context, const int *pos, int npos)
+{
+    u_long h = (u_long)context;
+    for (int i = 0; i < npos; i++) h = h*31 + (u_long)pos[i];
+    return h;
+}
+
+static void rx_dfa_flush(ScmRegexpDFA *dfa)
+{
+    dfa->table = SCM_NEW_ARRAY(rx_dfa_state*, RX_DFA_TABLE_SIZE);
+    dfa->nstates = 0;
+    dfa->flushes++;
+    Scm_AtomicStore(&dfa->start, 0);
+}
+
+static int rx_dfa_pos_compare(const void *a, const void *b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+/* Look up a state with the positions, or create a new one.
+   Called with dfa->mutex held.  POS may be sorted in place. */
+static rx_dfa_state *rx_dfa_intern(ScmRegexpDFA *dfa, int context,
+                                   int *pos, int npos)
+{
+    if (npos == 0) return RX_DFA_DEAD;
+    qsort(pos, npos, sizeof(int), rx_dfa_pos_compare);
+    context &= dfa->ctxmask;
+    u_long h = rx_dfa_hash(context, pos, npos);
+    rx_dfa_state **bucket = &dfa->table[h & (RX_DFA_TABLE_SIZE-1)];
+    for (rx_dfa_state *s = *bucket; s; s = s->chain) {
+        if (s->hashval == h && s->context == context && s->npos == npos
+            && memcmp(s->pos, pos, sizeof(int)*npos) == 0) {
+            return s;
+        }
+    }
+    if (dfa->nstates >= RX_DFA_MAX_STATES) {
+        rx_dfa_flush(dfa);
+        bucket = &dfa->table[h & (RX_DFA_TABLE_SIZE-1)];
+    }
+    rx_dfa_state *s = SCM_NEW2(rx_dfa_state*,
+                               sizeof(rx_dfa_state)+sizeof(int)*(npos-1));
+    for (int i = 0; i < 128; i++) s->next[i] = 0;
+    s->wide = 0;
+    s->hashval = h;
+    s->context = context;
+    s->accept = -1;
+    s->npos = npos;
+    memcpy(s->pos, pos, sizeof(int)*npos);
+    s->chain = *bucket;
+    *bucket = s;
+    dfa->nstates++;
+    return s;
+}
+
+/* Computes the closure of positions POS, given the context of the
+   previous char PREV and the next char C, and stores the positions after
+   consuming C into RESULT.  Returns the number of resulting positions,
+   or -1 if we reached RE_SUCCESS.  MARK and OMARK are indexed by
+   positions, and GEN must be a fresh generation number for them.
+   This is shared by the DFA of a single regexp and of a regexp set. */
+static int rx_closure(ScmRegexpDFA *dfa, int prev, ScmChar c,
+                      const int *pos, int npos, u_long gen,
+                      u_long *mark, u_long *omark, int *stack, int *result)
+{
+    ScmRegexp *rx = dfa->rx;
+    const unsigned char *code = rx->code;
+    int sp = 0, nresult = 0;
+
+    for (int i = npos - 1; i >= 0; i--) stack[sp++] = pos[i];
+    while (sp > 0) {
+        int p = stack[--sp];
+        if (mark[p] == gen) continue;
+        mark[p] = gen;
+        int pc = dfa->insn[p];
+        if (pc == p) {
+            switch (code[pc]) {
+            case RE_TRY:
+                stack[sp++] = code[pc+1]*256 + code[pc+2];
+                stack[sp++] = pc+3;
+                continue;
+            case RE_JUMP:
+                stack[sp++] = code[pc+1]*256 + code[pc+2];
+                continue;
+            case RE_BEGIN: case RE_END:
+                stack[sp++] = pc+2;
+                continue;
+            case RE_BOS: case RE_EOS: case RE_BOL: case RE_EOL:
+            case RE_BOW: case RE_EOW: case RE_WB: case RE_NWB:
+                if (rx_assertion_ok(rx, code[pc], prev, c)) {
+                    stack[sp++] = pc+1;
+                }
+                continue;
+            case RE_SUCCESS:
+                return -1;
+            case RE_FAIL:
+                continue;
+            case RE_SET1R: case RE_NSET1R: case RE_SETR: case RE_NSETR:
+            case RE_MATCH1R: case RE_MATCHR: case RE_ANYR:
+                if (!rx_repeat_ok(rx, pc, c)) {
+                    stack[sp++] = rx_repeat_next(code, pc);
+                    continue;
+                }
+                break;
+            }
+        }
+        /* P is a consumer */
+        if (c == RX_EOS) continue;
+        int next = rx_consume(dfa, p, c);
+        if (next >= 0 && omark[next] != gen) {
+            omark[next] = gen;
+            result[nresult++] = next;
+        }
+    }
+    return nresult;
+}
+
+/* Computes the transition of state S by the next char C into dfa->result.
+   Returns the number of resulting positions, or -1 if we reached
+   RE_SUCCESS.  Called with dfa->mutex held. */
+static int rx_dfa_step(ScmRegexpDFA *dfa, rx_dfa_state *s, ScmChar c)
+{
+    u_long gen = ++dfa->gen;
+    int nresult = rx_closure(dfa, s->context, c, s->pos, s->npos, gen,
+                             dfa->mark, dfa->omark, dfa->stack, dfa->result);
+    if (nresult >= 0 && c != RX_EOS && !dfa->anchored
+        && dfa->omark[0] != gen) {
+        dfa->result[nresult++] = 0;
+    }
+    return nresult;
+}
+
+/* Compute the transition from S by C.  If we've flushed the cache
+   too many times, returns NULL. */
+static rx_dfa_state *rx_dfa_transit(ScmRegexpDFA *dfa, rx_dfa_state *s,
+                                    ScmChar c, u_long *flushes)
+{
+    rx_dfa_state *n;
+    SCM_INTERNAL_MUTEX_LOCK(dfa->mutex);
+    u_long nflushes = dfa->flushes;
+    int nresult = rx_dfa_step(dfa, s, c);
+    if (nresult < 0) {
+        n = RX_DFA_MATCHED;
+    } else {
+        n = rx_dfa_intern(dfa, rx_char_context(c), dfa->result, nresult);
+    }
+    nflushes = dfa->flushes - nflushes;
+    if (c >= 128) (void)rx_wide_insert(&s->wide, c, n);
+    SCM_INTERNAL_MUTEX_UNLOCK(dfa->mutex);
+    if (c < 128) Scm_AtomicStoreFull(&s->next[c], (ScmAtomicWord)n);
+    *flushes += nflushes;
+    if (*flushes > RX_DFA_MAX_FLUSH) return NULL;
+    return n;
+}
+
+static rx_dfa_state *rx_dfa_start_state(ScmRegexpDFA *dfa)
+{
+    rx_dfa_state *s = (rx_dfa_state*)Scm_AtomicLoad(&dfa->start);
+    if (s == NULL) {
+        int pos0 = 0;
+        SCM_INTERNAL_MUTEX_LOCK(dfa->mutex);
+        s = rx_dfa_intern(dfa, RX_CTX_BOS, &pos0, 1);
+        Scm_AtomicStoreFull(&dfa->start, (ScmAtomicWord)s);
+        SCM_INTERNAL_MUTEX_UNLOCK(dfa->mutex);
+    }
+    return s;
+}
+
+/* Run the DFA over [start, stop).  Returns 1 if there's a match,
+   0 if there's none, -1 if we gave up. */
+static int rx_dfa_search(ScmRegexpDFA *dfa, const char *start,
+                         const char *stop)
+{
+    rx_dfa_state *s = rx_dfa_start_state(dfa);
+    const char *p = start;
+    u_long flushes = 0;
+
+    while (p < stop) {
+        unsigned char b = (unsigned char)*p;
+        rx_dfa_state *n;
+        if (b < 128) {
+            n = (rx_dfa_state*)Scm_AtomicLoad(&s->next[b]);
+            if (n == NULL) n = rx_dfa_transit(dfa, s, b, &flushes);
+            p++;
+        } else {
+            ScmChar ch;
+            SCM_CHAR_GET(p, ch);
+            n = (rx_dfa_state*)rx_wide_lookup(&s->wide, ch);
+            if (n == NULL) n = rx_dfa_transit(dfa, s, ch, &flushes);
+            p += SCM_CHAR_NFOLLOWS(b) + 1;
+        }
+        if (n == RX_DFA_MATCHED) return 1;
+        if (n == RX_DFA_DEAD) return 0;
+        if (n == NULL) return -1;
+        s = n;
+    }
+    if (s->accept < 0) {
+        SCM_INTERNAL_MUTEX_LOCK(dfa->mutex);
+        s->accept = (rx_dfa_step(dfa, s, RX_EOS) < 0);
+        SCM_INTERNAL_MUTEX_UNLOCK(dfa->mutex);
+    }
+    return s->accept;
+}
+
+/*
+ * Pike VM
+ */
+
+typedef struct rx_thread_list_rec {
+    int nthreads;
+    u_long gen;
+    u_long *mark;               /* mark[pos] == gen if visited */
+    int *pos;                   /* positions of threads */
+    const char **caps;          /* captures.  thread i uses
+                                   caps[i*ncaps] ... caps[(i+1)*ncaps-1] */
+} rx_thread_list;
+
+typedef struct rx_pike_frame_rec {
+    int pos;                    /* position to visit, or -1 to restore caps */
+    int capi;                   /* index of capture to restore */
+    const char *old;            /* saved value to restore */
+} rx_pike_frame;
+
+typedef struct rx_pike_rec {
+    ScmRegexpDFA *dfa;
+    int ncaps;
+    rx_pike_frame *stack;
+} rx_pike;
+
+static void rx_thread_list_init(rx_thread_list *l, ScmRegexpDFA *dfa,
+                                int ncaps)
+{
+    l->nthreads = 0;
+    l->gen = 0;
+    l->mark = SCM_NEW_ATOMIC_ARRAY(u_long, dfa->npos);
+    for (int i = 0; i < dfa->npos; i++) l->mark[i] = 0;
+    l->pos = SCM_NEW_ATOMIC_ARRAY(int, dfa->nslots);
+    l->caps = SCM_NEW_ATOMIC_ARRAY(const char*, dfa->nslots * ncaps);
+}
+
+static inline void rx_thread_list_clear(rx_thread_list *l)
+{
+    l->nthreads = 0;
+    l->gen++;
+}
+
+/* Add a thread at POS with captures CAPS to the list L, following
+   epsilon transitions in priority order.  INPUT is the current input
+   position, PREV is the context of the previous character, and C is the
+   next character.  CAPS is modified during the operation but restored
+   at the end. */
+static void rx_pike_add(rx_pike *pk, rx_thread_list *l, int pos0,
+                        const char **caps, const char *input,
+                        int prev, ScmChar c)
+{
+    ScmRegexpDFA *dfa = pk->dfa;
+    ScmRegexp *rx = dfa->rx;
+    const unsigned char *code = rx->code;
+    rx_pike_frame *stack = pk->stack;
+    int sp = 0;
+
+    stack[sp++].pos = pos0;
+    while (sp > 0) {
+        rx_pike_frame *f = &stack[--sp];
+        if (f->pos < 0) {
+            caps[f->capi] = f->old;
+            continue;
+        }
+        int pos = f->pos;
+        if (l->mark[pos] == l->gen) continue;
+        l->mark[pos] = l->gen;
+        int pc = dfa->insn[pos];
+        if (pc == pos) {
+            switch (code[pc]) {
+            case RE_TRY:
+                stack[sp++].pos = code[pc+1]*256 + code[pc+2];
+                stack[sp++].pos = pc+3;
+                continue;
+            case RE_JUMP:
+                stack[sp++].pos = code[pc+1]*256 + code[pc+2];
+                continue;
+            case RE_BEGIN: case RE_END: {
+                int capi = code[pc+1]*2 + (code[pc] == RE_END);
+                stack[sp].pos = -1;
+                stack[sp].capi = capi;
+                stack[sp].old = caps[capi];
+                sp++;
+                caps[capi] = input;
+                stack[sp++].pos = pc+2;
+                continue;
+            }
+            case RE_BOS: case RE_EOS: case RE_BOL: case RE_EOL:
+            case RE_BOW: case RE_EOW: case RE_WB: case RE_NWB:
+                if (rx_assertion_ok(rx, code[pc], prev, c)) {
+                    stack[sp++].pos = pc+1;
+                }
+                continue;
+            case RE_FAIL:
+                continue;
+            case RE_SET1R: case RE_NSET1R: case RE_SETR: case RE_NSETR:
+            case RE_MATCH1R: case RE_MATCHR: case RE_ANYR:
+                if (!rx_repeat_ok(rx, pc, c)) {
+                    stack[sp++].pos = rx_repeat_next(code, pc);
+                    continue;
+                }
+                break;
+            }
+        }
+        /* POS is a consumer or RE_SUCCESS.  Make it a thread. */
+        int n = l->nthreads++;
+        l->pos[n] = pos;
+        memcpy(&l->caps[n*pk->ncaps], caps, sizeof(const char*)*pk->ncaps);
+    }
+}
+
+/* Runs Pike VM.  If there's a match, fills ctx->matches and returns TRUE.
+   Ctx->input must be the start of the match. */
+static int rx_pike_run(ScmRegexpDFA *dfa, struct match_ctx *ctx)
+{
+    ScmRegexp *rx = dfa->rx;
+    rx_pike pk;
+    rx_thread_list l0, l1, *clist = &l0, *nlist = &l1;
+    int ncaps = rx->numGroups * 2;
+    const char **caps = SCM_NEW_ATOMIC_ARRAY(const char*, ncaps);
+    const char **mcaps = SCM_NEW_ATOMIC_ARRAY(const char*, ncaps);
+    const char *p = ctx->input, *stop = ctx->stop;
+    int prev = RX_CTX_BOS, matched = FALSE;
+    ScmChar c = RX_EOS;
+
+    pk.dfa = dfa;
+    pk.ncaps = ncaps;
+    pk.stack = SCM_NEW_ATOMIC_ARRAY(rx_pike_frame, 2*dfa->npos+1);
+    rx_thread_list_init(clist, dfa, ncaps);
+    rx_thread_list_init(nlist, dfa, ncaps);
+    rx_thread_list_clear(clist);
+
+    if (p < stop) SCM_CHAR_GET(p, c);
+    for (;;) {
+        if (!matched && (p == ctx->input || !dfa->anchored)) {
+            for (int i = 0; i < ncaps; i++) caps[i] = NULL;
+            rx_pike_add(&pk, clist, 0, caps, p, prev, c);
+        }
+        if (clist->nthreads == 0 && (matched || dfa->anchored)) break;
+
+        const char *np = p;
+        ScmChar nc = RX_EOS;
+        int nprev = 0;
+        if (c != RX_EOS) {
+            np = p + SCM_CHAR_NBYTES(c);
+            if (np < stop) SCM_CHAR_GET(np, nc);
+            nprev = rx_char_context(c);
+        }
+        rx_thread_list_clear(nlist);
+        for (int i = 0; i < clist->nthreads; i++) {
+            int pos = clist->pos[i];
+            const char **tcaps = &clist->caps[i*ncaps];
+            if (dfa->insn[pos] == pos && rx->code[pos] == RE_SUCCESS) {
+                /* Lower priority threads are cut off. */
+                memcpy(mcaps, tcaps, sizeof(const char*)*ncaps);
+                matched = TRUE;
+                break;
+            }
+            if (c == RX_EOS) continue;
+            int next = rx_consume(dfa, pos, c);
+            if (next >= 0) rx_pike_add(&pk, nlist, next, tcaps, np, nprev, nc);
+        }
+        if (c == RX_EOS) break;
+        rx_thread_list *t = clist; clist = nlist; nlist = t;
+        p = np;
+        c = nc;
+        prev = nprev;
+    }
+
+    if (!matched) return FALSE;
+    for (int i = 0; i < rx->numGroups; i++) {
+        ctx->matches[i]->startp = mcaps[i*2];
+        ctx->matches[i]->endp = mcaps[i*2+1];
+    }
+    return TRUE;
+}
+
+/* Matcher entry using the DFA.  Returns SCM_UNBOUND if we can't
+   use the DFA for this input and need to fall back to rex_rec. */
+static ScmObj rex_dfa(ScmRegexp *rx, ScmString *orig,
+                      const char *start, const char *end)
+{
+    ScmRegexpDFA *dfa = rx->dfa;
+    int r = rx_dfa_search(dfa, start, end);
+    if (r == 0) return SCM_FALSE;
+    if (dfa->nslots * rx->numGroups * 2 > RX_PIKE_MAX_CAPS) {
+        /* Too big for Pike VM.  If we know there's a match,
+           backtracking matcher can find it.  */
+        return SCM_UNBOUND;
+    }
+
+    struct match_ctx ctx;
+    ctx.rx = rx;
+    ctx.codehead = rx->code;
+    ctx.input = start;
+    ctx.stop = end;
+    ctx.begin_stack = (void*)&ctx;
+    ctx.cont = NULL;
+    ctx.grapheme_predicate = SCM_UNDEFINED;
+    ctx.matches = SCM_NEW_ARRAY(struct ScmRegMatchSub *, rx->numGroups);
+    for (int i = 0; i < rx->numGroups; i++) {
+        ctx.matches[i] = SCM_NEW(struct ScmRegMatchSub);
+        ctx.matches[i]->start = -1;
+        ctx.matches[i]->length = -1;
+        ctx.matches[i]->after = -1;
+        ctx.matches[i]->startp = NULL;
+        ctx.matches[i]->endp = NULL;
+    }
+    if (!rx_pike_run(dfa, &ctx)) return SCM_FALSE;
+    return make_match(rx, orig, &ctx);
+}
+
 /*----------------------------------------------------------------------
  * entry point
  */
@@ -2827,6 +3679,12 @@ ScmObj Scm_RegExec(ScmRegexp *rx, ScmString *str, ScmObj start_scm, ScmObj end_s
         Scm_Error("invalid start/end parameter: %S %S", start_scm, end_scm);
     }
     start_limit = end - mustMatchLen;
+
+    /* If the regexp doesn't require backtracking, we use DFA. */
+    if (rx->dfa) {
+        ScmObj r = rex_dfa(rx, str, start, end);
+        if (!SCM_UNBOUNDP(r)) return r;
+    }
 #if 0
     /* Disabled for now; we need to use more heuristics to determine
        when we should apply mustMatch.  For example, if the regexp
@@ -2878,6 +3736,391 @@ ScmObj Scm_RegExec(ScmRegexp *rx, ScmString *str, ScmObj start_scm, ScmObj end_s
     return SCM_FALSE;
 }
 
+/*=======================================================================
+ * Regexp set
+ */
+
+/* A regexp set matches an input against multiple regexps at once, and
+ * tells which of them match.  It doesn't give match positions or
+ * submatches; once we know which regexps match, the caller can run
+ * individual regexps to get them.
+ *
+ * Regexps that can be run with the lazy DFA are combined into a single
+ * lazy DFA.  A position of the combined DFA is (index << 16) | pos, where
+ * index is the index of the regexp in the set and pos is the position
+ * within the regexp.  A state also keeps the set of regexps that have
+ * already matched; once a regexp matches, its positions are dropped
+ * from the subsequent states.  So the input is scanned only once, and
+ * we can stop as soon as no positions are left.
+ *
+ * Regexps that need backtracking, and those too large to fit in the
+ * position encoding, are run individually by Scm_RegExec.
+ *
+ * The number of states grows with the number of regexps, so the cap of
+ * the state cache is scaled to it (sd->maxstates).  When the cache is
+ * full we flush it as the single-regexp DFA does, but we don't count
+ * the flushes; rebuilding states is still cheaper than running each
+ * regexp.  Instead, we give up the DFA and run the regexps individually
+ * only if a single search builds more than sd->budget bytes of states.
+ */
+
+#define RX_SET_MAX_CODES    0x10000 /* max code size of a regexp in DFA */
+#define RX_SET_MAX_DFA      0x7fff  /* max # of regexps in DFA */
+#define RX_SET_STATES_PER_RX 16     /* # of states we keep per regexp */
+#define RX_SET_MAX_STATES   0x4000  /* cap of sd->maxstates */
+#define RX_SET_BUDGET       0x2000000 /* default sd->budget, in bytes */
+#define RX_SET_INDEX(p)     ((p) >> 16)
+#define RX_SET_POS(p)       ((p) & 0xffff)
+#define RX_SET_BITS         (SIZEOF_LONG*8)
+
+typedef struct rx_set_state_rec rx_set_state;
+
+struct rx_set_state_rec {
+    ScmAtomicVar next[128];     /* cached transitions by ASCII chars.
+                                   0 if not computed yet. */
+    ScmAtomicVar wide;          /* rx_wide_table* for non-ASCII chars,
+                                   0 if none is computed yet. */
+    rx_set_state *chain;        /* hash chain */
+    u_long hashval;
+    int context;                /* RX_CTX_* of the previous char */
+    u_long *matched;            /* bitmap of regexps matched so far */
+    ScmAtomicVar accepted;      /* bitmap of regexps matched at the end of
+                                   input, or 0 if not computed yet */
+    int npos;                   /* # of positions */
+    int pos[1];                 /* positions, sorted (variable length) */
+};
+
+typedef struct ScmRegexpSetDFARec {
+    int ndfa;                   /* # of regexps in the DFA */
+    ScmRegexpDFA **dfas;        /* DFAs of the regexps, or NULL if the
+                                   regexp is run individually */
+    int *offset;                /* offset[i] - index of mark arrays
+                                   where the regexp i begins */
+    int nwords;                 /* # of words of bitmaps */
+    int ctxmask;                /* RX_CTX_* bits that matter */
+    int maxstates;              /* cap of # of states we keep */
+    int tablesize;              /* # of buckets of state table.
+                                   power of 2 */
+    size_t budget;              /* we give up DFA if a search allocates
+                                   more than this bytes of states */
+    ScmAtomicVar start;         /* start state, or 0 if not computed yet */
+
+    /* The following slots are protected by mutex. */
+    ScmInternalMutex mutex;
+    rx_set_state **table;       /* state table */
+    int nstates;                /* # of states in the table */
+    size_t allocated;           /* total bytes of states and transition
+                                   tables ever allocated */
+    /* work area to compute transitions */
+    u_long gen;
+    u_long *mark;
+    u_long *omark;
+    int *stack;
+    int *in;
+    int *result;
+    u_long *bits;
+} ScmRegexpSetDFA;
+
+static void regexp_set_print(ScmObj obj, ScmPort *port,
+                             ScmWriteContext *ctx SCM_UNUSED)
+{
+    Scm_Printf(port, "#<regexp-set %d>", SCM_REGEXP_SET(obj)->numRegexps);
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_RegexpSetClass, regexp_set_print);
+
+static ScmRegexpSetDFA *rx_set_prepare(ScmRegexp **rxs, int n)
+{
+    ScmRegexpSetDFA *sd = SCM_NEW(ScmRegexpSetDFA);
+    int npos = 0, maxpos = 0;
+
+    sd->ndfa = 0;
+    sd->dfas = SCM_NEW_ARRAY(ScmRegexpDFA*, n);
+    sd->offset = SCM_NEW_ATOMIC_ARRAY(int, n);
+    sd->ctxmask = 0;
+    for (int i = 0; i < n; i++) {
+        ScmRegexpDFA *dfa = rxs[i]->dfa;
+        sd->offset[i] = npos;
+        if (dfa == NULL || dfa->npos > RX_SET_MAX_CODES
+            || sd->ndfa >= RX_SET_MAX_DFA) {
+            sd->dfas[i] = NULL;
+            continue;
+        }
+        sd->dfas[i] = dfa;
+        sd->ndfa++;
+        sd->ctxmask |= dfa->ctxmask;
+        npos += dfa->npos;
+        if (dfa->npos > maxpos) maxpos = dfa->npos;
+    }
+    sd->nwords = (n + RX_SET_BITS - 1) / RX_SET_BITS;
+    sd->maxstates = RX_DFA_MAX_STATES;
+    if (sd->ndfa > RX_SET_MAX_STATES / RX_SET_STATES_PER_RX) {
+        sd->maxstates = RX_SET_MAX_STATES;
+    } else if (sd->ndfa * RX_SET_STATES_PER_RX > sd->maxstates) {
+        sd->maxstates = sd->ndfa * RX_SET_STATES_PER_RX;
+    }
+    sd->tablesize = RX_DFA_TABLE_SIZE;
+    while (sd->tablesize < sd->maxstates/2) sd->tablesize *= 2;
+    sd->budget = RX_SET_BUDGET;
+    sd->start = 0;
+    SCM_INTERNAL_MUTEX_INIT(sd->mutex);
+    sd->table = SCM_NEW_ARRAY(rx_set_state*, sd->tablesize);
+    sd->nstates = 0;
+    sd->allocated = 0;
+    sd->gen = 0;
+    sd->mark = SCM_NEW_ATOMIC_ARRAY(u_long, npos);
+    sd->omark = SCM_NEW_ATOMIC_ARRAY(u_long, npos);
+    for (int i = 0; i < npos; i++) sd->mark[i] = sd->omark[i] = 0;
+    sd->stack = SCM_NEW_ATOMIC_ARRAY(int, 3*maxpos+1);
+    sd->in = SCM_NEW_ATOMIC_ARRAY(int, maxpos+1);
+    sd->result = SCM_NEW_ATOMIC_ARRAY(int, npos+1);
+    sd->bits = SCM_NEW_ATOMIC_ARRAY(u_long, sd->nwords+1);
+    return sd;
+}
+
+static inline int rx_set_bit_p(const u_long *bits, int i)
+{
+    return (bits[i/RX_SET_BITS] >> (i%RX_SET_BITS)) & 1;
+}
+
+static inline void rx_set_bit(u_long *bits, int i)
+{
+    bits[i/RX_SET_BITS] |= 1UL << (i%RX_SET_BITS);
+}
+
+static void rx_set_flush(ScmRegexpSetDFA *sd)
+{
+    sd->table = SCM_NEW_ARRAY(rx_set_state*, sd->tablesize);
+    sd->nstates = 0;
+    Scm_AtomicStore(&sd->start, 0);
+}
+
+/* Look up a state, or create a new one.  MATCHED is a bitmap of
+   sd->nwords.  Called with sd->mutex held.  POS may be sorted in place. */
+static rx_set_state *rx_set_intern(ScmRegexpSetDFA *sd, int context,
+                                   const u_long *matched, int *pos, int npos)
+{
+    qsort(pos, npos, sizeof(int), rx_dfa_pos_compare);
+    context &= sd->ctxmask;
+    u_long h = rx_dfa_hash(context, pos, npos);
+    for (int i = 0; i < sd->nwords; i++) h = h*31 + matched[i];
+    rx_set_state **bucket = &sd->table[h & (sd->tablesize-1)];
+    for (rx_set_state *s = *bucket; s; s = s->chain) {
+        if (s->hashval == h && s->context == context && s->npos == npos
+            && memcmp(s->pos, pos, sizeof(int)*npos) == 0
+            && memcmp(s->matched, matched, sizeof(u_long)*sd->nwords) == 0) {
+            return s;
+        }
+    }
+    if (sd->nstates >= sd->maxstates) {
+        rx_set_flush(sd);
+        bucket = &sd->table[h & (sd->tablesize-1)];
+    }
+    size_t size = sizeof(rx_set_state)+sizeof(int)*(npos-1);
+    rx_set_state *s = SCM_NEW2(rx_set_state*, size);
+    for (int i = 0; i < 128; i++) s->next[i] = 0;
+    s->wide = 0;
+    s->hashval = h;
+    s->context = context;
+    s->matched = SCM_NEW_ATOMIC_ARRAY(u_long, sd->nwords+1);
+    memcpy(s->matched, matched, sizeof(u_long)*sd->nwords);
+    s->accepted = 0;
+    s->npos = npos;
+    memcpy(s->pos, pos, sizeof(int)*npos);
+    s->chain = *bucket;
+    *bucket = s;
+    sd->nstates++;
+    sd->allocated += size + sizeof(u_long)*(sd->nwords+1);
+    return s;
+}
+
+/* Computes the transition of state S by the next char C.  The positions
+   are stored in sd->result, and the regexps matched so far in sd->bits.
+   Returns the number of resulting positions.
+   Called with sd->mutex held. */
+static int rx_set_step(ScmRegexpSetDFA *sd, int n, rx_set_state *s,
+                       ScmChar c)
+{
+    u_long gen = ++sd->gen;
+    int nresult = 0;
+
+    memcpy(sd->bits, s->matched, sizeof(u_long)*sd->nwords);
+    for (int k = 0; k < s->npos; ) {
+        int index = RX_SET_INDEX(s->pos[k]), j = k;
+        for (; j < s->npos && RX_SET_INDEX(s->pos[j]) == index; j++) {
+            sd->in[j-k] = RX_SET_POS(s->pos[j]);
+        }
+        int off = sd->offset[index];
+        int *res = sd->result + nresult;
+        int r = rx_closure(sd->dfas[index], s->context, c, sd->in, j-k, gen,
+                           sd->mark + off, sd->omark + off, sd->stack, res);
+        if (r < 0) {
+            rx_set_bit(sd->bits, index);
+        } else {
+            for (int i = 0; i < r; i++) res[i] |= index << 16;
+            nresult += r;
+        }
+        k = j;
+    }
+    if (c == RX_EOS) return nresult;
+    /* A match can start from the next char for unanchored regexps. */
+    for (int i = 0; i < n; i++) {
+        ScmRegexpDFA *dfa = sd->dfas[i];
+        if (dfa == NULL || dfa->anchored || rx_set_bit_p(sd->bits, i))
+            continue;
+        int off = sd->offset[i];
+        if (sd->omark[off] != gen) {
+            sd->omark[off] = gen;
+            sd->result[nresult++] = i << 16;
+        }
+    }
+    return nresult;
+}
+
+/* Compute the transition from S by C.  *USED accumulates the bytes
+   of states allocated during the search.  If it exceeds the budget,
+   returns NULL. */
+static rx_set_state *rx_set_transit(ScmRegexpSetDFA *sd, int n,
+                                    rx_set_state *s, ScmChar c,
+                                    size_t *used)
+{
+    SCM_INTERNAL_MUTEX_LOCK(sd->mutex);
+    size_t allocated = sd->allocated;
+    int nresult = rx_set_step(sd, n, s, c);
+    rx_set_state *ns = rx_set_intern(sd, rx_char_context(c), sd->bits,
+                                     sd->result, nresult);
+    if (c >= 128) sd->allocated += rx_wide_insert(&s->wide, c, ns);
+    allocated = sd->allocated - allocated;
+    SCM_INTERNAL_MUTEX_UNLOCK(sd->mutex);
+    if (c < 128) Scm_AtomicStoreFull(&s->next[c], (ScmAtomicWord)ns);
+    *used += allocated;
+    if (*used > sd->budget) return NULL;
+    return ns;
+}
+
+static rx_set_state *rx_set_start_state(ScmRegexpSetDFA *sd, int n)
+{
+    rx_set_state *s = (rx_set_state*)Scm_AtomicLoad(&sd->start);
+    if (s == NULL) {
+        int npos = 0;
+        SCM_INTERNAL_MUTEX_LOCK(sd->mutex);
+        for (int i = 0; i < n; i++) {
+            if (sd->dfas[i]) sd->result[npos++] = i << 16;
+        }
+        for (int i = 0; i < sd->nwords; i++) sd->bits[i] = 0;
+        s = rx_set_intern(sd, RX_CTX_BOS, sd->bits, sd->result, npos);
+        Scm_AtomicStoreFull(&sd->start, (ScmAtomicWord)s);
+        SCM_INTERNAL_MUTEX_UNLOCK(sd->mutex);
+    }
+    return s;
+}
+
+/* Run the combined DFA over [start, stop).  Returns a bitmap of the
+   matched regexps, or NULL if we gave up. */
+static const u_long *rx_set_search(ScmRegexpSetDFA *sd, int n,
+                                   const char *start, const char *stop)
+{
+    rx_set_state *s = rx_set_start_state(sd, n);
+    const char *p = start;
+    size_t used = 0;
+
+    while (p < stop) {
+        unsigned char b = (unsigned char)*p;
+        rx_set_state *ns;
+        if (s->npos == 0) return s->matched; /* nothing more can match */
+        if (b < 128) {
+            ns = (rx_set_state*)Scm_AtomicLoad(&s->next[b]);
+            if (ns == NULL) ns = rx_set_transit(sd, n, s, b, &used);
+            p++;
+        } else {
+            ScmChar ch;
+            SCM_CHAR_GET(p, ch);
+            ns = (rx_set_state*)rx_wide_lookup(&s->wide, ch);
+            if (ns == NULL) ns = rx_set_transit(sd, n, s, ch, &used);
+            p += SCM_CHAR_NFOLLOWS(b) + 1;
+        }
+        if (ns == NULL) return NULL;
+        s = ns;
+    }
+
+    u_long *accepted = (u_long*)Scm_AtomicLoad(&s->accepted);
+    if (accepted == NULL) {
+        accepted = SCM_NEW_ATOMIC_ARRAY(u_long, sd->nwords+1);
+        SCM_INTERNAL_MUTEX_LOCK(sd->mutex);
+        (void)rx_set_step(sd, n, s, RX_EOS);
+        memcpy(accepted, sd->bits, sizeof(u_long)*sd->nwords);
+        SCM_INTERNAL_MUTEX_UNLOCK(sd->mutex);
+        Scm_AtomicStoreFull(&s->accepted, (ScmAtomicWord)accepted);
+    }
+    return accepted;
+}
+
+ScmObj Scm_MakeRegexpSet(ScmObj regexps)
+{
+    int n = Scm_Length(regexps);
+    if (n < 0) SCM_TYPE_ERROR(regexps, "list");
+
+    ScmObj h = SCM_NIL, t = SCM_NIL, cp;
+    ScmRegexp **rxs = SCM_NEW_ARRAY(ScmRegexp*, n+1);
+    int i = 0;
+    SCM_FOR_EACH(cp, regexps) {
+        ScmObj rx = SCM_CAR(cp);
+        if (SCM_STRINGP(rx)) {
+            rx = Scm_RegComp(SCM_STRING(rx), 0);
+        } else if (!SCM_REGEXPP(rx)) {
+            SCM_TYPE_ERROR(rx, "regexp or string");
+        }
+        rxs[i++] = SCM_REGEXP(rx);
+        SCM_APPEND1(h, t, rx);
+    }
+
+    ScmRegexpSet *rs = SCM_NEW(ScmRegexpSet);
+    SCM_SET_CLASS(rs, SCM_CLASS_REGEXP_SET);
+    rs->regexps = h;
+    rs->numRegexps = n;
+    rs->rxs = rxs;
+    rs->dfa = rx_set_prepare(rxs, n);
+    return SCM_OBJ(rs);
+}
+
+/* Returns a list of indexes of regexps that match INPUT, in
+   ascending order. */
+ScmObj Scm_RegexpSetMatch(ScmRegexpSet *rs, ScmString *input,
+                          ScmObj start_scm, ScmObj end_scm)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(input);
+    const char *start =
+        Scm_StringCursorPointer(b, start_scm, STRING_CURSOR_FALLBACK_TO_START);
+    const char *end =
+        Scm_StringCursorPointer(b, end_scm, STRING_CURSOR_FALLBACK_TO_END);
+    ScmRegexpSetDFA *sd = rs->dfa;
+    int n = rs->numRegexps;
+
+    if (SCM_STRING_INCOMPLETE_P(input)) {
+        Scm_Error("incomplete string is not allowed: %S", input);
+    }
+    if (end < start) {
+        Scm_Error("invalid start/end parameter: %S %S", start_scm, end_scm);
+    }
+
+    const u_long *matched = NULL;
+    if (sd->ndfa > 0) matched = rx_set_search(sd, n, start, end);
+
+    ScmObj r = SCM_NIL;
+    for (int i = n-1; i >= 0; i--) {
+        if (sd->dfas[i] && matched) {
+            if (rx_set_bit_p(matched, i)) r = Scm_Cons(SCM_MAKE_INT(i), r);
+        } else {
+            /* Not in the DFA, or we gave up the DFA. */
+            if (!SCM_FALSEP(Scm_RegExec(rs->rxs[i], input,
+                                        start_scm, end_scm))) {
+                r = Scm_Cons(SCM_MAKE_INT(i), r);
+            }
+        }
+    }
+    return r;
+}
+
 /*=======================================================================
  * Retrieving matches
  */
@@ -85,6 +85,12 @@ static int win_wait_for_handles(HANDLE *handles, int nhandles, int options,
 #ifdef HAVE_SCHED_H
 #include <sched.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 
 /*
  * Auxiliary system interface functions.   See libsys.scm for
@@ -2338,6 +2344,369 @@ ScmObj Scm_SysSelectX(ScmObj rfds, ScmObj wfds, ScmObj efds, ScmObj timeout)
     return select_int(r, w, e, timeout);
 }
 
+/*===============================================================
+ * poller
+ *
+ *  A thin wrapper of epoll(7), or poll(2) as a fallback.  Unlike
+ *  select, the interest set lives in the poller (the kernel, in case
+ *  of epoll), so registering is O(1) and waiting returns only the
+ *  descriptors that are ready.  It doesn't have FD_SETSIZE limit, either.
+ *
+ *  A poller isn't MT-safe; it is meant to be owned by an event loop
+ *  running in a single thread.
+ */
+
+#ifdef SCM_HAVE_SYS_POLLER
+
+struct ScmSysPollerRec {
+    SCM_HEADER;
+    int kind;                   /* SCM_SYS_POLLER_EPOLL or _POLL */
+    int closed;
+    int epfd;                   /* epoll */
+#if defined(HAVE_POLL_H)
+    /* For epoll, these hold the descriptors epoll doesn't support
+       (see Scm_SysPollerAdd). */
+    struct pollfd *pfds;        /* poll: interest set, packed */
+    u_long *masks;              /* poll: requested mask for each pfds[i] */
+    int npfds;
+    int pfdsSize;
+    int *slots;                 /* poll: fd -> index of pfds, or -1 */
+    int slotsSize;
+#endif
+};
+
+/* Max # of events we receive by a single epoll_wait call.  The rest is
+   retrieved by the next call. */
+#define POLLER_EVENT_MAX 256
+
+static void poller_print(ScmObj obj, ScmPort *port,
+                         ScmWriteContext *ctx SCM_UNUSED)
+{
+    ScmSysPoller *p = SCM_SYS_POLLER(obj);
+    Scm_Printf(port, "#<sys-poller %s%s>",
+               (p->kind == SCM_SYS_POLLER_EPOLL ? "epoll" : "poll"),
+               (p->closed ? " (closed)" : ""));
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_SysPollerClass, poller_print);
+
+static void poller_finalize(ScmObj obj, void *data SCM_UNUSED)
+{
+    Scm_SysPollerClose(SCM_SYS_POLLER(obj));
+}
+
+static void poller_check(ScmSysPoller *p)
+{
+    if (p->closed) Scm_Error("poller already closed: %S", SCM_OBJ(p));
+}
+
+ScmObj Scm_MakeSysPoller(int kind)
+{
+    if (kind == SCM_SYS_POLLER_DEFAULT) {
+#if defined(HAVE_SYS_EPOLL_H)
+        kind = SCM_SYS_POLLER_EPOLL;
+#else
+        kind = SCM_SYS_POLLER_POLL;
+#endif
+    }
+#if !defined(HAVE_SYS_EPOLL_H)
+    if (kind == SCM_SYS_POLLER_EPOLL)
+        Scm_Error("epoll isn't supported on this platform");
+#endif
+#if !defined(HAVE_POLL_H)
+    if (kind == SCM_SYS_POLLER_POLL)
+        Scm_Error("poll isn't supported on this platform");
+#endif
+
+    ScmSysPoller *p = SCM_NEW(ScmSysPoller);
+    SCM_SET_CLASS(p, SCM_CLASS_SYS_POLLER);
+    p->kind = kind;
+    p->closed = FALSE;
+    p->epfd = -1;
+#if defined(HAVE_POLL_H)
+    p->pfds = NULL;
+    p->masks = NULL;
+    p->npfds = p->pfdsSize = 0;
+    p->slots = NULL;
+    p->slotsSize = 0;
+#endif
+#if defined(HAVE_SYS_EPOLL_H)
+    if (kind == SCM_SYS_POLLER_EPOLL) {
+        int fd;
+        SCM_SYSCALL(fd, epoll_create1(EPOLL_CLOEXEC));
+        if (fd < 0) Scm_SysError("epoll_create1 failed");
+        p->epfd = fd;
+        Scm_RegisterFinalizer(SCM_OBJ(p), poller_finalize, NULL);
+    }
+#endif
+    return SCM_OBJ(p);
+}
+
+int Scm_SysPollerKind(ScmSysPoller *p)
+{
+    return p->kind;
+}
+
+#if defined(HAVE_SYS_EPOLL_H)
+static uint32_t epoll_events(u_long mask)
+{
+    uint32_t e = 0;
+    if (mask & SCM_SYS_POLL_READ)   e |= EPOLLIN;
+    if (mask & SCM_SYS_POLL_WRITE)  e |= EPOLLOUT;
+    if (mask & SCM_SYS_POLL_EXCEPT) e |= EPOLLPRI;
+    if (mask & SCM_SYS_POLL_EDGE)   e |= EPOLLET;
+    return e;
+}
+#endif /*HAVE_SYS_EPOLL_H*/
+
+#if defined(HAVE_POLL_H)
+static short poll_events(u_long mask)
+{
+    short e = 0;
+    if (mask & SCM_SYS_POLL_READ)   e |= POLLIN;
+    if (mask & SCM_SYS_POLL_WRITE)  e |= POLLOUT;
+    if (mask & SCM_SYS_POLL_EXCEPT) e |= POLLPRI;
+    return e;
+}
+
+static int poll_slot(ScmSysPoller *p, int fd)
+{
+    if (fd >= p->slotsSize) return -1;
+    return p->slots[fd];
+}
+
+static void poll_add(ScmSysPoller *p, int fd, u_long events)
+{
+    int i = poll_slot(p, fd);
+    if (i < 0) {
+        if (fd >= p->slotsSize) {
+            int newsize = (p->slotsSize ? p->slotsSize : 64);
+            while (newsize <= fd) newsize *= 2;
+            int *newslots = SCM_NEW_ATOMIC_ARRAY(int, newsize);
+            if (p->slotsSize > 0) {
+                memcpy(newslots, p->slots, p->slotsSize * sizeof(int));
+            }
+            for (int k = p->slotsSize; k < newsize; k++) newslots[k] = -1;
+            p->slots = newslots;
+            p->slotsSize = newsize;
+        }
+        if (p->npfds == p->pfdsSize) {
+            int newsize = (p->pfdsSize ? p->pfdsSize*2 : 16);
+            struct pollfd *newpfds =
+                SCM_NEW_ATOMIC_ARRAY(struct pollfd, newsize);
+            u_long *newmasks = SCM_NEW_ATOMIC_ARRAY(u_long, newsize);
+            if (p->npfds > 0) {
+                memcpy(newpfds, p->pfds, p->npfds * sizeof(struct pollfd));
+                memcpy(newmasks, p->masks, p->npfds * sizeof(u_long));
+            }
+            p->pfds = newpfds;
+            p->masks = newmasks;
+            p->pfdsSize = newsize;
+        }
+        i = p->npfds++;
+        p->slots[fd] = i;
+        p->pfds[i].fd = fd;
+    }
+    p->pfds[i].events = poll_events(events);
+    p->pfds[i].revents = 0;
+    p->masks[i] = events;
+}
+
+/* Returns TRUE if FD was registered. */
+static int poll_delete(ScmSysPoller *p, int fd)
+{
+    int i = poll_slot(p, fd);
+    if (i < 0) return FALSE;
+    /* Move the last entry to fill the hole, to keep pfds packed. */
+    int last = --p->npfds;
+    if (i != last) {
+        p->pfds[i] = p->pfds[last];
+        p->masks[i] = p->masks[last];
+        p->slots[p->pfds[i].fd] = i;
+    }
+    p->slots[fd] = -1;
+    return TRUE;
+}
+#endif /*HAVE_POLL_H*/
+
+/* Translate the kernel's report to the mask, limited to the conditions
+   the caller asked.  Errors and hangups are reported as readable and
+   writable, like select does, so that the handler gets a chance to see
+   the error by the subsequent I/O operation. */
+static u_long poller_result(u_long want, int in, int out, int pri,
+                            int err, int hup)
+{
+    u_long r = 0;
+    if ((want & SCM_SYS_POLL_READ) && (in || err || hup))
+        r |= SCM_SYS_POLL_READ;
+    if ((want & SCM_SYS_POLL_WRITE) && (out || err || hup))
+        r |= SCM_SYS_POLL_WRITE;
+    if ((want & SCM_SYS_POLL_EXCEPT) && pri)
+        r |= SCM_SYS_POLL_EXCEPT;
+    return r;
+}
+
+/* Registers FD with the condition EVENTS.  If FD is already registered,
+   its condition is replaced.
+
+   epoll refuses regular files and directories with EPERM.  poll and
+   select always report them ready for reading and writing, so we do the
+   same: such descriptors are kept in the poll interest set of the
+   poller, and Scm_SysPollerWait reports them without asking the kernel.
+   The edge flag has no effect on them. */
+void Scm_SysPollerAdd(ScmSysPoller *p, int fd, u_long events)
+{
+    poller_check(p);
+    if (fd < 0) Scm_Error("invalid file descriptor: %d", fd);
+    events &= (SCM_SYS_POLL_READ|SCM_SYS_POLL_WRITE
+               |SCM_SYS_POLL_EXCEPT|SCM_SYS_POLL_EDGE);
+
+#if defined(HAVE_SYS_EPOLL_H)
+    if (p->kind == SCM_SYS_POLLER_EPOLL) {
+        struct epoll_event ev;
+        int r;
+        ev.events = epoll_events(events);
+        /* We keep the requested mask along with fd, so that we can
+           filter the result without looking up a table. */
+        ev.data.u64 = ((uint64_t)events << 32) | (uint32_t)fd;
+        SCM_SYSCALL(r, epoll_ctl(p->epfd, EPOLL_CTL_MOD, fd, &ev));
+        if (r < 0 && errno == ENOENT) {
+            SCM_SYSCALL(r, epoll_ctl(p->epfd, EPOLL_CTL_ADD, fd, &ev));
+        }
+#if defined(HAVE_POLL_H)
+        if (r < 0 && errno == EPERM) {
+            poll_add(p, fd, events);
+            return;
+        }
+        if (r == 0) {
+            /* FD may have been closed and reused for another file. */
+            poll_delete(p, fd);
+        }
+#endif /*HAVE_POLL_H*/
+        if (r < 0) Scm_SysError("epoll_ctl failed on fd %d", fd);
+        return;
+    }
+#endif /*HAVE_SYS_EPOLL_H*/
+#if defined(HAVE_POLL_H)
+    poll_add(p, fd, events);
+#endif /*HAVE_POLL_H*/
+}
+
+/* Unregisters FD.  It's not an error if FD isn't registered; notably,
+   epoll automatically forgets a descriptor once it is closed. */
+void Scm_SysPollerDelete(ScmSysPoller *p, int fd)
+{
+    poller_check(p);
+    if (fd < 0) return;
+#if defined(HAVE_SYS_EPOLL_H)
+    if (p->kind == SCM_SYS_POLLER_EPOLL) {
+        struct epoll_event ev;  /* for kernels before 2.6.9 */
+        int r;
+#if defined(HAVE_POLL_H)
+        if (poll_delete(p, fd)) return;
+#endif /*HAVE_POLL_H*/
+        SCM_SYSCALL(r, epoll_ctl(p->epfd, EPOLL_CTL_DEL, fd, &ev));
+        if (r < 0 && errno != ENOENT && errno != EBADF) {
+            Scm_SysError("epoll_ctl failed on fd %d", fd);
+        }
+        return;
+    }
+#endif /*HAVE_SYS_EPOLL_H*/
+#if defined(HAVE_POLL_H)
+    poll_delete(p, fd);
+#endif /*HAVE_POLL_H*/
+}
+
+/* Waits until any of registered descriptors gets ready, or timeout
+   expires.  TIMEOUT is the same as sys-select's.  Returns a list of
+   (fd . mask) for ready descriptors; an empty list means timeout. */
+ScmObj Scm_SysPollerWait(ScmSysPoller *p, ScmObj timeout)
+{
+    struct timeval tv, *ptv = select_timeval(timeout, &tv);
+    int msec = -1;
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+
+    poller_check(p);
+    if (ptv) {
+        /* Round up, so that we won't wake up before the deadline. */
+        long long ms = (long long)ptv->tv_sec * 1000
+            + ((long long)ptv->tv_usec + 999) / 1000;
+        msec = (ms > INT_MAX) ? INT_MAX : (int)ms;
+    }
+
+#if defined(HAVE_SYS_EPOLL_H)
+    if (p->kind == SCM_SYS_POLLER_EPOLL) {
+        struct epoll_event evs[POLLER_EVENT_MAX];
+        int n;
+#if defined(HAVE_POLL_H)
+        /* Descriptors epoll refused are always ready. */
+        for (int i = 0; i < p->npfds; i++) {
+            u_long r = poller_result(p->masks[i], TRUE, TRUE, FALSE,
+                                     FALSE, FALSE);
+            if (r) {
+                SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(p->pfds[i].fd),
+                                           Scm_MakeIntegerU(r)));
+            }
+        }
+        if (!SCM_NULLP(h)) msec = 0;
+#endif /*HAVE_POLL_H*/
+        SCM_SYSCALL(n, epoll_wait(p->epfd, evs, POLLER_EVENT_MAX, msec));
+        if (n < 0) Scm_SysError("epoll_wait failed");
+        for (int i = 0; i < n; i++) {
+            uint32_t e = evs[i].events;
+            int fd = (int)(uint32_t)(evs[i].data.u64 & 0xffffffffUL);
+            u_long want = (u_long)(evs[i].data.u64 >> 32);
+            u_long r = poller_result(want,
+                                     e & EPOLLIN, e & EPOLLOUT, e & EPOLLPRI,
+                                     e & EPOLLERR, e & EPOLLHUP);
+            if (r) {
+                SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(fd),
+                                           Scm_MakeIntegerU(r)));
+            }
+        }
+        return h;
+    }
+#endif /*HAVE_SYS_EPOLL_H*/
+#if defined(HAVE_POLL_H)
+    int n;
+    SCM_SYSCALL(n, poll(p->pfds, (nfds_t)p->npfds, msec));
+    if (n < 0) Scm_SysError("poll failed");
+    for (int i = 0; i < p->npfds && n > 0; i++) {
+        short e = p->pfds[i].revents;
+        if (e == 0) continue;
+        n--;
+        /* POLLNVAL means fd isn't open.  We report it as ready so that
+           the handler sees EBADF, as select would fail with it. */
+        u_long r = poller_result(p->masks[i],
+                                 e & POLLIN, e & POLLOUT, e & POLLPRI,
+                                 e & (POLLERR|POLLNVAL), e & POLLHUP);
+        if (r) {
+            SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(p->pfds[i].fd),
+                                       Scm_MakeIntegerU(r)));
+        }
+    }
+#endif /*HAVE_POLL_H*/
+    return h;
+}
+
+void Scm_SysPollerClose(ScmSysPoller *p)
+{
+    if (p->closed) return;
+    p->closed = TRUE;
+    if (p->epfd >= 0) {
+        close(p->epfd);
+        p->epfd = -1;
+    }
+#if defined(HAVE_POLL_H)
+    p->pfds = NULL;
+    p->masks = NULL;
+    p->slots = NULL;
+    p->npfds = p->pfdsSize = p->slotsSize = 0;
+#endif
+}
+
+#endif /*SCM_HAVE_SYS_POLLER*/
+
 #endif /* HAVE_SELECT */
 
 /*===============================================================
@@ -3399,6 +3768,9 @@ void Scm__InitSystem(void)
     Scm_InitStaticClass(&Scm_SysPasswdClass, "<sys-passwd>", mod, pwd_slots, 0);
 #ifdef HAVE_SELECT
     Scm_InitStaticClass(&Scm_SysFdsetClass, "<sys-fdset>", mod, NULL, 0);
+#endif
+#ifdef SCM_HAVE_SYS_POLLER
+    Scm_InitStaticClass(&Scm_SysPollerClass, "<sys-poller>", mod, NULL, 0);
 #endif
     SCM_INTERNAL_MUTEX_INIT(env_mutex);
     Scm_HashCoreInitSimple(&env_strings, SCM_HASH_STRING, 0, NULL);
@@ -0,0 +1,177 @@
+/*
+ * Test the multiple precision routines on word arrays (mparith.c)
+ * with the portable versions of the arithmetic macros.
+ *
+ * The bignum tests in tests/number.scm go through whatever versions
+ * of the macros the platform uses, so on x86 the portable versions
+ * would otherwise be left untested.
+ */
+
+#define SCM_ARITH_PORTABLE
+#include "gauche.h"
+#include "gauche/priv/configP.h"
+#include "gauche/priv/arith.h"
+
+#define min(x, y)   (((x) < (y))? (x) : (y))
+
+#include "mparith.c"
+
+int errcount = 0;
+
+void message(FILE *out, const char *m, int filler)
+{
+    int i;
+    fprintf(out, "%s", m);
+    if (filler) {
+        int len = 79 - (int)strlen(m);
+        if (len < 0) len = 5;
+        for (i=0; i<len; i++) putc(filler, out);
+    }
+    putc('\n', out);
+}
+
+#define TEST_SECTION(name) message(stdout, "<" name ">", '-')
+
+/*
+ * Test data.  Words with all bits set exercise the carry propagation.
+ */
+enum { FILL_RANDOM, FILL_ONES, FILL_SPARSE };
+
+static uint64_t rnd_state = 88172645463325252ULL;
+
+/* Truncated to u_long if it is 32bit. */
+static u_long rnd(void)
+{
+    /* xorshift; we only need it to be deterministic */
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 7;
+    rnd_state ^= rnd_state << 17;
+    return (u_long)rnd_state;
+}
+
+static u_long *make_words(int n, int fill)
+{
+    u_long *x = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+    for (int i=0; i<n; i++) {
+        switch (fill) {
+        case FILL_ONES:   x[i] = SCM_ULONG_MAX; break;
+        case FILL_SPARSE: x[i] = (rnd()%8 == 0)? rnd() : 0; break;
+        default:          x[i] = rnd(); break;
+        }
+    }
+    if (x[n-1] == 0) x[n-1] = 1;
+    return x;
+}
+
+static int words_equal(const u_long *x, const u_long *y, int n)
+{
+    for (int i=0; i<n; i++) if (x[i] != y[i]) return FALSE;
+    return TRUE;
+}
+
+/* Returns TRUE if x[0..n) < y[0..n). */
+static int words_less(const u_long *x, const u_long *y, int n)
+{
+    for (int i=n-1; i>=0; i--) {
+        if (x[i] != y[i]) return x[i] < y[i];
+    }
+    return FALSE;
+}
+
+/*
+ * Multiplication.  mul_n is checked against mul_basecase.
+ */
+static void test_mul1(int xn, int yn, int fill)
+{
+    u_long *x = make_words(xn, fill), *y = make_words(yn, fill);
+    u_long *r = SCM_NEW_ATOMIC_ARRAY(u_long, xn+yn);
+    u_long *e = SCM_NEW_ATOMIC_ARRAY(u_long, xn+yn);
+
+    printf("testing %d words * %d words (fill %d) =>", xn, yn, fill);
+    mul_n(r, x, xn, y, yn);
+    mul_basecase(e, x, xn, y, yn);
+    if (words_equal(r, e, xn+yn)) {
+        printf("ok\n");
+    } else {
+        errcount++;
+        printf("ERROR\n");
+    }
+}
+
+static void test_mul(void)
+{
+    static const int sizes[][2] = {
+        {1, 1}, {31, 31}, {32, 32}, {33, 32}, {64, 64}, {100, 33},
+        {257, 255}, {1000, 40}, {1999, 1999}, {2000, 2000}, {2100, 2000},
+        {5000, 2000}, {6100, 4000}, {10000, 10000}, {12000, 10001},
+    };
+    TEST_SECTION("mul_n");
+    for (size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+        test_mul1(sizes[i][0], sizes[i][1], FILL_RANDOM);
+        test_mul1(sizes[i][0], sizes[i][1], FILL_ONES);
+        test_mul1(sizes[i][0], sizes[i][1], FILL_SPARSE);
+    }
+}
+
+/*
+ * Division.  We check q*v + r == u and r < v.
+ */
+static void test_div1(int un, int vn, int fill)
+{
+    int qn = un - vn + 1;
+    u_long *u = make_words(un, fill), *v = make_words(vn, fill);
+    u_long *q = SCM_NEW_ATOMIC_ARRAY(u_long, qn);
+    u_long *r = SCM_NEW_ATOMIC_ARRAY(u_long, vn);
+    u_long *p = SCM_NEW_ATOMIC_ARRAY(u_long, qn+vn);
+
+    printf("testing %d words / %d words (fill %d) =>", un, vn, fill);
+    div_qr(q, r, u, un, v, vn);
+    mul_basecase(p, q, qn, v, vn);
+    u_long c = mul_acc(p, qn+vn, r, vn);
+    if (c == 0 && p[un] == 0 && words_equal(p, u, un)
+        && words_less(r, v, vn)) {
+        printf("ok\n");
+    } else {
+        errcount++;
+        printf("ERROR\n");
+    }
+}
+
+static void test_div(void)
+{
+    static const int sizes[][2] = {
+        {2, 2}, {3, 2}, {80, 59}, {119, 60}, {120, 60}, {121, 61},
+        {200, 130}, {370, 300}, {700, 130}, {1000, 300}, {3000, 1000},
+    };
+    TEST_SECTION("div_qr");
+    for (size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+        test_div1(sizes[i][0], sizes[i][1], FILL_RANDOM);
+        test_div1(sizes[i][0], sizes[i][1], FILL_ONES);
+        test_div1(sizes[i][0], sizes[i][1], FILL_SPARSE);
+    }
+}
+
+/*=============================================================
+ * main
+ */
+int main(int argc SCM_UNUSED, char **argv SCM_UNUSED)
+{
+    const char *testmsg = "Testing multiple precision routines ... ";
+
+    Scm_Init(GAUCHE_SIGNATURE);
+
+    fprintf(stderr, "%-65s", testmsg);
+    message(stdout, testmsg, '=');
+
+    test_mul();
+    test_div();
+
+    if (errcount) {
+        fprintf(stderr, "failed.\n");
+        fprintf(stdout, "failed.\n");
+    } else {
+        fprintf(stderr, "passed.\n");
+        fprintf(stdout, "passed.\n");
+    }
+    return 0;
+}
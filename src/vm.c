@@ -36,6 +36,7 @@
 #include "gauche/priv/configP.h"
 #include "gauche/exception.h"
 #include "gauche/priv/builtin-syms.h"
+#include "gauche/priv/classP.h"
 #include "gauche/priv/codeP.h"
 #include "gauche/priv/vmP.h"
 #include "gauche/priv/glocP.h"
@@ -160,6 +161,26 @@ static ScmCompiledCode internal_apply_compiled_code =
                                         SCM_NIL, SCM_FALSE,
                                         SCM_FALSE, SCM_FALSE);
 
+#if GAUCHE_ENABLE_UNSAFE_JIT_API
+/* JIT hook.  When jitThreshold is nonzero, each closure body counts
+   how many times it is entered (in vmcall.c), and once the count reaches
+   jitThreshold the compiled code is queued to vm->jitPending.  The
+   queued code is passed to jitCompiler at the next safe point, which
+   may rewrite it in place.  See Scm__VMSetJITCompiler. */
+static ScmObj jitCompiler = SCM_FALSE;
+static u_long jitThreshold = 0;
+static void jit_request(ScmVM *vm, ScmCompiledCode *cc);
+
+#define JIT_COUNT_CALL(vm, cc)                                          \
+    do {                                                                \
+        if (jitThreshold > 0 && ++(cc)->callCount == jitThreshold) {    \
+            jit_request(vm, cc);                                        \
+        }                                                               \
+    } while (0)
+#else  /*!GAUCHE_ENABLE_UNSAFE_JIT_API*/
+#define JIT_COUNT_CALL(vm, cc)  /*empty*/
+#endif /*!GAUCHE_ENABLE_UNSAFE_JIT_API*/
+
 /* This saves offset of each instruction handler, initialized by
    the first call to run_loop.  The info can be used for detailed
    profiling. */
@@ -280,6 +301,7 @@ ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
     v->signalPending = 0;
     v->finalizerPending = 0;
     v->stopRequest = 0;
+    v->jitPending = SCM_NIL;
 
 #ifdef USE_CUSTOM_STACK_MARKER
     v->stack = (ScmObj*)GC_generic_malloc((SCM_VM_STACK_SIZE+1)*sizeof(ScmObj),
@@ -400,6 +422,7 @@ ScmVM *Scm_VMTakeSnapshot(ScmVM *vm)
     v->signalPending = vm->signalPending;
     v->finalizerPending = vm->finalizerPending;
     v->stopRequest = vm->stopRequest;
+    v->jitPending = SCM_NIL;
 
 #ifdef USE_CUSTOM_STACK_MARKER
     v->stack = (ScmObj*)GC_generic_malloc((SCM_VM_STACK_SIZE+1)*sizeof(ScmObj),
@@ -1024,6 +1047,32 @@ static void wna(ScmVM *vm SCM_UNUSED,
                        proc, reqargs, ngiven);
 }
 
+/* Returns a fresh list of N objects in ARGS followed by the elements of
+   TAIL, allocated as a single block of pairs.  Used by
+   ADJUST_ARGUMENT_FRAME (vmcall.c) for the closures whose rest list is
+   known not to escape; since no one keeps a tail of such a list after
+   the call, allocating it at once doesn't retain extra memory. */
+static ScmObj rest_list_block(ScmObj *args, int n, ScmObj tail)
+{
+    int ntail = 0;
+    for (ScmObj cp = tail; SCM_PAIRP(cp); cp = SCM_CDR(cp)) ntail++;
+    if (n + ntail == 0) return SCM_NIL;
+
+    ScmPair *ps = SCM_NEW_ARRAY(ScmPair, n + ntail);
+    for (int i=0; i<n; i++) {
+        ScmObj a = args[i];
+        SCM_FLONUM_ENSURE_MEM(a);
+        SCM_SET_CAR_UNCHECKED(&ps[i], a);
+        SCM_SET_CDR_UNCHECKED(&ps[i], SCM_OBJ(&ps[i+1]));
+    }
+    for (int i=n; i<n+ntail; i++, tail = SCM_CDR(tail)) {
+        SCM_SET_CAR_UNCHECKED(&ps[i], SCM_CAR(tail));
+        SCM_SET_CDR_UNCHECKED(&ps[i], SCM_OBJ(&ps[i+1]));
+    }
+    SCM_SET_CDR_UNCHECKED(&ps[n+ntail-1], SCM_NIL);
+    return SCM_OBJ(ps);
+}
+
 /* local_env_shift
    Called from LOCAL-ENV-SHIFT and LOCAL-ENV-JUMP insns (see vminsn.scm),
    and adjusts env frames for optimized local function call.
@@ -1079,6 +1128,92 @@ static void local_env_shift(ScmVM *vm, int env_depth)
     else           { ENV = tenv; }
 }
 
+/* pack_flonum_args
+   Called from PACK-FLONUM-ARGS insn, which the compiler emits before
+   entering a loop body whose arguments indicated by MASK are known to
+   be flonums.  We place those arguments in fresh FLONUM_REGs, so that
+   they are never shared with the outside of the loop.
+
+   If ENV_DEPTH > 0, this is a tail jump that discards ENV_DEPTH frames,
+   the outermost of which is the loop frame of the current iteration.
+   If the loop frame still holds FLONUM_REGs we've given in the last
+   pack, every FLONUM_REG above the lowest of them is owned by the
+   current iteration, hence dead after the jump (anything that outlives
+   the jump has been boxed), except the arguments not in MASK and VAL0,
+   which we box if they point into the area.  Then we reuse the area for
+   the new arguments and roll back fpsp, which keeps the fpstack from
+   growing across iterations and avoids the flush that boxes the loop
+   variables.
+ */
+#define PACK_FLONUM_ARGS_MAX 28
+
+static void pack_flonum_args(ScmVM *vm, int env_depth, u_long mask)
+{
+#if GAUCHE_FFX && defined(__GNUC__)
+    int nargs = (int)(SP - ARGP);
+    double vals[PACK_FLONUM_ARGS_MAX];
+    int k = 0;
+
+    if (nargs > PACK_FLONUM_ARGS_MAX) nargs = PACK_FLONUM_ARGS_MAX;
+    /* Fetch the values first, for the arguments may refer to the
+       registers we're going to overwrite. */
+    for (int i = 0; i < nargs; i++) {
+        if (!(mask & (1UL<<i))) continue;
+        if (!SCM_FLONUMP(ARGP[i])) {
+            mask &= ~(1UL<<i);  /* just in case */
+            continue;
+        }
+        vals[k++] = SCM_FLONUM_VALUE(ARGP[i]);
+    }
+    if (k == 0) return;
+
+    ScmFlonum *fp = NULL;
+    if (env_depth > 0) {
+        ScmEnvFrame *e = ENV;
+        while (--env_depth > 0) {
+            SCM_ASSERT(e);
+            e = e->up;
+        }
+        if (IN_STACK_P((ScmObj*)e) && e->size == SP - ARGP) {
+            for (int i = 0; i < nargs; i++) {
+                if (!(mask & (1UL<<i))) continue;
+                ScmObj v = ENV_DATA(e, e->size - i - 1);
+                if (!SCM_FLONUM_REG_P(v)) { fp = NULL; break; }
+                if (fp == NULL || SCM_FLONUM(v) < fp) fp = SCM_FLONUM(v);
+            }
+        }
+        if (fp != NULL && fp + k > vm->fpstackEnd) fp = NULL;
+        if (fp != NULL) {
+            /* The other arguments and VAL0 survive the jump, but they
+               may be FLONUM_REGs allocated during the current iteration,
+               in the area we're going to reuse.  Box them. */
+            for (int i = 0; ARGP + i < SP; i++) {
+                if (i < nargs && (mask & (1UL<<i))) continue;
+                if (SCM_FLONUM_REG_P(ARGP[i]) && SCM_FLONUM(ARGP[i]) >= fp) {
+                    SCM_FLONUM_ENSURE_MEM(ARGP[i]);
+                }
+            }
+            if (SCM_FLONUM_REG_P(VAL0) && SCM_FLONUM(VAL0) >= fp) {
+                SCM_FLONUM_ENSURE_MEM(VAL0);
+            }
+        }
+    }
+    if (fp == NULL) {
+        if (vm->fpsp + k > vm->fpstackEnd) Scm_VMFlushFPStack(vm);
+        fp = vm->fpsp;
+    }
+    vm->fpsp = fp + k;
+
+    k = 0;
+    for (int i = 0; i < nargs; i++) {
+        if (!(mask & (1UL<<i))) continue;
+        fp[k].val = vals[k];
+        ARGP[i] = SCM_MAKE_FLONUM_REG(&fp[k]);
+        k++;
+    }
+#endif /*GAUCHE_FFX && __GNUC__*/
+}
+
 
 /*===================================================================
  * Main loop of VM
@@ -3875,6 +4010,49 @@ static ScmObj process_queued_requests_cc(ScmObj result SCM_UNUSED, void **data)
     return vm->val0;
 }
 
+#if GAUCHE_ENABLE_UNSAFE_JIT_API
+/* Called from the closure call path when CC becomes hot. */
+static void jit_request(ScmVM *vm, ScmCompiledCode *cc)
+{
+    vm->jitPending = Scm_Cons(SCM_OBJ(cc), vm->jitPending);
+    vm->attentionRequest = TRUE;
+}
+
+/* Runs the JIT compiler for each pending code.  The compiler may
+   replace the code vector in place (via compiled-code-copy!), which
+   resets callCount; we set it past the threshold so that the code won't
+   be queued again, whether the compilation succeeded or not.  Errors
+   in the compiler are ignored, leaving the code interpreted. */
+static void jit_run_pending(ScmVM *vm)
+{
+    ScmObj pending = vm->jitPending;
+    vm->jitPending = SCM_NIL;
+    if (SCM_FALSEP(jitCompiler)) return;
+
+    ScmObj cp;
+    SCM_FOR_EACH(cp, pending) {
+        ScmCompiledCode *cc = SCM_COMPILED_CODE(SCM_CAR(cp));
+        ScmEvalPacket pkt;
+        (void)Scm_Apply(jitCompiler, SCM_LIST1(SCM_OBJ(cc)), &pkt);
+        cc->callCount = jitThreshold;
+    }
+}
+
+/* Register PROC as a JIT compiler.  PROC is called with a compiled
+   code that has been entered THRESHOLD times.  Passing #f or zero
+   threshold disables JIT. */
+void Scm__VMSetJITCompiler(ScmObj proc, u_long threshold)
+{
+    if (SCM_FALSEP(proc) || threshold == 0) {
+        jitThreshold = 0;
+        jitCompiler = SCM_FALSE;
+    } else {
+        jitCompiler = proc;
+        jitThreshold = threshold;
+    }
+}
+#endif /*GAUCHE_ENABLE_UNSAFE_JIT_API*/
+
 static void process_queued_requests(ScmVM *vm)
 {
     void *data[3];
@@ -3906,6 +4084,9 @@ static void process_queued_requests(ScmVM *vm)
        VM level. */
     if (vm->signalPending)   Scm_SigCheck(vm);
     if (vm->finalizerPending) Scm_VMFinalizerRun(vm);
+#if GAUCHE_ENABLE_UNSAFE_JIT_API
+    if (!SCM_NULLP(vm->jitPending)) jit_run_pending(vm);
+#endif
 
     /* VM STOP is required from other thread.
        See Scm_ThreadStop() in ext/threads/threads.c */
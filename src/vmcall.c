@@ -40,11 +40,16 @@
  *  the last value is the tail of the argument list.  For standard Scheme
  *  variable argument procedure, M is always 1 and the stack contains
  *  N required arguments plus one list of 'rest' argument.
+ *
+ *  If NOESCAPE is true, the callee is a closure whose rest list never
+ *  outlives the call (SCM_COMPILED_CODE_REST_NOESCAPE).  We build the
+ *  rest list in one block by rest_list_block() instead of consing
+ *  pairs one by one.
  */
 
 #undef ADJUST_ARGUMENT_FRAME
 #if !defined(APPLY_CALL)
-#define ADJUST_ARGUMENT_FRAME(proc, argc)                               \
+#define ADJUST_ARGUMENT_FRAME(proc, argc, noescape)                     \
     do {                                                                \
         int reqargs = SCM_PROCEDURE_REQUIRED(proc);                     \
         int optargs = SCM_PROCEDURE_OPTIONAL(proc);                     \
@@ -54,6 +59,12 @@
                 wna(vm, VAL0, argc, -1); RETURN_OP(); NEXT;             \
             }                                                           \
             /* fold &rest args */                                       \
+            if ((noescape) && argc > reqargs+optargs) {                 \
+                int nrest = argc - (reqargs+optargs-1);                 \
+                p = rest_list_block(SP-nrest, nrest, SCM_NIL);          \
+                SP -= nrest;                                            \
+                argc -= nrest;                                          \
+            }                                                           \
             while (argc > reqargs+optargs-1) {                          \
                 ScmObj a;                                               \
                 POP_ARG(a);                                             \
@@ -69,7 +80,7 @@
         }                                                               \
     } while (0)
 #else /*APPLY_CALL*/
-#define ADJUST_ARGUMENT_FRAME(proc, argc)                               \
+#define ADJUST_ARGUMENT_FRAME(proc, argc, noescape)                     \
     do {                                                                \
         ScmObj p, a;                                                    \
         int reqargs = SCM_PROCEDURE_REQUIRED(proc);                     \
@@ -82,10 +93,16 @@
             POP_ARG(p);  /* tail of arglist */                          \
             if (argc > reqargs+optargs) {                               \
                 /* fold rest args. */                                   \
-                p = Scm_CopyList(p);                                    \
-                for (int c=argc; c>reqargs+optargs; c--) {              \
-                    POP_ARG(a);                                         \
-                    p = Scm_Cons(a, p);                                 \
+                if (noescape) {                                         \
+                    int nrest = argc - (reqargs+optargs);               \
+                    p = rest_list_block(SP-nrest, nrest, p);            \
+                    SP -= nrest;                                        \
+                } else {                                                \
+                    p = Scm_CopyList(p);                                \
+                    for (int c=argc; c>reqargs+optargs; c--) {          \
+                        POP_ARG(a);                                     \
+                        p = Scm_Cons(a, p);                             \
+                    }                                                   \
                 }                                                       \
                 PUSH_ARG(p);                                            \
             } else {                                                    \
@@ -97,7 +114,8 @@
                     PUSH_ARG(SCM_CAR(p));                               \
                     p = SCM_CDR(p);                                     \
                 }                                                       \
-                p = Scm_CopyList(p);                                    \
+                p = (noescape)? rest_list_block(NULL, 0, p)             \
+                              : Scm_CopyList(p);                        \
                 PUSH_ARG(p);                                            \
             }                                                           \
         } else {                                                        \
@@ -175,7 +193,7 @@
         /* We don't need to complete environment frame.  Just need to
            adjust sp, so that stack-operating procs called from subr
            won't be confused. */
-        ADJUST_ARGUMENT_FRAME(VAL0, argc);
+        ADJUST_ARGUMENT_FRAME(VAL0, argc, FALSE);
         SP = ARGP;
         PC = PC_TO_RETURN;
 #if GAUCHE_FFX
@@ -200,7 +218,9 @@
         NEXT;
     }
     if (proctype == SCM_PROC_CLOSURE) {
-        ADJUST_ARGUMENT_FRAME(VAL0, argc);
+        ADJUST_ARGUMENT_FRAME(VAL0, argc,
+                              (SCM_COMPILED_CODE(SCM_CLOSURE(VAL0)->code)->flags
+                               & SCM_COMPILED_CODE_REST_NOESCAPE));
         if (argc) {
             FINISH_ENV(SCM_PROCEDURE_INFO(VAL0), SCM_CLOSURE(VAL0)->env);
         } else {
@@ -211,6 +231,7 @@
         PC = vm->base->code;
         CHECK_STACK(vm->base->maxstack);
         SCM_PROF_COUNT_CALL(vm, SCM_OBJ(vm->base));
+        JIT_COUNT_CALL(vm, vm->base);
         VAL0 = SCM_MAKE_INT(argc); /* keep argc to VAL0. */
         NEXT;
     }
@@ -256,7 +277,14 @@
         }
       GENERIC_ENTRY:
         /* pure generic application.  we implement MOP in C. */
+#if !defined(APPLY_CALL)
+        /* PC points right after the call, which identifies the call site
+           in BASE.  The methods are already sorted. */
+        mm = Scm__GenericCallSiteMethods(SCM_GENERIC(VAL0), BASE, PC,
+                                         ARGP, argc);
+#else  /* APPLY_CALL */
         mm = Scm_ComputeApplicableMethods(SCM_GENERIC(VAL0), ARGP, argc, APP);
+#endif /* APPLY_CALL */
         if (!SCM_NULLP(mm)) {
             /* sort methods.  we only need as many args as
                gf->maxReqargs to order methods, so we only unfold that
@@ -282,9 +310,11 @@
                 for (int i=0;i<argc; i++, ap++) SCM_FLONUM_ENSURE_MEM(*ap);
             }
 #endif /*GAUCHE_FFX*/
+#if defined(APPLY_CALL)
             if (SCM_PAIRP(SCM_CDR(mm))) {
                 mm = Scm_SortMethods(mm, ARGP, argc);
             }
+#endif /*APPLY_CALL*/
             if (SCM_METHOD_LEAF_P(SCM_CAR(mm))) {
                 nm = SCM_TRUE;  /* Dummy */
             } else {
@@ -370,7 +400,7 @@
     /*
      * Now, apply method
      */
-    ADJUST_ARGUMENT_FRAME(VAL0, argc);
+    ADJUST_ARGUMENT_FRAME(VAL0, argc, FALSE);
 
     VM_ASSERT(proctype == SCM_PROC_METHOD);
     VM_ASSERT(!SCM_FALSEP(nm));
@@ -395,6 +425,7 @@
         PC = vm->base->code;
         CHECK_STACK(vm->base->maxstack);
         SCM_PROF_COUNT_CALL(vm, SCM_OBJ(vm->base));
+        JIT_COUNT_CALL(vm, vm->base);
         VAL0 = SCM_MAKE_INT(argc); /* keep argc to VAL0. */
     }
     NEXT;
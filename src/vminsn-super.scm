@@ -0,0 +1,8 @@
+;; Generated by gen-superinsn.scm.  DO NOT EDIT.
+;; Included from vminsn.scm.  To regenerate, see 'insn-profile'
+;; in src/Makefile.
+;;
+;; No superinstructions have been generated yet.  They must be chosen
+;; from a profile taken with gosh built with COUNT_INSN_FREQUENCY, by
+;; the steps described in src/Makefile; the generator records the
+;; profile it used here.
@@ -86,6 +86,11 @@
 ;;;           :terminal   - the control unconditinoally transfers to
 ;;;                         elsewhere except the next insn, after
 ;;;                         executing this insn.
+;;;
+;;; (include <file>)
+;;;
+;;;   Reads define-insn forms from <file>, relative to this file.
+;;;   Used to bring in the generated superinstructions.
 
 ;;;==============================================================
 ;;; Common Cise macros
@@ -105,6 +110,8 @@
                                  NEXT_PUSHCHECK)]
                        [(push) `((PUSH-ARG ,expr) NEXT)]
                        [(call) `((set! VAL0 ,expr))]
+                       [(seq)  `((set! VAL0 ,expr)
+                                 (set! (-> vm numVals) 1))]
                        [(ret)  `((set! VAL0 ,expr)
                                  (set! (-> vm numVals) 1)
                                  (RETURN-OP)
@@ -1563,6 +1570,12 @@
 ;; XINSN info code-addr
 ;;   'Extended instruction' - JIT compiled instruction handler.
 ;;   The operand is an address of native code vector.
+;;   The native code is called with %r15 holding vm.  It follows the
+;;   C calling convention otherwise, so it may clobber any caller-saved
+;;   registers.  We step over the red zone before the call, since
+;;   the compiler may keep live data below the stack pointer.
+;;   The native code reads and writes VM registers through vm, hence
+;;   the memory clobber.
 (define-insn XINSN 0 obj+native #f
   (.if (and SCM_TARGET_X86_64
             (>= SIZEOF_LONG 8)
@@ -1572,11 +1585,41 @@
       (FETCH_LOCATION jitcode)
       INCR_PC
       (asm :volatile
-           "mov %[vm], %%r15; \
-            call *%[jitcode]"
+           "sub $128, %%rsp; \
+            mov %[vm], %%r15; \
+            call *%[jitcode]; \
+            add $128, %%rsp"
            ()
            ((vm "r" vm)
             (jitcode "r" jitcode))
-           ("r12" "r15"))
+           ("rax" "rcx" "rdx" "rsi" "rdi" "r8" "r9" "r10" "r11"
+            "r12" "r15"
+            "xmm0" "xmm1" "xmm2" "xmm3" "xmm4" "xmm5" "xmm6" "xmm7"
+            "xmm8" "xmm9" "xmm10" "xmm11" "xmm12" "xmm13" "xmm14" "xmm15"
+            "cc" "memory"))
       NEXT)
     (Scm_Panic "XINSN instruction should never be seen on this platform.")))
+
+;; PACK-FLONUM-ARGS(depth) <mask>
+;;   Emitted just before the arguments on the stack become the env frame
+;;   of an embedded loop body (that is, before LOCAL-ENV, LOCAL-ENV-SHIFT
+;;   or LOCAL-ENV-JUMP).  <mask> is a fixnum whose i-th bit is set if
+;;   the compiler has proven that the i-th argument is always a flonum.
+;;   DEPTH is the number of env frames discarded by the following tail
+;;   jump, or 0 if the frame is newly pushed.  See pack_flonum_args()
+;;   in vm.c for the details.
+(define-insn PACK-FLONUM-ARGS 1 obj #f
+  (let* ([mask])
+    (FETCH-OPERAND mask)
+    INCR-PC
+    (VM-ASSERT (SCM_INTP mask))
+    (pack_flonum_args vm (SCM_VM_INSN_ARG code) (SCM_INT_VALUE mask))
+    NEXT))
+
+;;;==============================================================
+;;; Superinstructions
+;;;
+
+;; Combined insns chosen from the measured instruction frequencies.
+;; See gen-superinsn.scm.  They must come after all the ingredients.
+(include "vminsn-super.scm")
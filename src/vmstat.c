@@ -33,33 +33,95 @@
 
 /* This file is included from vm.c */
 
+/* The statistics is dumped at exit to the file named by the environment
+   variable GAUCHE_INSN_FREQUENCY_FILE (appended), or to the current
+   output port if it is not set.  src/gen-superinsn.scm reads the dump
+   to choose superinstructions; see 'make insn-profile' in Makefile. */
+
 #ifdef COUNT_INSN_FREQUENCY
+#include <fcntl.h>
+
 /* for statistics */
 static u_long insn1_freq[SCM_VM_NUM_INSNS];
 static u_long insn2_freq[SCM_VM_NUM_INSNS][SCM_VM_NUM_INSNS];
 
+/* Triples of adjacent insns.  A full 3D table is too big, so we use
+   a fixed-size open-addressing hash table; the triples that don't fit
+   are just counted in insn3_overflow. */
+#define INSN3_FREQ_TABLE_SIZE 65536 /* must be a power of 2 */
+static struct {
+    u_long key;                 /* 0 for an empty entry */
+    u_long count;
+} insn3_freq[INSN3_FREQ_TABLE_SIZE];
+static u_long insn3_overflow;
+
+/* The last two insns executed, and the number of insns that have been
+   executed in a row without jump (saturated at 2). */
+static ScmWord *insn_last_pc = NULL;
+static u_int insn_last[2];
+static int insn_run = 0;
+
 #define LREF_FREQ_COUNT_MAX 10
 static u_long lref_freq[LREF_FREQ_COUNT_MAX][LREF_FREQ_COUNT_MAX];
 static u_long lset_freq[LREF_FREQ_COUNT_MAX][LREF_FREQ_COUNT_MAX];
 
+static int insn_words(u_int code)
+{
+    switch (Scm_VMInsnOperandType(code)) {
+    case SCM_VM_OPERAND_NONE: return 1;
+    case SCM_VM_OPERAND_OBJ_LABEL:
+    case SCM_VM_OPERAND_OBJ_NATIVE: return 3;
+    default: return 2;
+    }
+}
+
+static void count_insn3(u_int a, u_int b, u_int c)
+{
+    u_long key = ((u_long)a*SCM_VM_NUM_INSNS + b)*SCM_VM_NUM_INSNS + c + 1;
+    u_long h = (key * 2654435761UL) & (INSN3_FREQ_TABLE_SIZE-1);
+    for (int i=0; i<INSN3_FREQ_TABLE_SIZE; i++) {
+        if (insn3_freq[h].key == key) { insn3_freq[h].count++; return; }
+        if (insn3_freq[h].key == 0) {
+            insn3_freq[h].key = key;
+            insn3_freq[h].count = 1;
+            return;
+        }
+        h = (h+1) & (INSN3_FREQ_TABLE_SIZE-1);
+    }
+    insn3_overflow++;
+}
+
 static ScmWord fetch_insn_counting(ScmVM *vm, ScmWord code)
 {
     if (vm->base && vm->pc != vm->base->code) {
         insn2_freq[SCM_VM_INSN_CODE(code)][SCM_VM_INSN_CODE(*vm->pc)]++;
     }
+    /* Triples are only counted when they are adjacent in the code vector,
+       for only such sequences can be combined. */
+    u_int cur = SCM_VM_INSN_CODE(*vm->pc);
+    if (insn_last_pc != NULL
+        && vm->pc == insn_last_pc + insn_words(insn_last[1])) {
+        if (insn_run >= 2) count_insn3(insn_last[0], insn_last[1], cur);
+        else insn_run++;
+    } else {
+        insn_run = 1;
+    }
+    insn_last[0] = insn_last[1];
+    insn_last[1] = cur;
+    insn_last_pc = vm->pc;
     code = *vm->pc++;
     insn1_freq[SCM_VM_INSN_CODE(code)]++;
     switch (SCM_VM_INSN_CODE(code)) {
-    case SCM_VM_LREF0: lref_freq[0][0]++; break;
-    case SCM_VM_LREF1: lref_freq[0][1]++; break;
-    case SCM_VM_LREF2: lref_freq[0][2]++; break;
-    case SCM_VM_LREF3: lref_freq[0][3]++; break;
-    case SCM_VM_LREF4: lref_freq[0][4]++; break;
+    case SCM_VM_LREF0:  lref_freq[0][0]++; break;
+    case SCM_VM_LREF1:  lref_freq[0][1]++; break;
+    case SCM_VM_LREF2:  lref_freq[0][2]++; break;
+    case SCM_VM_LREF3:  lref_freq[0][3]++; break;
     case SCM_VM_LREF10: lref_freq[1][0]++; break;
     case SCM_VM_LREF11: lref_freq[1][1]++; break;
     case SCM_VM_LREF12: lref_freq[1][2]++; break;
-    case SCM_VM_LREF13: lref_freq[1][3]++; break;
-    case SCM_VM_LREF14: lref_freq[1][4]++; break;
+    case SCM_VM_LREF20: lref_freq[2][0]++; break;
+    case SCM_VM_LREF21: lref_freq[2][1]++; break;
+    case SCM_VM_LREF30: lref_freq[3][0]++; break;
     case SCM_VM_LREF:
     {
         int dep = SCM_VM_INSN_ARG0(code);
@@ -69,11 +131,6 @@ static ScmWord fetch_insn_counting(ScmVM *vm, ScmWord code)
         lref_freq[dep][off]++;
         break;
     }
-    case SCM_VM_LSET0: lset_freq[0][0]++; break;
-    case SCM_VM_LSET1: lset_freq[0][1]++; break;
-    case SCM_VM_LSET2: lset_freq[0][2]++; break;
-    case SCM_VM_LSET3: lset_freq[0][3]++; break;
-    case SCM_VM_LSET4: lset_freq[0][4]++; break;
     case SCM_VM_LSET:
     {
         int dep = SCM_VM_INSN_ARG0(code);
@@ -87,34 +144,55 @@ static ScmWord fetch_insn_counting(ScmVM *vm, ScmWord code)
     return code;
 }
 
-static void dump_insn_frequency(void *data)
+static void dump_insn_frequency(void *data SCM_UNUSED)
 {
-    Scm_Printf(SCM_CUROUT, "(:instruction-frequencies (");
+    ScmPort *out = SCM_CUROUT;
+    const char *path = Scm_GetEnv("GAUCHE_INSN_FREQUENCY_FILE");
+    if (path != NULL) {
+        ScmObj p = Scm_OpenFilePort(path, O_WRONLY|O_CREAT|O_APPEND,
+                                    SCM_PORT_BUFFER_FULL, 0666);
+        if (SCM_OPORTP(p)) out = SCM_PORT(p);
+    }
+
+    Scm_Printf(out, "(:instruction-frequencies (");
     for (int i=0; i<SCM_VM_NUM_INSNS; i++) {
-        Scm_Printf(SCM_CUROUT, "(%s %d", Scm_VMInsnName(i), insn1_freq[i]);
+        Scm_Printf(out, "(%s %lu", Scm_VMInsnName(i), insn1_freq[i]);
         for (int j=0; j<SCM_VM_NUM_INSNS; j++) {
-            Scm_Printf(SCM_CUROUT, " %d", insn2_freq[i][j]);
+            Scm_Printf(out, " %lu", insn2_freq[i][j]);
         }
-        Scm_Printf(SCM_CUROUT, ")\n");
+        Scm_Printf(out, ")\n");
     }
-    Scm_Printf(SCM_CUROUT, ")\n :lref-frequencies (");
+    Scm_Printf(out, ")\n :lref-frequencies (");
     for (int i=0; i<LREF_FREQ_COUNT_MAX; i++) {
-        Scm_Printf(SCM_CUROUT, "(");
+        Scm_Printf(out, "(");
         for (int j=0; j<LREF_FREQ_COUNT_MAX; j++) {
-            Scm_Printf(SCM_CUROUT, "%d ", lref_freq[i][j]);
+            Scm_Printf(out, "%lu ", lref_freq[i][j]);
         }
-        Scm_Printf(SCM_CUROUT, ")\n");
+        Scm_Printf(out, ")\n");
     }
-    Scm_Printf(SCM_CUROUT, ")\n :lset-frequencies (");
+    Scm_Printf(out, ")\n :lset-frequencies (");
     for (int i=0; i<LREF_FREQ_COUNT_MAX; i++) {
-        Scm_Printf(SCM_CUROUT, "(");
+        Scm_Printf(out, "(");
         for (int j=0; j<LREF_FREQ_COUNT_MAX; j++) {
-            Scm_Printf(SCM_CUROUT, "%d ", lset_freq[i][j]);
+            Scm_Printf(out, "%lu ", lset_freq[i][j]);
         }
-        Scm_Printf(SCM_CUROUT, ")\n");
+        Scm_Printf(out, ")\n");
+    }
+    Scm_Printf(out, ")\n :instruction-triples (");
+    for (int i=0; i<INSN3_FREQ_TABLE_SIZE; i++) {
+        u_long key = insn3_freq[i].key;
+        if (key == 0) continue;
+        key--;
+        Scm_Printf(out, "(%s %s %s %lu)\n",
+                   Scm_VMInsnName(key/(SCM_VM_NUM_INSNS*SCM_VM_NUM_INSNS)),
+                   Scm_VMInsnName((key/SCM_VM_NUM_INSNS)%SCM_VM_NUM_INSNS),
+                   Scm_VMInsnName(key%SCM_VM_NUM_INSNS),
+                   insn3_freq[i].count);
     }
-    Scm_Printf(SCM_CUROUT, ")\n");
-    Scm_Printf(SCM_CUROUT, ")\n");
+    Scm_Printf(out, ")\n :instruction-triples-overflow %lu\n",
+               insn3_overflow);
+    Scm_Printf(out, ")\n");
+    if (out != SCM_CUROUT) Scm_ClosePort(out);
 }
 
 #endif /*COUNT_INSN_FREQUENCY*/
@@ -223,6 +223,52 @@
   (define seq (coroutine->cseq coro))
   (test* "cseq (coroutine)" '(0 1 2 3 4 5 6 7 8 9) seq))
 
+;;--------------------------------------------------------------------
+;; control.fork-join
+;;
+
+(test-section "control.fork-join")
+(use control.fork-join)
+(test-module 'control.fork-join)
+
+(let1 pool (make-fork-join-pool 4)
+  (define (pfib n)
+    (if (< n 10)
+      (let fib ([n n]) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+      (let1 t (spawn (^[] (pfib (- n 1))) pool)
+        (let1 b (pfib (- n 2))
+          (+ (sync t) b)))))
+  (test* "spawn/sync" '(#t 3)
+         (let1 t (spawn (^[] (+ 1 2)) pool)
+           (list (fork-join-task? t) (sync t))))
+  (test* "multiple values" '(1 2 3)
+         (values->list (sync (spawn (^[] (values 1 2 3)) pool))))
+  (test* "nested spawn/sync" 6765
+         (sync (spawn (^[] (pfib 20)) pool)))
+  (test* "nested spawn/sync (from outside)" 6765
+         (pfib 20))
+  (test* "error propagation" (test-error <error> "oops")
+         (sync (spawn (^[] (error "oops")) pool)))
+  (test* "error propagation (again)" '("oops" "oops")
+         (let1 t (spawn (^[] (error "oops")) pool)
+           (map (^_ (guard (e [else (condition-message e)]) (sync t)))
+                '(1 2))))
+  (test* "parameterization" 'inner
+         (let1 p (make-parameter 'outer)
+           (parameterize ([p 'inner])
+             (sync (spawn (^[] (p)) pool)))))
+  (test* "sync/timeout" 'timeout
+         (let1 t (spawn (^[] (sys-sleep 1)) pool)
+           (sync/timeout t 0.01 (^[] 'timeout))))
+  (test* "done?" #t
+         (let1 t (spawn (^[] 'ok) pool)
+           (sync t)
+           (fork-join-task-done? t)))
+  (test* "shutdown" (test-error <error>)
+         (begin
+           (fork-join-pool-shutdown! pool)
+           (spawn (^[] 'ok) pool))))
+
 ;;--------------------------------------------------------------------
 ;; control.future
 ;;
@@ -241,8 +287,22 @@
   (test* "future error handling (delayed)" #t
          (future? f))
   (test* "future error handling (propagated)" (test-error <error> "oops")
+         (future-get f))
+  (test* "future error handling (again)" (test-error <error> "oops")
          (future-get f)))
 
+;; Each future waits for the previous one through a queue.  They must
+;; not deadlock even if there are more of them than processors.
+(test* "futures waiting each other" 16
+       (let* ([n 16]
+              [qs (list-tabulate (+ n 1) (^_ (make-mtqueue)))]
+              [fs (map (^[qin qout]
+                         (future (enqueue! qout (+ (dequeue/wait! qin) 1))))
+                       (drop-right qs 1) (cdr qs))])
+         (enqueue! (car qs) 0)
+         (for-each future-get fs)
+         (dequeue/wait! (last qs) 5 'timeout)))
+
 (test* "timeout" 'timeout
        (future-get (future (sys-sleep 10)) 0.01 'timeout))
 
@@ -291,6 +351,35 @@
              (append (pmap (cut * <> 2) (iota 100) :mapper mapper)
                      (pmap (cut * <> 3) (iota 100) :mapper mapper))
            (terminate-all! pool))))
+(test* "pmap (fork-join)"
+       (map (cut * <> 2) (iota 100))
+       (pmap (cut * <> 2) (iota 100) :mapper (make-fork-join-mapper)))
+(test* "pmap (fork-join, grain)"
+       (map (cut * <> 2) (iota 100))
+       (pmap (cut * <> 2) (iota 100) :mapper (make-fork-join-mapper :grain 1)))
+(test* "pmap (fork-join, nested)"
+       (map (^i (map (cut * i <>) (iota 10))) (iota 10))
+       (pmap (^i (pmap (cut * i <>) (iota 10)))
+             (iota 10)
+             :mapper (make-fork-join-mapper :grain 1)))
+(test* "pmap (fork-join, error)" (test-error <error> "oops")
+       (pmap (^i (if (= i 50) (error "oops") i)) (iota 100)
+             :mapper (make-fork-join-mapper)))
+(test* "pmap (fork-join, empty)" '()
+       (pmap (cut * <> 2) '() :mapper (make-fork-join-mapper)))
+(test* "pfor-each (default)" (* 2 (apply + (iota 100)))
+       (let1 sum (atom 0)
+         (pfor-each (^i (atomic-update! sum (cut + <> (* i 2)))) (iota 100))
+         (atom-ref sum)))
+(test* "pfor-each (sequential)" (iota 10)
+       (let1 r '()
+         (pfor-each (^i (push! r i)) (iota 10) :mapper (sequential-mapper))
+         (reverse r)))
+(test* "pfor-each (static)" (* 2 (apply + (iota 100)))
+       (let1 sum (atom 0)
+         (pfor-each (^i (atomic-update! sum (cut + <> (* i 2)))) (iota 100)
+                    :mapper (make-static-mapper))
+         (atom-ref sum)))
 (test* "pmap (fully concurrent)"
        (map (cut * <> 2) (iota 25))
        (pmap (cut * <> 2) (iota 25) :mapper (make-fully-concurrent-mapper)))
@@ -348,6 +437,17 @@
                       42))
              (iota 20)
              :mapper (make-fully-concurrent-mapper)))
+(test* "pfind (fork-join)"
+       (find (cut = <> 77) (iota 100))
+       (pfind (cut = <> 77) (iota 100)
+              :mapper (make-fork-join-mapper :grain 1)))
+(test* "pany (fork-join)"
+       (any (^x (and (= x 77) 42)) (iota 100))
+       (pany (^x (and (= x 77) 42)) (iota 100)
+             :mapper (make-fork-join-mapper :grain 1)))
+(test* "pany (fork-join, none)" #f
+       (pany (^x (and (< x 0) x)) (iota 100)
+             :mapper (make-fork-join-mapper)))
 
 ;;--------------------------------------------------------------------
 ;; control.scheduler
@@ -289,6 +289,80 @@
            (cache-through! c 'd symbol->string)  ; hit
            (cache-stats c))))
 
+;; concurrent cache
+(let ([c (make-concurrent-cache 3 :num-shards 1)])
+  (define (contents)
+    (map (cut cache-lookup! c <> #f) '(a b c d)))
+  (test* "Concurrent cache" '("a" "b" "c" #f)
+         (begin
+           (cache-through! c 'a symbol->string)
+           (cache-through! c 'b symbol->string)
+           (cache-through! c 'c symbol->string)
+           (contents)))
+  ;; All entries are referenced, so the clock hand clears the reference
+  ;; bits going around, then evicts the first one it sees again.
+  (test* "Concurrent cache (clock)" '(#f "b" "c" "d")
+         (begin
+           (cache-write! c 'd "d")   ; evicts a
+           (contents)))
+  (test* "Concurrent cache (clock)" '("a" #f "c" "d")
+         (begin
+           (cache-through! c 'a symbol->string)   ; evicts b
+           (contents)))
+  (test* "Concurrent cache (evict)" '("a" #f #f "d")
+         (begin
+           (cache-evict! c 'c)
+           (contents)))
+  (test* "Concurrent cache (clear)" '(#f #f #f #f)
+         (begin
+           (cache-clear! c)
+           (contents)))
+  (test* "Concurrent cache (stats)" '(:hits 11 :misses 13 :evictions 2
+                                      :expirations 0)
+         (cache-stats c))
+  (test* "Concurrent cache (storage)" #f (cache-storage c)))
+
+(let* ([now 0]
+       [c (make-concurrent-cache 4 :ttl 10 :num-shards 2
+                                 :timestamper (^[] now))])
+  (test* "Concurrent cache (ttl)" '(1 2 #f)
+         (begin
+           (cache-write! c 'a 1)
+           (cache-write! c 'b 2)
+           (set! now 10)
+           (list (cache-lookup! c 'a #f) (cache-lookup! c 'b #f)
+                 (cache-lookup! c 'c #f))))
+  (test* "Concurrent cache (ttl)" '(#f 3 (:hits 3 :misses 2 :evictions 0
+                                          :expirations 1))
+         (begin
+           (set! now 15)
+           (cache-write! c 'b 3)
+           (set! now 21)
+           (let* ([a (cache-lookup! c 'a #f)]
+                  [b (cache-lookup! c 'b #f)])
+             (list a b (cache-stats c))))))
+
+;; 8 threads share a cache smaller than the key space.
+(use gauche.threads)
+(cond-expand
+ [gauche.sys.pthreads
+  (let ([c (make-concurrent-cache 50 :num-shards 4)]
+        [bad (atom '())])
+    (define (worker k)
+      (dotimes [i 1000]
+        (let* ([key (modulo (* i (+ k 1)) 100)]
+               [v (cache-through! c key (cut * <> 2))])
+          (unless (eqv? v (* key 2))
+            (atomic-update! bad (cut cons key <>))))))
+    (test* "Concurrent cache (threads)" '(() 8000)
+           (let1 ts (map (^k (thread-start! (make-thread (cut worker k))))
+                         (iota 8))
+             (for-each thread-join! ts)
+             (let1 st (cache-stats c)
+               (list (atomic bad identity)
+                     (+ (get-keyword :hits st) (get-keyword :misses st)))))))]
+ [else])
+
 ;;;========================================================================
 (test-section "data.ideque")
 (use data.ideque)
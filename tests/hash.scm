@@ -514,6 +514,101 @@
        (hash-table-find h-it (^[k v] (and (eq? k 'e) (* v 2)))
                         (^[] 'oops)))
 
+;;------------------------------------------------------------------
+(test-section "concurrent hash table")
+
+;; Single-threaded behavior must be the same as the ordinary tables.
+;; Tests with multiple threads are in thread.scm.
+
+(dolist [cmpr `(eq? eqv? equal? string=?
+                ,(make-comparator string? string=? #f default-hash))]
+  (let ([h (make-hash-table cmpr :concurrent #t)]
+        [keys (map number->string (iota 100))])
+    (define (k x)
+      (case cmpr
+        [(eq?) (string->symbol x)]
+        [(eqv?) (string->number x)]
+        [else (string-copy x)]))
+    (test* #"concurrent ~cmpr" '(#t 100 #t)
+           (begin
+             (dolist [x keys] (hash-table-put! h (k x) (string->number x)))
+             (list (hash-table-concurrent? h)
+                   (hash-table-num-entries h)
+                   (every (^x (eqv? (hash-table-get h (k x) #f)
+                                    (string->number x)))
+                          keys))))
+    (test* #"concurrent ~cmpr delete" '(#t #f #f 99)
+           (list (hash-table-delete! h (k "50"))
+                 (hash-table-delete! h (k "50"))
+                 (hash-table-get h (k "50") #f)
+                 (hash-table-num-entries h)))
+    (test* #"concurrent ~cmpr adjoin/replace" '(1 #f)
+           (begin
+             (hash-table-adjoin! h (k "1") 'x)
+             (hash-table-replace! h (k "50") 'y)
+             (list (hash-table-get h (k "1") #f)
+                   (hash-table-get h (k "50") #f))))
+    (test* #"concurrent ~cmpr clear" '(0 #f)
+           (begin
+             (hash-table-clear! h)
+             (list (hash-table-num-entries h)
+                   (hash-table-get h (k "1") #f))))))
+
+(let1 h (make-hash-table 'eq? 16 :concurrent #t)
+  (test* "concurrent update!" '(3 (c b a) a 10)
+         (begin
+           (hash-table-update! h 'x (cut + <> 1) 0)
+           (hash-table-update! h 'x (cut + <> 2))
+           (hash-table-push! h 'y 'a)
+           (hash-table-push! h 'y 'b)
+           (hash-table-push! h 'y 'c)
+           ;; proc can modify the table
+           (hash-table-update! h 'z (^[v] (hash-table-put! h 'w 10) v) 'ok)
+           (let* ([x (hash-table-get h 'x)]
+                  [y (hash-table-get h 'y)]
+                  [p (begin (hash-table-pop! h 'y) (hash-table-pop! h 'y)
+                            (hash-table-pop! h 'y))])
+             (list x y p (hash-table-get h 'w)))))
+  (test* "concurrent update! (no entry)" (test-error)
+         (hash-table-update! h 'nosuchkey identity))
+  (test* "concurrent pop! (not a pair)" 'none
+         (hash-table-pop! h 'x 'none))
+  (test* "concurrent iteration" '((w . 10) (x . 3) (y) (z . ok))
+         (sort (hash-table->alist h) string<?
+               (^p (symbol->string (car p)))))
+  (test* "concurrent copy" '(#t 4)
+         (let1 h2 (hash-table-copy h)
+           (hash-table-put! h 'v 0)
+           (list (hash-table-concurrent? h2)
+                 (hash-table-num-entries h2))))
+  (test* "concurrent update! doesn't expose the default" '(#f d)
+         (let1 seen #t
+           (hash-table-update! h 'u (^[v] (set! seen (hash-table-exists? h 'u))
+                                      v)
+                               'd)
+           (list seen (hash-table-get h 'u))))
+  (test* "ordinary table" #f
+         (hash-table-concurrent? (make-hash-table 'eq?))))
+
+;; The comparator may access the table itself.  It must not be called
+;; with the table's lock held.
+(letrec ([h (make-hash-table
+             (make-comparator string?
+                              (^[a b] (hash-table-keys h) (string=? a b))
+                              #f
+                              (^[s] (hash-table-values h) (default-hash s)))
+             :concurrent #t)])
+  (test* "concurrent, reentrant comparator" '(2 (1 3))
+         (begin
+           (hash-table-put! h "a" 1)
+           (hash-table-put! h "b" 2)
+           (hash-table-put! h "a" 3)
+           (hash-table-update! h "b" (cut + <> 1))
+           (hash-table-delete! h "b")
+           (hash-table-put! h "b" 1)
+           (list (hash-table-num-entries h)
+                 (sort (hash-table-values h))))))
+
 ;;------------------------------------------------------------------
 (test-section "compare as sets")
 
@@ -179,6 +179,69 @@
              (port-fd-dup! (open-input-string "") p1))))
   )) ; !gauche.os.windows
 
+;;-------------------------------------------------------------------
+(test-section "copy-port")
+
+(let1 content (with-output-to-string
+                (^[] (dotimes [i 20000] (print i))))
+  (define (file->string* f) (call-with-input-file f port->string))
+  (with-output-to-file "tmp1.o" (cut display content))
+
+  ;; Between file ports, part of data is copied directly between fds.
+  ;; Make sure the data already buffered in the source port is
+  ;; preserved.
+  (test* "copy-port file to file" (list (string-size content)
+                                        (string-size content) content)
+         (let* ([in (open-input-file "tmp1.o")]
+                [out (open-output-file "tmp2.o")]
+                [line (read-line in)]
+                [ch (peek-char in)])
+           (display line out)
+           (newline out)
+           (let1 n (copy-port in out)
+             (close-input-port in)
+             (close-output-port out)
+             (list (+ n (string-length line) 1)
+                   (~ (sys-stat "tmp2.o")'size)
+                   (file->string* "tmp2.o")))))
+
+  (test* "copy-port file to file, with size" (list 12345
+                                                   (substring content
+                                                              100 12445))
+         (let* ([in (open-input-file "tmp1.o")]
+                [out (open-output-file "tmp2.o")])
+           (read-string 100 in)
+           (let1 n (copy-port in out :size 12345)
+             (close-input-port in)
+             (close-output-port out)
+             (list n (file->string* "tmp2.o")))))
+
+  (test* "copy-port file to file, remaining" (substring content 12445
+                                                        (string-size content))
+         (let* ([in (open-input-file "tmp1.o")]
+                [out (open-output-string)])
+           (read-string 100 in)
+           (call-with-output-file "tmp3.o"
+             (^[o] (copy-port in o :size 12345)))
+           (copy-port in out)
+           (close-input-port in)
+           (get-output-string out)))
+
+  (test* "copy-port file to string" content
+         (call-with-input-file "tmp1.o"
+           (^[in] (call-with-output-string (^[out] (copy-port in out))))))
+
+  (test* "copy-port string to file" content
+         (begin
+           (call-with-output-file "tmp2.o"
+             (^[out] (copy-port (open-input-string content) out)))
+           (file->string* "tmp2.o")))
+  )
+
+(sys-unlink "tmp1.o")
+(sys-unlink "tmp2.o")
+(sys-unlink "tmp3.o")
+
 ;;-------------------------------------------------------------------
 (test-section "input ports")
 
@@ -280,6 +343,75 @@
                (and (eof-object? s3)
                     (list (string-size s1) (string-size s2)))))))
 
+(test* "read-span (string)" '("abc" "123" #\space)
+       (with-input-from-string "abc123 def"
+         (^[] (list (read-span #[a-z])
+                    (read-until-char-set #[\s])
+                    (read-char)))))
+(test* "read-span (multibyte)" '("いろは" "abc" "にほへと" #t)
+       (with-input-from-string "いろはabcにほへと"
+         (^[] (let* ([s1 (read-until-char-set #[a-z])]
+                     [s2 (read-span #[a-z])]
+                     [s3 (read-until-char-set #[a-z])])
+                (list s1 s2 s3 (eof-object? (read-span #[a-z])))))))
+(test* "read-span (empty)" '("" #\a)
+       (with-input-from-string "abc"
+         (^[] (let1 s (read-span #[0-9]) (list s (read-char))))))
+(test* "read-span (ungotten)" '(#\a "abc" #\1)
+       (with-input-from-string "abc123"
+         (^[] (let* ([c (peek-char)]
+                     [s (read-span #[a-z])])
+                (list c s (peek-char))))))
+(test* "read-string (string)" '("いろは" "にほ" #t)
+       (with-input-from-string "いろはにほ"
+         (^[] (let* ([s1 (read-string 3)]
+                     [s2 (read-string 10)])
+                (list s1 s2 (eof-object? (read-string 1)))))))
+(test* "read-string after peeking EOF (string)" '(#t #t #t)
+       (with-input-from-string "a"
+         (^[] (read-char)
+              (let* ([c (peek-char)]
+                     [s (read-string 3)])
+                (list (eof-object? c) (eof-object? s)
+                      (eof-object? (read-char)))))))
+(test* "read-span after peeking EOF (string)" '(#t #t)
+       (with-input-from-string ""
+         (^[] (peek-char)
+              (list (eof-object? (read-span #[a-z]))
+                    (begin (peek-char)
+                           (eof-object? (read-until-char-set #[a-z])))))))
+
+(let1 content (string-append (make-string 8191 #\a) "いろは\nxyz\nいろは")
+  (with-output-to-file "tmp1.o" (cut display content))
+  (test* "read-span (file, across buffer boundary)"
+         `(,(make-string 8191 #\a) "いろは\nx" "yz" 2)
+         (call-with-input-file "tmp1.o"
+           (^p (let* ([s1 (read-span #[a] p)]
+                      [s2 (read-until-char-set #[y] p)]
+                      [s3 (read-span #[yz] p)])
+                 (list s1 s2 s3 (port-current-line p))))))
+  (test* "read-until-char-set (file, to EOF)"
+         `(,(string-append (make-string 8191 #\a) "いろは\nxyz\n") "いろは" #t)
+         (call-with-input-file "tmp1.o"
+           (^p (let* ([s1 (read-span #[a-z\n] p)]
+                      [s2 (read-until-char-set #[\n] p)])
+                 (list s1 s2 (eof-object? (read-until-char-set #[\n] p)))))))
+  (test* "read-string (file)"
+         `(,(string-append (make-string 8191 #\a) "いろ") "は\nxyz\nいろは" 3)
+         (call-with-input-file "tmp1.o"
+           (^p (let* ([s1 (read-string 8193 p)]
+                      [s2 (read-string 100000 p)])
+                 (list s1 s2 (port-current-line p))))))
+  (test* "read-span (file, ungotten)" `(#\a ,(make-string 8191 #\a))
+         (call-with-input-file "tmp1.o"
+           (^p (let1 c (peek-char p) (list c (read-span #[a] p))))))
+  (test* "read-string after peeking EOF (file)" '(#t #t)
+         (call-with-input-file "tmp1.o"
+           (^p (read-string 100000 p)
+               (let1 c (peek-char p)
+                 (list (eof-object? c) (eof-object? (read-string 10 p)))))))
+  )
+
 (with-output-to-file "tmp1.o"
   (cut display "a b c \"d e\" f g\n(0 1 2\n3 4 5)\n"))
 
@@ -84,6 +84,7 @@
     system.c
     test-arith.c
     test-extra.c
+    test-mparith.c
     test-vmstack.c
     treemap.c
     vector.c
@@ -439,6 +439,24 @@
 (test* "exponent out-of-range 8" '(0.0 #t) (flonum-test "1e-1000"))
 (test* "exponent out-of-range 9" '(0.0 #t) (flonum-test "1e-1000000000000000000000000000000000000000000000000000000000000000000"))
 
+;; Numbers with up to 19 digits take a fast path; giving them extra zeros
+;; sends them to the exact algorithm.  Both must agree.
+(test* "flonum reader (fast path vs. exact path)" '()
+       (append-map
+        (^m (filter-map
+             (^e (let ([a (string->number (format "~ae~a" m e))]
+                       [b (string->number
+                           (format "~a000000000000000000000e~a" m (- e 21)))])
+                   (and (not (eqv? a b)) (list m e a b))))
+             (iota 67 -330 10)))
+        '(1 7 9007199254740993 9007199254740995 1234567890123456789
+          17976931348623157 22250738585072011 49406564584124654
+          18446744073709551615 3512007320013007 4533446235848425)))
+
+(test* "flonum reader (halfway)" '(9007199254740992 9007199254740996)
+       (map (^s (exact (string->number s)))
+            '("9007199254740993.0" "9007199254740995.0")))
+
 (test* "no integral part" 0.5 (read-from-string ".5"))
 (test* "no integral part" -0.5 (read-from-string "-.5"))
 (test* "no integral part" 0.5 (read-from-string "+.5"))
@@ -733,6 +751,30 @@
          "15" "14" "13" "12" "11")
        (map (cut number->string <> <>) (make-list 35 37) (iota 35 2)))
 
+;; Large numbers are converted by divide-and-conquer.  Powers of the
+;; radix and numbers made of repeated digit patterns have known
+;; representations.
+(let ()
+  (define (pow-test radix k)
+    (test* (format "number->string ~a^~a" radix k)
+           (string-append "1" (make-string k #\0))
+           (number->string (expt radix k) radix))
+    (test* (format "number->string ~a^~a-1" radix k)
+           (make-string k (string-ref (number->string (- radix 1) radix) 0))
+           (number->string (- (expt radix k) 1) radix)))
+  (dolist [radix '(2 3 10 16 36)]
+    (dolist [k '(100 3000 50000)]
+      (pow-test radix k)))
+  (let* ([s (apply string-append (make-list 20000 "1234567890"))]
+         [n (string->number s)])
+    (test* "string->number large" #t
+           (= n (* 1234567890 (quotient (- (expt 10 200000) 1)
+                                        (- (expt 10 10) 1)))))
+    (test* "number->string large" s (number->string n))
+    (test* "number->string large negative" (string-append "-" s)
+           (number->string (- n))))
+  )
+
 (test* "number->string radix error 1" (test-error) (number->string 42 0))
 (test* "number->string radix error 2" (test-error) (number->string 42 1))
 (test* "number->string radix error 3" (test-error) (number->string 42 37))
@@ -753,6 +795,32 @@
                      '(#f #t (uppercase) (plus) (radix) (uppercase plus radix))))
             '(#xcafe #xcafebabedeadbeef 0 -14 10/11 1+i)))
 
+;; Shortest representation
+(test* "number->string flonum (shortest)"
+       '("0.1" "0.30000000000000004" "123.456" "123456789.0" "1.0e9"
+         "0.001" "1.0e-4" "1.0e23" "9.007199254740992e15"
+         "1.7976931348623157e308" "2.2250738585072014e-308" "5.0e-324")
+       (map number->string
+            (list 0.1 (+ 0.1 0.2) 123.456 123456789.0 1e9
+                  0.001 1e-4 1e23 (expt 2.0 53)
+                  (greatest-positive-flonum) (expt 2.0 -1022)
+                  (least-positive-flonum))))
+
+;; The value is exactly halfway between two shortest candidates.
+;; The lower one is chosen if the mantissa is even, the upper otherwise.
+(test* "number->string flonum (tie)"
+       '("8.780018300032517e14" "1.1333615589621063e15")
+       (map number->string
+            (list (exact->inexact 3512007320013007/4)
+                  (exact->inexact 4533446235848425/4))))
+
+(test* "number->string flonum round trip" '()
+       (filter (^x (not (eqv? x (string->number (number->string x)))))
+               (append-map (^e (list (expt 2.0 e)
+                                     (* 1.2345678901234567 (expt 2.0 e))
+                                     (- (* 1.9999999999999998 (expt 2.0 e)))))
+                           (iota 2098 -1074))))
+
 ;; Precision
 (dolist [n '((0.123456789 "0.12346" "0.1235" "0.123" "0.12" "0.1" "0.")
              (1.23456789 "1.23457" "1.2346" "1.235" "1.23" "1.2" "1.")
@@ -1640,6 +1708,31 @@
            173462447179147555430258970864309778377421844723664084649347019061363579192879108857591038330408837177983810868451546421940712978306134189864280826014542758708589243873685563973118948869399158545506611147420216132557017260564139394366945793220968665108959685482705388072645828554151936401912464931182546092879815733057795573358504982279280090942872567591518912118622751714319229788100979251036035496917279912663527358783236647193154777091427745377038294584918917590325110939381322486044298573971650711059244462177542540706913047034664643603491382441723306598834177
            ))
 
+;; Large operands go through Karatsuba, Toom-3 and NTT multiplication
+;; depending on their sizes.  Check them against results computed
+;; only with shifts and additions, and with division.
+(let ()
+  (define (mersenne-test bits)
+    (test* (format "(2^~a-1)(2^~a+1)" bits bits)
+           (- (ash 1 (* bits 2)) 1)
+           (* (- (ash 1 bits) 1) (+ (ash 1 bits) 1))))
+  (define (product-test xbits ybits)
+    (let* ([x (+ (ash (expt 3 (quotient xbits 2)) (quotient xbits 5)) 12345)]
+           [y (- (expt 7 (quotient ybits 3)) 98765)]
+           [z (* x y)])
+      (test* (format "~a bits * ~a bits" xbits ybits)
+             (list x y #t #t)
+             (list (quotient z y) (quotient z x)
+                   (= (* y x) z)
+                   (= (modulo z 1000003)
+                      (modulo (* (modulo x 1000003) (modulo y 1000003))
+                              1000003))))))
+  (dolist [bits '(2500 10000 200000 1000000)]
+    (mersenne-test bits))
+  (dolist [xy '((3000 3000) (20000 9000) (200000 150000) (200000 5000)
+                (1000000 800000) (1000000 100000))]
+    (apply product-test xy)))
+
 ;;------------------------------------------------------------------
 (test-section "multiplication short cuts")
 
@@ -1846,6 +1939,28 @@
 (test* "big[3]/big[2] -> fix" (q-result #xeffe #t)
       (q-tester #x7800000000000000 #x80008889ffff))
 
+;; large divisors go through the recursive division
+(let ()
+  (define (large-div-test xbits ybits)
+    (let* ([y (+ (expt 7 (quotient ybits 3)) 12345)]
+           [q (- (expt 3 (quotient (- xbits ybits) 2)) 1)]
+           [r (quotient (* y 2) 3)]
+           [x (+ (* q y) r)])
+      (test* (format "big[~a bits]/big[~a bits]" xbits ybits)
+             (list q r (- q) (- r) (- -1 q) (- y r))
+             (list (quotient x y) (remainder x y)
+                   (quotient (- x) y) (remainder (- x) y)
+                   (floor-quotient (- x) y) (modulo (- x) y)))))
+  (dolist [xy '((8000 4000) (8000 7000) (50000 6000) (300000 150000)
+                (300000 290000) (1000000 200000))]
+    (apply large-div-test xy))
+  ;; divisor with all-ones words makes quotient estimation hard
+  (let* ([y (- (expt 2 20000) 1)]
+         [x (- (expt 2 50000) 1)])
+    (test* "(2^50000-1)/(2^20000-1)"
+           (list (+ (expt 2 30000) (expt 2 10000)) (- (expt 2 10000) 1))
+           (list (quotient x y) (remainder x y)))))
+
 ;; inexact quotient
 (test* "exact/inexact -> inexact" (q-result 3.0 #f)
       (q-tester 13 4.0))
@@ -2785,6 +2900,55 @@
   (test* "probit(0.975) ng pattern" 1.959964 (probit-ng 0.975) ~=)
   )
 
+;; Flonum loop variables are kept in flonum registers across iterations
+;; (PACK-FLONUM-ARGS).  Make sure the registers aren't shared incorrectly.
+(let ()
+  (define (sum n)
+    (let loop ([i 0] [acc 0.0])
+      (if (= i n) acc (loop (+ i 1) (+. acc 0.5)))))
+  (define (fib n)
+    (let loop ([i 0] [a 0.0] [b 1.0])
+      (if (= i n) a (loop (+ i 1) b (+ a b)))))
+  (define (pending n)
+    (let outer ([k 0] [y 1.5])
+      (if (= k n)
+        (list y (let loop ([a y] [i 0])
+                  (if (= i 30000) a (loop (*. a 1.0) (+ i 1)))))
+        (outer (+ k 1) (+. y 1.0)))))
+  (define (non-tail a n)
+    (let loop ([a a] [n n])
+      (if (= n 10) a (+. (loop (*. a 2.0) (+ n 1)) a))))
+  (define (nested n)
+    (let outer ([i 0] [s 0.0])
+      (if (= i n)
+        s
+        (outer (+ i 1)
+               (let inner ([j 0] [t s])
+                 (if (= j n) t (inner (+ j 1) (+. t 0.5))))))))
+  (define (captured n)
+    (let loop ([i 0] [a 0.0] [fs '()])
+      (if (= i n)
+        (map (^f (f)) fs)
+        (loop (+ i 1) (+. a 1.0) (cons (^[] a) fs)))))
+  (define (unmasked)
+    ;; y isn't a flonum loop variable, but carries a flonum register
+    ;; computed in the previous iteration.
+    (let loop ([i 0] [x 0.0] [y #f])
+      (if (= i 3) y (loop (+ i 1) (+. x 1.0) (*. x 2.0)))))
+  (define (unmasked-caller a)
+    (let1 r (unmasked)
+      (list (+. a 1.0) (+. a 2.0) r)))
+
+  (test* "flonum loop" 50000.0 (sum 100000))
+  (test* "flonum loop (swapping)" 12586269025.0 (fib 50))
+  (test* "flonum loop (pending argument)" '(3.5 3.5) (pending 2))
+  (test* "flonum loop (non-tail)" 2047.0 (non-tail 1.0 0))
+  (test* "flonum loop (nested)" 45000.0 (nested 300))
+  (test* "flonum loop (captured)" '(4.0 3.0 2.0 1.0 0.0) (captured 5))
+  (test* "flonum loop (unmasked argument)" '(11.0 12.0 4.0)
+         (unmasked-caller 10.0))
+  )
+
 ;;------------------------------------------------------------------
 (test-section "arithmetic operation overload")
 
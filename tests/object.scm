@@ -446,6 +446,75 @@
        (cons (acc-dis-1 (make <acc-dis-1>) #f)
              (acc-dis-1 (make <acc-dis-1>) 2)))
 
+;; automatically built dispatcher
+(define-generic acc-dis-3)
+(define-method acc-dis-3 ((a <top>) b) 'top)
+(define-method acc-dis-3 ((a <acc-dis-0>) (b <integer>)) 'int)
+(define-method acc-dis-3 ((a <acc-dis-0>) (b <string>)) 'str)
+(define-method acc-dis-3 ((a <acc-dis-1>) b) 'one)
+(define-method acc-dis-3 ((a <acc-dis-2>) b) 'two)
+
+(define acc-dis-info (with-module gauche.object generic-dispatcher-info))
+(define (call-acc-dis-3)
+  (map (^[a b] (acc-dis-3 a b))
+       (list (make <acc-dis-0>) (make <acc-dis-0>) (make <acc-dis-0>)
+             (make <acc-dis-1>) (make <acc-dis-2>) (make <acc-dis-3>))
+       '(1 "a" #\a 1 1 1)))
+
+(test* "auto dispatcher (before)" #f (acc-dis-info acc-dis-3))
+(test* "auto dispatcher (calls)" '(int str top one two top)
+       (last (map (^_ (call-acc-dis-3)) (iota 30))))
+(test* "auto dispatcher (built)" '(0 #t)
+       (let1 i (acc-dis-info acc-dis-3)
+         (and i (list (get-keyword :axis i) (get-keyword :automatic i)))))
+(test* "auto dispatcher (after)" '(int str top one two top)
+       (call-acc-dis-3))
+(define-method acc-dis-3 ((a <acc-dis-3>) b) 'three)
+(test* "auto dispatcher (discarded)" #f (acc-dis-info acc-dis-3))
+(test* "auto dispatcher (rebuilt)" '((int str top one two three) #t)
+       (let1 r (last (map (^_ (call-acc-dis-3)) (iota 30)))
+         (list r (boolean (acc-dis-info acc-dis-3)))))
+
+;; methods are specialized by the second arg mostly, but one method is
+;; specialized by the first arg, so axis 1 can't be used.
+(define-generic acc-dis-4)
+(define-method acc-dis-4 ((a <integer>) b) 'int)
+(define-method acc-dis-4 (a (b <acc-dis-0>)) '<acc-dis-0>)
+(define-method acc-dis-4 (a (b <acc-dis-1>)) '<acc-dis-1>)
+(define-method acc-dis-4 (a (b <acc-dis-2>)) '<acc-dis-2>)
+(define-method acc-dis-4 (a (b <acc-dis-3>)) '<acc-dis-3>)
+
+(test* "auto dispatcher (axis)" '(int <acc-dis-0> <acc-dis-3>)
+       (last (map (^_ (list (acc-dis-4 1 (make <acc-dis-0>))
+                            (acc-dis-4 'a (make <acc-dis-0>))
+                            (acc-dis-4 'a (make <acc-dis-3>))))
+                  (iota 30))))
+
+;; Call-site cache.  The same call site sees different classes, and
+;; the cached result must be dropped when methods are changed.
+(define-generic ics-1)
+(define-method ics-1 ((a <acc-dis-0>)) 'zero)
+(define-method ics-1 ((a <acc-dis-1>)) 'one)
+(define-method ics-1 (a) 'top)
+(define (call-ics-1)
+  (map (^x (ics-1 x))
+       (list (make <acc-dis-0>) (make <acc-dis-1>) (make <acc-dis-2>)
+             (make <acc-dis-3>) (make <acc-dis-4>) 1)))
+
+(test* "call-site cache (polymorphic)" '(zero one top top top top)
+       (last (map (^_ (call-ics-1)) (iota 10))))
+(define-method ics-1 ((a <acc-dis-2>)) 'two)
+(test* "call-site cache (add method)" '(zero one two top top top)
+       (last (map (^_ (call-ics-1)) (iota 10))))
+(define-method ics-1 ((a <acc-dis-0>)) (cons 'zero (next-method)))
+(test* "call-site cache (replace method)" '((zero . top) one two top top top)
+       (last (map (^_ (call-ics-1)) (iota 10))))
+(delete-method! ics-1 (car (filter (^m (equal? (~ m 'specializers)
+                                               (list <acc-dis-1>)))
+                                   (~ ics-1 'methods))))
+(test* "call-site cache (delete method)" '((zero . top) top two top top top)
+       (last (map (^_ (call-ics-1)) (iota 10))))
+
 
 ;;----------------------------------------------------------------
 (test-section "module and accessor")
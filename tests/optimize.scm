@@ -268,6 +268,46 @@
        (unwrap-syntax
         (proc->insn/split (^x (set! (getter-setter-inline-3 x) 2)))))
 
+;; Cross-module inlining of small procedures defined by plain 'define'.
+;; It's off unless SCM_COMPILE_AUTO_INLINE is set (gosh -fauto-inline).
+(define-module optimize.no-auto-inline
+  (export no-auto-inline-second)
+  (define (no-auto-inline-second x) (car (cdr x))))
+(import optimize.no-auto-inline)
+
+(test* "no auto inlining by default" 1
+       (length (filter-insn (^x (no-auto-inline-second x)) 'GREF-TAIL-CALL)))
+
+(with-module gauche.internal
+  (vm-compiler-flag-set! SCM_COMPILE_AUTO_INLINE))
+(define-module optimize.auto-inline
+  (export auto-inline-second auto-inline-twice)
+  (define (auto-inline-second x) (car (cdr x)))
+  (define (auto-inline-twice x) (+ x x)))
+(with-module gauche.internal
+  (vm-compiler-flag-clear! SCM_COMPILE_AUTO_INLINE))
+(import optimize.auto-inline)
+
+(test* "auto inlining across modules" '()
+       (filter-insn (^x (auto-inline-second x)) 'GREF-TAIL-CALL))
+(test* "auto inlining across modules" 'b
+       ((^x (auto-inline-second x)) '(a b c)))
+
+(with-module gauche.internal
+  (vm-compiler-flag-set! SCM_COMPILE_AUTO_INLINE))
+(define (auto-inline-local x) (car (cdr x)))
+(with-module gauche.internal
+  (vm-compiler-flag-clear! SCM_COMPILE_AUTO_INLINE))
+(test* "auto inlining doesn't apply within the same module" 1
+       (length (filter-insn (^x (auto-inline-local x)) 'GREF-TAIL-CALL)))
+
+(with-module optimize.auto-inline
+  (set! auto-inline-twice (^x (* x 3))))
+(test* "auto inlining is dropped after redefinition" 1
+       (length (filter-insn (^x (auto-inline-twice x)) 'GREF-TAIL-CALL)))
+(test* "auto inlining is dropped after redefinition" 6
+       ((^x (auto-inline-twice x)) 2))
+
 
 
 (test-section "lambda lifting")
@@ -291,6 +331,38 @@
                              (f b))))
                     'CLOSURE))
 
+;; A closure created in a loop and called in the same iteration gets
+;; its free variables as extra arguments, and lifted.
+(define (lifting-closure-in-loop xs)
+  (let loop ([xs xs] [acc '()])
+    (if (null? xs)
+      (reverse acc)
+      (let* ([x (car xs)]
+             [f (^[y] (list (+ x y) (* x y) (- x y) (cons x y) (vector x y)))])
+        (loop (cdr xs) (cons (f 2) (cons (f 1) acc)))))))
+
+(test* "lifting closure in a loop" '()
+       (filter-insn lifting-closure-in-loop 'CLOSURE))
+(test* "lifting closure in a loop"
+       '((11 10 9 (10 . 1) #(10 1)) (12 20 8 (10 . 2) #(10 2))
+         (21 20 19 (20 . 1) #(20 1)) (22 40 18 (20 . 2) #(20 2)))
+       (lifting-closure-in-loop '(10 20)))
+
+;; If the closure is called in an inner loop, we keep it as a closure.
+(define (lifting-closure-outside-loop n)
+  (let ([f (^[y] (list (+ n y) (* n y) (- n y) (cons n y) (vector n y)))])
+    (let loop ([i 0] [acc '()])
+      (if (= i 2)
+        (reverse acc)
+        (loop (+ i 1) (cons (f (+ i 1)) (cons (f i) acc)))))))
+
+(test* "not lifting closure outside of a loop" 1
+       (length (filter-insn lifting-closure-outside-loop 'CLOSURE)))
+(test* "not lifting closure outside of a loop"
+       '((1 0 1 (1 . 0) #(1 0)) (2 1 0 (1 . 1) #(1 1))
+         (2 1 0 (1 . 1) #(1 1)) (3 2 -1 (1 . 2) #(1 2)))
+       (lifting-closure-outside-loop 1))
+
 ;; https://github.com/shirok/Gauche/issues/826
 (test* "lifting with clambda" #t
        (procedure?
@@ -474,4 +546,96 @@
        '(((CONST-RET) b))
        (proc->insn/split (^[] (typecase-inline-tester 3))))
 
+(test-section "flonum loop variables")
+
+;; Loop variables that are proven to be flonums are kept in flonum
+;; registers across iterations.
+(test* "flonum loop variable" '(2 2)
+       (map cadr
+            (filter-insn (^[n]
+                           (let loop ([i 0] [acc 0.0])
+                             (if (= i n)
+                               acc
+                               (loop (+ i 1) (+. acc i)))))
+                         'PACK-FLONUM-ARGS)))
+(test* "flonum loop variable (swapping)" '(6 6)
+       (map cadr
+            (filter-insn (^[n]
+                           (let loop ([i 0] [a 0.0] [b 1.0])
+                             (if (= i n)
+                               a
+                               (loop (+ i 1) b (+ a b)))))
+                         'PACK-FLONUM-ARGS)))
+(test* "non-flonum loop variable" '()
+       (filter-insn (^[n x]
+                      (let loop ([i 0] [acc 0.0])
+                        (if (= i n)
+                          acc
+                          (loop (+ i 1) (+ acc x)))))
+                    'PACK-FLONUM-ARGS))
+(test* "non-flonum loop variable" '()
+       (filter-insn (^[n]
+                      (let loop ([i 0] [acc 0.0])
+                        (if (= i n)
+                          acc
+                          (loop (+ i 1) (* acc i)))))
+                    'PACK-FLONUM-ARGS))
+
+(test-section "escape analysis")
+
+;; for-each and map with a literal lambda are expanded into a loop,
+;; so no closure is created.
+(test* "for-each with literal lambda" '()
+       (filter-insn (^[lis] (for-each (^x (print x)) lis)) 'CLOSURE))
+(test* "map with literal lambda" '()
+       (filter-insn (^[lis a] (map (^x (+ x a)) lis)) 'CLOSURE))
+(test* "for-each with literal lambda" '(3 2 1)
+       (let1 r '()
+         (for-each (^x (push! r x)) '(1 2 3))
+         r))
+(test* "map with literal lambda" '(11 12 13)
+       (let1 a 10
+         (map (^x (+ x a)) '(1 2 3))))
+(test* "map with literal lambda (empty)" '()
+       (map (^x (+ x 1)) '()))
+(test* "map with literal lambda (improper)" (test-error <assertion-violation>)
+       (map (^x (+ x 1)) '(1 2 . 3)))
+(test* "for-each with literal lambda (improper)" (test-error)
+       (for-each (^x (+ x 1)) '(1 2 . 3)))
+
+;; Rest argument list that doesn't outlive the call is marked, so that
+;; VM can allocate it in one chunk.
+(define (rest-flags proc) (~ (closure-code proc)'flags))
+(define *escaped-rest* #f)
+
+(test* "non-escaping rest arg" 1
+       (rest-flags (lambda (a . r) (if (pair? r) (car r) a))))
+(test* "non-escaping rest arg (loop)" 1
+       (rest-flags (lambda r
+                     (let loop ([r r] [s 0])
+                       (if (null? r) s (loop (cdr r) (+ s (car r))))))))
+(test* "escaping rest arg (returned)" 0
+       (rest-flags (lambda r r)))
+(test* "escaping rest arg (stored)" 0
+       (rest-flags (lambda r (set! *escaped-rest* (cdr r)))))
+(test* "escaping rest arg (passed)" 0
+       (rest-flags (lambda r (length+ r))))
+(test* "escaping rest arg (captured)" 0
+       (rest-flags (lambda r (^[] (car r)))))
+
+(define (sum-rest . r)
+  (let loop ([r r] [s 0])
+    (if (null? r) s (loop (cdr r) (+ s (car r))))))
+(define (second-rest a . r) (if (pair? r) (car r) a))
+
+(test* "non-escaping rest arg call" 15 (sum-rest 1 2 3 4 5))
+(test* "non-escaping rest arg call" 0 (sum-rest))
+(test* "non-escaping rest arg apply" 15 (apply sum-rest 1 2 '(3 4 5)))
+(test* "non-escaping rest arg apply" 15 (apply sum-rest '(1 2 3 4 5)))
+(test* "non-escaping rest arg apply" 1.5 (apply second-rest 0 '(1.5)))
+(test* "non-escaping rest arg apply" '(1 2 3)
+       (let1 lis (list 1 2 3)
+         (apply second-rest 0 lis)
+         lis))
+
 (test-end)
@@ -712,6 +712,88 @@
               [e (string-index->cursor str 6)])
          (rxmatch->full-match "abc$" "zzzabczz" s e)))
 
+;;-------------------------------------------------------------------------
+(test-section "pathological patterns")
+
+;; These take exponential time with a backtracking matcher.  Since they
+;; don't have backreferences or lookaround assertions, they are run by
+;; the lazy DFA.
+(let ([s (make-string 10000 #\a)])
+  (test* "(a|aa)*b (no match)" #f (rxmatch #/(a|aa)*b/ s))
+  (test* "(a|aa)*b (match)" '(10001 "a")
+         (let1 m (rxmatch #/(a|aa)*b/ (string-append s "b"))
+           (list (string-length (m 0)) (m 1))))
+  (test* "(a|aa)*c (match at the end)" '(10001 "c" #f)
+         (let1 m (rxmatch #/(a|aa)*c/ (string-append s "bc"))
+           (list (rxmatch-start m) (m 0) (m 1))))
+  (test* "(x+x+)+y" #f (rxmatch #/(x+x+)+y/ (make-string 10000 #\x)))
+  (test* "words with optional spaces" #f (rxmatch #/^(\w+\s?)*$/ (string-append s "!")))
+  (test* "multibyte" '("あいう" "い")
+         (rxmatch-substrings
+          (rxmatch #/あ(い|いい)*う/ (string-append s "あいう" s)))))
+
+;; Transitions by non-ASCII chars are cached per state.  Run the same
+;; regexp repeatedly so that the second run goes through the cache.
+(let ([s (string-append (make-string 1000 #\い) "あえ" (make-string 10 #\お))]
+      [rx #/あ[うえ]お*$/])
+  (test* "multibyte (cached transitions)" '("あえおおおおおおおおおお" #t)
+         (let* ([m1 (rxmatch-substring (rxmatch rx s))]
+                [m2 (rxmatch-substring (rxmatch rx s))])
+           (list m1 (equal? m1 m2))))
+  (test* "multibyte (cached transitions, no match)" '(#f #f)
+         (list (rxmatch rx (string-append s "か"))
+               (rxmatch rx (string-append s "か")))))
+
+;;-------------------------------------------------------------------------
+(test-section "regexp set")
+
+(let ([rs (make-regexp-set `(#/^GET / #/\.html$/ "^POST "
+                             #/(\w+)-\1/   ; backref; not in the DFA
+                             #/\bfoo\b/ #/^$/))])
+  (test* "regexp-set?" '(#t #f) (list (regexp-set? rs) (regexp-set? #/a/)))
+  (test* "regexp-set-size" 6 (regexp-set-size rs))
+  (test* "regexp-set-regexps" #t
+         (every regexp? (regexp-set-regexps rs)))
+  (test* "regexp-set-match" '(0 1) (regexp-set-match rs "GET /index.html"))
+  (test* "regexp-set-match" '(2) (regexp-set-match rs "POST /form"))
+  (test* "regexp-set-match" '() (regexp-set-match rs "PUT /x"))
+  (test* "regexp-set-match (backref)" '(3 4)
+         (regexp-set-match rs "foo bar-bar"))
+  (test* "regexp-set-match (word boundary)" '()
+         (regexp-set-match rs "foobar"))
+  (test* "regexp-set-match (empty)" '(5) (regexp-set-match rs ""))
+  (test* "regexp-set-match (start/end)" '(0 4)
+         (regexp-set-match rs "xGET foo" 1))
+  (test* "regexp-set-match (start/end)" '(1)
+         (regexp-set-match rs "a.html?x" 0 6))
+  ;; Consistent with individual matching
+  (let1 inputs '("GET /a.html" "foo" "GET foo.html" "abc-abc.html"
+                 "POST foo" "いろは.html" "GET" "")
+    (test* "regexp-set-match vs rxmatch"
+           (map (^s (filter-map (^[rx i] (and (rxmatch rx s) i))
+                                (regexp-set-regexps rs) (iota 6)))
+                inputs)
+           (map (cut regexp-set-match rs <>) inputs))))
+
+(test* "empty regexp set" '() (regexp-set-match (make-regexp-set '()) "abc"))
+(test* "regexp set with many patterns" '(3 33 333)
+       (regexp-set-match
+        (make-regexp-set (map (^i (string->regexp #"x~|i|y")) (iota 500)))
+        "x33y x333y x3y"))
+;; Hundreds of patterns exercise many states; the result must stay the
+;; same as individual matching even if the state cache is flushed.
+(let* ([rxs (map (^i (string->regexp #"~|i|[a-z]+~|i|")) (iota 300))]
+       [rs (make-regexp-set rxs)]
+       [input (string-join (map (^i #"~|i|xyz~(+ i 1)") (iota 200)) " ")])
+  (test* "regexp set with many states"
+         (filter-map (^[rx i] (and (rxmatch rx input) i)) rxs (iota 300))
+         (regexp-set-match rs input)))
+(test* "regexp set, pathological" '(1)
+       (regexp-set-match (make-regexp-set '(#/(a|aa)*b/ #/(a|aa)*$/))
+                         (make-string 10000 #\a)))
+(test* "make-regexp-set (bad element)" (test-error)
+       (make-regexp-set '(#/a/ 1)))
+
 ;;-------------------------------------------------------------------------
 (test-section "regexp macros")
 
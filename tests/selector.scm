@@ -97,4 +97,98 @@
          (selector-select *sel* 0)
          (list *x* *y*)))
 
+;; backends
+
+(define (test-backend backend)
+  (let ([sel (make <selector> :backend backend)]
+        [got '()])
+    (define (note! . xs) (set! got (cons xs got)))
+    (receive (in out) (sys-pipe)
+      (test* #"make (~backend)" (or backend #t)
+             (if backend
+               (slot-ref sel 'backend)
+               (boolean (memq (slot-ref sel 'backend) '(epoll poll select)))))
+      (test* #"selector-select (~backend, timeout)" 0
+             (begin (selector-add! sel in (^[p f] (note! (read p) f)) '(r))
+                    (selector-select sel 1000)))
+      (test* #"selector-select (~backend, read)" '(((hello) r))
+             (begin (write '(hello) out) (flush out)
+                    (selector-select sel 0)
+                    got))
+      (test* #"selector-wait (~backend)" `((,out w))
+             (begin (selector-add! sel out (^ _ #f) '(w))
+                    (selector-wait sel 0)))
+      (test* #"selector-add! replaces (~backend)" '((#t r) ((hello) r))
+             (begin (selector-delete! sel out #f #f)
+                    (selector-add! sel in (^[p f] (read p) (note! #t f)) '(r))
+                    (write '(bye) out) (flush out)
+                    (selector-select sel 0)
+                    got))
+      (test* #"selector-delete! (~backend, closed port)" '()
+             (begin (close-port in)
+                    (selector-delete! sel in #f #f)
+                    (selector-wait sel 0)))
+      (close-port out))
+    ;; epoll refuses regular files; they're always ready, as with select.
+    (with-output-to-file "test.o" (cut write '(file)))
+    (call-with-input-file "test.o"
+      (^[in]
+        (test* #"selector-select (~backend, file)" '(((file) r))
+               (begin (set! got '())
+                      (selector-add! sel in (^[p f] (note! (read p) f)) '(r))
+                      (selector-select sel 1000000)
+                      got))
+        (selector-delete! sel in #f #f)))
+    (sys-unlink "test.o")))
+
+(test-backend #f)
+(test-backend 'select)
+(cond-expand
+ [gauche.sys.poller
+  (test-backend 'poll)
+  (cond-expand
+   [linux (test-backend 'epoll)]
+   [else])]
+ [else])
+
+(test* "invalid backend" (test-error) (make <selector> :backend 'foo))
+
+;; timers
+
+(test* "selector-add-timer!" '(a b)
+       (let ([sel (make <selector>)]
+             [got '()])
+         (selector-add-timer! sel 0.05 (^[] (push! got 'b)))
+         (selector-add-timer! sel 0.01 (^[] (push! got 'a)))
+         (let loop ([n 0])
+           (when (and (< n 10) (< (length got) 2))
+             (selector-select sel 1000000)
+             (loop (+ n 1))))
+         (reverse got)))
+
+(test* "selector-select returns at timeout" 0
+       (let1 sel (make <selector>)
+         (selector-add-timer! sel 10 (^[] #f))
+         (selector-select sel 20000)))
+
+(test* "selector-delete-timer!" '(b)
+       (let ([sel (make <selector>)]
+             [got '()])
+         (let1 t (selector-add-timer! sel 0.01 (^[] (push! got 'a)))
+           (selector-add-timer! sel 0.03 (^[] (push! got 'b)))
+           (selector-delete-timer! sel t)
+           (selector-select sel 1000000)
+           got)))
+
+(test* "timer and I/O" '(io timer)
+       (let ([sel (make <selector>)]
+             [got '()])
+         (receive (in out) (sys-pipe)
+           (selector-add! sel in (^[p f] (read-char p) (push! got 'io)) '(r))
+           (selector-add-timer! sel 0.02 (^[] (push! got 'timer)))
+           (display "x" out) (flush out)
+           (selector-select sel 1000000)
+           (selector-select sel 1000000)
+           (reverse got))))
+
 (test-end)
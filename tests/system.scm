@@ -841,6 +841,54 @@
   ]
  [else]) ; cond-expand gauche.sys.select
 
+;;-------------------------------------------------------------------
+(test-section "poller")
+
+(cond-expand
+ [gauche.sys.poller
+  (dolist [kind (cond-expand [linux '(epoll poll)] [else '(poll)])]
+    (let1 poller (sys-poller-open kind)
+      (test* #"sys-poller-open (~kind)" kind (sys-poller-kind poller))
+      (receive (in out) (sys-pipe)
+        (test* #"sys-poller-wait (~kind, timeout)" '()
+               (begin (sys-poller-add! poller in '(r))
+                      (sys-poller-wait poller 0)))
+        (test* #"sys-poller-wait (~kind, write)"
+               `((,(port-file-number out) w))
+               (begin (sys-poller-add! poller out '(w))
+                      (sys-poller-wait poller '(0 0))))
+        (test* #"sys-poller-wait (~kind, read)"
+               `((,(port-file-number in) r))
+               (begin (sys-poller-delete! poller out)
+                      (display "x" out) (flush out)
+                      (sys-poller-wait poller 100000)))
+        (test* #"sys-poller-wait (~kind, modify)" '()
+               (begin (sys-poller-add! poller in '(x))
+                      (sys-poller-wait poller 0)))
+        (test* #"sys-poller-wait (~kind, delete)" '()
+               (begin (sys-poller-delete! poller in)
+                      (sys-poller-delete! poller in) ;no error
+                      (sys-poller-wait poller 0)))
+        (close-port in)
+        (close-port out))
+      ;; epoll refuses regular files; they're always ready, as with poll.
+      (with-output-to-file "test.o" (cut display "abc"))
+      (call-with-input-file "test.o"
+        (^[in]
+          (test* #"sys-poller-wait (~kind, file)"
+                 `((,(port-file-number in) r))
+                 (begin (sys-poller-add! poller in '(r))
+                        (sys-poller-wait poller 100000)))
+          (test* #"sys-poller-wait (~kind, file deleted)" '()
+                 (begin (sys-poller-delete! poller in)
+                        (sys-poller-wait poller 0)))))
+      (sys-unlink "test.o")
+      (sys-poller-close poller)
+      (test* #"sys-poller-close (~kind)" (test-error)
+             (sys-poller-wait poller 0))))
+  ]
+ [else])
+
 ;;-------------------------------------------------------------------
 (test-section "signal handling")
 
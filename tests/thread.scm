@@ -896,8 +896,38 @@
                         (make-mtqueue :max-length 0)
                         100 3)
 
+(test-producer-consumer "(mpmc queue)"
+                        (make-mpmc-queue 4)
+                        100 3)
+
+(let ()
+  (define q (make-mpmc-queue 8))
+  (define ndata 1000)
+  (define nthreads 4)
+  (define (producer k)
+    (dotimes [i ndata] (enqueue/wait! q (+ (* k ndata) i))))
+  (define (consumer)
+    (let loop ([r '()])
+      (let1 x (dequeue/wait! q 1 #f)
+        (if x (loop (cons x r)) r))))
+  (test* "mpmc queue (multiple producers and consumers)"
+         (iota (* ndata nthreads))
+         (let* ([cs (map (^_ (thread-start! (make-thread consumer)))
+                         (iota nthreads))]
+                [ps (map (^k (thread-start! (make-thread (cut producer k))))
+                         (iota nthreads))])
+           (for-each thread-join! ps)
+           (append-map thread-join! cs))
+         (^[a b] (equal? a (sort b)))))
+
 (test* "dequeue/wait! timeout" "timed out!"
        (dequeue/wait! (make-mtqueue) 0.01 "timed out!"))
+(test* "dequeue/wait! timeout (mpmc)" "timed out!"
+       (dequeue/wait! (make-mpmc-queue 1) 0.01 "timed out!"))
+(test* "enqueue/wait! timeout (mpmc)" "timed out!"
+       (let1 q (make-mpmc-queue 1)
+         (enqueue! q 'a)
+         (enqueue/wait! q 'b 0.01 "timed out!")))
 (test* "enqueue/wait! timeout" "timed out!"
        (let1 q (make-mtqueue :max-length 1)
          (enqueue! q 'a)
@@ -985,6 +1015,20 @@
          (let1 q (make-mtqueue)
            (enqueue/wait! q 'a #f #f #t)
            (~ q'closed)))
+  (test* "close mpmc queue without inserting item (timeout)"
+         'oops
+         (let* ([q (make-mpmc-queue 4)]
+                [t (thread-start!
+                    (make-thread (^[] (dequeue/wait! q 100 'oops))))])
+           (mtqueue-close! q)
+           (guard (e [(<uncaught-exception> e)
+                      (raise (~ e'reason))])
+             (thread-join! t))))
+  (test* "closed mpmc queue makes enqueue/wait give up"
+         'gave-up
+         (let1 q (make-mpmc-queue 4)
+           (dequeue/wait! q 0 #f #t)
+           (enqueue/wait! q 'a #f 'gave-up #f #f)))
   (test* "multiple mtqueue-close! is ok"
          '(#f :queue-closed)
          (let* ([q (make-mtqueue)]
@@ -1067,6 +1111,34 @@
   ;;((with-module gauche.internal memo-table-dump) string-hash-tab)
   )
 
+;;---------------------------------------------------------------------
+(test-section "concurrent hash tables")
+
+(let ([tab (make-hash-table 'eqv? :concurrent #t)]
+      [nthreads 16]
+      [nkeys 200])
+  (define (worker id)
+    (^[]
+      (dotimes [i nkeys]
+        (hash-table-update! tab i (cut + <> 1) 0)
+        (hash-table-push! tab (- -1 i) id)
+        (hash-table-put! tab (+ nkeys (* id nkeys) i) i)
+        (when (odd? i)
+          (hash-table-delete! tab (+ nkeys (* id nkeys) i))))))
+
+  (test* "concurrent updates" (list (make-list nkeys nthreads)
+                                    (make-list nkeys nthreads)
+                                    (* nthreads (quotient nkeys 2)))
+         (begin
+           ($ for-each thread-join!
+              $ map (^i (thread-start! (make-thread (worker i))))
+              $ iota nthreads)
+           (list (map (cut hash-table-get tab <>) (iota nkeys))
+                 (map (^i (length (hash-table-get tab (- -1 i))))
+                      (iota nkeys))
+                 (- (hash-table-num-entries tab) (* 2 nkeys)))))
+  )
+
 ;;---------------------------------------------------------------------
 (test-section "looping thread")
 